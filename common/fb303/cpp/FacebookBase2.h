@@ -9,17 +9,32 @@
  */
 #pragma once
 
+#include <map>
+#include <string>
+#include "common/fb303/if/gen-cpp2/FacebookService.h"
+#include "common/stats/ServiceData.h"
+#include "common/stats/ThreadCachedServiceData.h"
+
 namespace folly {
 class EventBaseManager;
 }
 
 namespace facebook { namespace fb303 {
 
-class FacebookBase2 {
+/**
+ * A base class for thrift handlers that implements the fb303 getCounters()
+ * call by exporting everything recorded in fbData.
+ */
+class FacebookBase2 : virtual public cpp2::FacebookServiceSvIf {
 public:
   explicit FacebookBase2(const char*) {}
 
   void setEventBaseManager(folly::EventBaseManager*) {}
+
+  void getCounters(std::map<std::string, int64_t>& result) override {
+    stats::ThreadCachedServiceData::get()->publishStats();
+    fbData->getCounters(result);
+  }
 };
 
 }}
@@ -9,8 +9,314 @@
  */
 #include "common/stats/ServiceData.h"
 
-static facebook::stats::ServiceData payload;
+#include <folly/Array.h>
+#include <folly/Conv.h>
+#include <folly/stats/Histogram.h>
+#include <folly/stats/MultiLevelTimeSeries.h>
+#include <folly/stats/TimeseriesHistogram.h>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+using folly::StringPiece;
+using std::chrono::seconds;
+
+namespace facebook { namespace stats {
+
+namespace {
+constexpr unsigned int kNumTimeseriesBuckets{60};
+constexpr auto kDurations = folly::make_array(
+    seconds(60),
+    seconds(600),
+    seconds(3600),
+    seconds(0));
+
+folly::MultiLevelTimeSeries<int64_t> makeTimeseries() {
+  return folly::MultiLevelTimeSeries<int64_t>{
+      kNumTimeseriesBuckets, kDurations.size(), kDurations.data()};
+}
+
+/** Returns the suffix of the exported name for one of the levels. */
+std::string levelSuffix(size_t level) {
+  auto duration = kDurations[level];
+  if (duration.count() == 0) {
+    return std::string{};
+  }
+  return folly::to<std::string>(".", duration.count());
+}
+
+const char* exportTypeName(ExportType type) {
+  switch (type) {
+    case SUM:
+      return "sum";
+    case COUNT:
+      return "count";
+    case AVG:
+      return "avg";
+    case RATE:
+      return "rate";
+    case PERCENT:
+      return "pct";
+    case NUM_TYPES:
+      break;
+  }
+  throw std::invalid_argument(
+      folly::to<std::string>("invalid stat export type ", int(type)));
+}
+
+/**
+ * Export the values of a MultiLevelTimeSeries or TimeseriesHistogram, which
+ * share the same accessors.
+ */
+template <typename Series>
+void exportSeries(
+    StringPiece key,
+    Series& series,
+    const std::vector<ExportType>& types,
+    std::map<std::string, int64_t>& result) {
+  for (auto type : types) {
+    auto prefix = folly::to<std::string>(key, ".", exportTypeName(type));
+    for (size_t level = 0; level < kDurations.size(); ++level) {
+      int64_t value = 0;
+      switch (type) {
+        case SUM:
+          value = series.sum(level);
+          break;
+        case COUNT:
+          value = series.count(level);
+          break;
+        case AVG:
+          value = series.template avg<int64_t>(level);
+          break;
+        case RATE:
+          value = series.template rate<int64_t>(level);
+          break;
+        case PERCENT:
+          value = series.template avg<double>(level) * 100;
+          break;
+        case NUM_TYPES:
+          break;
+      }
+      result[prefix + levelSuffix(level)] = value;
+    }
+  }
+}
+
+void addExportType(std::vector<ExportType>& types, ExportType type) {
+  if (std::find(types.begin(), types.end(), type) == types.end()) {
+    types.push_back(type);
+  }
+}
+}
+
+struct ServiceData::StatData {
+  struct State {
+    folly::MultiLevelTimeSeries<int64_t> series{makeTimeseries()};
+    std::vector<ExportType> types;
+  };
+  folly::Synchronized<State> state;
+};
+
+struct ServiceData::HistogramData {
+  HistogramData(int64_t bucketWidth, int64_t min, int64_t max)
+      : state{folly::construct_in_place, bucketWidth, min, max} {}
+
+  struct State {
+    State(int64_t bucketWidth, int64_t min, int64_t max)
+        : histogram{bucketWidth, min, max, makeTimeseries()} {}
+
+    folly::TimeseriesHistogram<int64_t> histogram;
+    std::vector<ExportType> types;
+    std::vector<int> percentiles;
+  };
+  folly::Synchronized<State> state;
+};
+
+ServiceData::ServiceData() {}
+
+ServiceData::~ServiceData() {}
+
+seconds ServiceData::now() {
+  return std::chrono::duration_cast<seconds>(
+      std::chrono::steady_clock::now().time_since_epoch());
+}
+
+void ServiceData::setCounter(StringPiece key, int64_t value) {
+  auto counters = counters_.wlock();
+  (*counters)[key.str()] = value;
+}
+
+int64_t ServiceData::incrementCounter(StringPiece key, int64_t amount) {
+  auto counters = counters_.wlock();
+  auto& value = (*counters)[key.str()];
+  value += amount;
+  return value;
+}
+
+int64_t ServiceData::getCounter(StringPiece key) const {
+  auto counters = counters_.rlock();
+  auto it = counters->find(key.str());
+  if (it == counters->end()) {
+    throw std::invalid_argument(
+        folly::to<std::string>("no counter named ", key));
+  }
+  return it->second;
+}
+
+void ServiceData::clearCounter(StringPiece key) {
+  counters_.wlock()->erase(key.str());
+}
+
+std::shared_ptr<ServiceData::StatData> ServiceData::getOrCreateStat(
+    StringPiece key) {
+  {
+    auto stats = stats_.rlock();
+    auto it = stats->find(key.str());
+    if (it != stats->end()) {
+      return it->second;
+    }
+  }
+
+  auto stats = stats_.wlock();
+  auto& stat = (*stats)[key.str()];
+  if (!stat) {
+    stat = std::make_shared<StatData>();
+  }
+  return stat;
+}
+
+void ServiceData::addStatExportType(StringPiece key, ExportType type) {
+  exportTypeName(type); // Throws if the type is invalid
+  auto stat = getOrCreateStat(key);
+  addExportType(stat->state.wlock()->types, type);
+}
+
+void ServiceData::addStatValue(StringPiece key, int64_t value) {
+  auto stat = getOrCreateStat(key);
+  stat->state.wlock()->series.addValue(now(), value);
+}
+
+void ServiceData::addStatValue(
+    StringPiece key,
+    int64_t value,
+    ExportType type) {
+  exportTypeName(type); // Throws if the type is invalid
+  auto stat = getOrCreateStat(key);
+  auto state = stat->state.wlock();
+  addExportType(state->types, type);
+  state->series.addValue(now(), value);
+}
+
+void ServiceData::addStatValueAggregated(
+    StringPiece key,
+    int64_t total,
+    int64_t numSamples,
+    seconds now) {
+  auto stat = getOrCreateStat(key);
+  stat->state.wlock()->series.addValueAggregated(now, total, numSamples);
+}
+
+void ServiceData::addHistogram(
+    StringPiece key,
+    int64_t bucketWidth,
+    int64_t min,
+    int64_t max) {
+  auto histograms = histograms_.wlock();
+  auto& histogram = (*histograms)[key.str()];
+  if (!histogram) {
+    histogram = std::make_shared<HistogramData>(bucketWidth, min, max);
+  }
+}
+
+std::shared_ptr<ServiceData::HistogramData> ServiceData::getHistogram(
+    StringPiece key) const {
+  auto histograms = histograms_.rlock();
+  auto it = histograms->find(key.str());
+  if (it == histograms->end()) {
+    throw std::invalid_argument(
+        folly::to<std::string>("no histogram named ", key));
+  }
+  return it->second;
+}
+
+void ServiceData::exportHistogramPercentile(StringPiece key, int percentile) {
+  if (percentile < 0 || percentile > 100) {
+    throw std::invalid_argument(
+        folly::to<std::string>("invalid percentile ", percentile));
+  }
+  auto histogram = getHistogram(key);
+  auto state = histogram->state.wlock();
+  auto& percentiles = state->percentiles;
+  if (std::find(percentiles.begin(), percentiles.end(), percentile) ==
+      percentiles.end()) {
+    percentiles.push_back(percentile);
+  }
+}
+
+void ServiceData::exportHistogram(StringPiece key, ExportType type) {
+  exportTypeName(type); // Throws if the type is invalid
+  auto histogram = getHistogram(key);
+  addExportType(histogram->state.wlock()->types, type);
+}
+
+void ServiceData::addHistogramValue(StringPiece key, int64_t value) {
+  auto histogram = getHistogram(key);
+  histogram->state.wlock()->histogram.addValue(now(), value);
+}
+
+void ServiceData::addHistogramValues(
+    StringPiece key,
+    const folly::Histogram<int64_t>& values,
+    seconds now) {
+  auto histogram = getHistogram(key);
+  histogram->state.wlock()->histogram.addValues(now, values);
+}
+
+void ServiceData::getCounters(std::map<std::string, int64_t>& result) {
+  {
+    auto counters = counters_.rlock();
+    for (const auto& entry : *counters) {
+      result[entry.first] = entry.second;
+    }
+  }
+
+  // Copy the maps, so that we don't hold the map locks while computing the
+  // exported values of each entry.
+  auto currentTime = now();
+  auto stats = *stats_.rlock();
+  for (const auto& entry : stats) {
+    auto state = entry.second->state.wlock();
+    state->series.update(currentTime);
+    exportSeries(entry.first, state->series, state->types, result);
+  }
+
+  auto histograms = *histograms_.rlock();
+  for (const auto& entry : histograms) {
+    auto state = entry.second->state.wlock();
+    auto& histogram = state->histogram;
+    histogram.update(currentTime);
+    exportSeries(entry.first, histogram, state->types, result);
+    for (auto pct : state->percentiles) {
+      auto prefix = folly::to<std::string>(entry.first, ".p", pct);
+      for (size_t level = 0; level < kDurations.size(); ++level) {
+        result[prefix + levelSuffix(level)] =
+            histogram.getPercentileEstimate(pct, level);
+      }
+    }
+  }
+}
+
+std::map<std::string, int64_t> ServiceData::getCounters() {
+  std::map<std::string, int64_t> result;
+  getCounters(result);
+  return result;
+}
+
+}
+
+// This is intentionally leaked, so that it remains usable by thread-local
+// and static objects that publish their final values while being destroyed
+// at exit.
+stats::ServiceData* fbData = new stats::ServiceData();
 
-namespace facebook {
-facebook::stats::ServiceData* fbData = &payload;
 }
@@ -9,27 +9,146 @@
  */
 #pragma once
 
-#include "common/stats/ExportedStatMap.h"
-#include "common/stats/ExportedHistogramMap.h"
+#include <folly/Range.h>
+#include <folly/Synchronized.h>
+#include <chrono>
 #include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "common/stats/ExportedStatMap.h"
+
+namespace folly {
+template <typename T>
+class Histogram;
+}
 
 namespace facebook { namespace stats {
 
+/**
+ * ServiceData holds the counters, timeseries stats and histograms that a
+ * process exports through the fb303 getCounters() call.
+ *
+ * This is a self-contained implementation for the open source build, built
+ * on top of the folly stats classes.
+ *
+ * - Counters are plain values that are set or incremented directly.
+ * - Stats record a stream of values, and export their sum, count, average,
+ *   rate or percent over the last minute, 10 minutes, hour, and all time.
+ *   Exported names have the form "<key>.<type>.<seconds>", or
+ *   "<key>.<type>" for the all time value.
+ * - Histograms additionally export percentile estimates, named
+ *   "<key>.p<percentile>.<seconds>".
+ *
+ * All methods are thread-safe.  Each stat and histogram has its own lock, so
+ * updates to different keys do not contend with each other.  Code that
+ * updates the same key from many threads should use the thread-cached
+ * wrappers in ThreadCachedServiceData.h, which only touch the shared data
+ * about once per second per thread.
+ */
 class ServiceData {
 public:
-  ExportedStatMap* getStatMap() {
-    static ExportedStatMap it;
-    return &it;
-  }
-  ExportedHistogramMap* getHistogramMap() {
-    static ExportedHistogramMap it;
-    return &it;
-  }
-  void getCounters(std::map<std::string, int64_t>&) {}
-  long getCounter(std::string) {return 0;};
-  long clearCounter(std::string) {return 0;};
+  ServiceData();
+  ~ServiceData();
+
+  /*
+   * Counters
+   */
+  void setCounter(folly::StringPiece key, int64_t value);
+  int64_t incrementCounter(folly::StringPiece key, int64_t amount = 1);
+  /**
+   * Get the current value of a counter.
+   *
+   * Throws std::invalid_argument if the counter does not exist.
+   */
+  int64_t getCounter(folly::StringPiece key) const;
+  void clearCounter(folly::StringPiece key);
+
+  /*
+   * Timeseries stats
+   */
+
+  /**
+   * Export a stat with the specified type.  A stat may be exported with
+   * several types.  This is a no-op if the stat already exports this type.
+   */
+  void addStatExportType(folly::StringPiece key, ExportType type);
+  void addStatValue(folly::StringPiece key, int64_t value = 1);
+  void addStatValue(folly::StringPiece key, int64_t value, ExportType type);
+  /** Add numSamples values, which sum to total, to a stat at once. */
+  void addStatValueAggregated(
+      folly::StringPiece key,
+      int64_t total,
+      int64_t numSamples,
+      std::chrono::seconds now);
+
+  /*
+   * Histograms
+   */
+
+  /**
+   * Define a histogram.
+   *
+   * Values below min or above max are counted in separate underflow and
+   * overflow buckets.  This is a no-op if the histogram already exists.
+   */
+  void addHistogram(
+      folly::StringPiece key,
+      int64_t bucketWidth,
+      int64_t min,
+      int64_t max);
+  /** Export an estimate of the specified percentile of a histogram. */
+  void exportHistogramPercentile(folly::StringPiece key, int percentile);
+  /** Export the sum, count, average or rate of all values in a histogram. */
+  void exportHistogram(folly::StringPiece key, ExportType type);
+
+  /**
+   * Add a value to a histogram previously defined with addHistogram().
+   *
+   * Throws std::invalid_argument if the histogram does not exist.
+   */
+  void addHistogramValue(folly::StringPiece key, int64_t value);
+  /**
+   * Add all of the values in a folly::Histogram to a histogram.
+   *
+   * The folly::Histogram must use the same bucket configuration as the
+   * histogram.  This is used to publish values that were cached per thread.
+   */
+  void addHistogramValues(
+      folly::StringPiece key,
+      const folly::Histogram<int64_t>& values,
+      std::chrono::seconds now);
+
+  /*
+   * Export
+   */
+
+  /** Add the value of every exported counter, stat and histogram to result. */
+  void getCounters(std::map<std::string, int64_t>& result);
+  std::map<std::string, int64_t> getCounters();
+
   void setUseOptionsAsFlags(bool) {}
-  void setCounter(folly::StringPiece, uint32_t) {}
+
+  /**
+   * Returns the current time in seconds, as used for the timestamps of stat
+   * and histogram values.
+   */
+  static std::chrono::seconds now();
+
+private:
+  struct StatData;
+  struct HistogramData;
+
+  template <typename Data>
+  using DataMap = folly::Synchronized<
+      std::unordered_map<std::string, std::shared_ptr<Data>>>;
+
+  std::shared_ptr<StatData> getOrCreateStat(folly::StringPiece key);
+  std::shared_ptr<HistogramData> getHistogram(folly::StringPiece key) const;
+
+  folly::Synchronized<std::unordered_map<std::string, int64_t>> counters_;
+  DataMap<StatData> stats_;
+  DataMap<HistogramData> histograms_;
 };
 
 }
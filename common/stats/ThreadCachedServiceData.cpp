@@ -0,0 +1,171 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ThreadCachedServiceData.h"
+
+#include "common/stats/ServiceData.h"
+
+using folly::StringPiece;
+using std::chrono::seconds;
+
+namespace facebook { namespace stats {
+
+ThreadCachedServiceData* ThreadCachedServiceData::get() {
+  // This is intentionally leaked, like fbData, so that thread-local stats
+  // can still unregister themselves while threads exit at shutdown.
+  static auto* instance = new ThreadCachedServiceData();
+  return instance;
+}
+
+void ThreadCachedServiceData::publishStats() {
+  // Holding the registry lock while publishing prevents stats from being
+  // destroyed underneath us.  Stats only take the registry lock while they
+  // are being constructed or destroyed, so this does not block updates.
+  auto stats = stats_.wlock();
+  for (auto* stat : *stats) {
+    stat->publish();
+  }
+}
+
+void ThreadCachedServiceData::TLStat::registerStat() {
+  ThreadCachedServiceData::get()->stats_.wlock()->insert(this);
+}
+
+void ThreadCachedServiceData::TLStat::unregisterStat() {
+  ThreadCachedServiceData::get()->stats_.wlock()->erase(this);
+}
+
+void ThreadCachedServiceData::TLStat::publish() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  publishLocked(ServiceData::now());
+}
+
+/*
+ * TLTimeseries
+ */
+
+ThreadCachedServiceData::TLTimeseries::TLTimeseries(
+    ThreadLocalStatsMap* map,
+    StringPiece name,
+    ExportType type)
+    : TLTimeseries{map, name, type, type} {}
+
+ThreadCachedServiceData::TLTimeseries::TLTimeseries(
+    ThreadLocalStatsMap*,
+    StringPiece name,
+    ExportType type1,
+    ExportType type2)
+    : TLStat{name}, type1_{type1}, type2_{type2} {
+  fbData->addStatExportType(name_, type1_);
+  fbData->addStatExportType(name_, type2_);
+  registerStat();
+}
+
+ThreadCachedServiceData::TLTimeseries::TLTimeseries(
+    TLTimeseries&& other) noexcept
+    : TLStat{other.name_}, type1_{other.type1_}, type2_{other.type2_} {
+  {
+    std::lock_guard<std::mutex> guard(other.mutex_);
+    sum_ = other.sum_;
+    count_ = other.count_;
+    other.sum_ = 0;
+    other.count_ = 0;
+  }
+  registerStat();
+}
+
+ThreadCachedServiceData::TLTimeseries::~TLTimeseries() {
+  unregisterStat();
+  publish();
+}
+
+void ThreadCachedServiceData::TLTimeseries::addValue(int64_t value) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  sum_ += value;
+  ++count_;
+  maybePublishLocked(ServiceData::now());
+}
+
+void ThreadCachedServiceData::TLTimeseries::publishLocked(seconds now) {
+  lastPublish_ = now;
+  if (count_ == 0) {
+    return;
+  }
+  fbData->addStatValueAggregated(name_, sum_, count_, now);
+  sum_ = 0;
+  count_ = 0;
+}
+
+/*
+ * TLHistogram
+ */
+
+ThreadCachedServiceData::TLHistogram::TLHistogram(
+    TLHistogram&& other) noexcept
+    : TLStat{other.name_},
+      pending_{other.pending_.getBucketSize(),
+               other.pending_.getMin(),
+               other.pending_.getMax()} {
+  {
+    std::lock_guard<std::mutex> guard(other.mutex_);
+    pending_ = other.pending_;
+    hasPending_ = other.hasPending_;
+    other.pending_.clear();
+    other.hasPending_ = false;
+  }
+  registerStat();
+}
+
+ThreadCachedServiceData::TLHistogram::~TLHistogram() {
+  unregisterStat();
+  publish();
+}
+
+void ThreadCachedServiceData::TLHistogram::define(
+    int64_t bucketWidth,
+    int64_t min,
+    int64_t max) {
+  fbData->addHistogram(name_, bucketWidth, min, max);
+}
+
+void ThreadCachedServiceData::TLHistogram::exportArg(ExportType type) {
+  fbData->exportHistogram(name_, type);
+}
+
+void ThreadCachedServiceData::TLHistogram::exportArg(int percentile) {
+  fbData->exportHistogramPercentile(name_, percentile);
+}
+
+void ThreadCachedServiceData::TLHistogram::addValue(int64_t value) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  pending_.addValue(value);
+  hasPending_ = true;
+  maybePublishLocked(ServiceData::now());
+}
+
+void ThreadCachedServiceData::TLHistogram::addRepeatedValue(
+    int64_t value,
+    int64_t nsamples) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  pending_.addRepeatedValue(value, nsamples);
+  hasPending_ = true;
+  maybePublishLocked(ServiceData::now());
+}
+
+void ThreadCachedServiceData::TLHistogram::publishLocked(seconds now) {
+  lastPublish_ = now;
+  if (!hasPending_) {
+    return;
+  }
+  fbData->addHistogramValues(name_, pending_, now);
+  pending_.clear();
+  hasPending_ = false;
+}
+
+}}
@@ -9,47 +9,157 @@
  */
 #pragma once
 
-#include <cstdint>
 #include <folly/Range.h>
+#include <folly/Synchronized.h>
+#include <folly/stats/Histogram.h>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_set>
 #include "common/stats/ExportedStatMap.h"
 
 namespace facebook { namespace stats {
 
+/**
+ * Thread-cached wrappers around the stats and histograms in fbData.
+ *
+ * TLTimeseries and TLHistogram objects are meant to be owned by a single
+ * thread (typically as members of a folly::ThreadLocal object).  Values are
+ * accumulated locally and published to fbData at most about once per second
+ * by each object, so the hot path only takes an uncontended per-object lock.
+ * publishStats() publishes every pending value immediately, and is called
+ * before fbData's counters are exported.
+ */
 class ThreadCachedServiceData {
 public:
+  /**
+   * Retained for compatibility with the internal stats API.  Thread-cached
+   * stats are tracked by ThreadCachedServiceData itself.
+   */
   class ThreadLocalStatsMap {
   };
 
-  class TLTimeseries {
+  /**
+   * The base class for thread-cached stats.
+   *
+   * Subclasses register themselves once they are fully constructed, and
+   * unregister themselves before they are destroyed, so that publishStats()
+   * never sees a partially constructed or destroyed object.
+   */
+  class TLStat {
   public:
-    TLTimeseries(ThreadLocalStatsMap*, folly::StringPiece,
-                 ExportType, ExportType = ExportType()) {}
-    void addValue(int64_t) {}
+    virtual ~TLStat() {}
+
+    /** Publish any pending values to fbData. */
+    void publish();
+
+  protected:
+    explicit TLStat(folly::StringPiece name) : name_{name.str()} {}
+
+    void registerStat();
+    void unregisterStat();
+
+    /** Publish pending values if they are more than a second old. */
+    void maybePublishLocked(std::chrono::seconds now) {
+      if (now != lastPublish_) {
+        publishLocked(now);
+      }
+    }
+    virtual void publishLocked(std::chrono::seconds now) = 0;
+
+    const std::string name_;
+    std::mutex mutex_;
+    std::chrono::seconds lastPublish_{0};
   };
 
-  class TLHistogram {
+  class TLTimeseries : public TLStat {
   public:
-    TLHistogram(ThreadLocalStatsMap*, folly::StringPiece, int, int, int) {}
+    TLTimeseries(
+        ThreadLocalStatsMap*,
+        folly::StringPiece name,
+        ExportType type);
+    TLTimeseries(
+        ThreadLocalStatsMap*,
+        folly::StringPiece name,
+        ExportType type1,
+        ExportType type2);
+    TLTimeseries(TLTimeseries&& other) noexcept;
+    ~TLTimeseries() override;
+
+    void addValue(int64_t value);
+
+  private:
+    void publishLocked(std::chrono::seconds now) override;
+
+    const ExportType type1_;
+    const ExportType type2_;
+    int64_t sum_{0};
+    int64_t count_{0};
+  };
+
+  class TLHistogram : public TLStat {
+  public:
+    /**
+     * Create a histogram.
+     *
+     * The remaining arguments may be any number of ExportType values to
+     * export the count, sum, average or rate of the values, and integer
+     * percentiles to export estimates of.
+     */
+    template <typename... Args>
     TLHistogram(
-        ThreadLocalStatsMap*, folly::StringPiece, int, int, int,
-        facebook::stats::ExportType, int, int) {}
-    void addValue(int64_t) {}
-    void addRepeatedValue(int64_t /*value*/, int64_t /*nsamples*/) {}
+        ThreadLocalStatsMap*,
+        folly::StringPiece name,
+        int64_t bucketWidth,
+        int64_t min,
+        int64_t max,
+        const Args&... args)
+        : TLStat{name}, pending_{bucketWidth, min, max} {
+      define(bucketWidth, min, max);
+      exportArgs(args...);
+      registerStat();
+    }
+    TLHistogram(TLHistogram&& other) noexcept;
+    ~TLHistogram() override;
+
+    void addValue(int64_t value);
+    void addRepeatedValue(int64_t value, int64_t nsamples);
+
+  private:
+    void define(int64_t bucketWidth, int64_t min, int64_t max);
+    void exportArg(ExportType type);
+    void exportArg(int percentile);
+
+    void exportArgs() {}
+    template <typename Arg, typename... Args>
+    void exportArgs(const Arg& arg, const Args&... args) {
+      exportArg(arg);
+      exportArgs(args...);
+    }
+
+    void publishLocked(std::chrono::seconds now) override;
+
+    folly::Histogram<int64_t> pending_;
+    bool hasPending_{false};
   };
 
-  static ThreadCachedServiceData* get() {
-    static ThreadCachedServiceData it;
-    return &it;
-  }
+  static ThreadCachedServiceData* get();
+
   ThreadLocalStatsMap* getThreadStats() {
-    static ThreadLocalStatsMap it;
-    return &it;
+    return &threadStats_;
   }
   bool publishThreadRunning() const {
     return false;
   }
-  void publishStats() {
-  }
+  /** Publish the pending values of every thread-cached stat to fbData. */
+  void publishStats();
+
+private:
+  ThreadCachedServiceData() {}
+
+  ThreadLocalStatsMap threadStats_;
+  folly::Synchronized<std::unordered_set<TLStat*>> stats_;
 };
 
 }}
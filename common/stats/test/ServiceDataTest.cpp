@@ -0,0 +1,158 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ServiceData.h"
+
+#include <folly/Conv.h>
+#include <folly/stats/Histogram.h>
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+using namespace facebook::stats;
+
+TEST(ServiceData, counters) {
+  ServiceData data;
+  data.setCounter("foo", 5);
+  EXPECT_EQ(7, data.incrementCounter("foo", 2));
+  EXPECT_EQ(1, data.incrementCounter("bar"));
+  EXPECT_EQ(7, data.getCounter("foo"));
+
+  auto counters = data.getCounters();
+  EXPECT_EQ(2, counters.size());
+  EXPECT_EQ(7, counters["foo"]);
+  EXPECT_EQ(1, counters["bar"]);
+
+  data.clearCounter("foo");
+  EXPECT_THROW(data.getCounter("foo"), std::invalid_argument);
+  EXPECT_EQ(0, data.getCounters().count("foo"));
+}
+
+TEST(ServiceData, statExportNames) {
+  ServiceData data;
+  data.addStatValue("foo", 5, SUM);
+  data.addStatValue("foo", 7, COUNT);
+  data.addStatValue("foo", 9);
+  data.addStatExportType("foo", AVG);
+  // Exporting a type twice only exports it once.
+  data.addStatExportType("foo", SUM);
+
+  auto counters = data.getCounters();
+  // Three types, each exported for 60s, 10m, 1h and all time.
+  EXPECT_EQ(12, counters.size());
+  for (const auto* suffix : {"", ".60", ".600", ".3600"}) {
+    SCOPED_TRACE(suffix);
+    EXPECT_EQ(21, counters.at(std::string{"foo.sum"} + suffix));
+    EXPECT_EQ(3, counters.at(std::string{"foo.count"} + suffix));
+    EXPECT_EQ(7, counters.at(std::string{"foo.avg"} + suffix));
+  }
+}
+
+TEST(ServiceData, statAggregated) {
+  ServiceData data;
+  data.addStatExportType("foo", SUM);
+  data.addStatExportType("foo", COUNT);
+  data.addStatValueAggregated("foo", 100, 4, ServiceData::now());
+  data.addStatValueAggregated("foo", 20, 1, ServiceData::now());
+
+  auto counters = data.getCounters();
+  EXPECT_EQ(120, counters.at("foo.sum"));
+  EXPECT_EQ(5, counters.at("foo.count"));
+  EXPECT_EQ(120, counters.at("foo.sum.60"));
+}
+
+TEST(ServiceData, invalidExports) {
+  ServiceData data;
+  EXPECT_THROW(data.addStatExportType("foo", NUM_TYPES), std::invalid_argument);
+  EXPECT_THROW(data.addHistogramValue("hist", 1), std::invalid_argument);
+  EXPECT_THROW(data.exportHistogram("hist", SUM), std::invalid_argument);
+
+  data.addHistogram("hist", 10, 0, 100);
+  EXPECT_THROW(
+      data.exportHistogramPercentile("hist", 101), std::invalid_argument);
+  EXPECT_THROW(
+      data.exportHistogramPercentile("hist", -1), std::invalid_argument);
+}
+
+TEST(ServiceData, histogramExportNames) {
+  ServiceData data;
+  data.addHistogram("hist", 10, 0, 100);
+  data.exportHistogram("hist", COUNT);
+  data.exportHistogramPercentile("hist", 50);
+  data.exportHistogramPercentile("hist", 90);
+  data.exportHistogramPercentile("hist", 50);
+  data.addHistogramValue("hist", 42);
+
+  auto counters = data.getCounters();
+  // count, p50 and p90, each exported for 60s, 10m, 1h and all time.
+  EXPECT_EQ(12, counters.size());
+  for (const auto* suffix : {"", ".60", ".600", ".3600"}) {
+    SCOPED_TRACE(suffix);
+    EXPECT_EQ(1, counters.at(std::string{"hist.count"} + suffix));
+    EXPECT_EQ(1, counters.count(std::string{"hist.p50"} + suffix));
+    EXPECT_EQ(1, counters.count(std::string{"hist.p90"} + suffix));
+  }
+}
+
+TEST(ServiceData, histogramPercentiles) {
+  ServiceData data;
+  data.addHistogram("hist", 10, 0, 1000);
+  data.exportHistogram("hist", SUM);
+  data.exportHistogram("hist", AVG);
+  for (auto pct : {10, 50, 90, 99}) {
+    data.exportHistogramPercentile("hist", pct);
+  }
+  // One value in each of 0..999, so each percentile is close to 10 times
+  // itself.  The estimates are interpolated within a bucket, so allow for
+  // one bucket width of error.
+  for (int64_t value = 0; value < 1000; ++value) {
+    data.addHistogramValue("hist", value);
+  }
+
+  auto counters = data.getCounters();
+  EXPECT_EQ(499500, counters.at("hist.sum"));
+  EXPECT_EQ(499, counters.at("hist.avg"));
+  for (auto pct : {10, 50, 90, 99}) {
+    SCOPED_TRACE(pct);
+    auto name = folly::to<std::string>("hist.p", pct);
+    EXPECT_NEAR(pct * 10, counters.at(name), 10);
+    EXPECT_EQ(counters.at(name), counters.at(name + ".60"));
+  }
+}
+
+TEST(ServiceData, histogramOutOfRange) {
+  ServiceData data;
+  data.addHistogram("hist", 10, 0, 100);
+  data.exportHistogram("hist", COUNT);
+  data.exportHistogramPercentile("hist", 50);
+  data.addHistogramValue("hist", -50);
+  data.addHistogramValue("hist", 50);
+  data.addHistogramValue("hist", 500);
+
+  // Values outside of the range are still counted, and the median falls in
+  // the middle bucket.
+  auto counters = data.getCounters();
+  EXPECT_EQ(3, counters.at("hist.count"));
+  EXPECT_NEAR(50, counters.at("hist.p50"), 10);
+}
+
+TEST(ServiceData, addHistogramValues) {
+  ServiceData data;
+  data.addHistogram("hist", 10, 0, 100);
+  data.exportHistogram("hist", SUM);
+  data.exportHistogram("hist", COUNT);
+
+  folly::Histogram<int64_t> values{10, 0, 100};
+  values.addValue(15);
+  values.addRepeatedValue(25, 3);
+  data.addHistogramValues("hist", values, ServiceData::now());
+
+  auto counters = data.getCounters();
+  EXPECT_EQ(4, counters.at("hist.count"));
+  EXPECT_EQ(90, counters.at("hist.sum"));
+}
@@ -0,0 +1,142 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ThreadCachedServiceData.h"
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "common/stats/ServiceData.h"
+
+using namespace facebook;
+using namespace facebook::stats;
+
+namespace {
+using TLTimeseries = ThreadCachedServiceData::TLTimeseries;
+using TLHistogram = ThreadCachedServiceData::TLHistogram;
+
+ThreadCachedServiceData::ThreadLocalStatsMap* threadStats() {
+  return ThreadCachedServiceData::get()->getThreadStats();
+}
+
+/**
+ * Get the all time value of an exported counter, after publishing every
+ * thread-cached value.
+ */
+int64_t publishedValue(folly::StringPiece name) {
+  ThreadCachedServiceData::get()->publishStats();
+  auto counters = fbData->getCounters();
+  auto it = counters.find(name.str());
+  return it == counters.end() ? 0 : it->second;
+}
+}
+
+TEST(ThreadCachedServiceData, timeseriesDefinesExports) {
+  TLTimeseries stat{threadStats(), "tc.defines", SUM, COUNT};
+  auto counters = fbData->getCounters();
+  EXPECT_EQ(0, counters.at("tc.defines.sum"));
+  EXPECT_EQ(0, counters.at("tc.defines.count.60"));
+  EXPECT_EQ(0, counters.count("tc.defines.avg"));
+}
+
+TEST(ThreadCachedServiceData, timeseriesPublish) {
+  TLTimeseries stat{threadStats(), "tc.timeseries", SUM, COUNT};
+  for (int n = 1; n <= 10; ++n) {
+    stat.addValue(n);
+  }
+  // Values are published at most once a second unless publishStats() is
+  // called, so the first value may have been published already and the
+  // rest are pending.
+  EXPECT_EQ(55, publishedValue("tc.timeseries.sum"));
+  EXPECT_EQ(10, publishedValue("tc.timeseries.count"));
+
+  // Publishing again does not publish anything twice.
+  EXPECT_EQ(55, publishedValue("tc.timeseries.sum"));
+}
+
+TEST(ThreadCachedServiceData, timeseriesFromManyThreads) {
+  constexpr int kNumThreads = 8;
+  constexpr int kValuesPerThread = 1000;
+  std::vector<std::thread> threads;
+  for (int n = 0; n < kNumThreads; ++n) {
+    threads.emplace_back([] {
+      TLTimeseries stat{threadStats(), "tc.threads", SUM, COUNT};
+      for (int i = 0; i < kValuesPerThread; ++i) {
+        stat.addValue(2);
+      }
+      // The stat publishes its remaining values when it is destroyed.
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto counters = fbData->getCounters();
+  EXPECT_EQ(kNumThreads * kValuesPerThread, counters.at("tc.threads.count"));
+  EXPECT_EQ(
+      2 * kNumThreads * kValuesPerThread, counters.at("tc.threads.sum"));
+}
+
+TEST(ThreadCachedServiceData, timeseriesMove) {
+  TLTimeseries stat{threadStats(), "tc.moved_timeseries", SUM};
+  stat.addValue(3);
+  stat.addValue(4);
+  TLTimeseries moved{std::move(stat)};
+  moved.addValue(5);
+  EXPECT_EQ(12, publishedValue("tc.moved_timeseries.sum"));
+}
+
+TEST(ThreadCachedServiceData, histogramPublish) {
+  TLHistogram hist{threadStats(), "tc.histogram", 10, 0, 100, COUNT, SUM, 50};
+  hist.addValue(15);
+  hist.addRepeatedValue(25, 3);
+  hist.addValue(35);
+
+  EXPECT_EQ(5, publishedValue("tc.histogram.count"));
+  EXPECT_EQ(125, publishedValue("tc.histogram.sum"));
+  EXPECT_NEAR(25, publishedValue("tc.histogram.p50"), 10);
+}
+
+TEST(ThreadCachedServiceData, histogramMove) {
+  TLHistogram hist{threadStats(), "tc.moved_histogram", 10, 0, 100, COUNT};
+  hist.addValue(10);
+  hist.addValue(20);
+  TLHistogram moved{std::move(hist)};
+  EXPECT_EQ(2, publishedValue("tc.moved_histogram.count"));
+
+  // Neither the moved-from histogram nor the new one has anything pending,
+  // so publishing again adds nothing.
+  EXPECT_EQ(2, publishedValue("tc.moved_histogram.count"));
+  moved.addValue(30);
+  EXPECT_EQ(3, publishedValue("tc.moved_histogram.count"));
+}
+
+TEST(ThreadCachedServiceData, histogramFromManyThreads) {
+  constexpr int kNumThreads = 8;
+  constexpr int kValuesPerThread = 1000;
+  std::vector<std::thread> threads;
+  for (int n = 0; n < kNumThreads; ++n) {
+    threads.emplace_back([n] {
+      TLHistogram hist{threadStats(), "tc.hist_threads", 1, 0, 10, COUNT, SUM};
+      for (int i = 0; i < kValuesPerThread; ++i) {
+        hist.addValue(n);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto counters = fbData->getCounters();
+  EXPECT_EQ(
+      kNumThreads * kValuesPerThread, counters.at("tc.hist_threads.count"));
+  // Each thread adds its own index: 0 + 1 + ... + 7 = 28.
+  EXPECT_EQ(28 * kValuesPerThread, counters.at("tc.hist_threads.sum"));
+}
@@ -9,7 +9,9 @@
 
 import argparse
 import binascii
+import json
 import os
+import re
 import stat
 import sys
 from typing import Tuple
@@ -175,6 +177,46 @@ def do_inode(args: argparse.Namespace):
         _print_inode_info(inode_info)
 
 
+def _print_request_trace(trace):
+    status = '' if trace.finished else ' (in progress)'
+    print('  #{} {} inode={} pid={}: {}us{}'.format(
+        trace.requestId, trace.operation, trace.inodeNumber, trace.pid,
+        trace.durationUs, status))
+    for fetch in trace.fetches:
+        status = '' if fetch.finished else ' (in progress)'
+        print('      +{}us fetch {} {}: {}us{}'.format(
+            fetch.startOffsetUs, fetch.type, fetch.id, fetch.durationUs,
+            status))
+
+
+def do_requests(args: argparse.Namespace):
+    config = cmd_util.create_config(args)
+    mount, _ = get_mount_path(args.path)
+
+    with config.get_thrift_client() as client:
+        traces = client.debugGetFuseRequests(mount, args.slowest)
+
+    print('{} outstanding requests'.format(len(traces.outstanding)))
+    for trace in traces.outstanding:
+        _print_request_trace(trace)
+    print('{} slowest recent requests'.format(len(traces.slowest)))
+    for trace in traces.slowest:
+        _print_request_trace(trace)
+
+
+def do_stats(args: argparse.Namespace):
+    config = cmd_util.create_config(args)
+
+    with config.get_thrift_client() as client:
+        counters = client.getCounters()
+
+    if args.pattern:
+        regex = re.compile(args.pattern)
+        counters = {k: v for k, v in counters.items() if regex.search(k)}
+    json.dump(counters, sys.stdout, indent=2, sort_keys=True)
+    sys.stdout.write('\n')
+
+
 def setup_argparse(parser: argparse.ArgumentParser):
     subparsers = parser.add_subparsers(dest='subparser_name')
 
@@ -214,3 +256,21 @@ def setup_argparse(parser: argparse.ArgumentParser):
         'a mount point is specified, only data about inodes under the '
         'specified subdirectory will be reported.')
     parser.set_defaults(func=do_inode)
+
+    parser = subparsers.add_parser(
+        'stats', help='Dump the counters exported by edenfs as JSON')
+    parser.add_argument(
+        'pattern', nargs='?',
+        help='Only show counters whose names match this regular expression.  '
+        'For example, "^fuse\\." shows the FUSE latency histograms.')
+    parser.set_defaults(func=do_stats)
+
+    parser = subparsers.add_parser(
+        'requests',
+        help='Show the outstanding and slowest recent FUSE requests for a '
+        'mount point')
+    parser.add_argument('-n', '--slowest',
+                        type=int, default=10,
+                        help='The number of slowest recent requests to show')
+    parser.add_argument('path', help='The path to the eden mount point path.')
+    parser.set_defaults(func=do_requests)
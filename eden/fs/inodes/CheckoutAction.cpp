@@ -10,10 +10,10 @@
 #include "eden/fs/inodes/CheckoutAction.h"
 
 #include "eden/fs/inodes/CheckoutContext.h"
+#include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/FileInode.h"
 #include "eden/fs/inodes/InodeBase.h"
 #include "eden/fs/inodes/TreeInode.h"
-#include "eden/fs/model/Blob.h"
 #include "eden/fs/model/Tree.h"
 #include "eden/fs/model/TreeEntry.h"
 #include "eden/fs/service/gen-cpp2/eden_types.h"
@@ -116,49 +116,40 @@ Future<Unit> CheckoutAction::run(
   // Even if all loads complete immediately, allLoadsComplete() won't be called
   // until this LoadingRefcount is destroyed.
   LoadingRefcount refcount{this};
+  auto progress = ctx_->getProgress();
+  ++progress->actionsStarted;
 
   try {
-    // Load the Blob or Tree for the old TreeEntry.
-    if (oldScmEntry_.hasValue()) {
-      if (oldScmEntry_.value().getType() == TreeEntryType::TREE) {
-        store->getTreeFuture(oldScmEntry_.value().getHash())
-            .then([rc = LoadingRefcount(this)](std::unique_ptr<Tree> oldTree) {
-              rc->setOldTree(std::move(oldTree));
-            })
-            .onError([rc = LoadingRefcount(this)](const exception_wrapper& ew) {
-              rc->error("error getting old tree", ew);
-            });
-      } else {
-        store->getBlobFuture(oldScmEntry_.value().getHash())
-            .then([rc = LoadingRefcount(this)](std::unique_ptr<Blob> oldBlob) {
-              rc->setOldBlob(std::move(oldBlob));
-            })
-            .onError([rc = LoadingRefcount(this)](const exception_wrapper& ew) {
-              rc->error("error getting old blob", ew);
-            });
-      }
+    // Load the Tree for the old TreeEntry.
+    //
+    // We never need the contents of old or new Blobs: the old file contents
+    // are compared by hash in hasConflict(), and new files are created
+    // directly from the new TreeEntry.
+    if (oldScmEntry_.hasValue() &&
+        oldScmEntry_.value().getType() == TreeEntryType::TREE) {
+      loadTree(store, oldScmEntry_.value().getHash())
+          .then([ rc = LoadingRefcount(this), progress ](
+              std::unique_ptr<Tree> oldTree) {
+            ++progress->treesLoaded;
+            rc->setOldTree(std::move(oldTree));
+          })
+          .onError([rc = LoadingRefcount(this)](const exception_wrapper& ew) {
+            rc->error("error getting old tree", ew);
+          });
     }
 
-    // If we have a new TreeEntry, load the corresponding Blob or Tree
-    if (newScmEntry_.hasValue()) {
-      const auto& newEntry = newScmEntry_.value();
-      if (newEntry.getType() == TreeEntryType::TREE) {
-        store->getTreeFuture(newEntry.getHash())
-            .then([rc = LoadingRefcount(this)](std::unique_ptr<Tree> newTree) {
-              rc->setNewTree(std::move(newTree));
-            })
-            .onError([rc = LoadingRefcount(this)](const exception_wrapper& ew) {
-              rc->error("error getting new tree", ew);
-            });
-      } else {
-        store->getBlobFuture(newEntry.getHash())
-            .then([rc = LoadingRefcount(this)](std::unique_ptr<Blob> newBlob) {
-              rc->setNewBlob(std::move(newBlob));
-            })
-            .onError([rc = LoadingRefcount(this)](const exception_wrapper& ew) {
-              rc->error("error getting new blob", ew);
-            });
-      }
+    // If the new TreeEntry is a Tree, load it
+    if (newScmEntry_.hasValue() &&
+        newScmEntry_.value().getType() == TreeEntryType::TREE) {
+      loadTree(store, newScmEntry_.value().getHash())
+          .then([ rc = LoadingRefcount(this), progress ](
+              std::unique_ptr<Tree> newTree) {
+            ++progress->treesLoaded;
+            rc->setNewTree(std::move(newTree));
+          })
+          .onError([rc = LoadingRefcount(this)](const exception_wrapper& ew) {
+            rc->error("error getting new tree", ew);
+          });
     }
 
     // If we were constructed with a Future<InodePtr>, wait for it.
@@ -177,33 +168,28 @@ Future<Unit> CheckoutAction::run(
     refcount->error("error preparing to load data for checkout action", ew);
   }
 
-  return promise_.getFuture();
+  return promise_.getFuture().ensure(
+      [progress = std::move(progress)] { ++progress->actionsCompleted; });
 }
 
-void CheckoutAction::setOldTree(std::unique_ptr<Tree> tree) {
-  CHECK(!oldTree_);
-  CHECK(!oldBlob_);
-  oldTree_ = std::move(tree);
+Future<std::unique_ptr<Tree>> CheckoutAction::loadTree(
+    ObjectStore* store,
+    const Hash& hash) {
+  return ctx_->getScheduler().schedule(
+      CheckoutScheduler::Priority::TREE_FETCH,
+      [store, hash]() { return store->getTreeFuture(hash); });
 }
 
-void CheckoutAction::setOldBlob(std::unique_ptr<Blob> blob) {
+void CheckoutAction::setOldTree(std::unique_ptr<Tree> tree) {
   CHECK(!oldTree_);
-  CHECK(!oldBlob_);
-  oldBlob_ = std::move(blob);
+  oldTree_ = std::move(tree);
 }
 
 void CheckoutAction::setNewTree(std::unique_ptr<Tree> tree) {
   CHECK(!newTree_);
-  CHECK(!newBlob_);
   newTree_ = std::move(tree);
 }
 
-void CheckoutAction::setNewBlob(std::unique_ptr<Blob> blob) {
-  CHECK(!newTree_);
-  CHECK(!newBlob_);
-  newBlob_ = std::move(blob);
-}
-
 void CheckoutAction::setInode(InodePtr inode) {
   CHECK(!inode_);
   inode_ = std::move(inode);
@@ -252,12 +238,14 @@ bool CheckoutAction::ensureDataReady() noexcept {
   // Make sure we actually have all the data we need.
   // (Just in case something went wrong when wiring up the callbacks in such a
   // way that we also failed to call error().)
-  if (oldScmEntry_.hasValue() && (!oldTree_ && !oldBlob_)) {
+  if (oldScmEntry_.hasValue() &&
+      oldScmEntry_.value().getType() == TreeEntryType::TREE && !oldTree_) {
     promise_.setException(
         std::runtime_error("failed to load data for old TreeEntry"));
     return false;
   }
-  if (newScmEntry_.hasValue() && (!newTree_ && !newBlob_)) {
+  if (newScmEntry_.hasValue() &&
+      newScmEntry_.value().getType() == TreeEntryType::TREE && !newTree_) {
     promise_.setException(
         std::runtime_error("failed to load data for new TreeEntry"));
     return false;
@@ -284,28 +272,67 @@ Future<Unit> CheckoutAction::doAction() {
   //   (merge, check-only, force)
 
   // Check for conflicts first.
-  if (hasConflict() && !ctx_->forceUpdate()) {
-    // hasConflict will have added the conflict information to ctx_
-    return makeFuture();
+  return hasConflict().then([this](bool conflict) -> Future<Unit> {
+    if (conflict && !ctx_->forceUpdate()) {
+      // hasConflict will have added the conflict information to ctx_
+      return makeFuture();
+    }
+
+    if (!ctx_->shouldApplyChanges()) {
+      return dryRunAction();
+    }
+
+    auto parent = inode_->getParent(ctx_->renameLock());
+    return parent->checkoutUpdateEntry(
+        ctx_,
+        getEntryName(),
+        std::move(inode_),
+        std::move(oldTree_),
+        std::move(newTree_),
+        std::move(newScmEntry_));
+  });
+}
+
+Future<Unit> CheckoutAction::dryRunAction() {
+  auto treeInode = inode_.asTreePtrOrNull();
+  if (!treeInode) {
+    // This file would be replaced or removed.
+    if (!newScmEntry_.hasValue()) {
+      ctx_->recordFileRemoved();
+      return makeFuture();
+    }
+    if (newScmEntry_.value().getType() != TreeEntryType::TREE) {
+      ctx_->recordFileModified();
+      return makeFuture();
+    }
+    ctx_->recordFileRemoved();
+    auto* store = inode_->getMount()->getObjectStore();
+    return ctx_->countChanges(store, nullptr, newScmEntry_.get_pointer());
   }
 
-  auto parent = inode_->getParent(ctx_->renameLock());
-  return parent->checkoutUpdateEntry(
-      ctx_,
-      getEntryName(),
-      std::move(inode_),
-      std::move(oldTree_),
-      std::move(newTree_),
-      std::move(newScmEntry_));
+  // Recurse into the directory, so that we report conflicts and count changes
+  // for its children.  If the directory is being replaced by a file, the
+  // file is added once the directory contents have been removed.
+  //
+  // Note that the dry run does not predict DIRECTORY_NOT_EMPTY conflicts for
+  // directories with untracked files that would be removed.
+  bool addsFile = newScmEntry_.hasValue() &&
+      newScmEntry_.value().getType() != TreeEntryType::TREE;
+  return treeInode->checkout(ctx_, std::move(oldTree_), std::move(newTree_))
+      .then([ ctx = ctx_, addsFile ]() {
+        if (addsFile) {
+          ctx->recordFileAdded();
+        }
+      });
 }
 
-bool CheckoutAction::hasConflict() {
+Future<bool> CheckoutAction::hasConflict() {
   if (oldTree_) {
     auto treeInode = inode_.asTreePtrOrNull();
     if (!treeInode) {
       // This was a directory, but has been replaced with a file on disk
       ctx_->addConflict(ConflictType::MODIFIED, inode_.get());
-      return true;
+      return makeFuture(true);
     }
 
     // TODO: check for permissions changes
@@ -314,28 +341,42 @@ bool CheckoutAction::hasConflict() {
     // We simply apply the checkout to the tree in this case, so that we report
     // conflicts for individual leaf inodes that were modified, and not for the
     // parent directories.
-    return false;
-  } else if (oldBlob_) {
+    return makeFuture(false);
+  } else if (oldScmEntry_.hasValue()) {
     auto fileInode = inode_.asFilePtrOrNull();
     if (!fileInode) {
       // This was a file, but has been replaced with a directory on disk
       ctx_->addConflict(ConflictType::MODIFIED, inode_.get());
-      return true;
+      return makeFuture(true);
     }
 
-    // Check that the file contents are the same as the old source control entry
-    if (!fileInode->isSameAs(*oldBlob_, oldScmEntry_.value().getMode())) {
-      // The file contents or mode bits are different
-      ctx_->addConflict(ConflictType::MODIFIED, inode_.get());
-      return true;
-    }
-
-    // This file is the same as the old source control state.
-    return false;
+    // Check that the file contents are the same as the old source control
+    // entry.  This only compares hashes, so the old blob is never loaded.
+    // Materialized files need the blob's metadata, so this goes through the
+    // scheduler along with the other fetches.
+    const auto& oldEntry = oldScmEntry_.value();
+    return ctx_->getScheduler()
+        .schedule(
+            CheckoutScheduler::Priority::BLOB_FETCH,
+            [
+              fileInode,
+              hash = oldEntry.getHash(),
+              mode = oldEntry.getMode()
+            ] { return fileInode->isSameAs(hash, mode); })
+        .then([this](bool isSame) {
+          if (!isSame) {
+            // The file contents or mode bits are different
+            ctx_->addConflict(ConflictType::MODIFIED, inode_.get());
+            return true;
+          }
+
+          // This file is the same as the old source control state.
+          return false;
+        });
   } else {
     // This entry did not exist in the old source control tree
     ctx_->addConflict(ConflictType::UNTRACKED_ADDED, inode_.get());
-    return true;
+    return makeFuture(true);
   }
 }
 }
@@ -23,7 +23,6 @@ class exception_wrapper;
 namespace facebook {
 namespace eden {
 
-class Blob;
 class CheckoutContext;
 class ObjectStore;
 class Tree;
@@ -105,17 +104,23 @@ class CheckoutAction {
       const TreeEntry* newScmEntry,
       folly::Future<InodePtr> inodeFuture);
 
+  /**
+   * Load a Tree once the CheckoutContext's scheduler has a slot for it.
+   */
+  folly::Future<std::unique_ptr<Tree>> loadTree(
+      ObjectStore* store,
+      const Hash& hash);
+
   void setOldTree(std::unique_ptr<Tree> tree);
-  void setOldBlob(std::unique_ptr<Blob> blob);
   void setNewTree(std::unique_ptr<Tree> tree);
-  void setNewBlob(std::unique_ptr<Blob> blob);
   void setInode(InodePtr inode);
   void error(folly::StringPiece msg, const folly::exception_wrapper& ew);
 
   void allLoadsComplete() noexcept;
   bool ensureDataReady() noexcept;
-  bool hasConflict();
+  folly::Future<bool> hasConflict();
   folly::Future<folly::Unit> doAction();
+  folly::Future<folly::Unit> dryRunAction();
 
   /**
    * The context for the in-progress checkout operation.
@@ -156,18 +161,13 @@ class CheckoutAction {
   /*
    * Data that we have to load to perform the checkout action.
    *
-   * Only one each oldTree_ and oldBlob_ will be loaded,
-   * and the same goes for newTree_ and newBlob_.
-   *
-   * TODO: We don't actually ever need the data from new blob.  If the
-   * destination entry is a blob we could just record this fact, and not bother
-   * loading the blob data itself.
+   * oldTree_ and newTree_ are only loaded if the corresponding TreeEntry
+   * refers to a Tree.  Blob contents are never loaded: files are compared
+   * using their hashes, and new files are created from the TreeEntry alone.
    */
   InodePtr inode_;
   std::unique_ptr<Tree> oldTree_;
-  std::unique_ptr<Blob> oldBlob_;
   std::unique_ptr<Tree> newTree_;
-  std::unique_ptr<Blob> newBlob_;
 
   /**
    * The errors vector keeps track of any errors that occurred while trying to
@@ -9,21 +9,53 @@
  */
 #include "eden/fs/inodes/CheckoutContext.h"
 
+#include <folly/futures/Future.h>
+#include <gflags/gflags.h>
+#include <wangle/concurrent/GlobalExecutor.h>
+#include "eden/fs/inodes/CheckoutPrefetcher.h"
 #include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/InodePtr.h"
 #include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/model/Tree.h"
+#include "eden/fs/store/ObjectStore.h"
+#include "eden/fuse/Dispatcher.h"
 
 using folly::Future;
+using folly::makeFuture;
 using folly::Unit;
+using std::unique_ptr;
 using std::vector;
 
+DEFINE_int32(
+    checkout_max_in_flight,
+    256,
+    "The maximum number of object fetches and inode loads that a checkout "
+    "operation will have in progress at once");
+DEFINE_int32(
+    checkout_max_in_flight_while_busy,
+    16,
+    "The maximum number of object fetches and inode loads that a checkout "
+    "operation will have in progress at once while the mount point has FUSE "
+    "requests outstanding");
+
 namespace facebook {
 namespace eden {
 
 CheckoutContext::CheckoutContext(
     folly::Synchronized<Hash>::LockedPtr&& snapshotLock,
-    bool force)
-    : force_{force}, snapshotLock_(std::move(snapshotLock)) {}
+    const fusell::Dispatcher* dispatcher,
+    bool force,
+    bool dryRun)
+    : force_{force},
+      dryRun_{dryRun},
+      snapshotLock_(std::move(snapshotLock)),
+      scheduler_{std::make_shared<CheckoutScheduler>(
+          FLAGS_checkout_max_in_flight,
+          FLAGS_checkout_max_in_flight_while_busy,
+          [dispatcher]() {
+            return dispatcher && dispatcher->getOutstandingRequestCount() > 0;
+          },
+          wangle::getCPUExecutor())} {}
 
 CheckoutContext::~CheckoutContext() {}
 
@@ -33,13 +65,17 @@ void CheckoutContext::start(RenameLock&& renameLock) {
 
 vector<CheckoutConflict> CheckoutContext::finish(Hash newSnapshot) {
   // Update the in-memory snapshot ID
-  *snapshotLock_ = newSnapshot;
+  if (!dryRun_) {
+    *snapshotLock_ = newSnapshot;
+  }
 
   // Release our locks.
   // This would release automatically when the CheckoutContext is destroyed,
   // but go ahead and explicitly unlock them just to make sure that we are
   // really completely finished when we fulfill the checkout futures.
-  renameLock_.unlock();
+  if (renameLock_.owns_lock()) {
+    renameLock_.unlock();
+  }
   snapshotLock_.unlock();
 
   // Return conflicts_ via a move operation.  We don't need them any more, and
@@ -68,8 +104,14 @@ void CheckoutContext::addConflict(
   // and we only operate on TreeInode's that still exist in the file system
   // namespace.  Therefore parent->getPath() must always return non-none value
   // here.
+  //
+  // Dry runs do not hold the RenameLock, so the directory may have been
+  // removed concurrently.  Its contents no longer matter in that case.
   auto parentPath = parent->getPath();
-  CHECK(parentPath.hasValue());
+  if (!parentPath.hasValue()) {
+    CHECK(dryRun_) << "checkout conflict in unlinked directory";
+    return;
+  }
 
   addConflict(type, parentPath.value() + name);
 }
@@ -77,7 +119,10 @@ void CheckoutContext::addConflict(
 void CheckoutContext::addConflict(ConflictType type, InodeBase* inode) {
   // As above, the inode in question must have a path here.
   auto path = inode->getPath();
-  CHECK(path.hasValue());
+  if (!path.hasValue()) {
+    CHECK(dryRun_) << "checkout conflict for unlinked inode";
+    return;
+  }
   addConflict(type, path.value());
 }
 
@@ -87,7 +132,10 @@ void CheckoutContext::addError(
     const folly::exception_wrapper& ew) {
   // As above in addConflict(), the parent tree must have a valid path here.
   auto parentPath = parent->getPath();
-  CHECK(parentPath.hasValue());
+  if (!parentPath.hasValue()) {
+    CHECK(dryRun_) << "checkout error in unlinked directory";
+    return;
+  }
 
   auto path = parentPath.value() + name;
   CheckoutConflict conflict;
@@ -96,5 +144,88 @@ void CheckoutContext::addError(
   conflict.message = folly::exceptionStr(ew).toStdString();
   conflicts_.wlock()->push_back(std::move(conflict));
 }
+
+Future<Unit> CheckoutContext::countChanges(
+    ObjectStore* store,
+    const TreeEntry* oldEntry,
+    const TreeEntry* newEntry) {
+  DCHECK(oldEntry || newEntry);
+  bool oldIsTree = oldEntry && oldEntry->getType() == TreeEntryType::TREE;
+  bool newIsTree = newEntry && newEntry->getType() == TreeEntryType::TREE;
+  if (!oldIsTree && !newIsTree) {
+    if (!oldEntry) {
+      recordFileAdded();
+    } else if (!newEntry) {
+      recordFileRemoved();
+    } else if (
+        oldEntry->getHash() != newEntry->getHash() ||
+        oldEntry->getMode() != newEntry->getMode()) {
+      recordFileModified();
+    }
+    return makeFuture();
+  }
+
+  // A file replaced by a directory (or vice versa) counts as a removal plus
+  // the files added inside the new directory.
+  if (oldEntry && !oldIsTree) {
+    recordFileRemoved();
+  }
+  if (newEntry && !newIsTree) {
+    recordFileAdded();
+  }
+
+  auto loadTree = [this, store](const Hash& hash) {
+    return scheduler_->schedule(
+        CheckoutScheduler::Priority::TREE_FETCH,
+        [store, hash]() { return store->getTreeFuture(hash); })
+        .then([progress = progress_](unique_ptr<Tree> tree) {
+          ++progress->treesLoaded;
+          return tree;
+        });
+  };
+  auto oldTreeFuture = oldIsTree ? loadTree(oldEntry->getHash())
+                                 : makeFuture<unique_ptr<Tree>>(nullptr);
+  auto newTreeFuture = newIsTree ? loadTree(newEntry->getHash())
+                                 : makeFuture<unique_ptr<Tree>>(nullptr);
+  return folly::collect(oldTreeFuture, newTreeFuture)
+      .then([this, store](
+          std::tuple<unique_ptr<Tree>, unique_ptr<Tree>> trees) {
+        ++progress_->treesCompared;
+        const auto& oldTree = std::get<0>(trees);
+        const auto& newTree = std::get<1>(trees);
+        vector<TreeEntry> emptyEntries;
+        const auto& oldEntries =
+            oldTree ? oldTree->getTreeEntries() : emptyEntries;
+        const auto& newEntries =
+            newTree ? newTree->getTreeEntries() : emptyEntries;
+
+        // Walk both sorted entry lists together, skipping identical entries.
+        vector<Future<Unit>> futures;
+        size_t oldIdx = 0;
+        size_t newIdx = 0;
+        while (oldIdx < oldEntries.size() || newIdx < newEntries.size()) {
+          const TreeEntry* oldChild = nullptr;
+          const TreeEntry* newChild = nullptr;
+          if (newIdx >= newEntries.size() ||
+              (oldIdx < oldEntries.size() &&
+               oldEntries[oldIdx].getName() < newEntries[newIdx].getName())) {
+            oldChild = &oldEntries[oldIdx++];
+          } else if (
+              oldIdx >= oldEntries.size() ||
+              oldEntries[oldIdx].getName() > newEntries[newIdx].getName()) {
+            newChild = &newEntries[newIdx++];
+          } else {
+            oldChild = &oldEntries[oldIdx++];
+            newChild = &newEntries[newIdx++];
+            if (oldChild->getHash() == newChild->getHash() &&
+                oldChild->getMode() == newChild->getMode()) {
+              continue;
+            }
+          }
+          futures.push_back(countChanges(store, oldChild, newChild));
+        }
+        return folly::collect(futures).unit();
+      });
+}
 }
 }
@@ -10,7 +10,12 @@
 #pragma once
 
 #include <folly/Synchronized.h>
+#include <glog/logging.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <vector>
+#include "eden/fs/inodes/CheckoutScheduler.h"
 #include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/InodePtrFwd.h"
 #include "eden/fs/service/gen-cpp2/eden_types.h"
@@ -26,28 +31,63 @@ class Unit;
 namespace facebook {
 namespace eden {
 
+namespace fusell {
+class Dispatcher;
+}
+
 class CheckoutConflict;
+class CheckoutPrefetcher;
+class ObjectStore;
 class TreeInode;
 class Tree;
+class TreeEntry;
+
+/**
+ * Counters describing the progress of a checkout operation.
+ *
+ * These are updated from many threads as the checkout runs, and may be read
+ * at any time, including after the checkout has finished.
+ */
+struct CheckoutProgress {
+  /** Number of pairs of source control Trees compared so far. */
+  std::atomic<uint64_t> treesCompared{0};
+  /** Number of Trees loaded from the ObjectStore by the checkout. */
+  std::atomic<uint64_t> treesLoaded{0};
+  /** Number of CheckoutActions started and completed. */
+  std::atomic<uint64_t> actionsStarted{0};
+  std::atomic<uint64_t> actionsCompleted{0};
+  /** Number of kernel cache invalidations queued for changed entries. */
+  std::atomic<uint64_t> inodesInvalidated{0};
+  /** Set once the checkout has finished, successfully or not. */
+  std::atomic<bool> finished{false};
+};
 
 /**
  * CheckoutContext maintains state during a checkout operation.
  */
 class CheckoutContext {
  public:
+  /**
+   * The dispatcher is used to check for outstanding FUSE requests, which
+   * checkout yields to.  It may be null.
+   */
   CheckoutContext(
       folly::Synchronized<Hash>::LockedPtr&& snapshotLock,
-      bool force);
+      const fusell::Dispatcher* dispatcher,
+      bool force,
+      bool dryRun = false);
   ~CheckoutContext();
 
   /**
    * Returns true if the checkout operation should actually update the inodes,
    * or false if it should do a dry run, looking for conflicts without actually
    * updating the inode contents.
+   *
+   * A dry run does not hold the mount's rename lock, and only loads Trees and
+   * blob metadata, never blob contents.
    */
   bool shouldApplyChanges() const {
-    // TODO: make this configurable on checkout start
-    return true;
+    return !dryRun_;
   }
 
   /**
@@ -59,7 +99,8 @@ class CheckoutContext {
    * new contents, rather than just reporting and skipping files with
    * conflicts.
    *
-   * forceUpdate() can only return true when shouldApplyChanges() is also true.
+   * In a dry run, forceUpdate() means that the file counts will include files
+   * with conflicts, since a forced checkout would update them.
    */
   bool forceUpdate() const {
     return force_;
@@ -67,6 +108,8 @@ class CheckoutContext {
 
   /**
    * Start the checkout operation.
+   *
+   * The renameLock is not held for dry runs.
    */
   void start(RenameLock&& renameLock);
 
@@ -74,10 +117,97 @@ class CheckoutContext {
    * Complete the checkout operation
    *
    * Returns the list of conflicts and errors that were encountered during the
-   * operation.
+   * operation.  The snapshot is not updated for dry runs.
    */
   std::vector<CheckoutConflict> finish(Hash newSnapshot);
 
+  /**
+   * Get the progress counters for this checkout.
+   *
+   * The returned object may outlive the CheckoutContext.
+   */
+  const std::shared_ptr<CheckoutProgress>& getProgress() const {
+    return progress_;
+  }
+
+  /**
+   * Get the scheduler that limits the object fetches and inode loads this
+   * checkout has in progress.
+   */
+  CheckoutScheduler& getScheduler() const {
+    return *scheduler_;
+  }
+
+  /**
+   * Set the CheckoutPrefetcher that should be told about changed files.
+   *
+   * This must be called before the checkout starts.
+   */
+  void setPrefetcher(std::shared_ptr<CheckoutPrefetcher> prefetcher) {
+    prefetcher_ = std::move(prefetcher);
+  }
+
+  /**
+   * Get the CheckoutPrefetcher for this checkout.
+   *
+   * Returns null if post-checkout prefetching is disabled.
+   */
+  CheckoutPrefetcher* getPrefetcher() const {
+    return prefetcher_.get();
+  }
+
+  /**
+   * Record time spent saving one directory's state to the overlay.
+   *
+   * Directories are saved concurrently, so the total is the time summed
+   * across all of them, and can exceed the wall-clock time of the checkout.
+   */
+  void addCumulativeOverlaySaveTime(
+      std::chrono::steady_clock::duration duration) {
+    cumulativeOverlaySaveTime_ += duration.count();
+  }
+  std::chrono::steady_clock::duration getCumulativeOverlaySaveTime() const {
+    return std::chrono::steady_clock::duration{
+        cumulativeOverlaySaveTime_.load()};
+  }
+
+  /**
+   * Record a file that a dry run found would be changed by the checkout.
+   */
+  void recordFileAdded() {
+    ++filesAdded_;
+  }
+  void recordFileModified() {
+    ++filesModified_;
+  }
+  void recordFileRemoved() {
+    ++filesRemoved_;
+  }
+
+  uint64_t getFilesAdded() const {
+    return filesAdded_.load();
+  }
+  uint64_t getFilesModified() const {
+    return filesModified_.load();
+  }
+  uint64_t getFilesRemoved() const {
+    return filesRemoved_.load();
+  }
+
+  /**
+   * Record the files that would change when updating a path with no local
+   * modifications from oldEntry to newEntry.
+   *
+   * Either entry may be null if the path does not exist on that side.  This
+   * loads Trees from the ObjectStore as necessary to count the files inside
+   * directories.  The entries only need to remain valid until this function
+   * returns.
+   */
+  folly::Future<folly::Unit> countChanges(
+      ObjectStore* store,
+      const TreeEntry* oldEntry,
+      const TreeEntry* newEntry);
+
   void addConflict(ConflictType type, RelativePathPiece path);
   void
   addConflict(ConflictType type, TreeInode* parent, PathComponentPiece name);
@@ -92,14 +222,16 @@ class CheckoutContext {
    * Get a reference to the rename lock.
    *
    * This is mostly used for APIs that require proof that we are currently
-   * holding the lock.
+   * holding the lock.  This must not be called during a dry run.
    */
   const RenameLock& renameLock() const {
+    DCHECK(shouldApplyChanges());
     return renameLock_;
   }
 
  private:
   bool const force_{false};
+  bool const dryRun_{false};
   folly::Synchronized<Hash>::LockedPtr snapshotLock_;
   RenameLock renameLock_;
 
@@ -107,6 +239,17 @@ class CheckoutContext {
   // if some data load operations complete asynchronously on other threads.
   // Therefore access to the conflicts list must be synchronized.
   folly::Synchronized<std::vector<CheckoutConflict>> conflicts_;
+
+  std::shared_ptr<CheckoutProgress> progress_{
+      std::make_shared<CheckoutProgress>()};
+  std::shared_ptr<CheckoutScheduler> scheduler_;
+  std::shared_ptr<CheckoutPrefetcher> prefetcher_;
+  std::atomic<std::chrono::steady_clock::rep> cumulativeOverlaySaveTime_{0};
+
+  // Counts of files that a dry run would change.
+  std::atomic<uint64_t> filesAdded_{0};
+  std::atomic<uint64_t> filesModified_{0};
+  std::atomic<uint64_t> filesRemoved_{0};
 };
 }
 }
@@ -0,0 +1,208 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/inodes/CheckoutPrefetcher.h"
+
+#include <glog/logging.h>
+#include "eden/fs/inodes/CheckoutScheduler.h"
+#include "eden/fs/model/Blob.h"
+#include "eden/fs/model/Tree.h"
+#include "eden/fs/model/TreeEntry.h"
+#include "eden/fs/store/ObjectStore.h"
+
+using folly::Future;
+using folly::makeFuture;
+using folly::Unit;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+using TreeResult = folly::Try<std::unique_ptr<facebook::eden::Tree>>;
+}
+
+namespace facebook {
+namespace eden {
+
+CheckoutPrefetcher::CheckoutPrefetcher(
+    const vector<std::string>& globs,
+    std::shared_ptr<CheckoutScheduler> scheduler)
+    : scheduler_{std::move(scheduler)} {
+  globs_.reserve(globs.size());
+  for (const auto& glob : globs) {
+    auto matcher = GlobMatcher::create(glob);
+    if (matcher.hasError()) {
+      LOG(WARNING) << "ignoring invalid checkout prefetch glob \"" << glob
+                   << "\": " << matcher.error();
+      continue;
+    }
+    globs_.push_back(std::move(matcher).value());
+  }
+  // Only take pointers once globs_ is fully populated
+  for (const auto& matcher : globs_) {
+    globSet_.add(&matcher);
+  }
+}
+
+CheckoutPrefetcher::~CheckoutPrefetcher() {}
+
+bool CheckoutPrefetcher::matches(RelativePathPiece path) const {
+  return globSet_.match(path.stringPiece()).hasValue();
+}
+
+void CheckoutPrefetcher::addReadFile(const Hash& blobHash) {
+  auto state = state_.wlock();
+  if (state->seen.insert(blobHash).second) {
+    state->blobs.push_back(blobHash);
+  }
+}
+
+void CheckoutPrefetcher::addUnreadFile(
+    RelativePathPiece path,
+    const Hash& blobHash) {
+  if (matches(path)) {
+    addReadFile(blobHash);
+  }
+}
+
+void CheckoutPrefetcher::addUnreadTree(
+    RelativePathPiece path,
+    const TreeEntry* oldEntry,
+    const TreeEntry& newEntry) {
+  if (!hasGlobs()) {
+    return;
+  }
+  folly::Optional<Hash> oldTree;
+  if (oldEntry && oldEntry->getType() == TreeEntryType::TREE) {
+    oldTree = oldEntry->getHash();
+  }
+  state_.wlock()->trees.push_back(
+      TreeChange{RelativePath{path}, oldTree, newEntry.getHash()});
+}
+
+Future<Unit> CheckoutPrefetcher::start(ObjectStore* store) {
+  vector<Hash> blobs;
+  vector<TreeChange> trees;
+  {
+    auto state = state_.wlock();
+    blobs.swap(state->blobs);
+    trees.swap(state->trees);
+  }
+  VLOG(2) << "starting checkout prefetch of " << blobs.size() << " files and "
+          << trees.size() << " directories";
+
+  vector<Future<Unit>> futures;
+  for (const auto& hash : blobs) {
+    futures.push_back(fetchBlob(store, hash));
+  }
+  for (auto& change : trees) {
+    futures.push_back(walkTree(store, std::move(change)));
+  }
+  return folly::collectAll(futures).then(
+      [self = shared_from_this()](vector<folly::Try<Unit>>) {
+        VLOG(2) << "checkout prefetch fetched " << self->getNumBlobsFetched()
+                << " blobs";
+      });
+}
+
+void CheckoutPrefetcher::cancel() {
+  cancelled_ = true;
+}
+
+Future<Unit> CheckoutPrefetcher::fetchBlob(
+    ObjectStore* store,
+    const Hash& hash) {
+  return scheduler_
+      ->schedule(
+          CheckoutScheduler::Priority::BLOB_FETCH,
+          [ self = shared_from_this(), store, hash ]() {
+            if (self->cancelled_) {
+              return makeFuture();
+            }
+            // ObjectStore saves blobs fetched from the BackingStore in the
+            // LocalStore.  We don't need the contents here.
+            return store->getBlobFuture(hash).then(
+                [self](unique_ptr<Blob>) { ++self->numBlobsFetched_; });
+          })
+      .onError([hash](const folly::exception_wrapper& ew) {
+        VLOG(1) << "error prefetching blob " << hash << ": "
+                << folly::exceptionStr(ew);
+      });
+}
+
+Future<unique_ptr<Tree>> CheckoutPrefetcher::loadTree(
+    ObjectStore* store,
+    const Hash& hash) {
+  return scheduler_->schedule(
+      CheckoutScheduler::Priority::TREE_FETCH,
+      [ self = shared_from_this(), store, hash ]() {
+        if (self->cancelled_) {
+          return makeFuture<unique_ptr<Tree>>(
+              std::runtime_error("checkout prefetch cancelled"));
+        }
+        return store->getTreeFuture(hash);
+      });
+}
+
+Future<Unit> CheckoutPrefetcher::walkTree(
+    ObjectStore* store,
+    TreeChange change) {
+  auto oldTreeFuture = change.oldTree
+      ? loadTree(store, change.oldTree.value())
+      : makeFuture<unique_ptr<Tree>>(nullptr);
+  auto newTreeFuture = loadTree(store, change.newTree);
+  // Use collectAll() rather than collect() so that neither load is still
+  // outstanding when we return.
+  return folly::collectAll(oldTreeFuture, newTreeFuture)
+      .then([
+        self = shared_from_this(),
+        store,
+        path = std::move(change.path)
+      ](std::tuple<TreeResult, TreeResult> trees) {
+        auto& oldTreeResult = std::get<0>(trees);
+        auto& newTreeResult = std::get<1>(trees);
+        if (oldTreeResult.hasException() || newTreeResult.hasException()) {
+          auto& failed =
+              oldTreeResult.hasException() ? oldTreeResult : newTreeResult;
+          VLOG(1) << "error loading trees to prefetch under " << path << ": "
+                  << folly::exceptionStr(failed.exception());
+          return makeFuture();
+        }
+        const auto& oldTree = oldTreeResult.value();
+
+        vector<Future<Unit>> futures;
+        for (const auto& entry : newTreeResult.value()->getTreeEntries()) {
+          const auto* oldEntry =
+              oldTree ? oldTree->getEntryPtr(entry.getName()) : nullptr;
+          if (oldEntry && oldEntry->getType() == entry.getType() &&
+              oldEntry->getHash() == entry.getHash()) {
+            continue;
+          }
+
+          auto entryPath = path + entry.getName();
+          if (entry.getType() == TreeEntryType::TREE) {
+            folly::Optional<Hash> oldSubtree;
+            if (oldEntry && oldEntry->getType() == TreeEntryType::TREE) {
+              oldSubtree = oldEntry->getHash();
+            }
+            futures.push_back(self->walkTree(
+                store,
+                TreeChange{std::move(entryPath), oldSubtree, entry.getHash()}));
+          } else if (self->matches(entryPath)) {
+            auto isNew =
+                self->state_.wlock()->seen.insert(entry.getHash()).second;
+            if (isNew) {
+              futures.push_back(self->fetchBlob(store, entry.getHash()));
+            }
+          }
+        }
+        return folly::collectAll(futures).unit();
+      });
+}
+}
+}
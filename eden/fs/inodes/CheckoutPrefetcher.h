@@ -0,0 +1,141 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Synchronized.h>
+#include <folly/futures/Future.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "eden/fs/model/Hash.h"
+#include "eden/fs/model/git/GlobMatcher.h"
+#include "eden/fs/model/git/GlobMatcherSet.h"
+#include "eden/utils/PathFuncs.h"
+
+namespace facebook {
+namespace eden {
+
+class CheckoutScheduler;
+class ObjectStore;
+class Tree;
+class TreeEntry;
+
+/**
+ * CheckoutPrefetcher fetches the blobs for files changed by a checkout into
+ * the LocalStore in the background after the checkout completes, so that the
+ * first reads of those files after the update do not have to wait for the
+ * BackingStore.
+ *
+ * Checkout only updates source control entries, so by itself it never
+ * fetches the contents of the files it changes.  Rather than fetching every
+ * changed file, only two kinds of files are prefetched:
+ * - files that had been read before the checkout, and
+ * - files whose paths match one of the configured globs.
+ *
+ * Directories that checkout replaces without ever loading them are walked
+ * during the prefetch phase to find the changed files inside them that match
+ * the globs.
+ *
+ * The add*() methods may be called concurrently from any thread while the
+ * checkout runs.
+ */
+class CheckoutPrefetcher
+    : public std::enable_shared_from_this<CheckoutPrefetcher> {
+ public:
+  /**
+   * Invalid glob patterns are logged and ignored.  Fetches are run through
+   * scheduler, which should have a low limit since this is background work.
+   */
+  CheckoutPrefetcher(
+      const std::vector<std::string>& globs,
+      std::shared_ptr<CheckoutScheduler> scheduler);
+  ~CheckoutPrefetcher();
+
+  /**
+   * Returns true if any glob patterns were configured.  Callers can skip
+   * computing paths for unread files when this returns false.
+   */
+  bool hasGlobs() const {
+    return !globSet_.empty();
+  }
+
+  /** Prefetch a changed file that had been read before the checkout. */
+  void addReadFile(const Hash& blobHash);
+
+  /** Prefetch a changed file that had not been read, if it matches a glob. */
+  void addUnreadFile(RelativePathPiece path, const Hash& blobHash);
+
+  /**
+   * Prefetch the changed files under a directory that had not been loaded,
+   * if they match a glob.  oldEntry is the source control entry that this
+   * directory replaced, and may be null.
+   */
+  void addUnreadTree(
+      RelativePathPiece path,
+      const TreeEntry* oldEntry,
+      const TreeEntry& newEntry);
+
+  /**
+   * Start fetching the blobs that were added.
+   *
+   * The returned Future completes once all of the fetches have finished.  It
+   * never fails: errors fetching individual blobs are logged and ignored.
+   * The ObjectStore must remain valid until then.
+   */
+  folly::Future<folly::Unit> start(ObjectStore* store);
+
+  /**
+   * Stop starting new fetches.  Fetches already in progress still complete.
+   */
+  void cancel();
+
+  /** Returns the number of blobs fetched so far. */
+  uint64_t getNumBlobsFetched() const {
+    return numBlobsFetched_.load();
+  }
+
+ private:
+  struct TreeChange {
+    RelativePath path;
+    folly::Optional<Hash> oldTree;
+    Hash newTree;
+  };
+
+  struct State {
+    std::vector<Hash> blobs;
+    std::vector<TreeChange> trees;
+    // Every blob queued so far, to avoid fetching the same blob twice.
+    std::unordered_set<Hash> seen;
+  };
+
+  bool matches(RelativePathPiece path) const;
+  folly::Future<folly::Unit> fetchBlob(ObjectStore* store, const Hash& hash);
+  folly::Future<std::unique_ptr<Tree>> loadTree(
+      ObjectStore* store,
+      const Hash& hash);
+  folly::Future<folly::Unit> walkTree(ObjectStore* store, TreeChange change);
+
+  CheckoutPrefetcher(CheckoutPrefetcher const&) = delete;
+  CheckoutPrefetcher& operator=(CheckoutPrefetcher const&) = delete;
+
+  // globSet_ refers to the GlobMatchers in globs_, which are never modified
+  // after construction.
+  std::vector<GlobMatcher> globs_;
+  GlobMatcherSet globSet_;
+  const std::shared_ptr<CheckoutScheduler> scheduler_;
+  folly::Synchronized<State> state_;
+  std::atomic<bool> cancelled_{false};
+  std::atomic<uint64_t> numBlobsFetched_{0};
+};
+}
+}
@@ -0,0 +1,136 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/inodes/CheckoutScheduler.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+
+using folly::Future;
+using folly::Promise;
+using folly::Unit;
+
+namespace facebook {
+namespace eden {
+
+constexpr size_t CheckoutScheduler::kNumPriorities;
+
+CheckoutScheduler::CheckoutScheduler(
+    size_t maxInFlight,
+    size_t maxInFlightWhileBusy,
+    std::function<bool()> isBusy,
+    std::shared_ptr<folly::Executor> executor)
+    : maxInFlight_{std::max(maxInFlight, size_t(1))},
+      maxInFlightWhileBusy_{
+          std::max(std::min(maxInFlightWhileBusy, maxInFlight_), size_t(1))},
+      isBusy_{std::move(isBusy)},
+      executor_{std::move(executor)} {
+  CHECK(executor_);
+}
+
+size_t CheckoutScheduler::getLimit() const {
+  if (isBusy_ && isBusy_()) {
+    return maxInFlightWhileBusy_;
+  }
+  return maxInFlight_;
+}
+
+bool CheckoutScheduler::hasPending(const State& state) const {
+  for (const auto& queue : state.queues) {
+    if (!queue.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Future<Unit> CheckoutScheduler::acquire(Priority priority) {
+  Future<Unit> future = folly::makeFuture();
+  bool slotAvailable;
+  {
+    auto state = state_.wlock();
+    slotAvailable = state->running < getLimit();
+    // Jobs that are already waiting go first, so only take a slot directly if
+    // nothing is queued.
+    if (slotAvailable && !hasPending(*state)) {
+      ++state->running;
+      return future;
+    }
+
+    // pump() fulfills the promise on whichever thread released a slot, so
+    // hop to the executor to start the job.
+    auto& queue = state->queues[static_cast<size_t>(priority)];
+    queue.emplace_back();
+    future = queue.back().getFuture().via(executor_.get());
+  }
+
+  // The limit may have risen since the queued jobs were added, in which case
+  // no running job will be releasing a slot to start them.
+  if (slotAvailable) {
+    pump();
+  }
+  return future;
+}
+
+void CheckoutScheduler::release() {
+  {
+    auto state = state_.wlock();
+    DCHECK_GT(state->running, 0);
+    --state->running;
+  }
+  pump();
+}
+
+void CheckoutScheduler::pump() {
+  {
+    auto state = state_.wlock();
+    if (state->pumping) {
+      // The thread already pumping will see the freed slot.
+      return;
+    }
+    state->pumping = true;
+  }
+
+  while (true) {
+    Promise<Unit> next;
+    {
+      auto state = state_.wlock();
+      auto queue = std::find_if(
+          state->queues.begin(),
+          state->queues.end(),
+          [](const std::deque<Promise<Unit>>& q) { return !q.empty(); });
+      if (queue == state->queues.end() || state->running >= getLimit()) {
+        state->pumping = false;
+        return;
+      }
+      next = std::move(queue->front());
+      queue->pop_front();
+      ++state->running;
+    }
+
+    // Fulfill the promise without holding the lock.  This only queues the
+    // job on the executor.
+    next.setValue();
+  }
+}
+
+size_t CheckoutScheduler::getNumRunning() const {
+  return state_.rlock()->running;
+}
+
+size_t CheckoutScheduler::getNumPending() const {
+  auto state = state_.rlock();
+  size_t total = 0;
+  for (const auto& queue : state->queues) {
+    total += queue.size();
+  }
+  return total;
+}
+}
+}
@@ -0,0 +1,113 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Executor.h>
+#include <folly/Synchronized.h>
+#include <folly/futures/Future.h>
+#include <array>
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace facebook {
+namespace eden {
+
+/**
+ * CheckoutScheduler limits the number of object fetches and inode loads that
+ * a single checkout operation has outstanding at once.
+ *
+ * Without a limit a large checkout starts a load for every changed directory
+ * and file as soon as it is discovered, which can send tens of thousands of
+ * simultaneous requests to the ObjectStore and starve FUSE requests that need
+ * the same BackingStore.
+ *
+ * Jobs waiting for a slot are started in priority order.  Tree fetches come
+ * first, since each one may discover more work, and blob fetches last.  While
+ * the mount point has FUSE requests outstanding, the checkout only starts new
+ * jobs while it has fewer than maxInFlightWhileBusy jobs running, leaving the
+ * rest of the BackingStore's capacity for interactive traffic.
+ *
+ * Each scheduled job holds a reference to the CheckoutScheduler until it has
+ * released its slot, so it must be managed by a shared_ptr.
+ */
+class CheckoutScheduler
+    : public std::enable_shared_from_this<CheckoutScheduler> {
+ public:
+  enum class Priority {
+    TREE_FETCH,
+    INODE_LOAD,
+    BLOB_FETCH,
+  };
+
+  /**
+   * isBusy is called whenever a slot becomes free, and should return true if
+   * there is interactive traffic that checkout should yield to.  It may be
+   * empty.
+   *
+   * Jobs that had to wait for a slot are started on executor, rather than on
+   * the thread that happened to release the slot.
+   */
+  CheckoutScheduler(
+      size_t maxInFlight,
+      size_t maxInFlightWhileBusy,
+      std::function<bool()> isBusy,
+      std::shared_ptr<folly::Executor> executor);
+
+  /**
+   * Run func() once a slot is available.
+   *
+   * func may return a value or a Future.  The slot is held until the Future
+   * that func returns has completed.  func is called immediately in the
+   * current thread if a slot is free, so schedule() must not be called while
+   * holding locks that func acquires.  Otherwise func is called later on the
+   * scheduler's executor.
+   */
+  template <typename Func>
+  auto schedule(Priority priority, Func&& func) {
+    return acquire(priority)
+        .then(std::forward<Func>(func))
+        .ensure([self = shared_from_this()] { self->release(); });
+  }
+
+  /** Returns the number of jobs that are currently running. */
+  size_t getNumRunning() const;
+
+  /** Returns the number of jobs waiting for a slot. */
+  size_t getNumPending() const;
+
+ private:
+  static constexpr size_t kNumPriorities = 3;
+
+  struct State {
+    std::array<std::deque<folly::Promise<folly::Unit>>, kNumPriorities> queues;
+    size_t running{0};
+    // Set while a thread is inside pump(), so that slots freed meanwhile
+    // are handed out by that loop instead of by a second one.
+    bool pumping{false};
+  };
+
+  folly::Future<folly::Unit> acquire(Priority priority);
+  void release();
+  void pump();
+  size_t getLimit() const;
+  bool hasPending(const State& state) const;
+
+  CheckoutScheduler(CheckoutScheduler const&) = delete;
+  CheckoutScheduler& operator=(CheckoutScheduler const&) = delete;
+
+  const size_t maxInFlight_;
+  const size_t maxInFlightWhileBusy_;
+  const std::function<bool()> isBusy_;
+  const std::shared_ptr<folly::Executor> executor_;
+  folly::Synchronized<State> state_;
+};
+}
+}
@@ -404,10 +404,14 @@ Dirstate::Dirstate(EdenMount* mount)
 
 Dirstate::~Dirstate() {}
 
-ThriftHgStatus Dirstate::getStatus(bool listIgnored) const {
-  ThriftStatusCallback callback(*userDirectives_.rlock());
-  mount_->diff(&callback, listIgnored);
-  return callback.extractStatus();
+folly::Future<ThriftHgStatus> Dirstate::getStatus(bool listIgnored) const {
+  // The callback must outlive the diff, so hold it in a shared_ptr that the
+  // continuation keeps alive.
+  auto callback =
+      std::make_shared<ThriftStatusCallback>(*userDirectives_.rlock());
+  return mount_->diff(callback.get(), listIgnored).then([callback] {
+    return callback->extractStatus();
+  });
 }
 
 std::unique_ptr<HgStatus> Dirstate::getStatusForExistingDirectory(
@@ -651,7 +655,7 @@ void Dirstate::computeDelta(
       // Each remaining entry in overlayIterator should be added to delta.added
       // (unless it is a directory).
       while (overlayIterator != overlayEnd) {
-        auto mode = overlayIterator->second.get()->mode;
+        auto mode = overlayIterator->second.mode;
         if (isFile(mode)) {
           delta.added.push_back(overlayIterator->first);
         }
@@ -685,12 +689,12 @@ void Dirstate::computeDelta(
       // 3. The entry was a file in the base commit but is now a directory.
       // 4. The entry was a directory in the base commit but is now a file.
       auto isFileInBase = isFile((*baseIterator).getMode());
-      auto isFileInOverlay = isFile(overlayIterator->second.get()->mode);
+      auto isFileInOverlay = isFile(overlayIterator->second.mode);
 
       if (isFileInBase && isFileInOverlay) {
         if (!hasMatchingAttributes(
                 &base,
-                overlayIterator->second.get(),
+                &overlayIterator->second,
                 mount_->getObjectStore(),
                 current,
                 *dir)) {
@@ -719,7 +723,7 @@ void Dirstate::computeDelta(
       }
       baseIterator++;
     } else {
-      auto mode = overlayIterator->second.get()->mode;
+      auto mode = overlayIterator->second.mode;
       if (isFile(mode)) {
         delta.added.push_back(overlayName);
       }
@@ -769,31 +773,46 @@ static bool isMagicPath(RelativePathPiece path) {
   return false;
 }
 
+/**
+ * Get the status of a path, given the result of looking up its inode.
+ */
 WorkingCopyStatus getPathStatus(
     RelativePathPiece path,
-    const EdenMount* mount) {
-  try {
-    // If any component of the path name is .eden, then this path is a magic
-    // path that we won't allow to be checked in or show up in the dirstate.
-    if (isMagicPath(path)) {
-      return WorkingCopyStatus::MagicPath;
-    }
+    const folly::Try<InodePtr>& inode) {
+  // If any component of the path name is .eden, then this path is a magic
+  // path that we won't allow to be checked in or show up in the dirstate.
+  if (isMagicPath(path)) {
+    return WorkingCopyStatus::MagicPath;
+  }
 
-    // Use getInodeBlocking() as a test of whether the path exists.
-    auto inodeBase = mount->getInodeBlocking(path);
-    if (inodeBase.asFilePtrOrNull() != nullptr) {
-      return WorkingCopyStatus::File;
-    } else {
-      return WorkingCopyStatus::Directory;
-    }
-  } catch (const std::system_error& e) {
-    if (e.code().value() != ENOENT) {
-      throw;
-    } else {
+  // The inode lookup is used as a test of whether the path exists.
+  if (inode.hasException()) {
+    bool doesNotExist = false;
+    inode.exception().with_exception([&](const std::system_error& e) {
+      doesNotExist = (e.code().value() == ENOENT);
+    });
+    if (doesNotExist) {
       return WorkingCopyStatus::DoesNotExist;
     }
+    inode.exception().throw_exception();
+  }
+
+  if (inode.value().asFilePtrOrNull() != nullptr) {
+    return WorkingCopyStatus::File;
+  } else {
+    return WorkingCopyStatus::Directory;
   }
 }
+
+WorkingCopyStatus getPathStatus(
+    RelativePathPiece path,
+    const EdenMount* mount) {
+  if (isMagicPath(path)) {
+    return WorkingCopyStatus::MagicPath;
+  }
+  return getPathStatus(
+      path, folly::makeTryWith([&] { return mount->getInodeBlocking(path); }));
+}
 }
 
 void Dirstate::addAll(
@@ -802,8 +821,19 @@ void Dirstate::addAll(
   // Find all of the untracked files and then update userDirectives, as
   // appropriate.
   std::unordered_map<RelativePath, AddAction> actions;
+
+  // Look up all of the inodes in one batch, so that directories shared by
+  // several of the paths are only walked once.
+  std::vector<RelativePath> lookupPaths;
+  lookupPaths.reserve(paths.size());
   for (auto& path : paths) {
-    auto pathStatus = getPathStatus(path, mount_);
+    lookupPaths.emplace_back(path);
+  }
+  auto inodes = mount_->getInodes(std::move(lookupPaths)).get();
+
+  for (size_t n = 0; n < paths.size(); ++n) {
+    const auto& path = paths[n];
+    auto pathStatus = getPathStatus(path, inodes[n]);
     if (pathStatus == WorkingCopyStatus::File) {
       // Admittedly, this getStatusForExistingDirectory() call will also
       // traverse subdirectories of path.dirname(), so it will do some extra
@@ -887,7 +917,7 @@ ShouldBeDeleted shouldFileBeDeletedByHgRemove(
   for (auto& entry : entries) {
     if (entry.first == name) {
       if (hasMatchingAttributes(
-              treeEntry, entry.second.get(), objectStore, *treeInode, *dir)) {
+              treeEntry, &entry.second, objectStore, *treeInode, *dir)) {
         return ShouldBeDeleted::YES;
       } else {
         addDirstateAddRemoveError(
@@ -9,6 +9,7 @@
  */
 #pragma once
 #include <folly/Synchronized.h>
+#include <folly/futures/Future.h>
 #include "eden/fs/inodes/DirstatePersistence.h"
 #include "eden/fs/inodes/InodePtrFwd.h"
 #include "eden/fs/inodes/gen-cpp2/overlay_types.h"
@@ -129,8 +130,11 @@ class Dirstate {
    *
    * @param listIgnored Whether or not to report information about ignored
    *     files.
+   *
+   * The returned Future completes once the diff of the working copy against
+   * the current commit has finished.
    */
-  ThriftHgStatus getStatus(bool listIgnored) const;
+  folly::Future<ThriftHgStatus> getStatus(bool listIgnored) const;
 
   /**
    * Analogous to `hg add <path1> <path2> ...` where each `<path>` identifies an
@@ -22,6 +22,7 @@
 #include "eden/fuse/Channel.h"
 #include "eden/fuse/DirHandle.h"
 #include "eden/fuse/FileHandle.h"
+#include "eden/fuse/InvalidationQueue.h"
 #include "eden/fuse/RequestData.h"
 
 using namespace folly;
@@ -308,11 +309,11 @@ folly::Future<folly::Unit> EdenDispatcher::unlink(
         // now as an example of how to use the invalidation API and
         // because we must invalidate when scmRemove is used.
         if (!fusell::RequestData::isFuseRequest()) {
-          auto chan = getChannelPtr();
-          if (chan) {
-            chan->invalidateEntry(inode->getNodeId(), childName);
-          }
+          auto* queue = mount_->getInvalidationQueue();
+          queue->invalidateEntry(inode->getNodeId(), childName);
+          return queue->flush();
         }
+        return folly::makeFuture();
       });
 }
 
@@ -10,16 +10,24 @@
 #include "EdenMount.h"
 
 #include <folly/ExceptionWrapper.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
 #include <folly/futures/Future.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <wangle/concurrent/GlobalExecutor.h>
+#include <chrono>
 
 #include "eden/fs/config/ClientConfig.h"
 #include "eden/fs/inodes/CheckoutContext.h"
+#include "eden/fs/inodes/CheckoutPrefetcher.h"
+#include "eden/fs/inodes/CheckoutScheduler.h"
 #include "eden/fs/inodes/DiffContext.h"
 #include "eden/fs/inodes/Dirstate.h"
 #include "eden/fs/inodes/EdenDispatcher.h"
 #include "eden/fs/inodes/EdenMounts.h"
 #include "eden/fs/inodes/FileInode.h"
+#include "eden/fs/inodes/GitIgnoreCache.h"
 #include "eden/fs/inodes/InodeError.h"
 #include "eden/fs/inodes/InodeMap.h"
 #include "eden/fs/inodes/Overlay.h"
@@ -27,7 +35,9 @@
 #include "eden/fs/model/Hash.h"
 #include "eden/fs/model/Tree.h"
 #include "eden/fs/model/git/GitIgnoreStack.h"
+#include "eden/fs/store/BlobCache.h"
 #include "eden/fs/store/ObjectStore.h"
+#include "eden/fuse/InvalidationQueue.h"
 #include "eden/fuse/MountPoint.h"
 
 using std::make_unique;
@@ -38,6 +48,43 @@ using folly::makeFuture;
 using folly::StringPiece;
 using folly::Unit;
 
+DEFINE_int64(
+    blob_cache_size,
+    32 * 1024 * 1024,
+    "The maximum number of bytes of recently closed file contents to keep "
+    "in memory for each mount point");
+DEFINE_int32(
+    gitignore_cache_size,
+    4096,
+    "The maximum number of parsed .gitignore files to keep in memory for "
+    "each mount point");
+DEFINE_string(
+    system_ignore_file,
+    "/etc/eden/ignore",
+    "A gitignore-style file of patterns to ignore in every mount point");
+DEFINE_string(
+    user_ignore_file,
+    "",
+    "A gitignore-style file of user-specific patterns to ignore in every "
+    "mount point (defaults to git's $XDG_CONFIG_HOME/git/ignore)");
+DEFINE_bool(
+    checkout_prefetch,
+    false,
+    "After a checkout completes, fetch the contents of changed files that "
+    "had previously been read, or that match --checkout_prefetch_globs, into "
+    "the local store in the background");
+DEFINE_string(
+    checkout_prefetch_globs,
+    "",
+    "A comma-separated list of glob patterns.  Changed files whose paths "
+    "match one of these are prefetched after checkout even if they had not "
+    "been read");
+DEFINE_int32(
+    checkout_prefetch_concurrency,
+    8,
+    "The maximum number of fetches that the post-checkout prefetch will "
+    "have in progress at once");
+
 namespace facebook {
 namespace eden {
 
@@ -57,34 +104,94 @@ static const uint64_t globalProcessGeneration =
 // for a given mount instance.
 static std::atomic<uint16_t> mountGeneration{0};
 
+namespace {
+/**
+ * The times at which each phase of a checkout operation completed.
+ */
+struct CheckoutTimes {
+  using Clock = std::chrono::steady_clock;
+
+  Clock::time_point start{Clock::now()};
+  Clock::time_point treesLoaded;
+  Clock::time_point actionsDone;
+  Clock::time_point journalWritten;
+  Clock::time_point invalidationsFlushed;
+};
+
+int64_t toMillis(CheckoutTimes::Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+      .count();
+}
+
+void logCheckoutComplete(
+    AbsolutePathPiece mountPath,
+    const CheckoutContext& ctx,
+    const CheckoutTimes& times,
+    size_t numConflicts) {
+  const auto& progress = *ctx.getProgress();
+  LOG(INFO) << "checkout for " << mountPath << " complete in "
+            << toMillis(times.invalidationsFlushed - times.start) << "ms: "
+            << numConflicts << " conflicts, " << progress.treesCompared.load()
+            << " trees compared, " << progress.treesLoaded.load()
+            << " trees loaded, " << progress.actionsCompleted.load()
+            << " actions, " << progress.inodesInvalidated.load()
+            << " invalidations; tree loading "
+            << toMillis(times.treesLoaded - times.start) << "ms, actions "
+            << toMillis(times.actionsDone - times.treesLoaded)
+            << "ms (overlay saves summed across directories "
+            << toMillis(ctx.getCumulativeOverlaySaveTime()) << "ms), journal "
+            << toMillis(times.journalWritten - times.actionsDone)
+            << "ms, invalidation "
+            << toMillis(times.invalidationsFlushed - times.journalWritten)
+            << "ms";
+}
+}
+
 std::shared_ptr<EdenMount> EdenMount::makeShared(
     std::unique_ptr<ClientConfig> config,
     std::unique_ptr<ObjectStore> objectStore,
     AbsolutePathPiece socketPath,
-    folly::ThreadLocal<fusell::EdenStats>* globalStats) {
-  return std::shared_ptr<EdenMount>{
-      new EdenMount{
-          std::move(config), std::move(objectStore), socketPath, globalStats},
-      EdenMountDeleter{}};
+    folly::ThreadLocal<fusell::EdenStats>* globalStats,
+    const overlay::SerializedInodeMap* takeoverInodeMap) {
+  return std::shared_ptr<EdenMount>{new EdenMount{std::move(config),
+                                                  std::move(objectStore),
+                                                  socketPath,
+                                                  globalStats,
+                                                  takeoverInodeMap},
+                                    EdenMountDeleter{}};
 }
 
 EdenMount::EdenMount(
     std::unique_ptr<ClientConfig> config,
     std::unique_ptr<ObjectStore> objectStore,
     AbsolutePathPiece socketPath,
-    folly::ThreadLocal<fusell::EdenStats>* globalStats)
+    folly::ThreadLocal<fusell::EdenStats>* globalStats,
+    const overlay::SerializedInodeMap* takeoverInodeMap)
     : globalEdenStats_(globalStats),
       config_(std::move(config)),
+      blobCache_{std::make_unique<BlobCache>(
+          static_cast<size_t>(std::max<int64_t>(FLAGS_blob_cache_size, 0)))},
+      gitIgnoreCache_{std::make_unique<GitIgnoreCache>(
+          static_cast<size_t>(std::max(FLAGS_gitignore_cache_size, 0)))},
       inodeMap_{new InodeMap(this)},
       dispatcher_{new EdenDispatcher(this)},
       mountPoint_(
           new fusell::MountPoint(config_->getMountPath(), dispatcher_.get())),
+      invalidationQueue_(std::make_unique<fusell::InvalidationQueue>(
+          mountPoint_.get(),
+          globalStats)),
       objectStore_(std::move(objectStore)),
       overlay_(std::make_shared<Overlay>(config_->getOverlayPath())),
       dirstate_(std::make_unique<Dirstate>(this)),
       bindMounts_(config_->getBindMounts()),
       mountGeneration_(globalProcessGeneration | ++mountGeneration),
       socketPath_(socketPath) {
+  // Restore the inode numbers before creating any inodes, so that the root
+  // and the TreeInodes loaded later can pick up their children's numbers.
+  if (takeoverInodeMap) {
+    inodeMap_->restore(*takeoverInodeMap);
+  }
+
   // Load the overlay, if present.
   auto rootOverlayDir = overlay_->loadOverlayDir(FUSE_ROOT_ID);
 
@@ -148,6 +255,7 @@ EdenMount::~EdenMount() {}
 
 void EdenMount::destroy() {
   VLOG(1) << "beginning shutdown for EdenMount " << getPath();
+  cancelCheckoutPrefetch();
   inodeMap_->beginShutdown();
 }
 
@@ -199,6 +307,13 @@ Future<InodePtr> EdenMount::getInode(RelativePathPiece path) const {
   return inodeMap_->getRootInode()->getChildRecursive(path);
 }
 
+Future<std::vector<folly::Try<InodePtr>>> EdenMount::getInodes(
+    std::vector<RelativePath> paths,
+    size_t maxConcurrentLoads) const {
+  return inodeMap_->getRootInode()->getChildrenRecursive(
+      std::move(paths), maxConcurrentLoads);
+}
+
 InodePtr EdenMount::getInodeBlocking(RelativePathPiece path) const {
   return getInode(path).get();
 }
@@ -219,23 +334,42 @@ folly::Future<std::vector<CheckoutConflict>> EdenMount::checkout(
   // This prevents multiple checkout operations from running in parallel.
   auto snapshotLock = currentSnapshot_.wlock();
   auto oldSnapshot = *snapshotLock;
-  auto ctx = std::make_shared<CheckoutContext>(std::move(snapshotLock), force);
+  auto ctx = std::make_shared<CheckoutContext>(
+      std::move(snapshotLock), getDispatcher(), force);
   VLOG(1) << "starting checkout for " << this->getPath() << ": " << oldSnapshot
           << " to " << snapshotHash;
 
+  auto prefetcher = createCheckoutPrefetcher();
+  ctx->setPrefetcher(prefetcher);
+
+  // Publish the progress counters for getCheckoutProgress()
+  auto progress = ctx->getProgress();
+  *checkoutProgress_.wlock() = progress;
+  auto times = std::make_shared<CheckoutTimes>();
+
   auto fromTreeFuture = objectStore_->getTreeForCommit(oldSnapshot);
   auto toTreeFuture = objectStore_->getTreeForCommit(snapshotHash);
 
   return folly::collect(fromTreeFuture, toTreeFuture)
-      .then([this, ctx](
+      .then([this, ctx, times](
           std::tuple<unique_ptr<Tree>, unique_ptr<Tree>> treeResults) {
+        times->treesLoaded = CheckoutTimes::Clock::now();
         auto& fromTree = std::get<0>(treeResults);
         auto& toTree = std::get<1>(treeResults);
         ctx->start(this->acquireRenameLock());
         return this->getRootInode()->checkout(
             ctx.get(), std::move(fromTree), std::move(toTree));
       })
-      .then([this, ctx, oldSnapshot, snapshotHash]() {
+      .then([
+        this,
+        ctx,
+        times,
+        oldSnapshot,
+        snapshotHash,
+        prefetcher = std::move(prefetcher)
+      ]() mutable {
+        times->actionsDone = CheckoutTimes::Clock::now();
+
         // Save the new snapshot hash
         VLOG(1) << "updating snapshot for " << this->getPath() << " from "
                 << oldSnapshot << " to " << snapshotHash;
@@ -252,8 +386,117 @@ folly::Future<std::vector<CheckoutConflict>> EdenMount::checkout(
         journalDelta->fromHash = oldSnapshot;
         journalDelta->toHash = snapshotHash;
         journal_.wlock()->addDelta(std::move(journalDelta));
+        times->journalWritten = CheckoutTimes::Clock::now();
+
+        // Checkout queues kernel cache invalidations rather than sending them
+        // while holding inode locks.  Wait for them to be delivered before
+        // reporting that the checkout is complete.
+        //
+        // When it has to wait, the flush completes on the invalidation
+        // queue's worker thread, so finish up on the CPU pool rather than
+        // hold up further invalidations.
+        auto flushed = invalidationQueue_->flush();
+        if (!flushed.isReady()) {
+          flushed = std::move(flushed).via(wangle::getCPUExecutor().get());
+        }
+        return flushed.then([
+          this,
+          ctx,
+          times,
+          conflicts = std::move(conflicts),
+          prefetcher = std::move(prefetcher)
+        ]() mutable {
+          times->invalidationsFlushed = CheckoutTimes::Clock::now();
+          logCheckoutComplete(
+              this->getPath(), *ctx, *times, conflicts.size());
+          if (prefetcher) {
+            this->startCheckoutPrefetch(std::move(prefetcher));
+          }
+          return std::move(conflicts);
+        });
+      })
+      .ensure([this, progress]() {
+        progress->finished = true;
+        auto current = checkoutProgress_.wlock();
+        if (*current == progress) {
+          current->reset();
+        }
+      });
+}
+
+std::shared_ptr<const CheckoutProgress> EdenMount::getCheckoutProgress()
+    const {
+  return *checkoutProgress_.rlock();
+}
+
+std::shared_ptr<CheckoutPrefetcher> EdenMount::createCheckoutPrefetcher() {
+  // Any prefetch for a previous checkout is now fetching the wrong data
+  cancelCheckoutPrefetch();
+  if (!FLAGS_checkout_prefetch) {
+    return nullptr;
+  }
+
+  vector<std::string> globs;
+  folly::split(',', FLAGS_checkout_prefetch_globs, globs, true);
+  const auto* dispatcher = getDispatcher();
+  auto scheduler = std::make_shared<CheckoutScheduler>(
+      FLAGS_checkout_prefetch_concurrency,
+      1,
+      [dispatcher]() { return dispatcher->getOutstandingRequestCount() > 0; },
+      wangle::getCPUExecutor());
+  return std::make_shared<CheckoutPrefetcher>(globs, std::move(scheduler));
+}
+
+void EdenMount::startCheckoutPrefetch(
+    std::shared_ptr<CheckoutPrefetcher> prefetcher) {
+  *checkoutPrefetcher_.wlock() = prefetcher;
+  // Hold a reference to the root inode while the prefetch runs, so the mount
+  // and its ObjectStore are not destroyed out from under it.  destroy()
+  // cancels the prefetch so this does not delay unmounting for long.
+  prefetcher->start(objectStore_.get()).ensure([root = getRootInode()]() {});
+}
 
-        return conflicts;
+void EdenMount::cancelCheckoutPrefetch() {
+  auto prefetcher = *checkoutPrefetcher_.rlock();
+  if (prefetcher) {
+    prefetcher->cancel();
+  }
+}
+
+std::shared_ptr<CheckoutPrefetcher> EdenMount::getCheckoutPrefetcher() const {
+  return *checkoutPrefetcher_.rlock();
+}
+
+Future<CheckoutDryRunResult> EdenMount::checkoutDryRun(
+    Hash snapshotHash,
+    bool force) {
+  // Hold the snapshot lock so that the parent commit cannot change while we
+  // are comparing against it, but do not acquire the rename lock.
+  auto snapshotLock = currentSnapshot_.wlock();
+  auto oldSnapshot = *snapshotLock;
+  auto ctx = std::make_shared<CheckoutContext>(
+      std::move(snapshotLock), getDispatcher(), force, /* dryRun = */ true);
+  VLOG(1) << "starting checkout dry run for " << this->getPath() << ": "
+          << oldSnapshot << " to " << snapshotHash;
+
+  auto fromTreeFuture = objectStore_->getTreeForCommit(oldSnapshot);
+  auto toTreeFuture = objectStore_->getTreeForCommit(snapshotHash);
+
+  return folly::collect(fromTreeFuture, toTreeFuture)
+      .then([this, ctx](
+          std::tuple<unique_ptr<Tree>, unique_ptr<Tree>> treeResults) {
+        auto& fromTree = std::get<0>(treeResults);
+        auto& toTree = std::get<1>(treeResults);
+        return this->getRootInode()->checkout(
+            ctx.get(), std::move(fromTree), std::move(toTree));
+      })
+      .then([ctx, snapshotHash]() {
+        CheckoutDryRunResult result;
+        result.conflicts = ctx->finish(snapshotHash);
+        result.filesAdded = ctx->getFilesAdded();
+        result.filesModified = ctx->getFilesModified();
+        result.filesRemoved = ctx->getFilesRemoved();
+        return result;
       });
 }
 
@@ -263,16 +506,11 @@ Future<Unit> EdenMount::diff(InodeDiffCallback* callback, bool listIgnored) {
       make_unique<DiffContext>(callback, listIgnored, getObjectStore());
   const DiffContext* ctxPtr = context.get();
 
-  // TODO: Load the system-wide ignore settings and user-specific
-  // ignore settings.
-  auto ignore = make_unique<GitIgnoreStack>(nullptr);
-  auto* ignorePtr = ignore.get();
-
-  // stateHolder() exists to ensure that the DiffContext and GitIgnoreStack
-  // exists until the diff completes.
-  auto stateHolder =
-      [ ctx = std::move(context), ignore = std::move(ignore) ](){};
+  // stateHolder() exists to ensure that the DiffContext exists until the diff
+  // completes.
+  auto stateHolder = [ctx = std::move(context)](){};
 
+  auto* ignorePtr = getRootIgnore();
   auto rootInode = getRootInode();
   return getRootTreeFuture()
       .then([ ctxPtr, ignorePtr, rootInode = std::move(rootInode) ](
@@ -283,6 +521,23 @@ Future<Unit> EdenMount::diff(InodeDiffCallback* callback, bool listIgnored) {
       .ensure(std::move(stateHolder));
 }
 
+GitIgnoreStack* EdenMount::getRootIgnore() {
+  std::call_once(rootIgnoreOnce_, [this] {
+    // A missing or unreadable ignore file is not an error; it simply
+    // contributes no rules.
+    auto loadIgnoreFile = [](GitIgnoreStack* parent, const std::string& path) {
+      std::string contents;
+      if (path.empty() || !folly::readFile(path.c_str(), contents)) {
+        return make_unique<GitIgnoreStack>(parent);
+      }
+      return make_unique<GitIgnoreStack>(parent, contents);
+    };
+    systemIgnore_ = loadIgnoreFile(nullptr, FLAGS_system_ignore_file);
+    userIgnore_ = loadIgnoreFile(systemIgnore_.get(), FLAGS_user_ignore_file);
+  });
+  return userIgnore_.get();
+}
+
 void EdenMount::resetCommit(Hash snapshotHash) {
   // We currently don't verify that snapshotHash refers to a valid commit
   // in the ObjectStore.  We could do that just for verification purposes.
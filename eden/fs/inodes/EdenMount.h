@@ -12,9 +12,11 @@
 #include <folly/SharedMutex.h>
 #include <folly/Synchronized.h>
 #include <folly/ThreadLocal.h>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <vector>
 #include "eden/fs/inodes/InodePtrFwd.h"
 #include "eden/fs/journal/JournalDelta.h"
 #include "eden/fuse/EdenStats.h"
@@ -24,20 +26,32 @@
 namespace folly {
 template <typename T>
 class Future;
+template <typename T>
+class Try;
 }
 
 namespace facebook {
 namespace eden {
 namespace fusell {
 class Channel;
+class InvalidationQueue;
 class MountPoint;
 }
+namespace overlay {
+class SerializedInodeMap;
+}
 
 class BindMount;
+class BlobCache;
 class CheckoutConflict;
+class CheckoutDryRunResult;
+class CheckoutPrefetcher;
+struct CheckoutProgress;
 class ClientConfig;
 class Dirstate;
 class EdenDispatcher;
+class GitIgnoreCache;
+class GitIgnoreStack;
 class InodeDiffCallback;
 class InodeMap;
 class ObjectStore;
@@ -60,11 +74,17 @@ class SharedRenameLock;
  */
 class EdenMount {
  public:
+  /**
+   * If takeoverInodeMap is non-null, the mount point is being handed over to
+   * us by another process, and the inode numbers that it recorded are
+   * restored.  (See InodeMap::restore().)
+   */
   EdenMount(
       std::unique_ptr<ClientConfig> config,
       std::unique_ptr<ObjectStore> objectStore,
       AbsolutePathPiece socketPath,
-      folly::ThreadLocal<fusell::EdenStats>* globalStats);
+      folly::ThreadLocal<fusell::EdenStats>* globalStats,
+      const overlay::SerializedInodeMap* takeoverInodeMap = nullptr);
 
   /**
    * Create a shared_ptr to an EdenMount.
@@ -76,7 +96,8 @@ class EdenMount {
       std::unique_ptr<ClientConfig> config,
       std::unique_ptr<ObjectStore> objectStore,
       AbsolutePathPiece socketPath,
-      folly::ThreadLocal<fusell::EdenStats>* globalStats);
+      folly::ThreadLocal<fusell::EdenStats>* globalStats,
+      const overlay::SerializedInodeMap* takeoverInodeMap = nullptr);
 
   /**
    * Destroy the EdenMount.
@@ -109,6 +130,16 @@ class EdenMount {
    */
   fusell::Channel* getFuseChannel() const;
 
+  /**
+   * Return the queue used to send kernel cache invalidations for this mount.
+   *
+   * Invalidations should be sent through this queue rather than directly on
+   * the FUSE channel, so that they are not sent while holding inode locks.
+   */
+  fusell::InvalidationQueue* getInvalidationQueue() const {
+    return invalidationQueue_.get();
+  }
+
   /**
    * Return the path to the mount point.
    */
@@ -137,6 +168,22 @@ class EdenMount {
     return objectStore_.get();
   }
 
+  /**
+   * Return the BlobCache holding recently released file contents for this
+   * mount point.
+   */
+  BlobCache* getBlobCache() const {
+    return blobCache_.get();
+  }
+
+  /**
+   * Return the cache of parsed .gitignore files shared by all diff operations
+   * on this mount point.
+   */
+  GitIgnoreCache* getGitIgnoreCache() const {
+    return gitIgnoreCache_.get();
+  }
+
   /**
    * Return the EdenDispatcher used for this mount.
    */
@@ -194,6 +241,20 @@ class EdenMount {
    */
   folly::Future<InodePtr> getInode(RelativePathPiece path) const;
 
+  /**
+   * Look up the Inode objects for a batch of paths.
+   *
+   * This is much cheaper than calling getInode() for each path when many of
+   * the paths share parent directories, since each directory is only looked
+   * up once.  The result for each path is returned in the same order as
+   * paths, and fails in the same ways as getInode() would.
+   *
+   * At most maxConcurrentLoads inodes are looked up at once.
+   */
+  folly::Future<std::vector<folly::Try<InodePtr>>> getInodes(
+      std::vector<RelativePath> paths,
+      size_t maxConcurrentLoads = std::numeric_limits<size_t>::max()) const;
+
   /**
    * A blocking version of getInode().
    *
@@ -228,6 +289,34 @@ class EdenMount {
       Hash snapshotHash,
       bool force = false);
 
+  /**
+   * Report what checking out the specified commit would do, without
+   * changing anything.
+   *
+   * This returns the conflicts that checkout() would report, plus counts of
+   * the files it would add, modify, and remove.  Only Trees and blob metadata
+   * are loaded, never blob contents.  The rename lock is not held, so
+   * concurrent file system operations are not blocked.
+   */
+  folly::Future<CheckoutDryRunResult> checkoutDryRun(
+      Hash snapshotHash,
+      bool force = false);
+
+  /**
+   * Get the progress counters for the checkout operation currently running on
+   * this mount point.
+   *
+   * Returns null if no checkout is in progress.  The returned object remains
+   * valid after the checkout finishes, and its finished flag is set then.
+   */
+  std::shared_ptr<const CheckoutProgress> getCheckoutProgress() const;
+
+  /**
+   * Get the CheckoutPrefetcher started by the most recent checkout, if
+   * --checkout_prefetch is enabled.
+   */
+  std::shared_ptr<CheckoutPrefetcher> getCheckoutPrefetcher() const;
+
   /**
    * Compute differences between the current commit and the working directory
    * state.
@@ -293,6 +382,20 @@ class EdenMount {
    */
   ~EdenMount();
 
+  /**
+   * Return the ignore rules that apply above the root of the mount, loading
+   * the system and user ignore files the first time this is called.
+   */
+  GitIgnoreStack* getRootIgnore();
+
+  /**
+   * Create the CheckoutPrefetcher for a new checkout, cancelling the
+   * prefetch for the previous one.  Returns null if prefetching is disabled.
+   */
+  std::shared_ptr<CheckoutPrefetcher> createCheckoutPrefetcher();
+  void startCheckoutPrefetch(std::shared_ptr<CheckoutPrefetcher> prefetcher);
+  void cancelCheckoutPrefetch();
+
   /**
    * The stats instance associated with this mount point.
    * This is just a reference to a global stats instance today, but we'd
@@ -302,9 +405,16 @@ class EdenMount {
   folly::ThreadLocal<fusell::EdenStats>* globalEdenStats_{nullptr};
 
   std::unique_ptr<ClientConfig> config_;
+  /**
+   * The BlobCache is declared before the InodeMap so that it outlives all
+   * FileData objects, which release their blobs into it when destroyed.
+   */
+  std::unique_ptr<BlobCache> blobCache_;
+  std::unique_ptr<GitIgnoreCache> gitIgnoreCache_;
   std::unique_ptr<InodeMap> inodeMap_;
   std::unique_ptr<EdenDispatcher> dispatcher_;
   std::unique_ptr<fusell::MountPoint> mountPoint_;
+  std::unique_ptr<fusell::InvalidationQueue> invalidationQueue_;
   std::unique_ptr<ObjectStore> objectStore_;
   std::shared_ptr<Overlay> overlay_;
   std::unique_ptr<Dirstate> dirstate_;
@@ -333,6 +443,27 @@ class EdenMount {
 
   folly::Synchronized<Journal> journal_;
 
+  /**
+   * The progress counters of the checkout currently in progress, if any.
+   */
+  folly::Synchronized<std::shared_ptr<const CheckoutProgress>>
+      checkoutProgress_;
+
+  /**
+   * The background prefetch started by the most recent checkout.
+   */
+  folly::Synchronized<std::shared_ptr<CheckoutPrefetcher>> checkoutPrefetcher_;
+
+  /**
+   * The system-wide and user-specific ignore rules, which apply below every
+   * .gitignore file in the mount.  These are loaded by the first diff() and
+   * then reused for the lifetime of the mount.  userIgnore_ is the top of
+   * the stack, and refers to systemIgnore_ as its parent.
+   */
+  std::once_flag rootIgnoreOnce_;
+  std::unique_ptr<GitIgnoreStack> systemIgnore_;
+  std::unique_ptr<GitIgnoreStack> userIgnore_;
+
   /**
    * A number to uniquely identify this particular incarnation of this mount.
    * We use bits from the process id and the time at which we were mounted.
@@ -41,14 +41,14 @@ void getModifiedDirectoriesRecursive(
     modifiedDirectories.push_back(dirPath.copy());
     for (auto& entIter : contents.entries) {
       const auto& ent = entIter.second;
-      if (S_ISDIR(ent->mode) && ent->isMaterialized()) {
+      if (S_ISDIR(ent.mode) && ent.isMaterialized()) {
         const auto& name = entIter.first;
-        auto childInode = ent->inode;
+        auto childInode = ent.inode;
         CHECK(childInode != nullptr);
         auto childPath = dirPath + name;
         auto childDir = boost::polymorphic_downcast<TreeInode*>(childInode);
         DCHECK(childDir->getContents().rlock()->materialized)
-            << (dirPath + name) << " entry " << ent.get()
+            << (dirPath + name) << " entry " << &ent
             << " materialized is true, but the contained dir is !materialized";
 
         getModifiedDirectoriesRecursive(
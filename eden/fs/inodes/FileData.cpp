@@ -17,12 +17,14 @@
 #include <folly/io/Cursor.h>
 #include <folly/io/IOBuf.h>
 #include <openssl/sha.h>
+#include <algorithm>
 #include "Overlay.h"
 #include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/FileInode.h"
 #include "eden/fs/inodes/Overlay.h"
 #include "eden/fs/model/Blob.h"
 #include "eden/fs/model/Hash.h"
+#include "eden/fs/store/BlobCache.h"
 #include "eden/fs/store/ObjectStore.h"
 #include "eden/fuse/BufVec.h"
 #include "eden/fuse/MountPoint.h"
@@ -49,7 +51,21 @@ FileData::FileData(FileInode* inode, const folly::Optional<Hash>& hash)
 }
 
 FileData::FileData(FileInode* inode, folly::File&& file)
-    : inode_(inode), file_(std::move(file)) {}
+    : inode_(inode), file_(std::move(file)) {
+  // A newly created file is empty, so we can start hashing its contents as
+  // they are appended.
+  struct stat st;
+  checkUnixError(fstat(file_.fd(), &st));
+  if (st.st_size == 0) {
+    resetSha1Stream();
+  }
+}
+
+FileData::~FileData() {
+  if (blob_) {
+    inode_->getMount()->getBlobCache()->insert(std::move(blob_));
+  }
+}
 
 // Conditionally updates target with either the value provided by
 // the caller, or with the current time value, depending on the value
@@ -86,6 +102,13 @@ struct stat FileData::setAttr(const struct stat& attr, int to_set) {
 
   if (to_set & FUSE_SET_ATTR_SIZE) {
     checkUnixError(ftruncate(file_.fd(), attr.st_size));
+    invalidateSha1(state);
+    if (attr.st_size == 0) {
+      resetSha1Stream();
+    } else {
+      sha1Stream_.clear();
+    }
+    state->generation = FileInode::allocateGeneration();
   }
 
   if (to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID)) {
@@ -199,7 +222,7 @@ void FileData::flush(uint64_t /* lock_owner */) {
   // but let's take this opportunity to update the sha1 attribute.
   auto state = inode_->state_.wlock();
   if (file_ && !sha1Valid_) {
-    recomputeAndStoreSha1(state);
+    getOverlaySha1(state);
   }
 }
 
@@ -219,7 +242,7 @@ void FileData::fsync(bool datasync) {
 
   // let's take this opportunity to update the sha1 attribute.
   if (!sha1Valid_) {
-    recomputeAndStoreSha1(state);
+    getOverlaySha1(state);
   }
 }
 
@@ -265,6 +288,19 @@ std::string FileData::readAll() {
 }
 
 fusell::BufVec FileData::read(size_t size, off_t off) {
+  {
+    auto state = inode_->state_.rlock();
+    if (file_) {
+      // Don't read materialized data into our own buffer; hand the overlay
+      // file descriptor to the FUSE layer so it can be spliced straight into
+      // the kernel.  The file_ stays open for as long as the FileHandle
+      // performing this read holds a reference to us.
+      return fusell::BufVec(file_.fd(), off, size);
+    }
+  }
+
+  // Blob data is already in memory.  readIntoBuffer() returns a clone that
+  // shares the blob's buffer, so no copy is made here either.
   auto buf = readIntoBuffer(size, off);
   return fusell::BufVec(std::move(buf));
 }
@@ -276,10 +312,12 @@ size_t FileData::write(fusell::BufVec&& buf, off_t off) {
     folly::throwSystemErrorExplicit(EINVAL);
   }
 
-  sha1Valid_ = false;
+  invalidateSha1(state);
+  state->generation = FileInode::allocateGeneration();
   auto vec = buf.getIov();
   auto xfer = ::pwritev(file_.fd(), vec.data(), vec.size(), off);
   checkUnixError(xfer);
+  updateSha1Stream(vec.data(), vec.size(), off, xfer);
   return xfer;
 }
 
@@ -290,9 +328,14 @@ size_t FileData::write(folly::StringPiece data, off_t off) {
     folly::throwSystemErrorExplicit(EINVAL);
   }
 
-  sha1Valid_ = false;
+  invalidateSha1(state);
+  state->generation = FileInode::allocateGeneration();
   auto xfer = ::pwrite(file_.fd(), data.data(), data.size(), off);
   checkUnixError(xfer);
+  struct iovec iov;
+  iov.iov_base = const_cast<char*>(data.data());
+  iov.iov_len = data.size();
+  updateSha1Stream(&iov, 1, off, xfer);
   return xfer;
 }
 
@@ -321,7 +364,7 @@ Future<Unit> FileData::ensureDataLoaded() {
   // For now doing a blocking load with the inode_->state_ lock held ensures
   // that only one thread can load the data at a time.  It's pretty unfortunate
   // to block with the lock held, though :-(
-  blob_ = getObjectStore()->getBlob(state->hash.value());
+  blob_ = loadBlob(state->hash.value());
   return makeFuture();
 }
 
@@ -334,8 +377,10 @@ Future<Unit> FileData::materializeForWrite(int openFlags) {
     CHECK(!state->hash.hasValue());
     if ((openFlags & O_TRUNC) != 0) {
       // truncating a file that we already have open
-      sha1Valid_ = false;
+      invalidateSha1(state);
+      state->generation = FileInode::allocateGeneration();
       checkUnixError(ftruncate(file_.fd(), 0));
+      resetSha1Stream();
       auto emptySha1 = Hash::sha1(ByteRange{});
       storeSha1(state, emptySha1);
     }
@@ -349,13 +394,14 @@ Future<Unit> FileData::materializeForWrite(int openFlags) {
   auto filePath = inode_->getLocalPath();
   if ((openFlags & O_TRUNC) != 0) {
     file_ = folly::File(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    resetSha1Stream();
     sha1 = Hash::sha1(ByteRange{});
   } else {
     if (!blob_) {
       // TODO: Load the blob using the non-blocking Future APIs.
       // However, just as in ensureDataLoaded() above we will also need
       // to add a mechanism to wait for already in-progress loads.
-      blob_ = getObjectStore()->getBlob(state->hash.value());
+      blob_ = loadBlob(state->hash.value());
     }
 
     // Write the blob contents out to the overlay
@@ -364,7 +410,11 @@ Future<Unit> FileData::materializeForWrite(int openFlags) {
         filePath.stringPiece(), iov.data(), iov.size(), 0600);
     file_ = folly::File(filePath.c_str(), O_RDWR);
 
-    sha1 = getObjectStore()->getSha1ForBlob(state->hash.value());
+    // Use the SHA-1 we already know for the blob if possible, rather than
+    // hashing the contents we just wrote out.
+    sha1 = state->sha1.hasValue()
+        ? state->sha1.value()
+        : getObjectStore()->getSha1ForBlob(state->hash.value());
   }
 
   // Copy and apply the sha1 to the new file.  This saves us from
@@ -375,32 +425,66 @@ Future<Unit> FileData::materializeForWrite(int openFlags) {
   // Update the FileInode to indicate that we are materialized now
   blob_.reset();
   state->hash = folly::none;
+  state->generation = FileInode::allocateGeneration();
 
   return makeFuture();
 }
 
 Hash FileData::getSha1() {
   auto state = inode_->state_.wlock();
+  if (state->sha1.hasValue()) {
+    return state->sha1.value();
+  }
   if (file_) {
-    std::string shastr;
-    if (sha1Valid_) {
-      shastr = fgetxattr(file_.fd(), kXattrSha1);
-    }
-    if (shastr.empty()) {
-      return recomputeAndStoreSha1(state);
-    } else {
-      return Hash(shastr);
-    }
+    return getOverlaySha1(state);
   }
 
   CHECK(state->hash.hasValue());
-  return getObjectStore()->getSha1ForBlob(state->hash.value());
+  auto sha1 = getObjectStore()->getSha1ForBlob(state->hash.value());
+  state->sha1 = sha1;
+  return sha1;
 }
 
 ObjectStore* FileData::getObjectStore() const {
   return inode_->getMount()->getObjectStore();
 }
 
+std::shared_ptr<const Blob> FileData::loadBlob(const Hash& hash) {
+  auto blob = inode_->getMount()->getBlobCache()->get(hash);
+  if (blob) {
+    return blob;
+  }
+  return getObjectStore()->getBlob(hash);
+}
+
+Hash FileData::getOverlaySha1(
+    const folly::Synchronized<FileInode::State>::LockedPtr& state) {
+  if (state->sha1.hasValue()) {
+    return state->sha1.value();
+  }
+
+  if (sha1Valid_) {
+    auto shastr = fgetxattr(file_.fd(), kXattrSha1);
+    if (!shastr.empty()) {
+      auto sha1 = Hash(shastr);
+      state->sha1 = sha1;
+      return sha1;
+    }
+  }
+
+  if (sha1Stream_.hasValue()) {
+    // Finalize a copy, so that we can keep hashing any further appends.
+    SHA_CTX ctx = sha1Stream_.value();
+    uint8_t digest[SHA_DIGEST_LENGTH];
+    SHA1_Final(digest, &ctx);
+    auto sha1 = Hash(folly::ByteRange(digest, sizeof(digest)));
+    storeSha1(state, sha1);
+    return sha1;
+  }
+
+  return recomputeAndStoreSha1(state);
+}
+
 Hash FileData::recomputeAndStoreSha1(
     const folly::Synchronized<FileInode::State>::LockedPtr& state) {
   uint8_t buf[8192];
@@ -425,6 +509,11 @@ Hash FileData::recomputeAndStoreSha1(
     off += len;
   }
 
+  // Keep the intermediate state around so that subsequent appends do not
+  // require rereading the whole file.
+  sha1Stream_ = ctx;
+  sha1StreamLength_ = off;
+
   uint8_t digest[SHA_DIGEST_LENGTH];
   SHA1_Final(digest, &ctx);
   auto sha1 = Hash(folly::ByteRange(digest, sizeof(digest)));
@@ -433,8 +522,9 @@ Hash FileData::recomputeAndStoreSha1(
 }
 
 void FileData::storeSha1(
-    const folly::Synchronized<FileInode::State>::LockedPtr& /* state */,
+    const folly::Synchronized<FileInode::State>::LockedPtr& state,
     Hash sha1) {
+  state->sha1 = sha1;
   try {
     fsetxattr(file_.fd(), kXattrSha1, sha1.toString());
     sha1Valid_ = true;
@@ -446,5 +536,42 @@ void FileData::storeSha1(
                  << folly::exceptionStr(ex);
   }
 }
+
+void FileData::invalidateSha1(
+    const folly::Synchronized<FileInode::State>::LockedPtr& state) {
+  sha1Valid_ = false;
+  state->sha1 = folly::none;
+}
+
+void FileData::resetSha1Stream() {
+  sha1Stream_.emplace();
+  SHA1_Init(sha1Stream_.get_pointer());
+  sha1StreamLength_ = 0;
+}
+
+void FileData::updateSha1Stream(
+    const struct iovec* iov,
+    size_t iovcnt,
+    off_t off,
+    size_t length) {
+  if (!sha1Stream_.hasValue()) {
+    return;
+  }
+  if (off != sha1StreamLength_) {
+    // This was not an append, so the stream no longer describes the file.
+    sha1Stream_.clear();
+    return;
+  }
+
+  // pwritev() may have written fewer bytes than requested, so only hash the
+  // data that actually made it into the file.
+  size_t remaining = length;
+  for (size_t n = 0; n < iovcnt && remaining > 0; ++n) {
+    auto len = std::min(remaining, iov[n].iov_len);
+    SHA1_Update(sha1Stream_.get_pointer(), iov[n].iov_base, len);
+    remaining -= len;
+  }
+  sha1StreamLength_ += length;
+}
 }
 }
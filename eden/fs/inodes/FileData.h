@@ -12,6 +12,8 @@
 #include <folly/Portability.h>
 #include <folly/futures/Future.h>
 #include <folly/io/IOBuf.h>
+#include <openssl/sha.h>
+#include <sys/uio.h>
 #include <mutex>
 #include "eden/fs/inodes/FileInode.h"
 #include "eden/fs/model/Tree.h"
@@ -54,6 +56,15 @@ class FileData {
    * O_EXCL correctly. */
   FileData(FileInode* inode, folly::File&& file);
 
+  /**
+   * Destroy the FileData.
+   *
+   * If we were holding blob contents loaded from the ObjectStore they are
+   * handed off to the EdenMount's BlobCache, so that re-opening the file
+   * shortly afterwards does not need to load them again.
+   */
+  ~FileData();
+
   /**
    * Read up to size bytes from the file at the specified offset.
    *
@@ -66,6 +77,16 @@ class FileData {
    * May throw exceptions on error.
    */
   std::unique_ptr<folly::IOBuf> readIntoBuffer(size_t size, off_t off);
+
+  /**
+   * Read up to size bytes from the file at the specified offset, for replying
+   * to a FUSE read request.
+   *
+   * For materialized files the returned BufVec refers to the overlay file
+   * descriptor rather than containing the data, so that it can be spliced
+   * into the kernel.  The BufVec must therefore be consumed while the caller
+   * still holds a reference to this FileData.
+   */
   fusell::BufVec read(size_t size, off_t off);
   size_t write(fusell::BufVec&& buf, off_t off);
   size_t write(folly::StringPiece data, off_t off);
@@ -80,7 +101,11 @@ class FileData {
   // names matching FUSE_SET_*.
   struct stat setAttr(const struct stat& attr, int to_set);
 
-  /// Returns the sha1 hash of the content.
+  /**
+   * Returns the sha1 hash of the content.
+   *
+   * The result is cached on the FileInode until the contents change.
+   */
   Hash getSha1();
 
   /**
@@ -114,12 +139,40 @@ class FileData {
  private:
   ObjectStore* getObjectStore() const;
 
+  /**
+   * Load the blob contents for the specified hash, checking the mount's
+   * BlobCache before going to the ObjectStore.
+   */
+  std::shared_ptr<const Blob> loadBlob(const Hash& hash);
+
+  /**
+   * Get the SHA1 content hash of the open file_, using the cached value,
+   * the sha1 xattr or sha1Stream_ if possible, and only rereading the file if
+   * none of them are available.
+   */
+  Hash getOverlaySha1(
+      const folly::Synchronized<FileInode::State>::LockedPtr& state);
   /// Recompute the SHA1 content hash of the open file_.
   Hash recomputeAndStoreSha1(
       const folly::Synchronized<FileInode::State>::LockedPtr& state);
   void storeSha1(
       const folly::Synchronized<FileInode::State>::LockedPtr& state,
       Hash sha1);
+  /// Forget the SHA1 of file_, because its contents have changed.
+  void invalidateSha1(
+      const folly::Synchronized<FileInode::State>::LockedPtr& state);
+
+  /// Start a new sha1Stream_ for a file_ that is now empty.
+  void resetSha1Stream();
+  /**
+   * Update sha1Stream_ after length bytes from iov were written to file_ at
+   * offset off.  The stream is discarded unless this was an append.
+   */
+  void updateSha1Stream(
+      const struct iovec* iov,
+      size_t iovcnt,
+      off_t off,
+      size_t length);
 
   /**
    * The FileInode that this FileData object belongs to.
@@ -130,14 +183,30 @@ class FileData {
    */
   FileInode* const inode_{nullptr};
 
-  /// if backed by tree, the data from the tree, else nullptr.
-  std::unique_ptr<Blob> blob_;
+  /**
+   * If backed by tree, the data from the tree, else nullptr.
+   *
+   * This is a shared_ptr since the same Blob may also be referenced by the
+   * EdenMount's BlobCache.
+   */
+  std::shared_ptr<const Blob> blob_;
 
   /// if backed by an overlay file, the open file descriptor
   folly::File file_;
 
   /// if backed by an overlay file, whether the sha1 xattr is valid
   bool sha1Valid_{false};
+
+  /**
+   * If backed by an overlay file, the running SHA1 state of its entire
+   * contents, which are sha1StreamLength_ bytes long.
+   *
+   * This is kept up to date as long as the file is only appended to, so
+   * getSha1() does not have to reread the whole file after every append.  It
+   * is discarded by any other kind of modification.
+   */
+  folly::Optional<SHA_CTX> sha1Stream_;
+  off_t sha1StreamLength_{0};
 };
 }
 }
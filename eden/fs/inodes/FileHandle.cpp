@@ -33,6 +33,14 @@ FileHandle::~FileHandle() {
   inode_->fileHandleDidClose();
 }
 
+fuse_ino_t FileHandle::getInodeNumber() {
+  return inode_->getNodeId();
+}
+
+int FileHandle::getOpenFlags() const {
+  return openFlags_;
+}
+
 folly::Future<fusell::Dispatcher::Attr> FileHandle::getattr() {
   return inode_->getattr();
 }
@@ -27,6 +27,8 @@ class FileHandle : public fusell::FileHandle {
       int flags);
   ~FileHandle();
 
+  fuse_ino_t getInodeNumber() override;
+  int getOpenFlags() const override;
   folly::Future<fusell::Dispatcher::Attr> getattr() override;
   folly::Future<fusell::Dispatcher::Attr> setattr(
       const struct stat& attr,
@@ -9,6 +9,7 @@
  */
 #include "FileInode.h"
 
+#include <atomic>
 #include "EdenMount.h"
 #include "FileData.h"
 #include "FileHandle.h"
@@ -17,6 +18,7 @@
 #include "TreeInode.h"
 #include "eden/fs/model/Blob.h"
 #include "eden/fs/model/Hash.h"
+#include "eden/fs/store/BlobMetadata.h"
 #include "eden/fs/store/ObjectStore.h"
 #include "eden/utils/XAttr.h"
 
@@ -38,7 +40,8 @@ FileInode::State::State(
     : data(std::make_shared<FileData>(inode, h)),
       mode(m),
       creationTime(std::chrono::system_clock::now()),
-      hash(h) {}
+      hash(h),
+      generation(allocateGeneration()) {}
 
 FileInode::State::State(
     FileInode* inode,
@@ -48,7 +51,8 @@ FileInode::State::State(
     : data(std::make_shared<FileData>(inode, std::move(file))),
       mode(m),
       rdev(rdev),
-      creationTime(std::chrono::system_clock::now()) {}
+      creationTime(std::chrono::system_clock::now()),
+      generation(allocateGeneration()) {}
 
 FileInode::FileInode(
     fuse_ino_t ino,
@@ -76,12 +80,17 @@ folly::Future<fusell::Dispatcher::Attr> FileInode::getattr() {
   // materialized the data from the entry, we have to materialize it
   // from the store.  If we augmented our metadata we could avoid this,
   // and this would speed up operations like `ls`.
-  return data->ensureDataLoaded().then([ self = inodePtrFromThis(), data ]() {
-    auto attr = fusell::Dispatcher::Attr{self->getMount()->getMountPoint()};
-    attr.st = data->stat();
-    attr.st.st_ino = self->getNodeId();
-    return attr;
-  });
+  return data->ensureDataLoaded().then(
+      [ self = inodePtrFromThis(), data ]() mutable {
+        auto attr =
+            fusell::Dispatcher::Attr{self->getMount()->getMountPoint()};
+        attr.st = data->stat();
+        attr.st.st_ino = self->getNodeId();
+
+        data.reset();
+        self->releaseUnusedData();
+        return attr;
+      });
 }
 
 folly::Future<fusell::Dispatcher::Attr> FileInode::setattr(
@@ -130,7 +139,12 @@ folly::Future<std::string> FileInode::readlink() {
 
   // The symlink contents are simply the file contents!
   return data->ensureDataLoaded().then(
-      [ self = inodePtrFromThis(), data ]() { return data->readAll(); });
+      [ self = inodePtrFromThis(), data ]() mutable {
+        auto contents = data->readAll();
+        data.reset();
+        self->releaseUnusedData();
+        return contents;
+      });
 }
 
 std::shared_ptr<FileData> FileInode::getOrLoadData() {
@@ -156,11 +170,27 @@ void FileInode::fileHandleDidClose() {
   }
 }
 
+void FileInode::releaseUnusedData() {
+  // Materialized files only hold an open overlay file descriptor, which is
+  // cheap to keep around and avoids re-opening the file on every stat().
+  std::shared_ptr<FileData> data;
+  {
+    auto state = state_.wlock();
+    if (!state->hash.hasValue() || !state->data.unique()) {
+      return;
+    }
+    data = std::move(state->data);
+  }
+  // Destroy the FileData outside of our state lock.  Its destructor hands the
+  // blob off to the BlobCache.
+  data.reset();
+}
+
 AbsolutePath FileInode::getLocalPath() const {
   return getMount()->getOverlay()->getFilePath(getNodeId());
 }
 
-bool FileInode::isSameAs(const Blob& blob, mode_t mode) {
+Future<bool> FileInode::isSameAs(const Hash& blobID, mode_t mode) {
   // When comparing mode bits, we only care about the
   // file type and owner permissions.
   auto relevantModeBits = [](mode_t m) { return (m & (S_IFMT | S_IRWXU)); };
@@ -169,18 +199,22 @@ bool FileInode::isSameAs(const Blob& blob, mode_t mode) {
   {
     auto state = state_.wlock();
     if (relevantModeBits(state->mode) != relevantModeBits(mode)) {
-      return false;
+      return makeFuture(false);
     }
 
     if (state->hash.hasValue()) {
       // This file is not materialized, so we can just compare hashes
-      return state->hash.value() == blob.getHash();
+      return makeFuture(state->hash.value() == blobID);
     }
 
     data = getOrLoadData(state);
   }
 
-  return data->getSha1() == Hash::sha1(&blob.getContents());
+  auto localSha1 = data->getSha1();
+  return getMount()->getObjectStore()->getBlobMetadata(blobID).then(
+      [localSha1](const BlobMetadata& metadata) {
+        return metadata.sha1 == localSha1;
+      });
 }
 
 mode_t FileInode::getMode() const {
@@ -195,6 +229,16 @@ folly::Optional<Hash> FileInode::getBlobHash() const {
   return state_.rlock()->hash;
 }
 
+FileInode::ContentsVersion FileInode::getContentsVersion() const {
+  auto state = state_.rlock();
+  return ContentsVersion{state->hash, state->generation};
+}
+
+uint64_t FileInode::allocateGeneration() {
+  static std::atomic<uint64_t> nextGeneration{1};
+  return nextGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
 folly::Future<std::shared_ptr<fusell::FileHandle>> FileInode::open(
     const struct fuse_file_info& fi) {
   shared_ptr<FileData> data;
@@ -288,6 +332,7 @@ Future<string> FileInode::getxattr(StringPiece name) {
 Future<Hash> FileInode::getSHA1(bool failIfSymlink) {
   std::shared_ptr<FileData> data;
   folly::Optional<Hash> hash;
+  uint64_t generation;
   {
     auto state = state_.wlock();
     if (failIfSymlink && !S_ISREG(state->mode)) {
@@ -295,14 +340,28 @@ Future<Hash> FileInode::getSHA1(bool failIfSymlink) {
       return makeFuture<Hash>(InodeError(kENOATTR, inodePtrFromThis()));
     }
 
+    if (state->sha1.hasValue()) {
+      return makeFuture(state->sha1.value());
+    }
+
     hash = state->hash;
+    generation = state->generation;
     if (!hash.hasValue()) {
       data = getOrLoadData(state);
     }
   }
 
   if (hash.hasValue()) {
-    return getMount()->getObjectStore()->getSha1ForBlob(hash.value());
+    // Only the blob metadata is needed for this, not the blob contents.
+    auto self = inodePtrFromThis();
+    return getMount()->getObjectStore()->getBlobMetadata(hash.value()).then(
+        [ self, generation ](const BlobMetadata& metadata) {
+          auto state = self->state_.wlock();
+          if (state->generation == generation) {
+            state->sha1 = metadata.sha1;
+          }
+          return metadata.sha1;
+        });
   }
 
   return data->getSha1();
@@ -76,12 +76,13 @@ class FileInode : public InodeBase {
 
   /**
    * Check to see if the file has the same contents as the specified blob
-   * and the same mode.
+   * and the same mode, without loading the blob contents.
    *
-   * This is more efficient than manually comparing the contents, as it can
-   * perform a simple hash check if the file is not materialized.
+   * If the file is not materialized this is a simple hash comparison.
+   * Otherwise the file's SHA-1 (which is cached in the overlay) is compared to
+   * the SHA-1 recorded in the blob's BlobMetadata.
    */
-  bool isSameAs(const Blob& blob, mode_t mode);
+  folly::Future<bool> isSameAs(const Hash& blobID, mode_t mode);
 
   /**
    * Get the file mode_t value.
@@ -112,6 +113,35 @@ class FileInode : public InodeBase {
    */
   folly::Optional<Hash> getBlobHash() const;
 
+  /**
+   * Identifies one version of this file's contents.
+   *
+   * If the file is backed by a source control Blob, hash is set to the Blob's
+   * hash.  Otherwise the file is materialized, and the version is identified
+   * by the inode number together with the generation number.
+   */
+  struct ContentsVersion {
+    folly::Optional<Hash> hash;
+    uint64_t generation;
+
+    bool operator==(const ContentsVersion& other) const {
+      return hash == other.hash && generation == other.generation;
+    }
+    bool operator!=(const ContentsVersion& other) const {
+      return !(*this == other);
+    }
+  };
+
+  /**
+   * Get the current ContentsVersion of this file.
+   *
+   * The generation number changes every time the file contents are modified.
+   * Generation numbers are never reused, even by other FileInode objects, so
+   * a version can be safely compared against one recorded before this inode
+   * was unloaded and loaded again.
+   */
+  ContentsVersion getContentsVersion() const;
+
  private:
   /**
    * The contents of a FileInode.
@@ -132,8 +162,26 @@ class FileInode : public InodeBase {
      */
     std::chrono::system_clock::time_point creationTime;
     folly::Optional<Hash> hash;
+    /**
+     * The SHA-1 of the current file contents, if it has been computed.
+     *
+     * This is cleared whenever the contents change, so repeated getSHA1()
+     * calls on an unchanged file do not need to consult the overlay or the
+     * ObjectStore.
+     */
+    folly::Optional<Hash> sha1;
+    /**
+     * The generation number of the file contents.
+     * See getContentsVersion().
+     */
+    uint64_t generation;
   };
 
+  /**
+   * Allocate a new, never before used, generation number.
+   */
+  static uint64_t allocateGeneration();
+
   /**
    * Get a FileInodePtr to ourself.
    *
@@ -157,6 +205,18 @@ class FileInode : public InodeBase {
   /// Called as part of shutting down an open handle.
   void fileHandleDidClose();
 
+  /**
+   * Drop our reference to the FileData if this file is not materialized and
+   * nothing else (an open FileHandle or another in-flight request) is still
+   * using it.
+   *
+   * This is called after requests such as getattr() and readlink() that need
+   * to load the blob contents temporarily, so that we do not pin the entire
+   * file contents in memory for the lifetime of the inode.  The blob itself
+   * is handed off to the mount's BlobCache when the FileData is destroyed.
+   */
+  void releaseUnusedData();
+
   folly::Synchronized<State> state_;
 
   friend class ::facebook::eden::FileHandle;
@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "GitIgnoreCache.h"
+
+#include "eden/fs/model/git/GitIgnore.h"
+
+using folly::StringPiece;
+using std::shared_ptr;
+
+namespace facebook {
+namespace eden {
+
+GitIgnoreCache::GitIgnoreCache(size_t maxEntries) : maxEntries_(maxEntries) {}
+
+GitIgnoreCache::~GitIgnoreCache() {}
+
+shared_ptr<const GitIgnore> GitIgnoreCache::get(const Hash& blobHash) {
+  auto table = blobEntries_.wlock();
+  auto* value = lookup(*table, blobHash);
+  return value ? *value : nullptr;
+}
+
+shared_ptr<const GitIgnore> GitIgnoreCache::get(
+    fuse_ino_t inode,
+    uint64_t generation) {
+  auto table = materializedEntries_.wlock();
+  auto* value = lookup(*table, inode);
+  if (!value || value->generation != generation) {
+    return nullptr;
+  }
+  return value->ignore;
+}
+
+void GitIgnoreCache::insert(
+    const Hash& blobHash,
+    shared_ptr<const GitIgnore> ignore) {
+  auto table = blobEntries_.wlock();
+  store(*table, blobHash, std::move(ignore));
+}
+
+void GitIgnoreCache::insert(
+    fuse_ino_t inode,
+    uint64_t generation,
+    shared_ptr<const GitIgnore> ignore) {
+  auto table = materializedEntries_.wlock();
+  // Replaces any entry for an older generation of this inode.
+  store(*table, inode, MaterializedEntry{generation, std::move(ignore)});
+}
+
+shared_ptr<const GitIgnore> GitIgnoreCache::parse(StringPiece contents) {
+  auto ignore = std::make_shared<GitIgnore>();
+  ignore->loadFile(contents);
+  return std::move(ignore);
+}
+
+size_t GitIgnoreCache::getEntryCount() const {
+  return blobEntries_.rlock()->index.size() +
+      materializedEntries_.rlock()->index.size();
+}
+
+template <typename Key, typename Value>
+Value* GitIgnoreCache::lookup(LruTable<Key, Value>& table, const Key& key) {
+  auto it = table.index.find(key);
+  if (it == table.index.end()) {
+    return nullptr;
+  }
+
+  // Move the entry to the front of the list
+  table.entries.splice(table.entries.begin(), table.entries, it->second);
+  return &it->second->second;
+}
+
+template <typename Key, typename Value>
+void GitIgnoreCache::store(
+    LruTable<Key, Value>& table,
+    const Key& key,
+    Value value) {
+  if (maxEntries_ == 0) {
+    return;
+  }
+
+  auto it = table.index.find(key);
+  if (it != table.index.end()) {
+    it->second->second = std::move(value);
+    table.entries.splice(table.entries.begin(), table.entries, it->second);
+    return;
+  }
+
+  while (table.index.size() >= maxEntries_) {
+    table.index.erase(table.entries.back().first);
+    table.entries.pop_back();
+  }
+  table.entries.emplace_front(key, std::move(value));
+  table.index.emplace(key, table.entries.begin());
+}
+}
+}
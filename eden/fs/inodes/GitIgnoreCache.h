@@ -0,0 +1,114 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/Synchronized.h>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include "eden/fs/model/Hash.h"
+#include "eden/fuse/fuse_headers.h"
+
+namespace facebook {
+namespace eden {
+
+class GitIgnore;
+
+/**
+ * GitIgnoreCache holds parsed .gitignore files so that repeated diff
+ * operations do not have to re-read and re-parse every .gitignore file in the
+ * tree each time.
+ *
+ * .gitignore files that are identical to their source control version are
+ * cached by blob hash, so a single entry is shared by every directory (and
+ * every commit) that uses the same contents.  Materialized .gitignore files
+ * are cached by inode number and FileInode generation number.  Only the most
+ * recent generation is kept for each inode.
+ *
+ * Both tables hold at most maxEntries entries, evicting the least recently
+ * used entries first.
+ *
+ * GitIgnoreCache is thread-safe and may be shared by concurrent diff
+ * operations.  Its locks are leaf locks: they are never held while calling
+ * out to other code, so the cache may be used while holding inode locks.
+ */
+class GitIgnoreCache {
+ public:
+  explicit GitIgnoreCache(size_t maxEntries);
+  ~GitIgnoreCache();
+
+  /**
+   * Look up the parsed contents of a .gitignore blob.
+   *
+   * Returns nullptr if it is not cached.
+   */
+  std::shared_ptr<const GitIgnore> get(const Hash& blobHash);
+
+  /**
+   * Look up the parsed contents of a materialized .gitignore file.
+   *
+   * Returns nullptr if it is not cached, or if the cached entry is for a
+   * different generation of the file.
+   */
+  std::shared_ptr<const GitIgnore> get(fuse_ino_t inode, uint64_t generation);
+
+  void insert(const Hash& blobHash, std::shared_ptr<const GitIgnore> ignore);
+  void insert(
+      fuse_ino_t inode,
+      uint64_t generation,
+      std::shared_ptr<const GitIgnore> ignore);
+
+  /**
+   * Parse the contents of a .gitignore file.
+   */
+  static std::shared_ptr<const GitIgnore> parse(folly::StringPiece contents);
+
+  /** Return the number of entries currently cached. */
+  size_t getEntryCount() const;
+
+ private:
+  /**
+   * A least-recently-used table of parsed ignore files.
+   */
+  template <typename Key, typename Value>
+  struct LruTable {
+    using EntryList = std::list<std::pair<Key, Value>>;
+
+    /** Entries, ordered from most to least recently used. */
+    EntryList entries;
+    std::unordered_map<Key, typename EntryList::iterator> index;
+  };
+
+  /**
+   * The cached parse of a materialized file, and the generation of the file
+   * that it was parsed from.
+   */
+  struct MaterializedEntry {
+    uint64_t generation;
+    std::shared_ptr<const GitIgnore> ignore;
+  };
+
+  template <typename Key, typename Value>
+  static Value* lookup(LruTable<Key, Value>& table, const Key& key);
+  template <typename Key, typename Value>
+  void store(LruTable<Key, Value>& table, const Key& key, Value value);
+
+  GitIgnoreCache(GitIgnoreCache const&) = delete;
+  GitIgnoreCache& operator=(GitIgnoreCache const&) = delete;
+
+  const size_t maxEntries_;
+  folly::Synchronized<LruTable<Hash, std::shared_ptr<const GitIgnore>>>
+      blobEntries_;
+  folly::Synchronized<LruTable<fuse_ino_t, MaterializedEntry>>
+      materializedEntries_;
+};
+}
+}
@@ -31,6 +31,7 @@ InodeBase::InodeBase(EdenMount* mount)
       location_{
           LocationInfo{nullptr,
                        PathComponentPiece{"", detail::SkipPathSanityCheck()}}} {
+  updateLastAccessTime();
   VLOG(5) << "root inode " << this << " (" << ino_ << ") created for mount "
           << mount_->getPath();
   // The root inode always starts with an implicit reference from FUSE.
@@ -47,6 +48,7 @@ InodeBase::InodeBase(
   // Inode numbers generally shouldn't be 0.
   // Older versions of glibc have bugs handling files with an inode number of 0
   DCHECK_NE(ino_, 0);
+  updateLastAccessTime();
   VLOG(5) << "inode " << this << " (" << ino_ << ") created: " << getLogPath();
 }
 
@@ -11,6 +11,7 @@
 #include <folly/Synchronized.h>
 #include <folly/futures/Future.h>
 #include <atomic>
+#include <chrono>
 #include <memory>
 #include <vector>
 #include "eden/fs/inodes/InodePtr.h"
@@ -226,6 +227,31 @@ class InodeBase {
     return numFuseReferences_.load(std::memory_order_acquire);
   }
 
+  /**
+   * Get the FUSE reference count once the FUSE channel has stopped.
+   *
+   * Unlike getFuseRefcount() this may be called while there are outstanding
+   * pointer references to the inode.  It should only be called by
+   * InodeMap::save(), when no FUSE requests can change the count.
+   */
+  uint32_t getFuseRefcountWhileStopped() const {
+    return numFuseReferences_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Get the time at which this inode was last accessed.
+   *
+   * This is updated each time a new InodePtr reference is handed out by
+   * InodeMap::lookupInode() or TreeInode::getOrLoadChild(), which covers all
+   * FUSE and thrift accesses to the inode.  It is used to decide which
+   * unreferenced inodes are idle enough to be unloaded.
+   */
+  std::chrono::steady_clock::time_point getLastAccessTime() const {
+    using Clock = std::chrono::steady_clock;
+    return Clock::time_point{
+        Clock::duration{lastAccessTime_.load(std::memory_order_relaxed)}};
+  }
+
   /**
    * Set the FUSE reference count.
    *
@@ -328,6 +354,13 @@ class InodeBase {
   // APIs that hand out new InodePtrs are InodeMap::lookupInode() and
   // TreeInode::getOrLoadChild().
   void newInodeRefConstructed() const {
+    updateLastAccessTime();
+    newInodeRefConstructedNoAccess();
+  }
+  // newInodeRefConstructedNoAccess() is the same, but is used for internal
+  // walks over the inode tree (such as the idle inode sweep) that must not
+  // make the inodes they visit look recently accessed.
+  void newInodeRefConstructedNoAccess() const {
     auto prevValue = ptrRefcount_.fetch_add(1, std::memory_order_acq_rel);
     if (prevValue == 0) {
       ptrAcquireCount_.fetch_add(1, std::memory_order_acq_rel);
@@ -341,6 +374,11 @@ class InodeBase {
   }
   void onPtrRefZero() const;
   ParentInodeInfo getParentInfo() const;
+  void updateLastAccessTime() const {
+    lastAccessTime_.store(
+        std::chrono::steady_clock::now().time_since_epoch().count(),
+        std::memory_order_relaxed);
+  }
 
   fuse_ino_t const ino_;
 
@@ -443,6 +481,15 @@ class InodeBase {
    */
   mutable std::atomic<uint32_t> ptrAcquireCount_{0};
 
+  /**
+   * The steady_clock time at which this inode was last accessed, stored as a
+   * raw duration count so that it can be updated atomically.
+   *
+   * This is only a heuristic for deciding when to unload idle inodes, so it is
+   * updated with relaxed memory ordering.
+   */
+  mutable std::atomic<std::chrono::steady_clock::rep> lastAccessTime_;
+
   /**
    * Information about this Inode's location in the file system path.
    * Eden does not support hard links, so each Inode has exactly one location.
@@ -9,8 +9,11 @@
  */
 #include "eden/fs/inodes/InodeMap.h"
 
+#include <folly/Conv.h>
 #include <folly/Exception.h>
 #include <folly/Likely.h>
+#include <algorithm>
+#include <stdexcept>
 #include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/FileInode.h"
 #include "eden/fs/inodes/Overlay.h"
@@ -46,20 +49,73 @@ InodeMap::~InodeMap() {
 }
 
 void InodeMap::initialize(TreeInodePtr root, fuse_ino_t maxExistingInode) {
-  auto data = data_.wlock();
+  auto data = getShard(FUSE_ROOT_ID).wlock();
   CHECK(!root_);
   root_ = std::move(root);
   auto ret = data->loadedInodes_.emplace(FUSE_ROOT_ID, root_.get());
   CHECK(ret.second);
   DCHECK_GE(maxExistingInode, FUSE_ROOT_ID);
-  data->nextInodeNumber_ = maxExistingInode + 1;
+  // restore() may have already set nextInodeNumber_ to a larger value.
+  auto nextInodeNumber = std::max(
+      nextInodeNumber_.load(std::memory_order_acquire), maxExistingInode + 1);
+  nextInodeNumber_.store(nextInodeNumber, std::memory_order_release);
+}
+
+void InodeMap::restore(const overlay::SerializedInodeMap& data) {
+  CHECK(!root_);
+  nextInodeNumber_.store(
+      static_cast<fuse_ino_t>(data.nextInodeNumber),
+      std::memory_order_release);
+
+  std::unordered_map<
+      fuse_ino_t,
+      std::vector<std::pair<PathComponent, fuse_ino_t>>>
+      childNumbers;
+  for (const auto& entry : data.entries) {
+    auto number = static_cast<fuse_ino_t>(entry.inodeNumber);
+    auto parent = static_cast<fuse_ino_t>(entry.parentInode);
+    PathComponentPiece name{entry.name};
+
+    UnloadedInode unloadedEntry(number, parent, name);
+    unloadedEntry.numFuseReferences = entry.numFuseReferences;
+    auto ret = getShard(number).wlock()->unloadedInodes_.emplace(
+        number, std::move(unloadedEntry));
+    CHECK(ret.second) << "duplicate inode number " << number;
+
+    childNumbers[parent].emplace_back(PathComponent{name}, number);
+  }
+
+  VLOG(2) << "restored " << data.entries.size() << " inode numbers for "
+          << mount_->getPath();
+  hasRestoredChildNumbers_.store(
+      !childNumbers.empty(), std::memory_order_release);
+  *restoredChildNumbers_.wlock() = std::move(childNumbers);
+}
+
+std::vector<std::pair<PathComponent, fuse_ino_t>>
+InodeMap::extractRestoredChildNumbers(fuse_ino_t parent) {
+  std::vector<std::pair<PathComponent, fuse_ino_t>> result;
+  if (LIKELY(!hasRestoredChildNumbers_.load(std::memory_order_acquire))) {
+    return result;
+  }
+
+  auto childNumbers = restoredChildNumbers_.wlock();
+  auto iter = childNumbers->find(parent);
+  if (iter != childNumbers->end()) {
+    result = std::move(iter->second);
+    childNumbers->erase(iter);
+    if (childNumbers->empty()) {
+      hasRestoredChildNumbers_.store(false, std::memory_order_release);
+    }
+  }
+  return result;
 }
 
 Future<InodePtr> InodeMap::lookupInode(fuse_ino_t number) {
-  // Lock the data.
+  // Lock the shard containing this inode.
   // We hold it while doing most of our work below, but explicitly unlock it
   // before triggering inode loading or before fulfilling any Promises.
-  auto data = data_.wlock();
+  auto data = getShard(number).wlock();
 
   // Check to see if this Inode is already loaded
   auto loadedIter = data->loadedInodes_.find(number);
@@ -107,37 +163,42 @@ Future<InodePtr> InodeMap::lookupInode(fuse_ino_t number) {
   // For parents we don't find, add a promise that will trigger the lookup on
   // its necessary child.
   //
-  // (It might have been simpler to recursively call lookupInode() to get the
-  // parent, but that would require releasing and re-acquiring the lock more
-  // than necessary.)
+  // The parent may live in a different shard than the child, so we only ever
+  // hold one shard lock at a time while walking up the tree.  This is safe
+  // since the child's pending promise list is already non-empty: nobody else
+  // will start loading the child, and whoever loads the parent will fulfill
+  // the promise we add to the parent's list.
   auto childInodeNumber = number;
+  auto parentNumber = unloadedData->parent;
+  PathComponent childName = unloadedData->name;
+  bool isUnlinked = unloadedData->isUnlinked;
+  data.unlock();
   while (true) {
+    auto parentShard = getShard(parentNumber).wlock();
+
     // Check to see if this parent is loaded
-    loadedIter = data->loadedInodes_.find(unloadedData->parent);
-    if (loadedIter != data->loadedInodes_.end()) {
+    loadedIter = parentShard->loadedInodes_.find(parentNumber);
+    if (loadedIter != parentShard->loadedInodes_.end()) {
       // We found a loaded parent.
-      // Grab copies of the arguments we need for startChildLookup(),
-      // with the lock still held.
+      // Grab a reference to it with the lock still held.
       InodePtr firstLoadedParent = InodePtr::newPtrLocked(loadedIter->second);
-      PathComponent requiredChildName = unloadedData->name;
-      bool isUnlinked = unloadedData->isUnlinked;
-      // Unlock the data before starting the child lookup
-      data.unlock();
+      // Unlock the shard before starting the child lookup
+      parentShard.unlock();
       // Trigger the lookup, then return to our caller.
       startChildLookup(
-          firstLoadedParent, requiredChildName, isUnlinked, childInodeNumber);
+          firstLoadedParent, childName, isUnlinked, childInodeNumber);
       return result;
     }
 
     // Look up the parent in unloadedInodes_
-    unloadedIter = data->unloadedInodes_.find(unloadedData->parent);
-    if (UNLIKELY(unloadedIter == data->unloadedInodes_.end())) {
+    unloadedIter = parentShard->unloadedInodes_.find(parentNumber);
+    if (UNLIKELY(unloadedIter == parentShard->unloadedInodes_.end())) {
       // This shouldn't happen.  We must know about the parent inode number if
       // we knew about the child.
-      auto bug = EDEN_BUG() << "unknown parent inode " << unloadedData->parent
-                            << " (of " << unloadedData->name << ")";
+      auto bug = EDEN_BUG() << "unknown parent inode " << parentNumber
+                            << " (of " << childName << ")";
       // Unlock our data before calling inodeLoadFailed()
-      data.unlock();
+      parentShard.unlock();
       inodeLoadFailed(childInodeNumber, bug.toException());
       return result;
     }
@@ -150,10 +211,7 @@ Future<InodePtr> InodeMap::lookupInode(fuse_ino_t number) {
     // it is fulfilled.
     parentData->promises.emplace_back();
     setupParentLookupPromise(
-        parentData->promises.back(),
-        unloadedData->name,
-        unloadedData->isUnlinked,
-        childInodeNumber);
+        parentData->promises.back(), childName, isUnlinked, childInodeNumber);
 
     if (alreadyLoading) {
       // This parent is already being loaded.
@@ -162,8 +220,10 @@ Future<InodePtr> InodeMap::lookupInode(fuse_ino_t number) {
     }
 
     // Continue around the loop to look up our parent's parent
-    childInodeNumber = unloadedData->parent;
-    unloadedData = parentData;
+    childInodeNumber = parentNumber;
+    childName = parentData->name;
+    isUnlinked = parentData->isUnlinked;
+    parentNumber = parentData->parent;
   }
 }
 
@@ -226,7 +286,7 @@ InodeMap::PromiseVector InodeMap::inodeLoadComplete(InodeBase* inode) {
 
   PromiseVector promises;
   try {
-    auto data = data_.wlock();
+    auto data = getShard(number).wlock();
     auto it = data->unloadedInodes_.find(number);
     CHECK(it != data->unloadedInodes_.end())
         << "failed to find unloaded inode data when finishing load of inode "
@@ -264,7 +324,7 @@ void InodeMap::inodeLoadFailed(
 InodeMap::PromiseVector InodeMap::extractPendingPromises(fuse_ino_t number) {
   PromiseVector promises;
   {
-    auto data = data_.wlock();
+    auto data = getShard(number).wlock();
     auto it = data->unloadedInodes_.find(number);
     CHECK(it != data->unloadedInodes_.end())
         << "failed to find unloaded inode data when finishing load of inode "
@@ -285,7 +345,7 @@ Future<FileInodePtr> InodeMap::lookupFileInode(fuse_ino_t number) {
 }
 
 InodePtr InodeMap::lookupLoadedInode(fuse_ino_t number) {
-  auto data = data_.rlock();
+  auto data = getShard(number).rlock();
   auto it = data->loadedInodes_.find(number);
   if (it == data->loadedInodes_.end()) {
     return nullptr;
@@ -310,7 +370,7 @@ FileInodePtr InodeMap::lookupLoadedFile(fuse_ino_t number) {
 }
 
 UnloadedInodeData InodeMap::lookupUnloadedInode(fuse_ino_t number) {
-  auto data = data_.rlock();
+  auto data = getShard(number).rlock();
   auto it = data->unloadedInodes_.find(number);
   if (it == data->unloadedInodes_.end()) {
     // This generally shouldn't happen.  If a fuse_ino_t has been allocated
@@ -324,7 +384,7 @@ UnloadedInodeData InodeMap::lookupUnloadedInode(fuse_ino_t number) {
 }
 
 void InodeMap::decFuseRefcount(fuse_ino_t number, uint32_t count) {
-  auto data = data_.wlock();
+  auto data = getShard(number).wlock();
 
   // First check in the loaded inode map
   auto loadedIter = data->loadedInodes_.find(number);
@@ -362,8 +422,75 @@ void InodeMap::decFuseRefcount(fuse_ino_t number, uint32_t count) {
   }
 }
 
-void InodeMap::save() {
-  // TODO
+overlay::SerializedInodeMap InodeMap::save() {
+  overlay::SerializedInodeMap result;
+  // Declared before the rename lock, so that the inodes are released after it
+  std::vector<InodePtr> loadedInodes;
+  size_t numUnlinked = 0;
+
+  // Hold the rename lock so that no inode can change its location while we
+  // record it.
+  auto renameLock = mount_->acquireRenameLock();
+
+  for (auto& shard : shards_) {
+    auto data = shard.wlock();
+    for (const auto& entry : data->loadedInodes_) {
+      if (entry.first != FUSE_ROOT_ID) {
+        loadedInodes.push_back(InodePtr::newPtrLocked(entry.second));
+      }
+    }
+    for (const auto& entry : data->unloadedInodes_) {
+      const auto& unloadedEntry = entry.second;
+      if (unloadedEntry.numFuseReferences <= 0) {
+        continue;
+      }
+      if (unloadedEntry.isUnlinked) {
+        ++numUnlinked;
+        continue;
+      }
+      overlay::SerializedInodeMapEntry serialized;
+      serialized.inodeNumber = unloadedEntry.number;
+      serialized.parentInode = unloadedEntry.parent;
+      serialized.name = unloadedEntry.name.stringPiece().str();
+      serialized.numFuseReferences = unloadedEntry.numFuseReferences;
+      result.entries.push_back(std::move(serialized));
+    }
+  }
+
+  // Query the loaded inodes after releasing the shard locks, since we must
+  // not access InodeBase objects while holding them.
+  for (const auto& inode : loadedInodes) {
+    auto numFuseReferences = inode->getFuseRefcountWhileStopped();
+    if (numFuseReferences == 0) {
+      continue;
+    }
+    auto location = inode->getLocationInfo(renameLock);
+    if (location.unlinked || !location.parent) {
+      ++numUnlinked;
+      continue;
+    }
+    overlay::SerializedInodeMapEntry serialized;
+    serialized.inodeNumber = inode->getNodeId();
+    serialized.parentInode = location.parent->getNodeId();
+    serialized.name = location.name.stringPiece().str();
+    serialized.numFuseReferences = numFuseReferences;
+    result.entries.push_back(std::move(serialized));
+  }
+
+  // An unlinked inode that the kernel still refers to (typically a file that
+  // is open but has been deleted) has no path through which the new process
+  // could find it again, so its file handles would stop working.  Refuse to
+  // hand over the mount rather than break them.
+  if (numUnlinked > 0) {
+    throw std::runtime_error(folly::to<std::string>(
+        "unable to save ",
+        numUnlinked,
+        " unlinked inodes that are still referenced by the kernel for ",
+        mount_->getPath()));
+  }
+
+  result.nextInodeNumber = nextInodeNumber_.load(std::memory_order_acquire);
+  return result;
 }
 
 void InodeMap::beginShutdown() {
@@ -398,19 +525,20 @@ void InodeMap::beginShutdown() {
     // to them, then let the normal pointer release process be responsible for
     // unloading them.
     std::vector<InodePtr> inodesToUnload;
-    auto data = data_.wlock();
-    for (const auto& entry : data->loadedInodes_) {
-      if (!entry.second->isPtrAcquireCountZero()) {
-        continue;
+    for (auto& shard : shards_) {
+      auto data = shard.wlock();
+      for (const auto& entry : data->loadedInodes_) {
+        if (!entry.second->isPtrAcquireCountZero()) {
+          continue;
+        }
+        if (!entry.second->isUnlinked()) {
+          continue;
+        }
+        inodesToUnload.push_back(InodePtr::newPtrLocked(entry.second));
       }
-      if (!entry.second->isUnlinked()) {
-        continue;
-      }
-      inodesToUnload.push_back(InodePtr::newPtrLocked(entry.second));
     }
-    // Release the lock, then release all of our InodePtrs to unload
-    // the inodes.
-    data.unlock();
+    // Release all of our InodePtrs to unload the inodes.  The shard locks
+    // have already been released at this point.
     inodesToUnload.clear();
   }
 
@@ -437,8 +565,8 @@ void InodeMap::onInodeUnreferenced(
     ParentInodeInfo&& parentInfo) {
   VLOG(5) << "inode " << inode->getNodeId()
           << " unreferenced: " << inode->getLogPath();
-  // Acquire our lock.
-  auto data = data_.wlock();
+  // Acquire the lock for this inode's shard.
+  auto data = getShard(inode->getNodeId()).wlock();
 
   // Decrement the Inode's acquire count
   auto acquireCount = inode->decPtrAcquireCount();
@@ -483,8 +611,8 @@ void InodeMap::onInodeUnreferenced(
       const auto& parentContents = parentInfo.getParentContents();
       auto it = parentContents->entries.find(parentInfo.getName());
       CHECK(it != parentContents->entries.end());
-      CHECK_EQ(it->second->inode, inode);
-      it->second->inode = nullptr;
+      CHECK_EQ(it->second.inode, inode);
+      it->second.inode = nullptr;
     }
   }
 
@@ -500,7 +628,14 @@ void InodeMap::onInodeUnreferenced(
 }
 
 InodeMapLock InodeMap::lockForUnload() {
-  return InodeMapLock{data_.wlock()};
+  // Acquire every shard lock, always in increasing index order so that
+  // concurrent lockForUnload() calls cannot deadlock with each other.
+  std::vector<Shard::LockedPtr> locks;
+  locks.reserve(kNumShards);
+  for (auto& shard : shards_) {
+    locks.push_back(shard.wlock());
+  }
+  return InodeMapLock{std::move(locks)};
 }
 
 void InodeMap::unloadInode(
@@ -509,7 +644,8 @@ void InodeMap::unloadInode(
     PathComponentPiece name,
     bool isUnlinked,
     const InodeMapLock& lock) {
-  return unloadInode(inode, parent, name, isUnlinked, lock.data_);
+  return unloadInode(
+      inode, parent, name, isUnlinked, lock.getShard(inode->getNodeId()));
 }
 
 void InodeMap::unloadInode(
@@ -517,7 +653,7 @@ void InodeMap::unloadInode(
     TreeInode* parent,
     PathComponentPiece name,
     bool isUnlinked,
-    const folly::Synchronized<Members>::LockedPtr& data) {
+    const Shard::LockedPtr& data) {
   auto fuseCount = inode->getFuseRefcount();
   if (fuseCount > 0) {
     // Insert an unloaded entry
@@ -552,13 +688,31 @@ void InodeMap::unloadInode(
                          << inode->getLogPath();
 }
 
+bool InodeMap::isInodeRemembered(
+    fuse_ino_t number,
+    const InodeMapLock& lock) const {
+  const auto& data = lock.getShard(number);
+  return data->loadedInodes_.count(number) > 0 ||
+      data->unloadedInodes_.count(number) > 0;
+}
+
+InodeCounts InodeMap::getInodeCounts() const {
+  InodeCounts counts;
+  for (const auto& shard : shards_) {
+    auto data = shard.rlock();
+    counts.loadedInodeCount += data->loadedInodes_.size();
+    counts.unloadedInodeCount += data->unloadedInodes_.size();
+  }
+  return counts;
+}
+
 bool InodeMap::shouldLoadChild(
     TreeInode* parent,
     PathComponentPiece name,
     fuse_ino_t childInode,
     folly::Promise<InodePtr> promise) {
-  auto data = data_.wlock();
-  CHECK(childInode < data->nextInodeNumber_);
+  CHECK(childInode < nextInodeNumber_.load(std::memory_order_acquire));
+  auto data = getShard(childInode).wlock();
   auto iter = data->unloadedInodes_.find(childInode);
   UnloadedInode* unloadedData{nullptr};
   if (iter == data->unloadedInodes_.end()) {
@@ -593,10 +747,10 @@ fuse_ino_t InodeMap::newChildLoadStarted(
     TreeInode* parent,
     PathComponentPiece name,
     folly::Promise<InodePtr> promise) {
-  auto data = data_.wlock();
-
   // Allocate a new inode number
-  auto childNumber = allocateInodeNumber(*data);
+  auto childNumber = allocateInodeNumber();
+
+  auto data = getShard(childNumber).wlock();
 
   // Put an entry in unloadedInodes_
   fuse_ino_t parentNumber = parent->getNodeId();
@@ -608,29 +762,43 @@ fuse_ino_t InodeMap::newChildLoadStarted(
   return childNumber;
 }
 
-fuse_ino_t InodeMap::allocateInodeNumber() {
-  auto data = data_.wlock();
-  return allocateInodeNumber(*data);
-}
-
-void InodeMap::inodeCreated(const InodePtr& inode) {
-  VLOG(4) << "created new inode " << inode->getNodeId() << ": "
-          << inode->getLogPath();
-  auto data = data_.wlock();
-  data->loadedInodes_.emplace(inode->getNodeId(), inode.get());
+void InodeMap::incUnloadedFuseRefcount(
+    TreeInode* parent,
+    PathComponentPiece name,
+    fuse_ino_t childInode) {
+  CHECK(childInode < nextInodeNumber_.load(std::memory_order_acquire));
+  auto data = getShard(childInode).wlock();
+  DCHECK_EQ(0, data->loadedInodes_.count(childInode));
+  auto iter = data->unloadedInodes_.find(childInode);
+  if (iter == data->unloadedInodes_.end()) {
+    auto unloadedData = UnloadedInode(childInode, parent->getNodeId(), name);
+    auto ret =
+        data->unloadedInodes_.emplace(childInode, std::move(unloadedData));
+    iter = ret.first;
+  }
+  ++iter->second.numFuseReferences;
 }
 
-fuse_ino_t InodeMap::allocateInodeNumber(Members& data) {
+fuse_ino_t InodeMap::allocateInodeNumber() {
   // fuse_ino_t should generally be 64-bits wide, in which case it isn't even
   // worth bothering to handle the case where nextInodeNumber_ wraps.
   // We don't need to bother checking for conflicts with existing inode numbers
   // since this can only happen if we wrap around.
   static_assert(
-      sizeof(data.nextInodeNumber_) >= 8,
-      "expected fuse_ino_t to be at least 64-bits");
-  fuse_ino_t number = data.nextInodeNumber_;
-  ++data.nextInodeNumber_;
-  return number;
+      sizeof(fuse_ino_t) >= 8, "expected fuse_ino_t to be at least 64-bits");
+  return nextInodeNumber_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+fuse_ino_t InodeMap::allocateInodeNumbers(size_t count) {
+  DCHECK_GT(count, 0);
+  return nextInodeNumber_.fetch_add(count, std::memory_order_acq_rel);
+}
+
+void InodeMap::inodeCreated(const InodePtr& inode) {
+  VLOG(4) << "created new inode " << inode->getNodeId() << ": "
+          << inode->getLogPath();
+  auto data = getShard(inode->getNodeId()).wlock();
+  data->loadedInodes_.emplace(inode->getNodeId(), inode.get());
 }
 }
 }
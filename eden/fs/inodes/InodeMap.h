@@ -11,11 +11,15 @@
 
 #include <folly/Synchronized.h>
 #include <folly/futures/Future.h>
+#include <array>
+#include <atomic>
 #include <list>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "eden/fs/inodes/InodePtr.h"
+#include "eden/fs/inodes/gen-cpp2/overlay_types.h"
 #include "eden/fuse/fuse_headers.h"
 #include "eden/utils/PathFuncs.h"
 
@@ -41,6 +45,15 @@ struct UnloadedInodeData {
 
 class InodeMapLock;
 
+/**
+ * Counts of the inodes tracked by an InodeMap, as returned by
+ * InodeMap::getInodeCounts().
+ */
+struct InodeCounts {
+  size_t loadedInodeCount{0};
+  size_t unloadedInodeCount{0};
+};
+
 /**
  * InodeMap allows looking up Inode objects based on a inode number
  * (fuse_ino_t).
@@ -127,6 +140,29 @@ class InodeMap {
    */
   void initialize(TreeInodePtr root, fuse_ino_t maxExistingInode);
 
+  /**
+   * Restore the inode numbers recorded by save() in another process, which
+   * has handed this mount point over to us.
+   *
+   * The inodes are all added to the unloadedInodes_ map.  Each TreeInode
+   * that is loaded afterwards gives its children the inode numbers that they
+   * had before, so the kernel's inode numbers stay valid.
+   *
+   * This must be called before the root inode is created and initialize() is
+   * called.  This method is not thread safe.
+   */
+  void restore(const overlay::SerializedInodeMap& data);
+
+  /**
+   * Get the inode numbers restored by restore() for the children of the
+   * specified directory.
+   *
+   * This should only be called by TreeInode, when it is constructed.
+   * The numbers are only returned once.
+   */
+  std::vector<std::pair<PathComponent, fuse_ino_t>>
+  extractRestoredChildNumbers(fuse_ino_t parent);
+
   /**
    * Get the root inode.
    */
@@ -212,7 +248,9 @@ class InodeMap {
    * Decrement the number of outstanding FUSE references to an inode number.
    *
    * Note that there is no corresponding incFuseRefcount() function:
-   * increments are always done directly on a loaded InodeBase object.
+   * increments are done directly on a loaded InodeBase object, or through
+   * incUnloadedFuseRefcount() when a TreeInode returns an unloaded child to
+   * FUSE.
    *
    * However, decrements may happen after we have decided to unload the Inode
    * object.  Therefore decrements are performed on the InodeMap so that we can
@@ -221,15 +259,21 @@ class InodeMap {
   void decFuseRefcount(fuse_ino_t number, uint32_t count = 1);
 
   /**
-   * Persist the inode number state to disk.
+   * Record the inode number state, so that another process can take over
+   * the mount point without unmounting it.
+   *
+   * This records every inode number that the kernel still has references to,
+   * with enough data to reconstruct it in the other process's
+   * unloadedInodes_ map.  See restore().
    *
-   * This API supports gracefully restarting the eden server without unmounting
-   * the mount point.
+   * This must only be called once the FUSE channel has stopped processing
+   * requests, so that the FUSE reference counts can no longer change.
    *
-   * This persists sufficient data to reconstruct all inode state into the
-   * unloadedInodes_ map.
+   * Unlinked inodes cannot be restored, so this throws if the kernel still
+   * refers to any of them (for instance a deleted file that is still open).
+   * The takeover must be aborted in that case.
    */
-  void save();
+  overlay::SerializedInodeMap save();
 
   /**
    * beginShutdown() is invoked by EdenMount::destroy()
@@ -287,6 +331,25 @@ class InodeMap {
       bool isUnlinked,
       const InodeMapLock& lock);
 
+  /**
+   * Check if the InodeMap has any record of the specified inode number,
+   * either as a loaded inode or as an unloaded inode that FUSE still
+   * references or that is currently being loaded.
+   *
+   * This is used by TreeInode to decide if it is safe to unload a tree whose
+   * children inode numbers would be forgotten as a result.  The caller must
+   * hold the lock returned by lockForUnload().
+   */
+  bool isInodeRemembered(fuse_ino_t number, const InodeMapLock& lock) const;
+
+  /**
+   * Get the number of loaded and unloaded inodes.
+   *
+   * The shards are locked one at a time, so the result is not an atomic
+   * snapshot.  It is intended for reporting statistics.
+   */
+  InodeCounts getInodeCounts() const;
+
   /////////////////////////////////////////////////////////////////////////
   // The following public APIs should only be used by TreeInode
   /////////////////////////////////////////////////////////////////////////
@@ -352,6 +415,22 @@ class InodeMap {
       PathComponentPiece name,
       folly::Promise<InodePtr> promise);
 
+  /**
+   * incUnloadedFuseRefcount() should only be called by TreeInode.
+   *
+   * This records a FUSE reference to a child inode that is not loaded,
+   * for instance when it is returned in a readdirplus() reply.  The child
+   * can then be loaded by inode number later, and its InodeBase object
+   * starts out with this reference count when it is loaded.
+   *
+   * The TreeInode must be holding its contents lock when calling this method,
+   * and the child must not be loaded.
+   */
+  void incUnloadedFuseRefcount(
+      TreeInode* parent,
+      PathComponentPiece name,
+      fuse_ino_t childInode);
+
   /**
    * inodeLoadComplete() should only be called by TreeInode.
    *
@@ -388,6 +467,15 @@ class InodeMap {
    *   new child Inode object.
    */
   fuse_ino_t allocateInodeNumber();
+
+  /**
+   * Allocate a contiguous block of count inode numbers, and return the first
+   * one.
+   *
+   * This should only be called by TreeInode, to reserve numbers for the
+   * children of a directory that is being listed.
+   */
+  fuse_ino_t allocateInodeNumbers(size_t count);
   void inodeCreated(const InodePtr& inode);
 
  private:
@@ -428,7 +516,7 @@ class InodeMap {
      *
      * (We could use folly::SharedPromise here instead, but it has extra
      * overhead that we don't really need.  It performs its own locking, but we
-     * are already protected by the data_ lock.)
+     * are already protected by the shard lock.)
      */
     PromiseVector promises;
     /**
@@ -439,6 +527,24 @@ class InodeMap {
     int64_t numFuseReferences{0};
   };
 
+  /**
+   * The number of shards that the inode maps are split into.
+   *
+   * This must be a power of two.  Inode numbers are allocated sequentially,
+   * so taking the low bits of the inode number spreads inodes evenly across
+   * the shards.
+   */
+  static constexpr size_t kNumShards = 64;
+  static_assert(
+      (kNumShards & (kNumShards - 1)) == 0,
+      "kNumShards must be a power of two");
+
+  /**
+   * The data for one shard of the InodeMap.
+   *
+   * Each shard only contains entries for inode numbers that map to it via
+   * getShard().
+   */
   struct Members {
     /**
      * The map of loaded inodes
@@ -454,10 +560,8 @@ class InodeMap {
      * The map of currently unloaded inodes
      */
     std::unordered_map<fuse_ino_t, UnloadedInode> unloadedInodes_;
-
-    /** The next inode number to allocate */
-    fuse_ino_t nextInodeNumber_{FUSE_ROOT_ID + 1};
   };
+  using Shard = folly::Synchronized<Members>;
 
   InodeMap(InodeMap const&) = delete;
   InodeMap& operator=(InodeMap const&) = delete;
@@ -479,12 +583,20 @@ class InodeMap {
    * Extract the list of promises waiting on the specified inode number to be
    * loaded.
    *
-   * This method acquires the data_ lock internally.
+   * This method acquires the lock for the inode's shard internally.
    * It should never be called while already holding the lock.
    */
   PromiseVector extractPendingPromises(fuse_ino_t number);
 
-  fuse_ino_t allocateInodeNumber(Members& data);
+  /**
+   * Get the shard responsible for the specified inode number.
+   */
+  Shard& getShard(fuse_ino_t number) {
+    return shards_[number & (kNumShards - 1)];
+  }
+  const Shard& getShard(fuse_ino_t number) const {
+    return shards_[number & (kNumShards - 1)];
+  }
 
   /**
    * Unload an inode
@@ -494,13 +606,15 @@ class InodeMap {
    *
    * The caller is responsible for actually deleting the Inode object after
    * releasing the InodeMap lock.
+   *
+   * The data argument must be the locked shard for this inode's number.
    */
   void unloadInode(
       const InodeBase* inode,
       TreeInode* parent,
       PathComponentPiece name,
       bool isUnlinked,
-      const folly::Synchronized<Members>::LockedPtr& lock);
+      const Shard::LockedPtr& data);
 
   /**
    * The EdenMount that owns this InodeMap.
@@ -521,16 +635,37 @@ class InodeMap {
   std::atomic<bool> shuttingDown_{false};
 
   /**
-   * The locked data.
+   * The next inode number to allocate.
+   */
+  std::atomic<fuse_ino_t> nextInodeNumber_{FUSE_ROOT_ID + 1};
+
+  /**
+   * The inode numbers of the children of each directory, restored from
+   * another process by restore(), that have not been claimed by their parent
+   * TreeInode yet.
    *
-   * Note: be very careful to hold this lock only when necessary.  No other
-   * locks should be acquired when holding this lock.  In particular this means
-   * that we should never access any InodeBase objects while holding the lock,
-   * since we should not hold our lock while an InodeBase acquires its own
-   * internal lock.  (This makes it safe for InodeBase to perform operations on
-   * the InodeMap while holding their own lock.)
+   * This is indexed by parent inode number.  hasRestoredChildNumbers_ lets
+   * TreeInode construction skip the lock when there are none.
    */
-  folly::Synchronized<Members> data_;
+  folly::Synchronized<std::unordered_map<
+      fuse_ino_t,
+      std::vector<std::pair<PathComponent, fuse_ino_t>>>>
+      restoredChildNumbers_;
+  std::atomic<bool> hasRestoredChildNumbers_{false};
+
+  /**
+   * The locked data, split into shards by inode number.
+   *
+   * Note: be very careful to hold these locks only when necessary.  No other
+   * locks should be acquired when holding a shard lock, except for other
+   * shard locks acquired in increasing index order by lockForUnload().  In
+   * particular this means that we should never access any InodeBase objects
+   * while holding the lock, since we should not hold our lock while an
+   * InodeBase acquires its own internal lock.  (This makes it safe for
+   * InodeBase to perform operations on the InodeMap while holding their own
+   * lock.)
+   */
+  std::array<Shard, kNumShards> shards_;
 };
 
 /**
@@ -538,21 +673,30 @@ class InodeMap {
  * in order to make multiple calls to unloadInode() without releasing and
  * re-acquiring the lock.
  *
+ * This holds the locks on all of the InodeMap shards.
+ *
  * This mostly exists to make forward declarations simpler.
  */
 class InodeMapLock {
  public:
-  explicit InodeMapLock(
-      folly::Synchronized<InodeMap::Members>::LockedPtr&& data)
-      : data_(std::move(data)) {}
+  explicit InodeMapLock(std::vector<InodeMap::Shard::LockedPtr>&& shards)
+      : shards_(std::move(shards)) {}
 
   void unlock() {
-    data_.unlock();
+    // Release the locks in the opposite order that they were acquired
+    for (auto it = shards_.rbegin(); it != shards_.rend(); ++it) {
+      it->unlock();
+    }
   }
 
  private:
   friend class InodeMap;
-  folly::Synchronized<InodeMap::Members>::LockedPtr data_;
+
+  const InodeMap::Shard::LockedPtr& getShard(fuse_ino_t number) const {
+    return shards_[number & (InodeMap::kNumShards - 1)];
+  }
+
+  std::vector<InodeMap::Shard::LockedPtr> shards_;
 };
 }
 }
@@ -44,6 +44,14 @@ InodePtrImpl<InodeType>::InodePtrImpl(
   value_->newInodeRefConstructed();
 }
 
+template <typename InodeType>
+InodePtrImpl<InodeType>::InodePtrImpl(
+    InodeType* value,
+    LockedIncrementNoAccessEnum) noexcept
+    : value_(value) {
+  value_->newInodeRefConstructedNoAccess();
+}
+
 template <typename InodeType>
 void InodePtrImpl<InodeType>::incref() {
   if (value_) {
@@ -126,6 +126,17 @@ class InodePtrImpl {
     return InodePtrImpl{value, LOCKED_INCREMENT};
   }
 
+  /**
+   * Like newPtrLocked(), but the new reference does not count as an access to
+   * the inode, and so does not update its last access time.
+   *
+   * This should only be used by internal bookkeeping code that walks the
+   * inode tree, such as TreeInode::unloadChildrenLastAccessedBefore().
+   */
+  static InodePtrImpl newPtrLockedNoAccess(InodeType* value) noexcept {
+    return InodePtrImpl{value, LOCKED_INCREMENT_NO_ACCESS};
+  }
+
   /**
    * An API for TreeInode to use to construct an InodePtr from itself in order
    * to give to new children inodes that it creates.
@@ -168,10 +179,12 @@ class InodePtrImpl {
   enum NoIncrementEnum { NO_INCREMENT };
   enum NormalIncrementEnum { NORMAL_INCREMENT };
   enum LockedIncrementEnum { LOCKED_INCREMENT };
+  enum LockedIncrementNoAccessEnum { LOCKED_INCREMENT_NO_ACCESS };
 
   // Protected constructors for internal use.
   InodePtrImpl(InodeType* value, NormalIncrementEnum) noexcept;
   InodePtrImpl(InodeType* value, LockedIncrementEnum) noexcept;
+  InodePtrImpl(InodeType* value, LockedIncrementNoAccessEnum) noexcept;
   InodePtrImpl(InodeType* value, NoIncrementEnum) noexcept : value_(value) {}
 
   void incref();
@@ -27,9 +27,7 @@ using folly::File;
 using folly::MutableStringPiece;
 using folly::Optional;
 using folly::StringPiece;
-using std::make_unique;
 using std::string;
-using std::unique_ptr;
 
 /* Relative to the localDir, the metaFile holds the serialized rendition
  * of the overlay_ data.  We use thrift CompactSerialization for this.
@@ -212,18 +210,18 @@ Optional<TreeInode::Dir> Overlay::loadOverlayDir(fuse_ino_t inodeNumber) const {
     result.treeHash = Hash(folly::ByteRange(folly::StringPiece(dir.treeHash)));
   }
 
+  result.entries.reserve(dir.entries.size());
   for (auto& iter : dir.entries) {
     const auto& name = iter.first;
     const auto& value = iter.second;
 
-    unique_ptr<TreeInode::Entry> entry;
     if (value.inodeNumber == 0) {
       auto hash = Hash(folly::ByteRange(folly::StringPiece(value.hash)));
-      entry = make_unique<TreeInode::Entry>(value.mode, hash);
+      result.entries.emplace(PathComponentPiece(name), value.mode, hash);
     } else {
-      entry = make_unique<TreeInode::Entry>(value.mode, value.inodeNumber);
+      result.entries.emplace(
+          PathComponentPiece(name), value.mode, value.inodeNumber);
     }
-    result.entries.emplace(PathComponentPiece(name), std::move(entry));
   }
 
   return folly::Optional<TreeInode::Dir>(std::move(result));
@@ -242,7 +240,7 @@ void Overlay::saveOverlayDir(
   }
   for (auto& entIter : dir->entries) {
     const auto& entName = entIter.first;
-    const auto ent = entIter.second.get();
+    const auto* ent = &entIter.second;
 
     overlay::OverlayEntry oent;
     oent.mode = ent->mode;
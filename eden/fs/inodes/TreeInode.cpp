@@ -12,9 +12,14 @@
 #include <boost/polymorphic_cast.hpp>
 #include <folly/FileUtil.h>
 #include <folly/futures/Future.h>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <numeric>
 #include <vector>
 #include "eden/fs/inodes/CheckoutAction.h"
 #include "eden/fs/inodes/CheckoutContext.h"
+#include "eden/fs/inodes/CheckoutPrefetcher.h"
 #include "eden/fs/inodes/DeferredDiffEntry.h"
 #include "eden/fs/inodes/DiffContext.h"
 #include "eden/fs/inodes/EdenDispatcher.h"
@@ -22,6 +27,7 @@
 #include "eden/fs/inodes/FileData.h"
 #include "eden/fs/inodes/FileHandle.h"
 #include "eden/fs/inodes/FileInode.h"
+#include "eden/fs/inodes/GitIgnoreCache.h"
 #include "eden/fs/inodes/InodeDiffCallback.h"
 #include "eden/fs/inodes/InodeError.h"
 #include "eden/fs/inodes/InodeMap.h"
@@ -33,8 +39,10 @@
 #include "eden/fs/model/git/GitIgnoreStack.h"
 #include "eden/fs/service/ThriftUtil.h"
 #include "eden/fs/service/gen-cpp2/eden_types.h"
+#include "eden/fs/store/BlobMetadata.h"
 #include "eden/fs/store/ObjectStore.h"
 #include "eden/fuse/Channel.h"
+#include "eden/fuse/InvalidationQueue.h"
 #include "eden/fuse/MountPoint.h"
 #include "eden/fuse/RequestData.h"
 #include "eden/utils/Bug.h"
@@ -53,6 +61,12 @@ using std::vector;
 namespace facebook {
 namespace eden {
 
+// Directory entries are stored inline in Dir::entries; make sure they stay
+// small enough that scanning a large directory stays cache friendly.
+static_assert(
+    sizeof(TreeInode::Entry) <= 48,
+    "TreeInode::Entry should be packed without padding");
+
 /**
  * A helper class to track info about inode loads that we started while holding
  * the contents_ lock.
@@ -131,16 +145,48 @@ TreeInode::TreeInode(
     Dir&& dir)
     : InodeBase(ino, parent, name), contents_(std::move(dir)) {
   DCHECK_NE(ino, FUSE_ROOT_ID);
+  restoreChildInodeNumbers();
 }
 
 TreeInode::TreeInode(EdenMount* mount, std::unique_ptr<Tree>&& tree)
     : TreeInode(mount, buildDirFromTree(tree.get())) {}
 
 TreeInode::TreeInode(EdenMount* mount, Dir&& dir)
-    : InodeBase(mount), contents_(std::move(dir)) {}
+    : InodeBase(mount), contents_(std::move(dir)) {
+  restoreChildInodeNumbers();
+}
 
 TreeInode::~TreeInode() {}
 
+void TreeInode::restoreChildInodeNumbers() {
+  // If another process handed this mount point over to us, give children
+  // that the kernel already knows about the inode numbers they had there.
+  auto childNumbers = getInodeMap()->extractRestoredChildNumbers(getNodeId());
+  if (childNumbers.empty()) {
+    return;
+  }
+
+  auto contents = contents_.wlock();
+  for (const auto& child : childNumbers) {
+    auto iter = contents->entries.find(child.first);
+    if (iter == contents->entries.end()) {
+      LOG(WARNING) << "restored inode " << child.second << " for \""
+                   << child.first << "\" no longer exists in "
+                   << getLogPath();
+      continue;
+    }
+    auto& entry = iter->second;
+    if (!entry.hasInodeNumber()) {
+      entry.setInodeNumber(child.second);
+    } else if (entry.getInodeNumber() != child.second) {
+      LOG(WARNING) << "restored inode " << child.second << " for \""
+                   << child.first << "\" in " << getLogPath()
+                   << " conflicts with existing inode "
+                   << entry.getInodeNumber();
+    }
+  }
+}
+
 folly::Future<fusell::Dispatcher::Attr> TreeInode::getattr() {
   return getAttrLocked(&*contents_.rlock());
 }
@@ -183,9 +229,9 @@ Future<InodePtr> TreeInode::getOrLoadChild(PathComponentPiece name) {
     }
 
     // Check to see if the entry is already loaded
-    auto& entryPtr = iter->second;
-    if (entryPtr->inode) {
-      return makeFuture<InodePtr>(InodePtr::newPtrLocked(entryPtr->inode));
+    auto& entry = iter->second;
+    if (entry.inode) {
+      return makeFuture<InodePtr>(InodePtr::newPtrLocked(entry.inode));
     }
 
     // The entry is not loaded yet.  Ask the InodeMap about the entry.
@@ -194,28 +240,34 @@ Future<InodePtr> TreeInode::getOrLoadChild(PathComponentPiece name) {
     folly::Promise<InodePtr> promise;
     returnFuture = promise.getFuture();
     bool startLoad;
-    if (entryPtr->hasInodeNumber()) {
-      childNumber = entryPtr->getInodeNumber();
+    if (!entry.hasInodeNumber()) {
+      // Adopt the number that readdir() reported for this entry, if any.
+      auto reservedNumber = contents->getReservedInodeNumber(iter);
+      if (reservedNumber != 0) {
+        entry.setInodeNumber(reservedNumber);
+      }
+    }
+    if (entry.hasInodeNumber()) {
+      childNumber = entry.getInodeNumber();
       startLoad = getInodeMap()->shouldLoadChild(
           this, name, childNumber, std::move(promise));
     } else {
       childNumber =
           getInodeMap()->newChildLoadStarted(this, name, std::move(promise));
       // Immediately record the newly allocated inode number
-      entryPtr->setInodeNumber(childNumber);
+      entry.setInodeNumber(childNumber);
       startLoad = true;
     }
     if (startLoad) {
       // The inode is not already being loaded.  We have to start loading it
       // now.
-      auto loadFuture =
-          startLoadingInodeNoThrow(entryPtr.get(), name, childNumber);
+      auto loadFuture = startLoadingInodeNoThrow(&entry, name, childNumber);
       if (loadFuture.isReady() && loadFuture.hasValue()) {
         // If we finished loading the inode immediately, just call
         // InodeMap::inodeLoadComplete() now, since we still have the data_
         // lock.
         auto childInode = loadFuture.get();
-        entryPtr->inode = childInode.get();
+        entry.inode = childInode.get();
         promises = getInodeMap()->inodeLoadComplete(childInode.get());
         childInodePtr = InodePtr::newPtrLocked(childInode.release());
       } else {
@@ -279,6 +331,185 @@ class LookupProcessor {
   RelativePath path_;
   size_t pathIndex_{0};
 };
+
+/**
+ * Looks up a batch of paths, loading each distinct directory only once.
+ *
+ * The paths are sorted by their components, so that all of the paths below
+ * a given directory form a contiguous range.  Each range is resolved with a
+ * single lookup of its directory, and sibling ranges are resolved in
+ * parallel.
+ */
+class BatchLookupProcessor {
+ public:
+  BatchLookupProcessor(vector<RelativePath> paths, size_t maxConcurrentLoads)
+      : paths_{std::move(paths)},
+        results_(paths_.size()),
+        maxConcurrentLoads_{std::max<size_t>(maxConcurrentLoads, 1)} {
+    components_.resize(paths_.size());
+    for (size_t n = 0; n < paths_.size(); ++n) {
+      for (auto component : paths_[n].components()) {
+        components_[n].push_back(component);
+      }
+    }
+
+    order_.resize(paths_.size());
+    std::iota(order_.begin(), order_.end(), 0);
+    std::sort(order_.begin(), order_.end(), [this](size_t a, size_t b) {
+      return std::lexicographical_compare(
+          components_[a].begin(),
+          components_[a].end(),
+          components_[b].begin(),
+          components_[b].end());
+    });
+  }
+
+  Future<Unit> run(TreeInodePtr root) {
+    return lookupChildren(std::move(root), 0, order_.size(), 0);
+  }
+
+  vector<folly::Try<InodePtr>> extractResults() {
+    return std::move(results_);
+  }
+
+ private:
+  size_t numComponents(size_t orderIdx) const {
+    return components_[order_[orderIdx]].size();
+  }
+
+  PathComponentPiece component(size_t orderIdx, size_t depth) const {
+    return components_[order_[orderIdx]][depth];
+  }
+
+  void setResults(size_t begin, size_t end, const folly::Try<InodePtr>& r) {
+    for (size_t n = begin; n < end; ++n) {
+      results_[order_[n]] = r;
+    }
+  }
+
+  /**
+   * Resolve the paths in order_[begin, end), which all refer to tree or to
+   * its descendants.  depth is the number of components in tree's path.
+   */
+  Future<Unit>
+  lookupChildren(TreeInodePtr tree, size_t begin, size_t end, size_t depth) {
+    // Paths that refer to the tree itself sort first.
+    while (begin < end && numComponents(begin) == depth) {
+      results_[order_[begin]] = folly::Try<InodePtr>(tree);
+      ++begin;
+    }
+
+    vector<Future<Unit>> futures;
+    while (begin < end) {
+      auto name = component(begin, depth);
+      auto groupEnd = begin + 1;
+      while (groupEnd < end && component(groupEnd, depth) == name) {
+        ++groupEnd;
+      }
+
+      futures.push_back(
+          loadChild(tree, name)
+              .then([ this, begin, groupEnd, depth ](InodePtr child) {
+                return lookupChild(std::move(child), begin, groupEnd, depth);
+              })
+              .onError([this, begin, groupEnd](folly::exception_wrapper ew) {
+                setResults(begin, groupEnd, folly::Try<InodePtr>(ew));
+              }));
+      begin = groupEnd;
+    }
+    return folly::collectAll(futures).unit();
+  }
+
+  /**
+   * Resolve the paths in order_[begin, end), which all refer to child or to
+   * its descendants.  depth is the number of components in the path of
+   * child's parent.
+   */
+  Future<Unit>
+  lookupChild(InodePtr child, size_t begin, size_t end, size_t depth) {
+    while (begin < end && numComponents(begin) == depth + 1) {
+      results_[order_[begin]] = folly::Try<InodePtr>(child);
+      ++begin;
+    }
+    if (begin == end) {
+      return makeFuture();
+    }
+
+    auto childTree = child.asTreePtrOrNull();
+    if (!childTree) {
+      setResults(
+          begin,
+          end,
+          folly::Try<InodePtr>(
+              folly::make_exception_wrapper<InodeError>(ENOTDIR, child)));
+      return makeFuture();
+    }
+    return lookupChildren(std::move(childTree), begin, end, depth + 1);
+  }
+
+  /**
+   * Call tree->getOrLoadChild(name) once fewer than maxConcurrentLoads_
+   * other children are being loaded.
+   *
+   * A slot is only held while the child itself is loading, not while its
+   * descendants are being looked up, so lookups can never wait on each other.
+   */
+  Future<InodePtr> loadChild(TreeInodePtr tree, PathComponentPiece name) {
+    // name points into paths_, so it remains valid until we are done.
+    return acquireLoadSlot().then([ this, tree = std::move(tree), name ]() {
+      return tree->getOrLoadChild(name).ensure([this] { releaseLoadSlot(); });
+    });
+  }
+
+  Future<Unit> acquireLoadSlot() {
+    std::lock_guard<std::mutex> guard(loadMutex_);
+    if (numLoading_ < maxConcurrentLoads_) {
+      ++numLoading_;
+      return makeFuture();
+    }
+    waitingLoads_.emplace_back();
+    return waitingLoads_.back().getFuture();
+  }
+
+  void releaseLoadSlot() {
+    std::unique_lock<std::mutex> lock(loadMutex_);
+    --numLoading_;
+    // Starting a waiting load may run it inline, and if the child is already
+    // loaded it will call releaseLoadSlot() again before returning.  Only the
+    // outermost call starts waiting loads, so that the stack doesn't grow
+    // with the number of waiting loads.
+    if (startingLoads_) {
+      return;
+    }
+    startingLoads_ = true;
+    while (numLoading_ < maxConcurrentLoads_ && !waitingLoads_.empty()) {
+      auto next = std::move(waitingLoads_.front());
+      waitingLoads_.pop_front();
+      ++numLoading_;
+      lock.unlock();
+      next.setValue();
+      lock.lock();
+    }
+    startingLoads_ = false;
+  }
+
+  const vector<RelativePath> paths_;
+  /** The components of each path, pointing into paths_ */
+  vector<vector<PathComponentPiece>> components_;
+  /** Indices into paths_, sorted by path components */
+  vector<size_t> order_;
+  /** The result for each path, in the same order as paths_ */
+  vector<folly::Try<InodePtr>> results_;
+
+  const size_t maxConcurrentLoads_;
+  std::mutex loadMutex_;
+  /** The number of children being loaded.  Protected by loadMutex_ */
+  size_t numLoading_{0};
+  /** True while releaseLoadSlot() is starting waiting loads */
+  bool startingLoads_{false};
+  /** Loads waiting for numLoading_ to drop.  Protected by loadMutex_ */
+  std::deque<folly::Promise<Unit>> waitingLoads_;
+};
 }
 
 Future<InodePtr> TreeInode::getChildRecursive(RelativePathPiece path) {
@@ -294,6 +525,15 @@ Future<InodePtr> TreeInode::getChildRecursive(RelativePathPiece path) {
   return future.ensure([p = std::move(processor)]() mutable { p.reset(); });
 }
 
+Future<vector<folly::Try<InodePtr>>> TreeInode::getChildrenRecursive(
+    vector<RelativePath> paths,
+    size_t maxConcurrentLoads) {
+  auto processor = std::make_shared<BatchLookupProcessor>(
+      std::move(paths), maxConcurrentLoads);
+  return processor->run(TreeInodePtr::newPtrFromExisting(this))
+      .then([processor]() { return processor->extractResults(); });
+}
+
 fuse_ino_t TreeInode::getChildInodeNumber(PathComponentPiece name) {
   auto contents = contents_.wlock();
   auto iter = contents->entries.find(name);
@@ -302,19 +542,142 @@ fuse_ino_t TreeInode::getChildInodeNumber(PathComponentPiece name) {
   }
 
   auto& ent = iter->second;
-  if (ent->inode) {
-    return ent->inode->getNodeId();
+  if (ent.inode) {
+    return ent.inode->getNodeId();
   }
 
-  if (ent->hasInodeNumber()) {
-    return ent->getInodeNumber();
+  if (ent.hasInodeNumber()) {
+    return ent.getInodeNumber();
   }
 
-  auto inodeNumber = getInodeMap()->allocateInodeNumber();
-  ent->setInodeNumber(inodeNumber);
+  auto inodeNumber = contents->getReservedInodeNumber(iter);
+  if (inodeNumber == 0) {
+    inodeNumber = getInodeMap()->allocateInodeNumber();
+  }
+  ent.setInodeNumber(inodeNumber);
   return inodeNumber;
 }
 
+void TreeInode::reserveChildInodeNumbers(Dir& contents) {
+  if (contents.reservedInodeBase != 0 || contents.entries.empty()) {
+    return;
+  }
+  contents.reservedInodeBase =
+      getInodeMap()->allocateInodeNumbers(contents.entries.size());
+}
+
+fuse_ino_t TreeInode::Dir::getReservedInodeNumber(
+    PathMap<Entry>::const_iterator iter) const {
+  if (reservedInodeBase == 0) {
+    return 0;
+  }
+  return reservedInodeBase + (iter - entries.cbegin());
+}
+
+void TreeInode::Dir::assignReservedInodeNumbers() {
+  if (reservedInodeBase == 0) {
+    return;
+  }
+  auto number = reservedInodeBase;
+  for (auto& entry : entries) {
+    if (!entry.second.inode && !entry.second.hasInodeNumber()) {
+      entry.second.setInodeNumber(number);
+    }
+    ++number;
+  }
+  reservedInodeBase = 0;
+}
+
+Future<Optional<fusell::Dispatcher::Attr>> TreeInode::getChildAttrForReaddir(
+    PathComponentPiece name) {
+  using AttrResult = Optional<fusell::Dispatcher::Attr>;
+  InodePtr child;
+  fuse_ino_t childNumber{0};
+  mode_t childMode{0};
+  Hash blobHash;
+  {
+    auto contents = contents_.wlock();
+    auto iter = contents->entries.find(name);
+    if (iter == contents->entries.end()) {
+      return AttrResult{};
+    }
+
+    auto& entry = iter->second;
+    if (entry.inode) {
+      child = InodePtr::newPtrLocked(entry.inode);
+    } else if (entry.isMaterialized() || entry.isDirectory()) {
+      // Reporting these requires reading the overlay or the source control
+      // tree, which is what lookup() will do if the caller needs it.
+      return AttrResult{};
+    } else {
+      if (!entry.hasInodeNumber()) {
+        auto number = contents->getReservedInodeNumber(iter);
+        if (number == 0) {
+          number = getInodeMap()->allocateInodeNumber();
+        }
+        entry.setInodeNumber(number);
+      }
+      childNumber = entry.getInodeNumber();
+      childMode = entry.mode;
+      blobHash = entry.getHash();
+    }
+  }
+
+  if (child) {
+    return child->getattr().then([child](fusell::Dispatcher::Attr attr) {
+      child->incFuseRefcount();
+      return AttrResult{attr};
+    });
+  }
+
+  return getStore()->getBlobMetadata(blobHash).then([
+    self = inodePtrFromThis(),
+    childName = PathComponent{name},
+    childNumber,
+    childMode
+  ](const BlobMetadata& metadata) {
+    if (!self->addUnloadedChildFuseReference(childName, childNumber)) {
+      return AttrResult{};
+    }
+
+    // This matches what FileData::stat() reports for a file that has not
+    // been materialized, using the current time as the timestamp.
+    fusell::Dispatcher::Attr attr(self->getMount()->getMountPoint());
+    attr.st.st_ino = childNumber;
+    attr.st.st_mode = childMode;
+    attr.st.st_nlink = 1;
+    attr.st.st_size = metadata.size;
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(now);
+    auto nsec =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - seconds);
+    attr.st.st_atim.tv_sec = seconds.count();
+    attr.st.st_atim.tv_nsec = nsec.count();
+    attr.st.st_mtim = attr.st.st_atim;
+    attr.st.st_ctim = attr.st.st_atim;
+    return AttrResult{attr};
+  });
+}
+
+bool TreeInode::addUnloadedChildFuseReference(
+    PathComponentPiece name,
+    fuse_ino_t number) {
+  auto contents = contents_.wlock();
+  auto iter = contents->entries.find(name);
+  if (iter == contents->entries.end()) {
+    return false;
+  }
+
+  const auto& entry = iter->second;
+  if (entry.inode || entry.isMaterialized() || !entry.hasInodeNumber() ||
+      entry.getInodeNumber() != number) {
+    return false;
+  }
+
+  getInodeMap()->incUnloadedFuseRefcount(this, name, number);
+  return true;
+}
+
 void TreeInode::loadChildInode(PathComponentPiece name, fuse_ino_t number) {
   folly::Optional<folly::Future<unique_ptr<InodeBase>>> future;
   {
@@ -328,10 +691,10 @@ void TreeInode::loadChildInode(PathComponentPiece name, fuse_ino_t number) {
       return;
     }
 
-    auto& entryPtr = iter->second;
+    auto& entry = iter->second;
     // InodeMap makes sure to only try loading each inode once, so this entry
     // should not already be loaded.
-    if (entryPtr->inode != nullptr) {
+    if (entry.inode != nullptr) {
       auto bug = EDEN_BUG() << "InodeMap requested to load inode " << number
                             << "(" << name << " in " << getNodeId()
                             << "), which is already loaded";
@@ -346,7 +709,7 @@ void TreeInode::loadChildInode(PathComponentPiece name, fuse_ino_t number) {
       return;
     }
 
-    future = startLoadingInodeNoThrow(entryPtr.get(), name, number);
+    future = startLoadingInodeNoThrow(&entry, name, number);
   }
   registerInodeLoadComplete(future.value(), name, number);
 }
@@ -392,7 +755,7 @@ void TreeInode::inodeLoadComplete(
           childName,
           "inode removed before loading finished");
     }
-    iter->second->inode = childInode.get();
+    iter->second.inode = childInode.get();
     // Make sure that we are still holding the contents_ lock when
     // calling inodeLoadComplete().  This ensures that no-one can look up
     // the inode by name before it is also available in the InodeMap.
@@ -553,13 +916,13 @@ void TreeInode::childMaterialized(
                  << getLogPath() << ": entry not present";
     }
 
-    auto* childEntry = iter->second.get();
-    if (contents->materialized && childEntry->isMaterialized()) {
+    auto& childEntry = iter->second;
+    if (contents->materialized && childEntry.isMaterialized()) {
       // Nothing to do
       return;
     }
 
-    childEntry->setMaterialized(childNodeId);
+    childEntry.setMaterialized(childNodeId);
     contents->materialized = true;
     getOverlay()->saveOverlayDir(this->getNodeId(), &*contents);
   }
@@ -586,15 +949,14 @@ void TreeInode::childDematerialized(
                  << getLogPath() << ": entry not present";
     }
 
-    auto* childEntry = iter->second.get();
-    if (!childEntry->isMaterialized() &&
-        childEntry->getHash() == childScmHash) {
+    auto& childEntry = iter->second;
+    if (!childEntry.isMaterialized() && childEntry.getHash() == childScmHash) {
       // Nothing to do.  Our child's state and our own are both unchanged.
       return;
     }
 
     // Mark the child dematerialized.
-    childEntry->setDematerialized(childScmHash);
+    childEntry.setDematerialized(childScmHash);
 
     // Mark us materialized!
     //
@@ -628,10 +990,10 @@ TreeInode::Dir TreeInode::buildDirFromTree(const Tree* tree) {
   }
 
   dir.treeHash = tree->getHash();
+  dir.entries.reserve(tree->getTreeEntries().size());
   for (const auto& treeEntry : tree->getTreeEntries()) {
-    Entry entry{treeEntry.getMode(), treeEntry.getHash()};
     dir.entries.emplace(
-        treeEntry.getName(), std::make_unique<Entry>(std::move(entry)));
+        treeEntry.getName(), treeEntry.getMode(), treeEntry.getHash());
   }
   return dir;
 }
@@ -678,13 +1040,17 @@ TreeInode::create(PathComponentPiece name, mode_t mode, int flags) {
     mode = S_IFREG | (07777 & mode);
 
     // Record the new entry
-    auto& entry = contents->entries[name];
-    entry = std::make_unique<Entry>(mode, childNumber);
+    contents->assignReservedInodeNumbers();
+    auto emplaceResult = contents->entries.emplace(name, mode, childNumber);
+    auto& entry = emplaceResult.first->second;
+    if (!emplaceResult.second) {
+      entry = Entry{mode, childNumber};
+    }
 
     // build a corresponding FileInode
     inode = FileInodePtr::makeNew(
         childNumber, this->inodePtrFromThis(), name, mode, std::move(file));
-    entry->inode = inode.get();
+    entry.inode = inode.get();
     inodeMap->inodeCreated(inode);
 
     // The kernel wants an open operation to return the inode,
@@ -770,17 +1136,18 @@ FileInodePtr TreeInode::symlink(
           " bytes");
     }
 
-    auto entry = std::make_unique<Entry>(S_IFLNK | 0770, childNumber);
+    Entry entry{S_IFLNK | 0770, childNumber};
 
     // build a corresponding FileInode
     inode = FileInodePtr::makeNew(
         childNumber,
         this->inodePtrFromThis(),
         name,
-        entry->mode,
+        entry.mode,
         std::move(file));
-    entry->inode = inode.get();
+    entry.inode = inode.get();
     inodeMap->inodeCreated(inode);
+    contents->assignReservedInodeNumbers();
     contents->entries.emplace(name, std::move(entry));
 
     this->getOverlay()->saveOverlayDir(getNodeId(), &*contents);
@@ -840,17 +1207,18 @@ TreeInode::mknod(PathComponentPiece name, mode_t mode, dev_t rdev) {
       ::unlink(filePath.c_str());
     };
 
-    auto entry = std::make_unique<Entry>(mode, childNumber, rdev);
+    Entry entry{mode, childNumber, rdev};
 
     // build a corresponding FileInode
     inode = FileInodePtr::makeNew(
         childNumber,
         this->inodePtrFromThis(),
         name,
-        entry->mode,
+        entry.mode,
         std::move(file));
-    entry->inode = inode.get();
+    entry.inode = inode.get();
     inodeMap->inodeCreated(inode);
+    contents->assignReservedInodeNumbers();
     contents->entries.emplace(name, std::move(entry));
 
     this->getOverlay()->saveOverlayDir(getNodeId(), &*contents);
@@ -902,8 +1270,8 @@ TreeInodePtr TreeInode::mkdir(PathComponentPiece name, mode_t mode) {
     overlay->saveOverlayDir(childNumber, &emptyDir);
 
     // Add a new entry to contents_.entries
-    auto emplaceResult = contents->entries.emplace(
-        name, std::make_unique<Entry>(mode, childNumber));
+    contents->assignReservedInodeNumbers();
+    auto emplaceResult = contents->entries.emplace(name, mode, childNumber);
     CHECK(emplaceResult.second)
         << "directory contents should not have changed since the check above";
     auto& entry = emplaceResult.first->second;
@@ -914,7 +1282,7 @@ TreeInodePtr TreeInode::mkdir(PathComponentPiece name, mode_t mode) {
         this->inodePtrFromThis(),
         name,
         std::move(emptyDir));
-    entry->inode = newChild.get();
+    entry.inode = newChild.get();
     inodeMap->inodeCreated(newChild);
 
     // Save our updated overlay data
@@ -1053,20 +1421,20 @@ int TreeInode::tryRemoveChild(
       return ENOENT;
     }
     auto& ent = entIter->second;
-    if (!ent->inode) {
+    if (!ent.inode) {
       // The inode in question is not loaded.  The caller will need to load it
       // and retry (if they want to retry).
       return EBADF;
     }
     if (child) {
-      if (ent->inode != child.get()) {
+      if (ent.inode != child.get()) {
         // This entry no longer refers to what the caller expected.
         return EBADF;
       }
     } else {
       // Make sure the entry being removed is the expected file/directory type.
       auto* currentChild =
-          dynamic_cast<typename InodePtrType::InodeType*>(ent->inode);
+          dynamic_cast<typename InodePtrType::InodeType*>(ent.inode);
       if (!currentChild) {
         return InodePtrType::InodeType::WRONG_TYPE_ERRNO;
       }
@@ -1083,6 +1451,7 @@ int TreeInode::tryRemoveChild(
     deletedInode = child->markUnlinked(this, name, renameLock);
 
     // Remove it from our entries list
+    contents->assignReservedInodeNumbers();
     contents->entries.erase(entIter);
 
     // Update the on-disk overlay
@@ -1138,12 +1507,12 @@ class TreeInode::TreeRenameLocks {
     return destContents_;
   }
 
-  const PathMap<std::unique_ptr<Entry>>::iterator& destChildIter() const {
+  const PathMap<Entry>::iterator& destChildIter() const {
     return destChildIter_;
   }
   InodeBase* destChild() const {
     DCHECK(destChildExists());
-    return destChildIter_->second->inode;
+    return destChildIter_->second.inode;
   }
 
   bool destChildExists() const {
@@ -1151,7 +1520,7 @@ class TreeInode::TreeRenameLocks {
   }
   bool destChildIsDirectory() const {
     DCHECK(destChildExists());
-    return destChildIter_->second->isDirectory();
+    return destChildIter_->second.isDirectory();
   }
   bool destChildIsEmpty() const {
     DCHECK_NOTNULL(destChildContents_);
@@ -1193,7 +1562,7 @@ class TreeInode::TreeRenameLocks {
    * This may point to destContents_->entries.end() if the destination child
    * does not exist.
    */
-  PathMap<std::unique_ptr<Entry>>::iterator destChildIter_;
+  PathMap<Entry>::iterator destChildIter_;
 };
 
 Future<Unit> TreeInode::rename(
@@ -1220,13 +1589,13 @@ Future<Unit> TreeInode::rename(
       // The source path does not exist.  Fail the rename.
       return makeFuture<Unit>(InodeError(ENOENT, inodePtrFromThis(), name));
     }
-    Entry* srcEntry = srcIter->second.get();
+    auto& srcEntry = srcIter->second;
 
     // Perform as much input validation as possible now, before starting inode
     // loads that might be necessary.
 
     // Validate invalid file/directory replacement
-    if (srcEntry->isDirectory()) {
+    if (srcEntry.isDirectory()) {
       // The source is a directory.
       // The destination must not exist, or must be an empty directory,
       // or the exact same directory.
@@ -1237,7 +1606,7 @@ Future<Unit> TreeInode::rename(
                   << destName;
           return makeFuture<Unit>(InodeError(ENOTDIR, destParent, destName));
         } else if (
-            locks.destChild() != srcEntry->inode && !locks.destChildIsEmpty()) {
+            locks.destChild() != srcEntry.inode && !locks.destChildIsEmpty()) {
           VLOG(4) << "attempted to rename directory " << getLogPath() << "/"
                   << name << " over non-empty directory "
                   << destParent->getLogPath() << "/" << destName;
@@ -1264,7 +1633,7 @@ Future<Unit> TreeInode::rename(
     }
 
     // Check to see if we need to load the source or destination inodes
-    needSrc = !srcEntry->inode;
+    needSrc = !srcEntry.inode;
     needDest = locks.destChildExists() && !locks.destChild();
 
     // If we don't have to load anything now, we can immediately perform the
@@ -1322,14 +1691,14 @@ bool isAncestor(const RenameLock& renameLock, TreeInode* a, TreeInode* b) {
 Future<Unit> TreeInode::doRename(
     TreeRenameLocks&& locks,
     PathComponentPiece srcName,
-    PathMap<std::unique_ptr<Entry>>::iterator srcIter,
+    PathMap<Entry>::iterator srcIter,
     TreeInodePtr destParent,
     PathComponentPiece destName) {
-  Entry* srcEntry = srcIter->second.get();
+  auto& srcEntry = srcIter->second;
 
   // If the source and destination refer to exactly the same file,
   // then just succeed immediately.  Nothing needs to be done in this case.
-  if (locks.destChildExists() && srcEntry->inode == locks.destChild()) {
+  if (locks.destChildExists() && srcEntry.inode == locks.destChild()) {
     return folly::Unit{};
   }
 
@@ -1342,11 +1711,11 @@ Future<Unit> TreeInode::doRename(
   // We don't have to worry about the source being a child of the destination
   // directory.  That will have already been caught by the earlier check that
   // ensures the destination directory is non-empty.
-  if (srcEntry->isDirectory()) {
+  if (srcEntry.isDirectory()) {
     // Our caller has already verified that the source is also a
     // directory here.
     auto* srcTreeInode =
-        boost::polymorphic_downcast<TreeInode*>(srcEntry->inode);
+        boost::polymorphic_downcast<TreeInode*>(srcEntry.inode);
     if (srcTreeInode == destParent.get() ||
         isAncestor(locks.renameLock(), srcTreeInode, destParent.get())) {
       return makeFuture<Unit>(InodeError(EINVAL, destParent, destName));
@@ -1357,7 +1726,9 @@ Future<Unit> TreeInode::doRename(
   // Update the destination with the source data (this copies in the hash if
   // it happens to be set).
   std::unique_ptr<InodeBase> deletedInode;
-  auto* childInode = srcEntry->inode;
+  auto* childInode = srcEntry.inode;
+  locks.srcContents()->assignReservedInodeNumbers();
+  locks.destContents()->assignReservedInodeNumbers();
   if (locks.destChildExists()) {
     deletedInode = locks.destChild()->markUnlinked(
         destParent.get(), destName, locks.renameLock());
@@ -1535,7 +1906,7 @@ Future<Unit> TreeInode::diff(
     Entry* inodeEntry = nullptr;
     auto iter = contents->entries.find(kIgnoreFilename);
     if (iter != contents->entries.end()) {
-      inodeEntry = iter->second.get();
+      inodeEntry = &iter->second;
       if (inodeEntry->isDirectory()) {
         // Ignore .gitignore directories
         VLOG(4) << "Ignoring .gitignore directory in " << getLogPath();
@@ -1556,6 +1927,24 @@ Future<Unit> TreeInode::diff(
           isIgnored);
     }
 
+    // If the .gitignore file is unmodified from source control and we have
+    // already parsed this blob, we don't need to load the inode at all.
+    if (!inodeEntry->isMaterialized() && S_ISREG(inodeEntry->mode)) {
+      auto cached =
+          getMount()->getGitIgnoreCache()->get(inodeEntry->getHash());
+      if (cached) {
+        auto ignore =
+            make_unique<GitIgnoreStack>(parentIgnore, std::move(cached));
+        return computeDiff(
+            std::move(contents),
+            context,
+            currentPath,
+            std::move(tree),
+            std::move(ignore),
+            isIgnored);
+      }
+    }
+
     if (inodeEntry->inode) {
       inode = InodePtr::newPtrLocked(inodeEntry->inode);
     } else {
@@ -1636,6 +2025,25 @@ Future<Unit> TreeInode::loadGitIgnoreThenDiff(
         });
   }
 
+  // Check the cache for an already parsed version of this file.  The version
+  // is recorded before reading the file, so that if the file is modified
+  // while we are reading it we don't cache the new version under the old key.
+  auto* cache = getMount()->getGitIgnoreCache();
+  auto version = fileInode->getContentsVersion();
+  auto cached = version.hash.hasValue()
+      ? cache->get(version.hash.value())
+      : cache->get(fileInode->getNodeId(), version.generation);
+  if (cached) {
+    auto ignore = make_unique<GitIgnoreStack>(parentIgnore, std::move(cached));
+    return computeDiff(
+        contents_.wlock(),
+        context,
+        currentPath,
+        std::move(tree),
+        std::move(ignore),
+        isIgnored);
+  }
+
   // Load the file data
   // We intentionally call data->ensureDataLoaded() as a separate statement
   // from creating the future callback with then(), since the callback
@@ -1650,10 +2058,20 @@ Future<Unit> TreeInode::loadGitIgnoreThenDiff(
     tree = std::move(tree),
     parentIgnore,
     isIgnored,
+    fileInode = std::move(fileInode),
+    version = std::move(version),
     data = std::move(data)
   ]() mutable {
-    auto ignoreFileContents = data->readAll();
-    auto ignore = make_unique<GitIgnoreStack>(parentIgnore, ignoreFileContents);
+    auto parsed = GitIgnoreCache::parse(data->readAll());
+    if (fileInode->getContentsVersion() == version) {
+      auto* cache = self->getMount()->getGitIgnoreCache();
+      if (version.hash.hasValue()) {
+        cache->insert(version.hash.value(), parsed);
+      } else {
+        cache->insert(fileInode->getNodeId(), version.generation, parsed);
+      }
+    }
+    auto ignore = make_unique<GitIgnoreStack>(parentIgnore, std::move(parsed));
     return self->computeDiff(
         self->contents_.wlock(),
         context,
@@ -1871,7 +2289,7 @@ Future<Unit> TreeInode::computeDiff(
     // inode entries are both sorted in the same order.
     vector<TreeEntry> emptyEntries;
     const auto& scEntries = tree ? tree->getTreeEntries() : emptyEntries;
-    const auto& inodeEntries = contents->entries;
+    auto& inodeEntries = contents->entries;
     size_t scIdx = 0;
     auto inodeIter = inodeEntries.begin();
     while (true) {
@@ -1882,7 +2300,7 @@ Future<Unit> TreeInode::computeDiff(
         }
 
         // This entry is present locally but not in the source control tree.
-        processUntracked(inodeIter->first, inodeIter->second.get());
+        processUntracked(inodeIter->first, &inodeIter->second);
         ++inodeIter;
       } else if (inodeIter == inodeEntries.end()) {
         // This entry is present in the old tree but not the old one.
@@ -1892,11 +2310,11 @@ Future<Unit> TreeInode::computeDiff(
         processRemoved(scEntries[scIdx]);
         ++scIdx;
       } else if (scEntries[scIdx].getName() > inodeIter->first) {
-        processUntracked(inodeIter->first, inodeIter->second.get());
+        processUntracked(inodeIter->first, &inodeIter->second);
         ++inodeIter;
       } else {
         const auto& scmEntry = scEntries[scIdx];
-        auto* inodeEntry = inodeIter->second.get();
+        auto* inodeEntry = &inodeIter->second;
         ++scIdx;
         ++inodeIter;
         processBothPresent(scmEntry, inodeEntry);
@@ -1950,15 +2368,52 @@ Future<Unit> TreeInode::checkout(
     std::unique_ptr<Tree> toTree) {
   VLOG(4) << "checkout: starting update of " << getLogPath() << ": "
           << fromTree->getHash() << " --> " << toTree->getHash();
+  ++ctx->getProgress()->treesCompared;
   vector<unique_ptr<CheckoutAction>> actions;
-  vector<IncompleteInodeLoad> pendingLoads;
+  vector<CheckoutLoad> checkoutLoads;
+  vector<DryRunChange> dryRunChanges;
 
   computeCheckoutActions(
-      ctx, fromTree.get(), toTree.get(), &actions, &pendingLoads);
+      ctx,
+      fromTree.get(),
+      toTree.get(),
+      &actions,
+      &checkoutLoads,
+      &dryRunChanges);
+
+  // Start loading the child inodes that the actions need.  These go through
+  // the scheduler so that a large checkout does not load every changed inode
+  // at once.
+  for (auto& load : checkoutLoads) {
+    ctx->getScheduler()
+        .schedule(
+            CheckoutScheduler::Priority::INODE_LOAD,
+            [ self = inodePtrFromThis(), name = std::move(load.name) ] {
+              return self->getOrLoadChild(name);
+            })
+        .then([promise = std::move(load.promise)](
+            folly::Try<InodePtr>&& result) mutable {
+          promise.setTry(std::move(result));
+        });
+  }
 
-  // Wire up the callbacks for any pending inode loads we started
-  for (auto& load : pendingLoads) {
-    load.finish();
+  // Count the changes a dry run found for entries without loaded inodes.
+  // This is done after releasing the contents_ lock since it may need to
+  // load Trees.  Errors are reported for the individual entries.
+  vector<Future<Unit>> dryRunCounts;
+  for (const auto& change : dryRunChanges) {
+    const auto* oldEntry = change.oldEntry.get_pointer();
+    const auto* newEntry = change.newEntry.get_pointer();
+    const auto& name = oldEntry ? oldEntry->getName() : newEntry->getName();
+    dryRunCounts.push_back(
+        ctx->countChanges(getStore(), oldEntry, newEntry)
+            .onError([
+              ctx,
+              self = inodePtrFromThis(),
+              name = PathComponent{name}
+            ](const folly::exception_wrapper& ew) {
+              ctx->addError(self.get(), name, ew);
+            }));
   }
 
   // Now start all of the checkout actions
@@ -1971,8 +2426,9 @@ Future<Unit> TreeInode::checkout(
     ctx,
     self = inodePtrFromThis(),
     toTree = std::move(toTree),
-    actions = std::move(actions)
-  ](vector<folly::Try<Unit>> actionResults) {
+    actions = std::move(actions),
+    dryRunCounts = std::move(dryRunCounts)
+  ](vector<folly::Try<Unit>> actionResults) mutable {
     // Record any errors that occurred
     size_t numErrors = 0;
     for (size_t n = 0; n < actionResults.size(); ++n) {
@@ -1984,11 +2440,23 @@ Future<Unit> TreeInode::checkout(
       ctx->addError(self.get(), actions[n]->getEntryName(), result.exception());
     }
 
+    if (!ctx->shouldApplyChanges()) {
+      // Nothing was changed, but wait for the dry run to finish counting
+      // changes inside directories that were not loaded.
+      VLOG(4) << "checkout: finished dry run of " << self->getLogPath() << ": "
+              << numErrors << " errors";
+      return folly::collectAll(dryRunCounts).unit();
+    }
+
     // Update our state in the overlay
+    auto saveStart = std::chrono::steady_clock::now();
     self->saveOverlayPostCheckout(ctx, toTree.get());
+    ctx->addCumulativeOverlaySaveTime(
+        std::chrono::steady_clock::now() - saveStart);
 
     VLOG(4) << "checkout: finished update of " << self->getLogPath() << ": "
             << numErrors << " errors";
+    return makeFuture();
   });
 }
 
@@ -1997,7 +2465,8 @@ void TreeInode::computeCheckoutActions(
     const Tree* fromTree,
     const Tree* toTree,
     vector<unique_ptr<CheckoutAction>>* actions,
-    vector<IncompleteInodeLoad>* pendingLoads) {
+    vector<CheckoutLoad>* checkoutLoads,
+    vector<DryRunChange>* dryRunChanges) {
   // Grab the contents_ lock for the duration of this function
   auto contents = contents_.wlock();
 
@@ -2023,20 +2492,40 @@ void TreeInode::computeCheckoutActions(
 
       // This entry is present in the new tree but not the old one.
       action = processCheckoutEntry(
-          ctx, *contents, nullptr, &newEntries[newIdx], pendingLoads);
+          ctx,
+          *contents,
+          nullptr,
+          &newEntries[newIdx],
+          checkoutLoads,
+          dryRunChanges);
       ++newIdx;
     } else if (newIdx >= newEntries.size()) {
       // This entry is present in the old tree but not the old one.
       action = processCheckoutEntry(
-          ctx, *contents, &oldEntries[oldIdx], nullptr, pendingLoads);
+          ctx,
+          *contents,
+          &oldEntries[oldIdx],
+          nullptr,
+          checkoutLoads,
+          dryRunChanges);
       ++oldIdx;
     } else if (oldEntries[oldIdx].getName() < newEntries[newIdx].getName()) {
       action = processCheckoutEntry(
-          ctx, *contents, &oldEntries[oldIdx], nullptr, pendingLoads);
+          ctx,
+          *contents,
+          &oldEntries[oldIdx],
+          nullptr,
+          checkoutLoads,
+          dryRunChanges);
       ++oldIdx;
     } else if (oldEntries[oldIdx].getName() > newEntries[newIdx].getName()) {
       action = processCheckoutEntry(
-          ctx, *contents, nullptr, &newEntries[newIdx], pendingLoads);
+          ctx,
+          *contents,
+          nullptr,
+          &newEntries[newIdx],
+          checkoutLoads,
+          dryRunChanges);
       ++newIdx;
     } else {
       action = processCheckoutEntry(
@@ -2044,7 +2533,8 @@ void TreeInode::computeCheckoutActions(
           *contents,
           &oldEntries[oldIdx],
           &newEntries[newIdx],
-          pendingLoads);
+          checkoutLoads,
+          dryRunChanges);
       ++oldIdx;
       ++newIdx;
     }
@@ -2060,7 +2550,8 @@ unique_ptr<CheckoutAction> TreeInode::processCheckoutEntry(
     Dir& contents,
     const TreeEntry* oldScmEntry,
     const TreeEntry* newScmEntry,
-    vector<IncompleteInodeLoad>* pendingLoads) {
+    vector<CheckoutLoad>* checkoutLoads,
+    vector<DryRunChange>* dryRunChanges) {
   // At most one of oldScmEntry and newScmEntry may be null.
   DCHECK(oldScmEntry || newScmEntry);
 
@@ -2089,9 +2580,14 @@ unique_ptr<CheckoutAction> TreeInode::processCheckoutEntry(
       // and does not currently exist in the filesystem.  Go ahead and add it
       // now.
       if (ctx->shouldApplyChanges()) {
-        auto newEntry =
-            make_unique<Entry>(newScmEntry->getMode(), newScmEntry->getHash());
-        contents.entries.emplace(newScmEntry->getName(), std::move(newEntry));
+        contents.assignReservedInodeNumbers();
+        contents.entries.emplace(
+            newScmEntry->getName(),
+            newScmEntry->getMode(),
+            newScmEntry->getHash());
+        addCheckoutPrefetch(ctx, name, nullptr, newScmEntry, false);
+      } else {
+        addDryRunChange(nullptr, newScmEntry, dryRunChanges);
       }
     } else if (!newScmEntry) {
       // This file exists in the old tree, but is being removed in the new
@@ -2106,10 +2602,16 @@ unique_ptr<CheckoutAction> TreeInode::processCheckoutEntry(
       ctx->addConflict(
           ConflictType::REMOVED_MODIFIED, this, oldScmEntry->getName());
       if (ctx->forceUpdate()) {
-        DCHECK(ctx->shouldApplyChanges());
-        auto newEntry =
-            make_unique<Entry>(newScmEntry->getMode(), newScmEntry->getHash());
-        contents.entries.emplace(newScmEntry->getName(), std::move(newEntry));
+        if (ctx->shouldApplyChanges()) {
+          contents.assignReservedInodeNumbers();
+          contents.entries.emplace(
+              newScmEntry->getName(),
+              newScmEntry->getMode(),
+              newScmEntry->getHash());
+          addCheckoutPrefetch(ctx, name, nullptr, newScmEntry, false);
+        } else {
+          addDryRunChange(nullptr, newScmEntry, dryRunChanges);
+        }
       }
     }
 
@@ -2118,9 +2620,10 @@ unique_ptr<CheckoutAction> TreeInode::processCheckoutEntry(
   }
 
   auto& entry = it->second;
-  if (entry->inode) {
+  if (entry.inode) {
     // If the inode is already loaded, create a CheckoutAction to process it
-    auto childPtr = InodePtr::newPtrLocked(entry->inode);
+    auto childPtr = InodePtr::newPtrLocked(entry.inode);
+    addCheckoutPrefetch(ctx, name, oldScmEntry, newScmEntry, true);
     return make_unique<CheckoutAction>(
         ctx, oldScmEntry, newScmEntry, std::move(childPtr));
   }
@@ -2133,12 +2636,12 @@ unique_ptr<CheckoutAction> TreeInode::processCheckoutEntry(
   //
   // This also handles materialized inodes--an inode cannot be materialized if
   // it does not have an inode number assigned to it.
-  if (entry->hasInodeNumber()) {
+  if (entry.hasInodeNumber()) {
     // This child is potentially modified, but is not currently loaded.
-    // Start loading it and create a CheckoutAction to process it once it
-    // is loaded.
-    auto inodeFuture =
-        loadChildLocked(contents, name, entry.get(), pendingLoads);
+    // Load it once we release the contents_ lock, and create a
+    // CheckoutAction to process it once it is loaded.
+    auto inodeFuture = addCheckoutLoad(name, checkoutLoads);
+    addCheckoutPrefetch(ctx, name, oldScmEntry, newScmEntry, true);
     return make_unique<CheckoutAction>(
         ctx, oldScmEntry, newScmEntry, std::move(inodeFuture));
   }
@@ -2147,16 +2650,15 @@ unique_ptr<CheckoutAction> TreeInode::processCheckoutEntry(
   auto conflictType = ConflictType::ERROR;
   if (!oldScmEntry) {
     conflictType = ConflictType::UNTRACKED_ADDED;
-  } else if (entry->getHash() != oldScmEntry->getHash()) {
+  } else if (entry.getHash() != oldScmEntry->getHash()) {
     conflictType = ConflictType::MODIFIED;
   }
   if (conflictType != ConflictType::ERROR) {
     // If this is are a directory we unfortunately have to load the directory
     // and recurse into it just so we can accurately report the list of files
     // with conflicts.
-    if (entry->isDirectory()) {
-      auto inodeFuture =
-          loadChildLocked(contents, name, entry.get(), pendingLoads);
+    if (entry.isDirectory()) {
+      auto inodeFuture = addCheckoutLoad(name, checkoutLoads);
       return make_unique<CheckoutAction>(
           ctx, oldScmEntry, newScmEntry, std::move(inodeFuture));
     }
@@ -2166,18 +2668,38 @@ unique_ptr<CheckoutAction> TreeInode::processCheckoutEntry(
     if (!ctx->forceUpdate()) {
       return nullptr;
     }
+
+    // For a dry run of a forced update, this file differs from the old
+    // source control state, so it is replaced even if the old and new
+    // entries are identical.
+    if (!ctx->shouldApplyChanges()) {
+      if (!newScmEntry) {
+        ctx->recordFileRemoved();
+      } else if (newScmEntry->getType() == TreeEntryType::TREE) {
+        ctx->recordFileRemoved();
+        addDryRunChange(nullptr, newScmEntry, dryRunChanges);
+      } else {
+        ctx->recordFileModified();
+      }
+      return nullptr;
+    }
   }
 
   // Bail out now if we aren't actually supposed to apply changes.
+  // The entry is identical to the old source control state, so the changes
+  // are exactly those between the old and new source control entries.
   if (!ctx->shouldApplyChanges()) {
+    addDryRunChange(oldScmEntry, newScmEntry, dryRunChanges);
     return nullptr;
   }
 
   // Update the entry
+  contents.assignReservedInodeNumbers();
   if (!newScmEntry) {
     contents.entries.erase(it);
   } else {
-    *entry = Entry{newScmEntry->getMode(), newScmEntry->getHash()};
+    entry = Entry{newScmEntry->getMode(), newScmEntry->getHash()};
+    addCheckoutPrefetch(ctx, name, oldScmEntry, newScmEntry, false);
   }
 
   // Note that we intentionally don't bother calling
@@ -2190,6 +2712,68 @@ unique_ptr<CheckoutAction> TreeInode::processCheckoutEntry(
   return nullptr;
 }
 
+void TreeInode::addCheckoutPrefetch(
+    CheckoutContext* ctx,
+    PathComponentPiece name,
+    const TreeEntry* oldScmEntry,
+    const TreeEntry* newScmEntry,
+    bool wasRead) {
+  auto* prefetcher = ctx->getPrefetcher();
+  if (!prefetcher || !newScmEntry) {
+    return;
+  }
+  if (oldScmEntry && oldScmEntry->getType() == newScmEntry->getType() &&
+      oldScmEntry->getHash() == newScmEntry->getHash()) {
+    return;
+  }
+
+  auto isTree = newScmEntry->getType() == TreeEntryType::TREE;
+  if (wasRead) {
+    // Loaded directories are handled by their own checkout() call
+    if (!isTree) {
+      prefetcher->addReadFile(newScmEntry->getHash());
+    }
+    return;
+  }
+
+  // Only compute the path if it will be matched against globs.  We hold the
+  // rename lock, so the path cannot change during the checkout.
+  if (!prefetcher->hasGlobs()) {
+    return;
+  }
+  auto myPath = getPath();
+  if (!myPath.hasValue()) {
+    return;
+  }
+  auto path = myPath.value() + name;
+  if (isTree) {
+    prefetcher->addUnreadTree(path, oldScmEntry, *newScmEntry);
+  } else {
+    prefetcher->addUnreadFile(path, newScmEntry->getHash());
+  }
+}
+
+Future<InodePtr> TreeInode::addCheckoutLoad(
+    PathComponentPiece name,
+    vector<CheckoutLoad>* checkoutLoads) {
+  checkoutLoads->push_back(CheckoutLoad{PathComponent{name}, {}});
+  return checkoutLoads->back().promise.getFuture();
+}
+
+void TreeInode::addDryRunChange(
+    const TreeEntry* oldScmEntry,
+    const TreeEntry* newScmEntry,
+    vector<DryRunChange>* dryRunChanges) {
+  DryRunChange change;
+  if (oldScmEntry) {
+    change.oldEntry = *oldScmEntry;
+  }
+  if (newScmEntry) {
+    change.newEntry = *newScmEntry;
+  }
+  dryRunChanges->push_back(std::move(change));
+}
+
 Future<Unit> TreeInode::checkoutUpdateEntry(
     CheckoutContext* ctx,
     PathComponentPiece name,
@@ -2213,7 +2797,7 @@ Future<Unit> TreeInode::checkoutUpdateEntry(
           << inode->getLogPath();
       return folly::makeFuture<Unit>(bug.toException());
     }
-    if (it->second->inode != inode.get()) {
+    if (it->second.inode != inode.get()) {
       auto bug = EDEN_BUG()
           << "entry changed while holding rename lock during checkout: "
           << inode->getLogPath();
@@ -2223,19 +2807,20 @@ Future<Unit> TreeInode::checkoutUpdateEntry(
     // This is a file, so we can simply unlink it, and replace/remove the entry
     // as desired.
     deletedInode = inode->markUnlinked(this, name, ctx->renameLock());
+    contents->assignReservedInodeNumbers();
     if (newScmEntry) {
       DCHECK_EQ(newScmEntry->getName(), name);
-      it->second =
-          make_unique<Entry>(newScmEntry->getMode(), newScmEntry->getHash());
+      it->second = Entry{newScmEntry->getMode(), newScmEntry->getHash()};
     } else {
       contents->entries.erase(it);
     }
 
     // Tell FUSE to invalidate its cache for this entry.
-    auto* fuseChannel = getMount()->getFuseChannel();
-    if (fuseChannel) {
-      fuseChannel->invalidateEntry(getNodeId(), name);
-    }
+    //
+    // This is queued rather than sent immediately: sending the notification
+    // can block behind kernel locks, and we are holding our contents lock.
+    // EdenMount::checkout() waits for the queue to drain before returning.
+    invalidateEntryForCheckout(ctx, name);
 
     // We don't save our own overlay data right now:
     // we'll wait to do that until the checkout operation finishes touching all
@@ -2281,9 +2866,9 @@ Future<Unit> TreeInode::checkoutUpdateEntry(
     // Add the new entry
     auto contents = parentInode->contents_.wlock();
     DCHECK_EQ(TreeEntryType::BLOB, newEntry->getType());
-    auto newTreeEntry =
-        make_unique<Entry>(newEntry->getMode(), newEntry->getHash());
-    auto ret = contents->entries.emplace(name, std::move(newTreeEntry));
+    contents->assignReservedInodeNumbers();
+    auto ret = contents->entries.emplace(
+        name, newEntry->getMode(), newEntry->getHash());
     if (!ret.second) {
       // Hmm.  Someone else already created a new entry in this location
       // before we had a chance to add our new entry.  We don't block new file
@@ -2303,6 +2888,20 @@ Future<Unit> TreeInode::checkoutUpdateEntry(
   });
 }
 
+void TreeInode::invalidateEntryForCheckout(
+    CheckoutContext* ctx,
+    PathComponentPiece name) {
+  ++ctx->getProgress()->inodesInvalidated;
+  auto* queue = getMount()->getInvalidationQueue();
+  auto loc = getLocationInfo(ctx->renameLock());
+  if (loc.parent && !loc.unlinked) {
+    queue->invalidateEntry(
+        getNodeId(), name, loc.parent->getNodeId(), loc.name);
+  } else {
+    queue->invalidateEntry(getNodeId(), name);
+  }
+}
+
 void TreeInode::saveOverlayPostCheckout(
     CheckoutContext* ctx,
     const Tree* tree) {
@@ -2346,14 +2945,14 @@ void TreeInode::saveOverlayPostCheckout(
         // operation.)  Even if the child is still identical to its source
         // control state we still want to make sure we are materialized if the
         // child is.
-        if (inodeIter->second->isMaterialized()) {
+        if (inodeIter->second.isMaterialized()) {
           return true;
         }
 
         // If if the child is not materialized, it is the same as some source
         // control object.  However, if it isn't the same as the object in our
         // Tree, we have to materialize ourself.
-        if (inodeIter->second->getHash() != scmIter->getHash()) {
+        if (inodeIter->second.getHash() != scmIter->getHash()) {
           return true;
         }
       }
@@ -2437,7 +3036,12 @@ bool TreeInode::checkoutTryRemoveEmptyDir(CheckoutContext* ctx) {
 
   auto errnoValue = location.parent->tryRemoveChild(
       ctx->renameLock(), location.name, inodePtrFromThis());
-  return errnoValue == 0;
+  if (errnoValue != 0) {
+    return false;
+  }
+
+  location.parent->invalidateEntryForCheckout(ctx, location.name);
+  return true;
 }
 
 namespace {
@@ -2453,7 +3057,7 @@ folly::Future<folly::Unit> recursivelyLoadMaterializedChildren(
 }
 
 folly::Future<InodePtr> TreeInode::loadChildLocked(
-    Dir& /* contents */,
+    Dir& contents,
     PathComponentPiece name,
     Entry* entry,
     std::vector<IncompleteInodeLoad>* pendingLoads) {
@@ -2463,6 +3067,11 @@ folly::Future<InodePtr> TreeInode::loadChildLocked(
   fuse_ino_t childNumber;
   folly::Promise<InodePtr> promise;
   auto future = promise.getFuture();
+  if (!entry->hasInodeNumber() && contents.reservedInodeBase != 0) {
+    // Adopt the number that readdir() reported for this entry.
+    entry->setInodeNumber(
+        contents.getReservedInodeNumber(contents.entries.find(name)));
+  }
   if (entry->hasInodeNumber()) {
     childNumber = entry->getInodeNumber();
     startLoad = getInodeMap()->shouldLoadChild(
@@ -2497,21 +3106,21 @@ folly::Future<folly::Unit> TreeInode::loadMaterializedChildren() {
 
     for (auto& entry : contents->entries) {
       const auto& name = entry.first;
-      const auto& ent = entry.second;
-      if (!ent->isMaterialized()) {
+      auto& ent = entry.second;
+      if (!ent.isMaterialized()) {
         continue;
       }
 
-      if (ent->inode) {
+      if (ent.inode) {
         // We generally don't expect any inodes to be loaded already
         LOG(WARNING)
             << "found already-loaded inode for materialized child "
-            << ent->inode->getLogPath()
+            << ent.inode->getLogPath()
             << " when performing initial loading of materialized inodes";
         continue;
       }
 
-      auto future = loadChildLocked(*contents, name, ent.get(), &pendingLoads);
+      auto future = loadChildLocked(*contents, name, &ent, &pendingLoads);
       inodeFutures.emplace_back(std::move(future));
     }
   }
@@ -2542,22 +3151,22 @@ void TreeInode::unloadChildrenNow() {
     auto inodeMapLock = inodeMap->lockForUnload();
 
     for (auto& entry : contents->entries) {
-      if (!entry.second->inode) {
+      if (!entry.second.inode) {
         continue;
       }
 
-      auto* asTree = dynamic_cast<TreeInode*>(entry.second->inode);
+      auto* asTree = dynamic_cast<TreeInode*>(entry.second.inode);
       if (asTree) {
         treeChildren.push_back(TreeInodePtr::newPtrLocked(asTree));
       } else {
-        if (entry.second->inode->isPtrAcquireCountZero()) {
+        if (entry.second.inode->isPtrAcquireCountZero()) {
           // Unload the inode
           inodeMap->unloadInode(
-              entry.second->inode, this, entry.first, false, inodeMapLock);
+              entry.second.inode, this, entry.first, false, inodeMapLock);
           // Record that we should now delete this inode after releasing
           // the locks.
-          toDelete.push_back(entry.second->inode);
-          entry.second->inode = nullptr;
+          toDelete.push_back(entry.second.inode);
+          entry.second.inode = nullptr;
         }
       }
     }
@@ -2575,6 +3184,126 @@ void TreeInode::unloadChildrenNow() {
   // all of our children trees, which may result in them being destroyed.
 }
 
+size_t TreeInode::unloadChildrenLastAccessedBefore(
+    std::chrono::steady_clock::time_point cutoff) {
+  // Recurse into children directories first, so that idle descendants are
+  // unloaded before we decide whether their parents can be unloaded.
+  size_t numUnloaded = 0;
+  {
+    std::vector<TreeInodePtr> treeChildren;
+    {
+      auto contents = contents_.wlock();
+      for (const auto& entry : contents->entries) {
+        auto* asTree = dynamic_cast<TreeInode*>(entry.second.inode);
+        if (asTree) {
+          // Visiting the child must not count as an access, otherwise it
+          // would never look idle when we check it below.
+          treeChildren.push_back(TreeInodePtr::newPtrLockedNoAccess(asTree));
+        }
+      }
+    }
+    for (auto& child : treeChildren) {
+      numUnloaded += child->unloadChildrenLastAccessedBefore(cutoff);
+    }
+    // treeChildren is destroyed here, releasing our references to the
+    // children before we check them for unloading below.
+  }
+
+  struct UnloadCandidate {
+    PathComponentPiece name;
+    Entry* entry;
+    // For TreeInode candidates, the inode numbers allocated to its children.
+    std::vector<fuse_ino_t> childNumbers;
+  };
+
+  std::vector<InodeBase*> toDelete;
+  auto* inodeMap = getInodeMap();
+  {
+    auto contents = contents_.wlock();
+
+    // First find the children that look idle.  This checks each child's
+    // materialization state, which requires acquiring the child's own lock,
+    // so this must be done before we acquire the InodeMap lock.
+    std::vector<UnloadCandidate> candidates;
+    for (auto& entry : contents->entries) {
+      auto* child = entry.second.inode;
+      if (!child || !child->isPtrAcquireCountZero() ||
+          child->getLastAccessTime() >= cutoff) {
+        continue;
+      }
+
+      UnloadCandidate candidate{entry.first, &entry.second, {}};
+      auto* asTree = dynamic_cast<TreeInode*>(child);
+      if (asTree) {
+        auto childContents = asTree->contents_.rlock();
+        if (childContents->materialized) {
+          continue;
+        }
+        bool hasLoadedChildren = false;
+        for (const auto& childEntry : childContents->entries) {
+          if (childEntry.second.inode) {
+            hasLoadedChildren = true;
+            break;
+          }
+          if (childEntry.second.hasInodeNumber()) {
+            candidate.childNumbers.push_back(
+                childEntry.second.getInodeNumber());
+          }
+        }
+        if (hasLoadedChildren) {
+          continue;
+        }
+      } else {
+        auto* asFile = dynamic_cast<FileInode*>(child);
+        if (!asFile || !asFile->getBlobHash().hasValue()) {
+          // Never unload materialized files.
+          continue;
+        }
+      }
+      candidates.push_back(std::move(candidate));
+    }
+
+    if (candidates.empty()) {
+      return numUnloaded;
+    }
+
+    // Now acquire the InodeMap lock and re-check each candidate.  Nobody can
+    // acquire a new reference to these children while we hold both our
+    // contents_ lock and the InodeMap lock.  Any access since the checks
+    // above would have updated the child's last access time.
+    auto inodeMapLock = inodeMap->lockForUnload();
+    for (auto& candidate : candidates) {
+      auto* child = candidate.entry->inode;
+      if (!child->isPtrAcquireCountZero() ||
+          child->getFuseRefcount() != 0 ||
+          child->getLastAccessTime() >= cutoff) {
+        continue;
+      }
+      bool childNumbersInUse = false;
+      for (auto number : candidate.childNumbers) {
+        if (inodeMap->isInodeRemembered(number, inodeMapLock)) {
+          childNumbersInUse = true;
+          break;
+        }
+      }
+      if (childNumbersInUse) {
+        continue;
+      }
+
+      inodeMap->unloadInode(child, this, candidate.name, false, inodeMapLock);
+      toDelete.push_back(child);
+      candidate.entry->inode = nullptr;
+    }
+  }
+
+  // Delete the unloaded inodes only after releasing our locks.
+  for (auto* child : toDelete) {
+    delete child;
+  }
+  numUnloaded += toDelete.size();
+  return numUnloaded;
+}
+
 void TreeInode::getDebugStatus(vector<TreeInodeDebugInfo>& results) const {
   TreeInodeDebugInfo info;
   info.inodeNumber = getNodeId();
@@ -2592,20 +3321,20 @@ void TreeInode::getDebugStatus(vector<TreeInodeDebugInfo>& results) const {
     info.treeHash = thriftHash(contents->treeHash);
 
     for (const auto& entry : contents->entries) {
-      if (entry.second->inode) {
+      if (entry.second.inode) {
         // A child inode exists, so just grab an InodePtr and add it to the
         // childInodes list.  We will process all loaded children after
         // releasing our own contents_ lock (since we need to grab each child
         // Inode's own lock to get its data).
         childInodes.emplace_back(
-            entry.first, InodePtr::newPtrLocked(entry.second->inode));
+            entry.first, InodePtr::newPtrLocked(entry.second.inode));
       } else {
         // We can store data about unloaded entries immediately, since we have
         // the authoritative data ourself, and don't need to ask a separate
         // InodeBase object.
         info.entries.emplace_back();
         auto& infoEntry = info.entries.back();
-        auto* inodeEntry = entry.second.get();
+        const auto* inodeEntry = &entry.second;
         infoEntry.name = entry.first.stringPiece().str();
         if (inodeEntry->hasInodeNumber()) {
           infoEntry.inodeNumber = inodeEntry->getInodeNumber();
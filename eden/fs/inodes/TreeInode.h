@@ -11,6 +11,7 @@
 #include <folly/Optional.h>
 #include <folly/Portability.h>
 #include <folly/Synchronized.h>
+#include <limits>
 #include "eden/fs/inodes/InodeBase.h"
 #include "eden/fs/model/Hash.h"
 #include "eden/utils/PathMap.h"
@@ -75,7 +76,10 @@ class TreeInode : public InodeBase {
      * Create a hash for a materialized entry.
      */
     Entry(mode_t m, fuse_ino_t number, dev_t rdev = 0)
-        : mode(m), inodeNumber_{number}, rdev_(rdev) {}
+        : mode(m), rdev_(rdev), inodeNumber_{number} {
+      // FUSE only ever passes us 32-bit device numbers.
+      DCHECK_EQ(rdev_, rdev);
+    }
 
     Entry(Entry&& e) = default;
     Entry& operator=(Entry&& e) = default;
@@ -134,10 +138,6 @@ class TreeInode : public InodeBase {
      */
     bool isDirectory() const;
 
-    // TODO: Make mode private and provide an accessor method instead
-    /** The complete st_mode value for this entry */
-    mode_t mode{0};
-
     dev_t getRdev() const {
       // Callers should not check getRdev() if an inode is loaded.
       // If the child inode is loaded it is the authoritative source for
@@ -146,18 +146,24 @@ class TreeInode : public InodeBase {
       return rdev_;
     }
 
+    /*
+     * Entries are stored inline in Dir::entries, so the fields below are
+     * ordered to avoid padding.  Keep them that way when adding new fields:
+     * scanning a large directory touches every entry.
+     */
+
+    // TODO: Make mode private and provide an accessor method instead
+    /** The complete st_mode value for this entry */
+    mode_t mode{0};
+
    private:
     /**
-     * If the entry is not materialized, this contains the hash
-     * identifying the source control Tree (if this is a directory) or Blob
-     * (if this is a file) that contains the entry contents.
-     *
-     * If the entry is materialized, this field is not set.
+     * The value of the rdev field that we report in stat.
+     * This is used for mknod and thus for unix domain sockets.
      *
-     * TODO: If inode is set, this field generally should not be used, and the
-     * child InodeBase should be consulted instead.
-     */
-    folly::Optional<Hash> hash_;
+     * The FUSE protocol only carries 32 bits of rdev, so that is all we store.
+     **/
+    uint32_t rdev_{0};
 
     /**
      * The inode number, if one is allocated for this entry, or 0 if one is not
@@ -169,12 +175,6 @@ class TreeInode : public InodeBase {
      */
     fuse_ino_t inodeNumber_{0};
 
-    /**
-     * The value of the rdev field that we report in stat.
-     * This is used for mknod and thus for unix domain sockets.
-     **/
-    dev_t rdev_{0};
-
    public:
     // TODO: Make inode private and provide an accessor method instead
     /**
@@ -192,18 +192,70 @@ class TreeInode : public InodeBase {
      *   children, so it resets this pointer to null when it unloads the child.
      */
     InodeBase* inode{nullptr};
+
+   private:
+    /**
+     * If the entry is not materialized, this contains the hash
+     * identifying the source control Tree (if this is a directory) or Blob
+     * (if this is a file) that contains the entry contents.
+     *
+     * If the entry is materialized, this field is not set.
+     *
+     * TODO: If inode is set, this field generally should not be used, and the
+     * child InodeBase should be consulted instead.
+     */
+    folly::Optional<Hash> hash_;
   };
 
   /** Represents a directory in the overlay */
   struct Dir {
-    /** The direct children of this directory */
-    PathMap<std::unique_ptr<Entry>> entries;
+    /**
+     * The direct children of this directory.
+     *
+     * Entries are stored inline in the sorted vector rather than behind a
+     * pointer, so inserting or erasing an entry invalidates pointers and
+     * references to the other entries.  Never hold an Entry* across a
+     * modification of this map.
+     */
+    PathMap<Entry> entries;
     /** If the origin of this dir was a Tree, the hash of that tree */
     folly::Optional<Hash> treeHash;
 
     /** true if the dir has been materialized to the overlay.
      * If the contents match the original tree, this is false. */
     bool materialized{false};
+
+    /**
+     * The first of a block of inode numbers reserved for the entries of this
+     * directory, or 0 if no block is reserved.
+     *
+     * readdir() reserves a block the first time it lists a directory that
+     * has entries without inode numbers.  While the block is reserved, an
+     * entry without an inode number at index i of entries has the number
+     * reservedInodeBase + i.  This lets readdir() report numbers for entries
+     * that were never looked up while only holding a read lock, and without
+     * modifying the entries, and a later lookup adopts the same number.
+     *
+     * The numbers depend on the position of each entry, so
+     * assignReservedInodeNumbers() must be called before inserting, erasing
+     * or replacing entries.
+     */
+    fuse_ino_t reservedInodeBase{0};
+
+    /**
+     * Get the reserved inode number for the entry at iter, or 0 if there is
+     * no block reserved.  This should only be called for entries that do not
+     * have an inode number.
+     */
+    fuse_ino_t getReservedInodeNumber(
+        PathMap<Entry>::const_iterator iter) const;
+
+    /**
+     * Give each entry that does not have an inode number its reserved
+     * number, and release the block.  This does nothing if no block is
+     * reserved.
+     */
+    void assignReservedInodeNumbers();
   };
 
   /** Holds the results of a create operation.
@@ -264,8 +316,49 @@ class TreeInode : public InodeBase {
    */
   folly::Future<InodePtr> getChildRecursive(RelativePathPiece name);
 
+  /**
+   * Recursively look up a batch of child inodes.
+   *
+   * Each directory shared by several of the paths is only looked up once,
+   * and the children of each directory are loaded in parallel.  The returned
+   * vector holds the result for each path, in the same order as paths.  An
+   * error looking up one path does not affect the others.
+   *
+   * At most maxConcurrentLoads children are looked up at once across the
+   * whole batch, so a large batch cannot start loading every inode (and
+   * fetching every tree) at the same time.
+   */
+  folly::Future<std::vector<folly::Try<InodePtr>>> getChildrenRecursive(
+      std::vector<RelativePath> paths,
+      size_t maxConcurrentLoads = std::numeric_limits<size_t>::max());
+
   fuse_ino_t getChildInodeNumber(PathComponentPiece name);
 
+  /**
+   * Reserve a block of inode numbers for the entries of this directory, if
+   * one is not reserved already.  See Dir::reservedInodeBase.
+   *
+   * contents must be this inode's contents, locked for writing.
+   */
+  void reserveChildInodeNumbers(Dir& contents);
+
+  /**
+   * Get the attributes of a child entry for a readdirplus() reply.
+   *
+   * On success this also records a FUSE reference to the child, the same way
+   * lookup() does, since the kernel treats each entry of a readdirplus()
+   * reply as a lookup result.  The returned attributes have st_ino set to the
+   * child's inode number.
+   *
+   * Loaded children report their getattr() results.  Unloaded files that are
+   * not materialized are described using the blob metadata from the
+   * ObjectStore, without loading an inode for them.  Other unloaded entries
+   * would have to be loaded to stat them, so for these (and for entries that
+   * have been removed) this returns folly::none and records no reference.
+   */
+  folly::Future<folly::Optional<fusell::Dispatcher::Attr>>
+  getChildAttrForReaddir(PathComponentPiece name);
+
   folly::Future<std::shared_ptr<fusell::DirHandle>> opendir(
       const struct fuse_file_info& fi);
   folly::Future<folly::Unit> rename(
@@ -433,6 +526,23 @@ class TreeInode : public InodeBase {
    */
   void unloadChildrenNow();
 
+  /**
+   * Unload idle children under this tree (recursively).
+   *
+   * This unloads children inodes that are unreferenced, have no outstanding
+   * FUSE references, are not materialized, and have not been accessed since
+   * the specified cutoff time.  Children directories are processed before
+   * their parents, so an entire idle subtree can be unloaded in one call.
+   *
+   * A child TreeInode is only unloaded if none of its own children have inode
+   * numbers that are still known to the InodeMap, since those numbers would
+   * be lost when the tree is re-created from source control.
+   *
+   * Returns the number of inodes that were unloaded.
+   */
+  size_t unloadChildrenLastAccessedBefore(
+      std::chrono::steady_clock::time_point cutoff);
+
   /**
    * Load all materialized children underneath this TreeInode.
    *
@@ -492,6 +602,12 @@ class TreeInode : public InodeBase {
   class TreeRenameLocks;
   class IncompleteInodeLoad;
 
+  /**
+   * Give children the inode numbers restored by InodeMap::restore(), if this
+   * mount point was handed over to us by another process.
+   */
+  void restoreChildInodeNumbers();
+
   void registerInodeLoadComplete(
       folly::Future<std::unique_ptr<InodeBase>>& future,
       PathComponentPiece name,
@@ -508,6 +624,18 @@ class TreeInode : public InodeBase {
   folly::Future<std::unique_ptr<InodeBase>>
   startLoadingInode(Entry* entry, PathComponentPiece name, fuse_ino_t number);
 
+  /**
+   * Record a FUSE reference to an unloaded child whose attributes were
+   * computed by getChildAttrForReaddir().
+   *
+   * Returns false if the entry has since been removed, replaced, loaded, or
+   * materialized, in which case the attributes may be stale and no reference
+   * is recorded.
+   */
+  bool addUnloadedChildFuseReference(
+      PathComponentPiece name,
+      fuse_ino_t number);
+
   /**
    * Materialize this directory in the overlay.
    *
@@ -519,10 +647,22 @@ class TreeInode : public InodeBase {
   folly::Future<folly::Unit> doRename(
       TreeRenameLocks&& locks,
       PathComponentPiece srcName,
-      PathMap<std::unique_ptr<Entry>>::iterator srcIter,
+      PathMap<Entry>::iterator srcIter,
       TreeInodePtr destParent,
       PathComponentPiece destName);
 
+  /**
+   * Queue a kernel cache invalidation for one of our entries that was
+   * changed by a checkout operation.
+   *
+   * Our own location is passed along so that the InvalidationQueue can
+   * collapse many changed entries into a single invalidation of this
+   * directory.
+   */
+  void invalidateEntryForCheckout(
+      CheckoutContext* ctx,
+      PathComponentPiece name);
+
   /** Translates a Tree object from our store into a Dir object
    * used to track the directory in the inode */
   static Dir buildDirFromTree(const Tree* tree);
@@ -635,18 +775,64 @@ class TreeInode : public InodeBase {
       std::unique_ptr<GitIgnoreStack> ignore,
       bool isIgnored);
 
+  /**
+   * A change found by a checkout dry run for an entry with no loaded inode.
+   * The files it affects are counted once the contents_ lock is released.
+   */
+  struct DryRunChange {
+    folly::Optional<TreeEntry> oldEntry;
+    folly::Optional<TreeEntry> newEntry;
+  };
+
+  /**
+   * A child inode that a checkout action needs.  The load is started once
+   * the contents_ lock has been released, when the checkout's scheduler has
+   * room for it.
+   */
+  struct CheckoutLoad {
+    PathComponent name;
+    folly::Promise<InodePtr> promise;
+  };
+
+  /**
+   * Compute the actions needed to check out this directory.
+   *
+   * During a dry run, entries with no loaded inode are left unchanged, and
+   * are added to dryRunChanges instead.
+   */
   void computeCheckoutActions(
       CheckoutContext* ctx,
       const Tree* fromTree,
       const Tree* toTree,
       std::vector<std::unique_ptr<CheckoutAction>>* actions,
-      std::vector<IncompleteInodeLoad>* pendingLoads);
+      std::vector<CheckoutLoad>* checkoutLoads,
+      std::vector<DryRunChange>* dryRunChanges);
   std::unique_ptr<CheckoutAction> processCheckoutEntry(
       CheckoutContext* ctx,
       Dir& contents,
       const TreeEntry* oldScmEntry,
       const TreeEntry* newScmEntry,
-      std::vector<IncompleteInodeLoad>* pendingLoads);
+      std::vector<CheckoutLoad>* checkoutLoads,
+      std::vector<DryRunChange>* dryRunChanges);
+  static folly::Future<InodePtr> addCheckoutLoad(
+      PathComponentPiece name,
+      std::vector<CheckoutLoad>* checkoutLoads);
+
+  /**
+   * Tell the checkout's CheckoutPrefetcher, if any, about an entry that
+   * checkout is changing.  wasRead indicates if the entry had an inode
+   * number assigned before the checkout.
+   */
+  void addCheckoutPrefetch(
+      CheckoutContext* ctx,
+      PathComponentPiece name,
+      const TreeEntry* oldScmEntry,
+      const TreeEntry* newScmEntry,
+      bool wasRead);
+  static void addDryRunChange(
+      const TreeEntry* oldScmEntry,
+      const TreeEntry* newScmEntry,
+      std::vector<DryRunChange>* dryRunChanges);
   void saveOverlayPostCheckout(CheckoutContext* ctx, const Tree* tree);
 
   /**
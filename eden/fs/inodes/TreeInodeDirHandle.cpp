@@ -9,6 +9,8 @@
  */
 #include "TreeInodeDirHandle.h"
 
+#include <folly/Optional.h>
+#include <algorithm>
 #include "Overlay.h"
 #include "eden/fs/inodes/TreeInode.h"
 #include "eden/fs/model/Tree.h"
@@ -19,6 +21,86 @@ namespace eden {
 
 TreeInodeDirHandle::TreeInodeDirHandle(TreeInodePtr inode) : inode_(inode) {}
 
+fuse_ino_t TreeInodeDirHandle::getInodeNumber() {
+  return inode_->getNodeId();
+}
+
+namespace {
+/**
+ * Get the inode number to report for a child entry, without assigning one.
+ *
+ * Returns folly::none if the entry has not been assigned an inode number and
+ * the directory has no block of numbers reserved, or 0 if the entry has been
+ * removed since the snapshot was taken.
+ */
+folly::Optional<fuse_ino_t> findChildInodeNumber(
+    const TreeInode::Dir& contents,
+    folly::StringPiece name) {
+  auto iter = contents.entries.find(PathComponentPiece{name});
+  if (iter == contents.entries.end()) {
+    return fuse_ino_t{0};
+  }
+  const auto& entry = iter->second;
+  if (entry.inode) {
+    return entry.inode->getNodeId();
+  } else if (entry.hasInodeNumber()) {
+    return entry.getInodeNumber();
+  }
+  auto reservedNumber = contents.getReservedInodeNumber(iter);
+  if (reservedNumber != 0) {
+    return reservedNumber;
+  }
+  return folly::none;
+}
+}
+
+template <typename Fn>
+void TreeInodeDirHandle::forEachEntry(
+    const std::vector<Entry>& entries,
+    off_t off,
+    Fn&& fn) {
+  size_t idx = std::max<off_t>(off, 0);
+
+  // Returns false if it stopped at an entry that needs a block of inode
+  // numbers reserved first.
+  auto visitEntries = [&](const TreeInode::Dir& contents) {
+    for (; idx < entries.size(); ++idx) {
+      const auto& entry = entries[idx];
+      auto ino = entry.ino;
+      if (ino == 0) {
+        auto number = findChildInodeNumber(contents, entry.name);
+        if (!number.hasValue()) {
+          return false;
+        }
+        ino = number.value();
+        if (ino == 0) {
+          // This entry was removed after we took the snapshot.
+          continue;
+        }
+      }
+      if (!fn(entry, ino, idx)) {
+        break;
+      }
+    }
+    return true;
+  };
+
+  // Once a block of inode numbers is reserved for the directory, every entry
+  // has a number we can report while only holding a read lock.
+  if (visitEntries(*inode_->getContents().rlock())) {
+    return;
+  }
+
+  // Reserve a block of numbers for the directory's entries, so that readdir()
+  // reports the same number that a later lookup() adopts.  This is done once
+  // per directory rather than once per entry, and does not modify the
+  // entries themselves.
+  auto contents = inode_->getContents().wlock();
+  inode_->reserveChildInodeNumbers(*contents);
+  auto finished = visitEntries(*contents);
+  DCHECK(finished);
+}
+
 folly::Future<fusell::DirList> TreeInodeDirHandle::readdir(
     fusell::DirList&& list,
     off_t off) {
@@ -31,60 +113,15 @@ folly::Future<fusell::DirList> TreeInodeDirHandle::readdir(
   // DirList.
   // We need to return as soon as we have filled the available space in the
   // provided DirList object.
-
-  // The inode of this directory
-  auto dir_inode = inode_->getNodeId();
-
-  // It's pretty complicated to stitch together the directory contents
-  // while trying to skip around and respect the offset parameter.
-  // Let's go for the simple approach and see if that is good enough.
-  //
-  // There are three components to the DirList that we need to populate:
-  // 1. The "." and ".." entries
-  // 2. The overlay entries if we have any
-  // 3. The tree entries if we do not have an overlay entry for this dir.
   //
-  // We're going to build a vector of this combined information,
-  // then we can paginate sanely using the off parameter.
-
-  /** This struct is pretty lightweight and doesn't need to make any
-   * heap copies of names as we accumulate the view of the entries */
-  struct Entry {
-    const char* name;
-    dtype_t type;
-    /// If 0, look up/assign it based on name
-    fuse_ino_t ino;
-
-    Entry(const char* name, dtype_t type, fuse_ino_t ino = 0)
-        : name(name), type(type), ino(ino) {}
-  };
-  folly::fbvector<Entry> entries;
-
-  {
-    auto dir = inode_->getContents().rlock();
-    entries.reserve(2 /* "." and ".." */ + dir->entries.size());
-
-    // Reserved entries for linking to parent and self.
-    entries.emplace_back(".", dtype_t::Dir, dir_inode);
-    auto parent = inode_->getParentBuggy();
-    if (!parent) {
-      // For the root of the mount point, just add its own inode ID
-      // as its parent.
-      entries.emplace_back("..", dtype_t::Dir, dir_inode);
-    } else {
-      entries.emplace_back("..", dtype_t::Dir, parent->getNodeId());
-    }
-
-    for (const auto& entry : dir->entries) {
-      entries.emplace_back(
-          entry.first.value().c_str(), mode_to_dtype(entry.second->mode));
-    }
-  }
-
-  // And now the easy part: seek to the provided offset and fill up
-  // the DirList with the entries that remain.
-  auto entry_iter = entries.begin();
-  std::advance(entry_iter, off);
+  // The kernel only asks for a few KB of entries at a time, so rather than
+  // rebuilding the full entry list for every call we capture a snapshot of
+  // the directory when reading from the start, and serve the remaining calls
+  // from it.  The offset of each entry is simply its index in the snapshot,
+  // so seeking within the stream keeps working.  Entries added or removed
+  // after the snapshot was taken are picked up once the caller rewinds back
+  // to offset 0.
+  auto entries = getSnapshot(off);
 
   // The stat struct is only used by the fuse machinery to compute the type
   // of the entry so that it can report an appropriate DT_XXX type up to
@@ -96,27 +133,139 @@ folly::Future<fusell::DirList> TreeInodeDirHandle::readdir(
   struct stat st;
   memset(&st, 0, sizeof(st));
 
-  while (entry_iter < entries.end()) {
-    const auto& entry = *entry_iter;
-    st.st_ino = entry.ino;
-    st.st_mode = dtype_to_mode(entry.type);
-
-    if (st.st_ino == 0) {
-      // We haven't looked up its inode yet, do so now.
-      // We defer it from the first pass above in case we have a huge
-      // dir and need to paginate through it across several calls into
-      // this function.
-      st.st_ino = inode_->getChildInodeNumber(PathComponentPiece{entry.name});
+  forEachEntry(
+      *entries, off, [&](const Entry& entry, fuse_ino_t ino, size_t idx) {
+        st.st_ino = ino;
+        st.st_mode = dtype_to_mode(entry.type);
+        return list.add(entry.name, st, idx + 1);
+      });
+
+  return std::move(list);
+}
+
+folly::Future<fusell::DirList> TreeInodeDirHandle::readdirplus(
+    fusell::DirList&& list,
+    off_t off) {
+  // This returns the same entries as readdir(), from the same snapshot, along
+  // with the attributes of each entry so that the kernel does not need to
+  // send a lookup() for every entry afterwards.
+  //
+  // The kernel counts every entry returned with attributes as a lookup, so
+  // first pick the entries that fit in this reply, and only then ask for
+  // their attributes, which records a FUSE reference to each of them.
+  using AttrResult = folly::Optional<fusell::Dispatcher::Attr>;
+  struct PlusEntry {
+    PlusEntry(const Entry& ent, fuse_ino_t number, off_t offset)
+        : entry(ent), ino(number), off(offset) {}
+
+    Entry entry;
+    fuse_ino_t ino;
+    off_t off;
+  };
+  std::vector<PlusEntry> selected;
+  {
+    auto entries = getSnapshot(off);
+    size_t avail = list.getAvailable();
+    forEachEntry(
+        *entries, off, [&](const Entry& entry, fuse_ino_t ino, size_t idx) {
+          auto size = fusell::DirList::getPlusEntrySize(entry.name);
+          if (size > avail) {
+            return false;
+          }
+          avail -= size;
+          selected.emplace_back(entry, ino, idx + 1);
+          return true;
+        });
+  }
+
+  std::vector<folly::Future<AttrResult>> futures;
+  futures.reserve(selected.size());
+  for (const auto& plus : selected) {
+    if (plus.entry.ino != 0) {
+      // "." and "..": the kernel never looks these up through readdirplus()
+      // results, so report them without attributes.
+      futures.push_back(AttrResult{});
+    } else {
+      futures.push_back(inode_->getChildAttrForReaddir(
+          PathComponentPiece{plus.entry.name}));
     }
+  }
+
+  return folly::collectAll(futures).then([
+    list = std::move(list),
+    selected = std::move(selected)
+  ](std::vector<folly::Try<AttrResult>> results) mutable {
+    for (size_t n = 0; n < selected.size(); ++n) {
+      const auto& plus = selected[n];
+      fuse_entry_param param;
+      memset(&param, 0, sizeof(param));
+      const auto& result = results[n];
+      if (result.hasValue() && result.value().hasValue()) {
+        const auto& attr = result.value().value();
+        param.ino = attr.st.st_ino;
+        param.generation = 1;
+        param.attr = attr.st;
+        param.attr_timeout = attr.timeout;
+        param.entry_timeout = attr.timeout;
+      } else {
+        // Report just the name and type; the kernel will send a lookup()
+        // if it needs anything else.
+        if (result.hasException()) {
+          VLOG(3) << "unable to get attributes of " << plus.entry.name
+                  << " for readdirplus: " << result.exception().what();
+        }
+        param.attr.st_ino = plus.ino;
+        param.attr.st_mode = dtype_to_mode(plus.entry.type);
+      }
 
-    if (!list.add(entry.name, st, ++off)) {
-      break;
+      auto added = list.addPlus(plus.entry.name, param, plus.off);
+      DCHECK(added) << "readdirplus entry unexpectedly did not fit";
     }
+    return std::move(list);
+  });
+}
 
-    ++entry_iter;
+std::shared_ptr<const std::vector<TreeInodeDirHandle::Entry>>
+TreeInodeDirHandle::getSnapshot(off_t off) {
+  // The snapshot is never modified once built, so callers only hold the
+  // snapshot lock long enough to copy the pointer.
+  auto snapshot = snapshot_.wlock();
+  if (off == 0 || !*snapshot) {
+    *snapshot = std::make_shared<const std::vector<Entry>>(loadSnapshot());
   }
+  return *snapshot;
+}
 
-  return std::move(list);
+std::vector<TreeInodeDirHandle::Entry> TreeInodeDirHandle::loadSnapshot() {
+  // There are two components to the listing:
+  // 1. The "." and ".." entries
+  // 2. The entries in our TreeInode
+  std::vector<Entry> entries;
+
+  // The inode of this directory
+  auto dirInode = inode_->getNodeId();
+
+  auto dir = inode_->getContents().rlock();
+  entries.reserve(2 /* "." and ".." */ + dir->entries.size());
+
+  // Reserved entries for linking to parent and self.
+  entries.emplace_back(".", dtype_t::Dir, dirInode);
+  auto parent = inode_->getParentBuggy();
+  if (!parent) {
+    // For the root of the mount point, just add its own inode ID
+    // as its parent.
+    entries.emplace_back("..", dtype_t::Dir, dirInode);
+  } else {
+    entries.emplace_back("..", dtype_t::Dir, parent->getNodeId());
+  }
+
+  // Inode numbers for the children are looked up when they are returned,
+  // so that they reflect numbers assigned after the snapshot was taken.
+  for (const auto& entry : dir->entries) {
+    entries.emplace_back(
+        entry.first.stringPiece(), mode_to_dtype(entry.second.mode), 0);
+  }
+  return entries;
 }
 
 folly::Future<fusell::Dispatcher::Attr> TreeInodeDirHandle::setattr(
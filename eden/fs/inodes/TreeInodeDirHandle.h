@@ -8,8 +8,13 @@
  *
  */
 #pragma once
+#include <folly/FBString.h>
+#include <folly/Synchronized.h>
+#include <memory>
+#include <vector>
 #include "eden/fs/inodes/InodePtr.h"
 #include "eden/fuse/DirHandle.h"
+#include "eden/utils/DirType.h"
 
 namespace facebook {
 namespace eden {
@@ -18,8 +23,12 @@ class TreeInodeDirHandle : public fusell::DirHandle {
  public:
   explicit TreeInodeDirHandle(TreeInodePtr inode);
 
+  fuse_ino_t getInodeNumber() override;
   folly::Future<fusell::DirList> readdir(fusell::DirList&& list, off_t off)
       override;
+  folly::Future<fusell::DirList> readdirplus(
+      fusell::DirList&& list,
+      off_t off) override;
 
   folly::Future<fusell::Dispatcher::Attr> setattr(
       const struct stat& attr,
@@ -28,7 +37,54 @@ class TreeInodeDirHandle : public fusell::DirHandle {
   folly::Future<fusell::Dispatcher::Attr> getattr() override;
 
  private:
+  /**
+   * A directory entry captured by readdir().
+   */
+  struct Entry {
+    Entry(folly::StringPiece name, dtype_t type, fuse_ino_t ino)
+        : name(name), type(type), ino(ino) {}
+
+    folly::fbstring name;
+    dtype_t type;
+    /**
+     * Only set for "." and "..".  Child entries are looked up by name when
+     * they are returned, since they may be assigned an inode number (or
+     * removed) after the snapshot was taken.
+     */
+    fuse_ino_t ino;
+  };
+
+  /**
+   * Get the snapshot to serve a read at the specified offset from, building
+   * a new one when reading from the start.
+   */
+  std::shared_ptr<const std::vector<Entry>> getSnapshot(off_t off);
+
+  /**
+   * Call fn(entry, ino, idx) for each entry of the snapshot starting at
+   * offset off, until it returns false.  ino is the inode number to report
+   * for the entry.  Entries that have been removed since the snapshot was
+   * taken are skipped.
+   *
+   * Children that do not have an inode number yet are reported with a number
+   * from the directory's reserved block (see TreeInode::Dir), which a later
+   * lookup() adopts.
+   */
+  template <typename Fn>
+  void forEachEntry(const std::vector<Entry>& entries, off_t off, Fn&& fn);
+
+  /**
+   * Build the list of entries to return, including "." and "..".
+   */
+  std::vector<Entry> loadSnapshot();
+
   TreeInodePtr inode_;
+
+  /**
+   * The directory listing being returned to the caller.  This is built when
+   * reading from offset 0, and reused to serve the following pages.
+   */
+  folly::Synchronized<std::shared_ptr<const std::vector<Entry>>> snapshot_;
 };
 }
 }
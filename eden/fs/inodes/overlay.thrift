@@ -41,3 +41,18 @@ enum UserStatusDirective {
 struct DirstateData {
   1: map<RelativePath, UserStatusDirective> directives
 }
+
+// An inode number that the kernel knows about, recorded so that another
+// process can continue serving the mount point during a graceful restart.
+struct SerializedInodeMapEntry {
+  1: i64 inodeNumber
+  2: i64 parentInode
+  3: PathComponent name
+  // The number of lookups the kernel has not yet forgotten.
+  4: i64 numFuseReferences
+}
+
+struct SerializedInodeMap {
+  1: i64 nextInodeNumber
+  2: list<SerializedInodeMapEntry> entries
+}
@@ -0,0 +1,152 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/inodes/CheckoutScheduler.h"
+
+#include <folly/futures/ManualExecutor.h>
+#include <gtest/gtest.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace facebook::eden;
+using folly::Future;
+using folly::Promise;
+using folly::Unit;
+using Priority = CheckoutScheduler::Priority;
+
+namespace {
+/**
+ * Schedules jobs that stay running until they are explicitly completed.
+ */
+class TestJobs {
+ public:
+  explicit TestJobs(std::shared_ptr<CheckoutScheduler> scheduler)
+      : scheduler_{std::move(scheduler)} {}
+
+  Future<Unit> add(Priority priority, std::string name) {
+    return scheduler_->schedule(priority, [this, name]() {
+      started_.push_back(name);
+      running_.emplace_back();
+      return running_.back().getFuture();
+    });
+  }
+
+  /** Complete the oldest running job. */
+  void completeOne() {
+    auto promise = std::move(running_.front());
+    running_.pop_front();
+    promise.setValue();
+  }
+
+  const std::vector<std::string>& getStarted() const {
+    return started_;
+  }
+
+ private:
+  std::shared_ptr<CheckoutScheduler> scheduler_;
+  std::deque<Promise<Unit>> running_;
+  std::vector<std::string> started_;
+};
+}
+
+TEST(CheckoutScheduler, limitsJobsInFlight) {
+  auto executor = std::make_shared<folly::ManualExecutor>();
+  auto scheduler = std::make_shared<CheckoutScheduler>(2, 2, nullptr, executor);
+  TestJobs jobs{scheduler};
+
+  std::vector<Future<Unit>> futures;
+  for (int n = 0; n < 5; ++n) {
+    futures.push_back(jobs.add(Priority::TREE_FETCH, std::to_string(n)));
+  }
+  EXPECT_EQ(2, scheduler->getNumRunning());
+  EXPECT_EQ(3, scheduler->getNumPending());
+  EXPECT_EQ(2, jobs.getStarted().size());
+
+  jobs.completeOne();
+  EXPECT_TRUE(futures[0].isReady());
+  EXPECT_EQ(2, scheduler->getNumRunning());
+  EXPECT_EQ(2, scheduler->getNumPending());
+
+  // The next job has been given the free slot, but it starts on the
+  // executor rather than in the thread that completed the previous job.
+  EXPECT_EQ(2, jobs.getStarted().size());
+  executor->drain();
+  EXPECT_EQ(3, jobs.getStarted().size());
+
+  for (int n = 0; n < 4; ++n) {
+    jobs.completeOne();
+    executor->drain();
+  }
+  EXPECT_EQ(0, scheduler->getNumRunning());
+  EXPECT_EQ(0, scheduler->getNumPending());
+  for (auto& future : futures) {
+    EXPECT_TRUE(future.isReady());
+  }
+  EXPECT_EQ(
+      (std::vector<std::string>{"0", "1", "2", "3", "4"}), jobs.getStarted());
+}
+
+TEST(CheckoutScheduler, priorityOrder) {
+  auto executor = std::make_shared<folly::ManualExecutor>();
+  auto scheduler = std::make_shared<CheckoutScheduler>(1, 1, nullptr, executor);
+  TestJobs jobs{scheduler};
+
+  jobs.add(Priority::BLOB_FETCH, "first");
+  jobs.add(Priority::BLOB_FETCH, "blob");
+  jobs.add(Priority::INODE_LOAD, "inode");
+  jobs.add(Priority::TREE_FETCH, "tree");
+  EXPECT_EQ(3, scheduler->getNumPending());
+
+  for (int n = 0; n < 4; ++n) {
+    jobs.completeOne();
+    executor->drain();
+  }
+  EXPECT_EQ(
+      (std::vector<std::string>{"first", "tree", "inode", "blob"}),
+      jobs.getStarted());
+}
+
+TEST(CheckoutScheduler, yieldsWhileBusy) {
+  bool busy = true;
+  auto executor = std::make_shared<folly::ManualExecutor>();
+  auto scheduler = std::make_shared<CheckoutScheduler>(
+      4, 1, [&busy] { return busy; }, executor);
+  TestJobs jobs{scheduler};
+
+  for (int n = 0; n < 4; ++n) {
+    jobs.add(Priority::TREE_FETCH, std::to_string(n));
+  }
+  EXPECT_EQ(1, scheduler->getNumRunning());
+  EXPECT_EQ(3, scheduler->getNumPending());
+
+  // Once the interactive traffic stops, the next free slot lets the
+  // remaining jobs start.
+  busy = false;
+  jobs.completeOne();
+  EXPECT_EQ(3, scheduler->getNumRunning());
+  EXPECT_EQ(0, scheduler->getNumPending());
+  executor->drain();
+  EXPECT_EQ(4, jobs.getStarted().size());
+}
+
+TEST(CheckoutScheduler, failedJobReleasesSlot) {
+  auto executor = std::make_shared<folly::ManualExecutor>();
+  auto scheduler = std::make_shared<CheckoutScheduler>(1, 1, nullptr, executor);
+  auto failed = scheduler->schedule(Priority::TREE_FETCH, []() -> Unit {
+    throw std::runtime_error("fetch failed");
+  });
+  EXPECT_TRUE(failed.isReady());
+  EXPECT_TRUE(failed.hasException());
+  EXPECT_EQ(0, scheduler->getNumRunning());
+
+  auto next = scheduler->schedule(Priority::TREE_FETCH, []() { return 5; });
+  ASSERT_TRUE(next.isReady());
+  EXPECT_EQ(5, next.get());
+}
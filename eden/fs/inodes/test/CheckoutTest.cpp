@@ -10,8 +10,11 @@
 #include <folly/Array.h>
 #include <folly/Conv.h>
 #include <folly/test/TestUtils.h>
+#include <gflags/gflags.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "eden/fs/inodes/CheckoutContext.h"
+#include "eden/fs/inodes/CheckoutPrefetcher.h"
 #include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/FileInode.h"
 #include "eden/fs/inodes/TreeInode.h"
@@ -31,6 +34,9 @@ using folly::Unit;
 using std::string;
 using testing::UnorderedElementsAre;
 
+DECLARE_bool(checkout_prefetch);
+DECLARE_string(checkout_prefetch_globs);
+
 namespace {
 
 /**
@@ -349,6 +355,40 @@ TEST(Checkout, modifyFile) {
   runModifyFileTests("a/b/zzz.txt");
 }
 
+TEST(Checkout, modifyFileWithoutLoadingBlobs) {
+  // Checkout should never need the contents of the old or new blobs for an
+  // unmodified file, whether or not its inode is loaded.
+  for (auto loadType : kAllLoadTypes) {
+    SCOPED_TRACE(folly::to<string>("load type ", loadType));
+    auto builder1 = FakeTreeBuilder();
+    builder1.setFile("readme.txt", "just filling out the tree\n");
+    builder1.setFile("a/b/test.txt", "contents v1\n");
+    TestMount testMount{builder1};
+
+    // Mark the new trees ready, but leave the new blob unavailable.
+    auto builder2 = builder1.clone();
+    builder2.replaceFile("a/b/test.txt", "contents v2\n");
+    builder2.finalize(testMount.getBackingStore(), false);
+    builder2.setReady("");
+    builder2.setReady("a");
+    builder2.setReady("a/b");
+    auto commit2 = testMount.getBackingStore()->putCommit("2", builder2);
+    commit2->setReady();
+
+    loadInodes(testMount, "a/b/test.txt", loadType, "contents v1\n");
+
+    auto checkoutResult =
+        testMount.getEdenMount()->checkout(makeTestHash("2"));
+    ASSERT_TRUE(checkoutResult.isReady());
+    EXPECT_EQ(0, checkoutResult.get().size());
+
+    // Reading the file will need the new blob.
+    builder2.setReady("a/b/test.txt");
+    auto postInode = testMount.getFileInode("a/b/test.txt");
+    EXPECT_FILE_INODE(postInode, "contents v2\n", 0644);
+  }
+}
+
 void testModifyConflict(
     folly::StringPiece path,
     LoadBehavior loadType,
@@ -573,6 +613,151 @@ TEST(Checkout, removeSubdirectorySimple) {
   }
 }
 
+void testDryRun(LoadBehavior loadType, bool force) {
+  auto builder1 = FakeTreeBuilder();
+  builder1.setFile("readme.txt", "just filling out the tree\n");
+  builder1.setFile("c.txt", "to be removed\n");
+  builder1.setFile("a/test.txt", "test contents\n");
+  builder1.setFile("a/b/x.txt", "x contents\n");
+  builder1.setFile("a/b/y.txt", "y contents\n");
+  TestMount testMount{builder1};
+  auto originalCommit = testMount.getEdenMount()->getSnapshotID();
+
+  auto builder2 = builder1.clone();
+  builder2.removeFile("c.txt");
+  builder2.replaceFile("a/test.txt", "new test contents\n");
+  builder2.replaceFile("a/b/x.txt", "new x contents\n");
+  builder2.setFile("new/dir/1.txt", "one\n");
+  builder2.setFile("new/dir/2.txt", "two\n");
+  builder2.finalize(testMount.getBackingStore(), true);
+  auto commit2 = testMount.getBackingStore()->putCommit("2", builder2);
+  commit2->setReady();
+
+  loadInodes(testMount, "a/b/x.txt", loadType, "x contents\n");
+  // Locally modify a file that is also changed in the new commit
+  testMount.overwriteFile("a/test.txt", "local edit\n");
+
+  auto dryRunFuture =
+      testMount.getEdenMount()->checkoutDryRun(makeTestHash("2"), force);
+  ASSERT_TRUE(dryRunFuture.isReady());
+  auto result = dryRunFuture.get();
+  EXPECT_THAT(
+      result.conflicts,
+      UnorderedElementsAre(makeConflict(ConflictType::MODIFIED, "a/test.txt")));
+  EXPECT_EQ(2, result.filesAdded);
+  EXPECT_EQ(force ? 2 : 1, result.filesModified);
+  EXPECT_EQ(1, result.filesRemoved);
+
+  // Nothing should have changed
+  EXPECT_EQ(originalCommit, testMount.getEdenMount()->getSnapshotID());
+  EXPECT_FILE_INODE(testMount.getFileInode("c.txt"), "to be removed\n", 0644);
+  EXPECT_FILE_INODE(
+      testMount.getFileInode("a/test.txt"), "local edit\n", 0644);
+  EXPECT_FILE_INODE(
+      testMount.getFileInode("a/b/x.txt"), "x contents\n", 0644);
+  EXPECT_THROW_ERRNO(testMount.getTreeInode("new"), ENOENT);
+
+  // A real checkout should report the same conflicts
+  auto checkoutResult =
+      testMount.getEdenMount()->checkout(makeTestHash("2"), force);
+  ASSERT_TRUE(checkoutResult.isReady());
+  EXPECT_THAT(
+      checkoutResult.get(),
+      UnorderedElementsAre(makeConflict(ConflictType::MODIFIED, "a/test.txt")));
+}
+
+TEST(Checkout, dryRun) {
+  for (auto loadType : kAllLoadTypes) {
+    for (bool force : {true, false}) {
+      SCOPED_TRACE(
+          folly::to<string>("load type ", loadType, " force=", force));
+      testDryRun(loadType, force);
+    }
+  }
+}
+
+TEST(Checkout, progress) {
+  auto builder1 = FakeTreeBuilder();
+  builder1.setFile("readme.txt", "just filling out the tree\n");
+  builder1.setFile("a/test.txt", "test contents\n");
+  builder1.setFile("a/b/x.txt", "x contents\n");
+  TestMount testMount{builder1};
+  EXPECT_EQ(nullptr, testMount.getEdenMount()->getCheckoutProgress());
+  // Load the inodes so that checkout has to recurse into each directory
+  testMount.getFileInode("a/b/x.txt");
+
+  // Leave the new trees unavailable so the checkout stays in progress
+  auto builder2 = builder1.clone();
+  builder2.replaceFile("a/test.txt", "new test contents\n");
+  builder2.setFile("a/b/y.txt", "y contents\n");
+  builder2.finalize(testMount.getBackingStore(), false);
+  auto commit2 = testMount.getBackingStore()->putCommit("2", builder2);
+  commit2->setReady();
+
+  auto checkoutResult = testMount.getEdenMount()->checkout(makeTestHash("2"));
+  EXPECT_FALSE(checkoutResult.isReady());
+  auto progress = testMount.getEdenMount()->getCheckoutProgress();
+  ASSERT_NE(nullptr, progress);
+  EXPECT_FALSE(progress->finished);
+
+  builder2.setAllReady();
+  ASSERT_TRUE(checkoutResult.isReady());
+  EXPECT_EQ(0, checkoutResult.get().size());
+
+  EXPECT_TRUE(progress->finished);
+  EXPECT_EQ(nullptr, testMount.getEdenMount()->getCheckoutProgress());
+  // The root, "a", and "a/b" trees differ between the two commits
+  EXPECT_EQ(3, progress->treesCompared.load());
+  // There is at least one action each for "a" and "a/b"
+  EXPECT_LE(2, progress->actionsStarted.load());
+  EXPECT_EQ(
+      progress->actionsStarted.load(), progress->actionsCompleted.load());
+}
+
+TEST(Checkout, prefetchChangedFiles) {
+  gflags::FlagSaver flagSaver;
+  FLAGS_checkout_prefetch = true;
+  FLAGS_checkout_prefetch_globs = "**/*.h";
+
+  auto builder1 = FakeTreeBuilder();
+  builder1.setFile("readme.txt", "just filling out the tree\n");
+  builder1.setFile("src/main.cpp", "main v1\n");
+  builder1.setFile("src/other.cpp", "other v1\n");
+  builder1.setFile("src/util.h", "util v1\n");
+  builder1.setFile("lib/a.h", "a v1\n");
+  TestMount testMount{builder1};
+  // Read src/main.cpp, but nothing else
+  testMount.getFileInode("src/main.cpp");
+
+  // Leave the new blobs unavailable, so the prefetch stays pending
+  auto builder2 = builder1.clone();
+  builder2.replaceFile("src/main.cpp", "main v2\n");
+  builder2.replaceFile("src/other.cpp", "other v2\n");
+  builder2.replaceFile("src/util.h", "util v2\n");
+  builder2.replaceFile("lib/a.h", "a v2\n");
+  builder2.setFile("lib/b.cpp", "b v2\n");
+  builder2.finalize(testMount.getBackingStore(), false);
+  builder2.setReady("");
+  builder2.setReady("src");
+  builder2.setReady("lib");
+  auto commit2 = testMount.getBackingStore()->putCommit("2", builder2);
+  commit2->setReady();
+
+  auto checkoutResult = testMount.getEdenMount()->checkout(makeTestHash("2"));
+  ASSERT_TRUE(checkoutResult.isReady());
+  EXPECT_EQ(0, checkoutResult.get().size());
+
+  auto prefetcher = testMount.getEdenMount()->getCheckoutPrefetcher();
+  ASSERT_NE(nullptr, prefetcher);
+  EXPECT_EQ(0, prefetcher->getNumBlobsFetched());
+
+  // src/main.cpp was read, src/util.h matches the glob, and lib/a.h matches
+  // the glob inside a directory that was never loaded.  src/other.cpp and
+  // lib/b.cpp are neither.
+  builder2.setAllReady();
+  EXPECT_EQ(3, prefetcher->getNumBlobsFetched());
+}
+
 // TODO:
 // - remove subdirectory
 //   - with no untracked/ignored files, it should get removed entirely
@@ -10,7 +10,9 @@
 #include <folly/ExceptionWrapper.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/FileInode.h"
+#include "eden/fs/inodes/GitIgnoreCache.h"
 #include "eden/fs/inodes/InodeDiffCallback.h"
 #include "eden/fs/inodes/TreeInode.h"
 #include "eden/fs/testharness/FakeTreeBuilder.h"
@@ -930,6 +932,61 @@ TEST(DiffTest, ignoreFileModified) {
       result.getModified(), UnorderedElementsAre(RelativePath{"a/.gitignore"}));
 }
 
+// Parsed .gitignore files are cached across diff operations.  Make sure the
+// cached rules are shared between identical files and are never used once a
+// file has been modified.
+TEST(DiffTest, ignoreFileCached) {
+  DiffTest test({
+      {"a/.gitignore", "foo.txt\n"},
+      {"b/.gitignore", "foo.txt\n"},
+  });
+
+  test.getMount().addFile("a/foo.txt", "test\n");
+  test.getMount().addFile("b/foo.txt", "test\n");
+
+  auto result = test.diff(true);
+  EXPECT_THAT(result.getErrors(), UnorderedElementsAre());
+  EXPECT_THAT(result.getUntracked(), UnorderedElementsAre());
+  EXPECT_THAT(
+      result.getIgnored(),
+      UnorderedElementsAre(
+          RelativePath{"a/foo.txt"}, RelativePath{"b/foo.txt"}));
+
+  // Both directories use the same blob, so only one entry should be cached
+  auto* cache = test.getMount().getEdenMount()->getGitIgnoreCache();
+  EXPECT_EQ(1, cache->getEntryCount());
+
+  // Modify the file several times, diffing after each change.
+  test.getMount().overwriteFile("a/.gitignore", "bar.txt\n");
+  result = test.diff(true);
+  EXPECT_THAT(result.getErrors(), UnorderedElementsAre());
+  EXPECT_THAT(
+      result.getUntracked(), UnorderedElementsAre(RelativePath{"a/foo.txt"}));
+  EXPECT_THAT(
+      result.getIgnored(), UnorderedElementsAre(RelativePath{"b/foo.txt"}));
+  EXPECT_EQ(2, cache->getEntryCount());
+
+  test.getMount().overwriteFile("a/.gitignore", "foo.txt\n");
+  result = test.diff(true);
+  EXPECT_THAT(result.getErrors(), UnorderedElementsAre());
+  EXPECT_THAT(result.getUntracked(), UnorderedElementsAre());
+  EXPECT_THAT(
+      result.getIgnored(),
+      UnorderedElementsAre(
+          RelativePath{"a/foo.txt"}, RelativePath{"b/foo.txt"}));
+  // The entry for the previous generation of a/.gitignore is replaced
+  EXPECT_EQ(2, cache->getEntryCount());
+
+  // Diffing again without changes must give the same results
+  result = test.diff(true);
+  EXPECT_THAT(result.getErrors(), UnorderedElementsAre());
+  EXPECT_THAT(result.getUntracked(), UnorderedElementsAre());
+  EXPECT_THAT(
+      result.getIgnored(),
+      UnorderedElementsAre(
+          RelativePath{"a/foo.txt"}, RelativePath{"b/foo.txt"}));
+}
+
 // Make sure the code ignores .gitignore directories
 TEST(DiffTest, ignoreFileIsDirectory) {
   DiffTest test({
@@ -43,11 +43,11 @@ TEST(HgStatus, toString) {
 void verifyExpectedDirstate(
     const Dirstate* dirstate,
     const std::map<std::string, StatusCode>& expectedStatus) {
-  EXPECT_EQ(expectedStatus, dirstate->getStatus(true).entries);
+  EXPECT_EQ(expectedStatus, dirstate->getStatus(true).get().entries);
 }
 
 void verifyEmptyDirstate(const Dirstate* dirstate) {
-  auto status = dirstate->getStatus(true);
+  auto status = dirstate->getStatus(true).get();
   EXPECT_THAT(status.entries, UnorderedElementsAre())
       << "Expected dirstate to be empty.";
 }
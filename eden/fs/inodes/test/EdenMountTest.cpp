@@ -11,6 +11,7 @@
 #include <gtest/gtest.h>
 #include "eden/fs/config/ClientConfig.h"
 #include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/InodeMap.h"
 #include "eden/fs/inodes/TreeInode.h"
 #include "eden/fs/journal/Journal.h"
 #include "eden/fs/journal/JournalDelta.h"
@@ -19,6 +20,7 @@
 #include "eden/fs/testharness/TestChecks.h"
 #include "eden/fs/testharness/TestMount.h"
 #include "eden/fs/testharness/TestUtil.h"
+#include "eden/utils/test/TestChecks.h"
 
 namespace facebook {
 namespace eden {
@@ -67,5 +69,72 @@ TEST(EdenMount, resetCommit) {
   EXPECT_FILE_INODE(testMount.getFileInode("src/test.c"), "testy tests", 0644);
   EXPECT_FALSE(testMount.hasFileAt("src/extra.h"));
 }
+
+TEST(EdenMount, getInodes) {
+  auto builder = FakeTreeBuilder();
+  builder.setFile("src/main.c", "int main() { return 0; }\n");
+  builder.setFile("src/test.c", "testy tests");
+  builder.setFile("src/lib/util.c", "utilities");
+  builder.setFile("doc/readme.txt", "all the words");
+  TestMount testMount{builder};
+  const auto& edenMount = testMount.getEdenMount();
+
+  std::vector<RelativePath> paths{
+      RelativePath{"src/test.c"},
+      RelativePath{"doc/readme.txt"},
+      RelativePath{""},
+      RelativePath{"src/lib/util.c"},
+      RelativePath{"src/missing.c"},
+      RelativePath{"src"},
+      RelativePath{"doc/readme.txt/child"},
+      RelativePath{"src/main.c"},
+      RelativePath{"src/test.c"},
+  };
+  auto results = edenMount->getInodes(paths).get();
+  ASSERT_EQ(paths.size(), results.size());
+
+  // Each successful result should be the same inode that getInode() returns
+  for (size_t n = 0; n < paths.size(); ++n) {
+    if (n == 4 || n == 6) {
+      continue;
+    }
+    ASSERT_TRUE(results[n].hasValue()) << "error looking up " << paths[n];
+    EXPECT_EQ(testMount.getInode(paths[n]).get(), results[n].value().get())
+        << "wrong inode for " << paths[n];
+  }
+  EXPECT_EQ(edenMount->getRootInode().get(), results[2].value().get());
+  EXPECT_THROW_ERRNO(results[4].value(), ENOENT);
+  EXPECT_THROW_ERRNO(results[6].value(), ENOTDIR);
+}
+
+TEST(EdenMount, getInodesLimitsConcurrentLoads) {
+  auto builder = FakeTreeBuilder();
+  builder.setFile("a/x.txt", "x");
+  builder.setFile("b/y.txt", "y");
+  TestMount testMount{builder, false};
+  const auto& edenMount = testMount.getEdenMount();
+  auto* inodeMap = edenMount->getInodeMap();
+
+  std::vector<RelativePath> paths{
+      RelativePath{"a/x.txt"}, RelativePath{"b/y.txt"},
+  };
+  auto future = edenMount->getInodes(paths, 1);
+  EXPECT_FALSE(future.isReady());
+
+  // Only "a" is being loaded, so "b" stays unloaded even once its Tree is
+  // available.
+  auto loadedBefore = inodeMap->getInodeCounts().loadedInodeCount;
+  builder.setReady("b");
+  EXPECT_EQ(loadedBefore, inodeMap->getInodeCounts().loadedInodeCount);
+  EXPECT_FALSE(future.isReady());
+
+  // Once "a" finishes loading the rest of the lookups can proceed.
+  builder.setReady("a");
+  ASSERT_TRUE(future.isReady());
+  auto results = future.get();
+  ASSERT_EQ(2, results.size());
+  EXPECT_EQ(RelativePath{"a/x.txt"}, results[0].value()->getPath());
+  EXPECT_EQ(RelativePath{"b/y.txt"}, results[1].value()->getPath());
+}
 }
 }
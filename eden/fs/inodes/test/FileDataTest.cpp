@@ -0,0 +1,114 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/inodes/FileData.h"
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+#include "eden/fs/inodes/FileInode.h"
+#include "eden/fs/model/Hash.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+#include "eden/fuse/BufVec.h"
+#include "eden/fuse/fuse_headers.h"
+
+using namespace facebook::eden;
+using folly::StringPiece;
+
+namespace {
+std::string bufVecToString(const fusell::BufVec& buf) {
+  std::string result;
+  for (const auto& iov : buf.getIov()) {
+    result.append(static_cast<const char*>(iov.iov_base), iov.iov_len);
+  }
+  return result;
+}
+
+class FileDataTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FakeTreeBuilder builder;
+    builder.setFile("src/test.txt", "this is a test file\n");
+    mount_.initialize(builder);
+  }
+
+  TestMount mount_;
+};
+}
+
+TEST_F(FileDataTest, readBlobData) {
+  auto inode = mount_.getFileInode("src/test.txt");
+  auto data = inode->getOrLoadData();
+  data->ensureDataLoaded().get();
+
+  auto buf = data->read(4, 5);
+  EXPECT_FALSE(buf.hasFileDescriptors());
+  EXPECT_EQ("is a", bufVecToString(buf));
+
+  EXPECT_EQ("", bufVecToString(data->read(100, 100)));
+}
+
+TEST_F(FileDataTest, readMaterializedDataFromFileDescriptor) {
+  mount_.overwriteFile("src/test.txt", "materialized contents\n");
+
+  auto inode = mount_.getFileInode("src/test.txt");
+  auto data = inode->getOrLoadData();
+  data->ensureDataLoaded().get();
+
+  auto buf = data->read(8, 13);
+  // Materialized data is not copied into memory until it is needed
+  EXPECT_TRUE(buf.hasFileDescriptors());
+  EXPECT_EQ("contents", bufVecToString(buf));
+  EXPECT_FALSE(buf.hasFileDescriptors());
+
+  // Reads past the end of the file are truncated
+  EXPECT_EQ("contents\n", bufVecToString(data->read(100, 13)));
+  EXPECT_EQ("", bufVecToString(data->read(100, 1000)));
+}
+
+TEST_F(FileDataTest, sha1TracksModifications) {
+  auto sha1 = [](StringPiece contents) {
+    return Hash::sha1(folly::ByteRange{contents});
+  };
+
+  auto inode = mount_.getFileInode("src/test.txt");
+  EXPECT_EQ(sha1("this is a test file\n"), inode->getSHA1().get());
+
+  auto data = inode->getOrLoadData();
+  data->materializeForWrite(0).get();
+  EXPECT_EQ(sha1("this is a test file\n"), inode->getSHA1().get());
+
+  // Appends
+  data->write("more data\n", 20);
+  EXPECT_EQ(sha1("this is a test file\nmore data\n"), inode->getSHA1().get());
+  data->write("even more\n", 30);
+  EXPECT_EQ(
+      sha1("this is a test file\nmore data\neven more\n"),
+      inode->getSHA1().get());
+
+  // An overwrite in the middle of the file
+  data->write("THIS", 0);
+  EXPECT_EQ(
+      sha1("THIS is a test file\nmore data\neven more\n"),
+      inode->getSHA1().get());
+
+  // Truncation, followed by appends to the empty file
+  struct stat attr = {};
+  attr.st_size = 0;
+  data->setAttr(attr, FUSE_SET_ATTR_SIZE);
+  EXPECT_EQ(sha1(""), inode->getSHA1().get());
+  data->write("new", 0);
+  data->write(" contents", 3);
+  EXPECT_EQ(sha1("new contents"), inode->getSHA1().get());
+
+  // Truncation to a non-empty size
+  attr.st_size = 3;
+  data->setAttr(attr, FUSE_SET_ATTR_SIZE);
+  EXPECT_EQ(sha1("new"), inode->getSHA1().get());
+}
@@ -0,0 +1,165 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <fcntl.h>
+#include <folly/Benchmark.h>
+#include <folly/Exception.h>
+#include <folly/File.h>
+#include <folly/FileUtil.h>
+#include <folly/Optional.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/FileData.h"
+#include "eden/fs/inodes/FileHandle.h"
+#include "eden/fs/inodes/FileInode.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+#include "eden/fuse/BufVec.h"
+
+/*
+ * Measures the throughput of cat-style sequential reads through the FUSE
+ * read path: repeatedly call FileHandle::read() for large chunks until EOF
+ * and push each reply into a pipe, the same way the FUSE library delivers
+ * reply data to /dev/fuse.
+ *
+ * For materialized files the reply is spliced from the overlay file, as is
+ * done when the FUSE connection has SPLICE_WRITE enabled.  The "copy"
+ * variant reads into a userspace buffer first, which is what the read path
+ * did before splice support.
+ */
+
+using namespace facebook::eden;
+using folly::StringPiece;
+
+DEFINE_uint64(file_size, 64 * 1024 * 1024, "size of the file to read");
+DEFINE_uint64(read_size, 128 * 1024, "size of each read request");
+
+namespace {
+
+class PipeSink {
+ public:
+  PipeSink() : devNull_("/dev/null", O_WRONLY) {
+    int fds[2];
+    folly::checkUnixError(pipe(fds), "failed to create pipe");
+    readEnd_ = folly::File(fds[0], true);
+    writeEnd_ = folly::File(fds[1], true);
+    // Make the pipe big enough to hold a full reply, like libfuse does.
+    fcntl(writeEnd_.fd(), F_SETPIPE_SZ, FLAGS_read_size);
+  }
+
+  /** Push one read reply through the pipe.  Returns the number of bytes. */
+  size_t send(const fusell::BufVec& buf, bool splice) {
+    size_t total = 0;
+#ifdef FUSE_CAP_SPLICE_WRITE
+    if (splice && buf.hasFileDescriptors()) {
+      for (const auto& fb : buf.getFuseBufs()) {
+        if (fb.flags & FUSE_BUF_IS_FD) {
+          loff_t pos = fb.pos;
+          auto res = ::splice(
+              fb.fd, &pos, writeEnd_.fd(), nullptr, fb.size, SPLICE_F_MOVE);
+          folly::checkUnixError(res, "splice from file failed");
+          total += res;
+        } else {
+          auto res = folly::writeFull(writeEnd_.fd(), fb.mem, fb.size);
+          folly::checkUnixError(res, "write to pipe failed");
+          total += res;
+        }
+      }
+      drain(total);
+      return total;
+    }
+#endif
+    // getIov() reads any file descriptor backed data into memory first.
+    auto iov = buf.getIov();
+    auto res = folly::writevFull(writeEnd_.fd(), iov.data(), iov.size());
+    folly::checkUnixError(res, "writev to pipe failed");
+    total = res;
+    drain(total);
+    return total;
+  }
+
+ private:
+  void drain(size_t size) {
+    while (size > 0) {
+      auto res = ::splice(
+          readEnd_.fd(), nullptr, devNull_.fd(), nullptr, size, SPLICE_F_MOVE);
+      folly::checkUnixError(res, "splice to /dev/null failed");
+      size -= res;
+    }
+  }
+
+  folly::File devNull_;
+  folly::File readEnd_;
+  folly::File writeEnd_;
+};
+
+struct ReadFixture {
+  explicit ReadFixture(bool materialize) {
+    std::string contents(FLAGS_file_size, 'x');
+    FakeTreeBuilder builder;
+    builder.setFile("big_file", contents);
+    mount.initialize(builder);
+    if (materialize) {
+      mount.overwriteFile("big_file", contents);
+    }
+
+    fuse_file_info info{};
+    info.flags = O_RDONLY;
+    auto inode = mount.getFileInode("big_file");
+    handle = std::dynamic_pointer_cast<FileHandle>(inode->open(info).get());
+  }
+
+  TestMount mount;
+  std::shared_ptr<FileHandle> handle;
+  PipeSink sink;
+};
+
+void catFile(size_t iters, bool materialize, bool splice) {
+  folly::Optional<ReadFixture> fixture;
+  BENCHMARK_SUSPEND {
+    fixture.emplace(materialize);
+  }
+
+  for (size_t n = 0; n < iters; ++n) {
+    off_t off = 0;
+    while (true) {
+      auto buf = fixture->handle->read(FLAGS_read_size, off).get();
+      auto len = fixture->sink.send(buf, splice);
+      if (len == 0) {
+        break;
+      }
+      off += len;
+    }
+    folly::doNotOptimizeAway(off);
+  }
+
+  BENCHMARK_SUSPEND {
+    fixture.clear();
+  }
+}
+}
+
+BENCHMARK(cat_blob, iters) {
+  catFile(iters, false, false);
+}
+
+BENCHMARK_RELATIVE(cat_materialized_copy, iters) {
+  catFile(iters, true, false);
+}
+
+BENCHMARK_RELATIVE(cat_materialized_splice, iters) {
+  catFile(iters, true, true);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -13,6 +13,10 @@
 #include <folly/Format.h>
 #include <folly/String.h>
 #include <gtest/gtest.h>
+#include <map>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
 #include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/FileInode.h"
 #include "eden/fs/inodes/TreeInode.h"
@@ -25,6 +29,22 @@
 using namespace facebook::eden;
 using folly::StringPiece;
 
+namespace {
+/**
+ * Index the entries saved by InodeMap::save() by inode number, since they
+ * are not recorded in any particular order.
+ */
+std::map<int64_t, std::tuple<int64_t, std::string, int64_t>> savedEntries(
+    const overlay::SerializedInodeMap& inodeMap) {
+  std::map<int64_t, std::tuple<int64_t, std::string, int64_t>> result;
+  for (const auto& entry : inodeMap.entries) {
+    result[entry.inodeNumber] = std::make_tuple(
+        entry.parentInode, entry.name, entry.numFuseReferences);
+  }
+  return result;
+}
+}
+
 TEST(InodeMap, invalidInodeNumber) {
   FakeTreeBuilder builder;
   builder.setFile("Makefile", "all:\necho success\n");
@@ -71,6 +91,40 @@ TEST(InodeMap, simpleLookups) {
       inodeMap->lookupTreeInode(noop->getNodeId()).get(), ENOTDIR);
 }
 
+TEST(InodeMap, concurrentAllocation) {
+  FakeTreeBuilder builder;
+  builder.setFile("README", "docs go here\n");
+  TestMount testMount{builder};
+  auto* inodeMap = testMount.getEdenMount()->getInodeMap();
+
+  // Allocate inode numbers from several threads at once, and make sure
+  // that every number handed out is unique.
+  constexpr size_t kNumThreads = 8;
+  constexpr size_t kPerThread = 1000;
+  std::vector<std::vector<fuse_ino_t>> results(kNumThreads);
+  std::vector<std::thread> threads;
+  for (size_t n = 0; n < kNumThreads; ++n) {
+    threads.emplace_back([&, n] {
+      for (size_t i = 0; i < kPerThread; ++i) {
+        results[n].push_back(inodeMap->allocateInodeNumber());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::unordered_set<fuse_ino_t> allNumbers;
+  for (const auto& numbers : results) {
+    for (auto number : numbers) {
+      EXPECT_GT(number, FUSE_ROOT_ID);
+      EXPECT_TRUE(allNumbers.insert(number).second) << "duplicate inode "
+                                                     << number;
+    }
+  }
+  EXPECT_EQ(kNumThreads * kPerThread, allNumbers.size());
+}
+
 TEST(InodeMap, asyncLookup) {
   auto builder = FakeTreeBuilder();
   builder.setFile("README", "docs go here\n");
@@ -279,3 +333,205 @@ TEST(InodeMap, renameDuringRecursiveLookupAndLoad) {
   EXPECT_EQ(
       RelativePathPiece{"a/b/x/d/file.txt"}, fileInode->getPath().value());
 }
+
+TEST(InodeMap, unloadIdleInodes) {
+  FakeTreeBuilder builder;
+  builder.setFile("Makefile", "all:\necho success\n");
+  builder.setFile("src/noop.c", "int main() { return 0; }\n");
+  TestMount testMount{builder};
+  auto* inodeMap = testMount.getEdenMount()->getInodeMap();
+  auto root = testMount.getEdenMount()->getRootInode();
+
+  fuse_ino_t srcNumber;
+  fuse_ino_t noopNumber;
+  {
+    auto noop = testMount.getFileInode("src/noop.c");
+    noopNumber = noop->getNodeId();
+    srcNumber = testMount.getTreeInode("src")->getNodeId();
+  }
+  auto countBefore = inodeMap->getInodeCounts().loadedInodeCount;
+
+  // Nothing should be unloaded if the cutoff is older than the last access.
+  auto past = std::chrono::steady_clock::now() - std::chrono::hours(1);
+  EXPECT_EQ(0, root->unloadChildrenLastAccessedBefore(past));
+  EXPECT_TRUE(inodeMap->lookupLoadedInode(noopNumber));
+
+  // Unreferenced inodes that have not been accessed since the cutoff should
+  // be unloaded, including the parent directory.
+  auto future = std::chrono::steady_clock::now() + std::chrono::hours(1);
+  EXPECT_EQ(2, root->unloadChildrenLastAccessedBefore(future));
+  EXPECT_FALSE(inodeMap->lookupLoadedInode(noopNumber));
+  EXPECT_FALSE(inodeMap->lookupLoadedInode(srcNumber));
+  EXPECT_EQ(countBefore - 2, inodeMap->getInodeCounts().loadedInodeCount);
+
+  // The inodes can be loaded again by name afterwards.  The "src" directory
+  // keeps its inode number since it is recorded in the root directory entry.
+  auto src = testMount.getTreeInode("src");
+  EXPECT_EQ(srcNumber, src->getNodeId());
+  auto noop = testMount.getFileInode("src/noop.c");
+  EXPECT_EQ(RelativePath{"src/noop.c"}, noop->getPath());
+}
+
+TEST(InodeMap, unloadIdleDirectories) {
+  FakeTreeBuilder builder;
+  builder.setFile("src/lib/noop.c", "int main() { return 0; }\n");
+  TestMount testMount{builder};
+  auto* inodeMap = testMount.getEdenMount()->getInodeMap();
+  auto root = testMount.getEdenMount()->getRootInode();
+
+  fuse_ino_t srcNumber;
+  fuse_ino_t libNumber;
+  fuse_ino_t noopNumber;
+  {
+    noopNumber = testMount.getFileInode("src/lib/noop.c")->getNodeId();
+    libNumber = testMount.getTreeInode("src/lib")->getNodeId();
+    srcNumber = testMount.getTreeInode("src")->getNodeId();
+  }
+
+  auto countBefore = inodeMap->getInodeCounts().loadedInodeCount;
+
+  // Every inode above was last accessed before this cutoff.
+  auto cutoff = std::chrono::steady_clock::now();
+
+  // A sweep with an older cutoff unloads nothing, and must not itself count
+  // as an access to the directories it walks.  (Don't use lookupLoadedInode()
+  // to check this, since that does count as an access.)
+  auto past = cutoff - std::chrono::hours(1);
+  EXPECT_EQ(0, root->unloadChildrenLastAccessedBefore(past));
+  EXPECT_EQ(countBefore, inodeMap->getInodeCounts().loadedInodeCount);
+
+  // The idle directories are unloaded along with the file.
+  EXPECT_EQ(3, root->unloadChildrenLastAccessedBefore(cutoff));
+  EXPECT_EQ(countBefore - 3, inodeMap->getInodeCounts().loadedInodeCount);
+  EXPECT_FALSE(inodeMap->lookupLoadedInode(noopNumber));
+  EXPECT_FALSE(inodeMap->lookupLoadedInode(libNumber));
+  EXPECT_FALSE(inodeMap->lookupLoadedInode(srcNumber));
+}
+
+TEST(InodeMap, unloadIdleInodesSkipsReferenced) {
+  FakeTreeBuilder builder;
+  builder.setFile("src/noop.c", "int main() { return 0; }\n");
+  TestMount testMount{builder};
+  auto* inodeMap = testMount.getEdenMount()->getInodeMap();
+  auto root = testMount.getEdenMount()->getRootInode();
+
+  auto noop = testMount.getFileInode("src/noop.c");
+  auto future = std::chrono::steady_clock::now() + std::chrono::hours(1);
+  EXPECT_EQ(0, root->unloadChildrenLastAccessedBefore(future));
+  EXPECT_TRUE(inodeMap->lookupLoadedInode(noop->getNodeId()));
+}
+
+TEST(InodeMap, saveAndRestore) {
+  FakeTreeBuilder builder;
+  builder.setFile("Makefile", "all:\necho success\n");
+  builder.setFile("src/noop.c", "int main() { return 0; }\n");
+  builder.setFile("src/test.c", "int main() { return 1; }\n");
+  TestMount testMount{builder};
+  auto* inodeMap = testMount.getEdenMount()->getInodeMap();
+
+  // Give the kernel references to some of the inodes.  "src/test.c" is
+  // loaded but has no FUSE references, so it should not be saved.
+  fuse_ino_t makefileNumber;
+  fuse_ino_t srcNumber;
+  fuse_ino_t noopNumber;
+  overlay::SerializedInodeMap saved;
+  {
+    auto makefile = testMount.getFileInode("Makefile");
+    makefile->incFuseRefcount();
+    makefileNumber = makefile->getNodeId();
+    auto src = testMount.getTreeInode("src");
+    src->incFuseRefcount();
+    srcNumber = src->getNodeId();
+    auto noop = testMount.getFileInode("src/noop.c");
+    noop->incFuseRefcount();
+    noop->incFuseRefcount();
+    noopNumber = noop->getNodeId();
+    testMount.getFileInode("src/test.c");
+    noop.reset();
+
+    // Unload the files in "src", so that both loaded and unloaded inodes
+    // are saved.
+    src->unloadChildrenNow();
+    EXPECT_FALSE(inodeMap->lookupLoadedInode(noopNumber));
+
+    saved = inodeMap->save();
+  }
+
+  auto expected = savedEntries(saved);
+  ASSERT_EQ(3, expected.size());
+  EXPECT_EQ(
+      std::make_tuple(int64_t{FUSE_ROOT_ID}, std::string{"Makefile"}, 1),
+      expected[makefileNumber]);
+  EXPECT_EQ(
+      std::make_tuple(int64_t{FUSE_ROOT_ID}, std::string{"src"}, 1),
+      expected[srcNumber]);
+  EXPECT_EQ(
+      std::make_tuple(
+          static_cast<int64_t>(srcNumber), std::string{"noop.c"}, 2),
+      expected[noopNumber]);
+
+  testMount.remount(saved);
+  inodeMap = testMount.getEdenMount()->getInodeMap();
+
+  // The restored inodes are all unloaded, with their FUSE reference counts.
+  auto restored = inodeMap->save();
+  EXPECT_EQ(expected, savedEntries(restored));
+  EXPECT_LE(saved.nextInodeNumber, restored.nextInodeNumber);
+
+  // Loading an inode by number loads its parents, which give their children
+  // the inode numbers they had before.
+  auto noop = inodeMap->lookupInode(noopNumber).get();
+  EXPECT_EQ(RelativePath{"src/noop.c"}, noop->getPath());
+  EXPECT_EQ(srcNumber, testMount.getTreeInode("src")->getNodeId());
+  EXPECT_EQ(makefileNumber, testMount.getFileInode("Makefile")->getNodeId());
+
+  // Inodes that were not saved get new numbers that cannot collide with the
+  // restored ones.
+  auto test = testMount.getFileInode("src/test.c");
+  EXPECT_LE(saved.nextInodeNumber, test->getNodeId());
+
+  // The loaded inodes still have their FUSE reference counts.
+  EXPECT_EQ(expected, savedEntries(inodeMap->save()));
+}
+
+TEST(InodeMap, saveFailsWithUnlinkedOpenFile) {
+  FakeTreeBuilder builder;
+  builder.setFile("Makefile", "all:\necho success\n");
+  builder.setFile("src/noop.c", "int main() { return 0; }\n");
+  TestMount testMount{builder};
+  auto* inodeMap = testMount.getEdenMount()->getInodeMap();
+
+  // Keep src/noop.c open in the kernel, then delete it.
+  auto makefile = testMount.getFileInode("Makefile");
+  makefile->incFuseRefcount();
+  auto makefileNumber = makefile->getNodeId();
+  makefile.reset();
+  auto noop = testMount.getFileInode("src/noop.c");
+  noop->incFuseRefcount();
+  auto noopNumber = noop->getNodeId();
+  noop.reset();
+  testMount.getTreeInode("src")->unlink(PathComponentPiece{"noop.c"}).get();
+  EXPECT_TRUE(inodeMap->lookupLoadedInode(noopNumber));
+
+  // The new process could not find the unlinked file, so the takeover must
+  // not proceed.
+  EXPECT_THROW(inodeMap->save(), std::runtime_error);
+
+  // Once the kernel releases the file the mount can be handed over.
+  inodeMap->decFuseRefcount(noopNumber);
+  EXPECT_FALSE(inodeMap->lookupLoadedInode(noopNumber));
+  auto saved = inodeMap->save();
+  auto expected = savedEntries(saved);
+  ASSERT_EQ(1, expected.size());
+  EXPECT_EQ(
+      std::make_tuple(int64_t{FUSE_ROOT_ID}, std::string{"Makefile"}, 1),
+      expected[makefileNumber]);
+
+  testMount.remount(saved);
+  inodeMap = testMount.getEdenMount()->getInodeMap();
+  EXPECT_EQ(expected, savedEntries(inodeMap->save()));
+  EXPECT_EQ(
+      RelativePath{"Makefile"},
+      inodeMap->lookupInode(makefileNumber).get()->getPath());
+  EXPECT_FALSE(testMount.hasFileAt("src/noop.c"));
+}
@@ -0,0 +1,307 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/Optional.h>
+#include <gflags/gflags.h>
+#include <linux/fuse.h>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/InodeDiffCallback.h"
+#include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/inodes/TreeInodeDirHandle.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+#include "eden/fuse/DirList.h"
+
+/*
+ * Measures operations that scan or search the entries of a single large
+ * directory: lookup by name, readdir, and diff.
+ *
+ * The *_boxed benchmarks use the previous TreeInode::Dir layout, where each
+ * Entry was a separate heap allocation, and compare it against entries stored
+ * inline in the PathMap.  The treeinode_* and listDirectory benchmarks run
+ * the real code paths against a TestMount.
+ */
+
+using namespace facebook::eden;
+using folly::StringPiece;
+using std::vector;
+
+DEFINE_uint64(num_entries, 10000, "number of entries in the directory");
+
+namespace {
+
+using InlineEntries = PathMap<TreeInode::Entry>;
+using BoxedEntries = PathMap<std::unique_ptr<TreeInode::Entry>>;
+
+const Hash kBlobHash{"0123456789abcdef0123456789abcdef01234567"};
+
+vector<PathComponent> buildNames(size_t numEntries = FLAGS_num_entries) {
+  vector<PathComponent> names;
+  names.reserve(numEntries);
+  for (size_t n = 0; n < numEntries; ++n) {
+    // Alternate between names short enough to be stored inline in the
+    // fbstring and longer names that require a separate allocation.
+    if (n % 2) {
+      names.emplace_back(folly::to<std::string>("file", n, ".cpp"));
+    } else {
+      names.emplace_back(
+          folly::to<std::string>("SomeLongerGeneratedFileName", n, ".java"));
+    }
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+/** Returns the names in a random order, to look them up in. */
+vector<PathComponent> shuffledNames(const vector<PathComponent>& names) {
+  auto shuffled = names;
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937{});
+  return shuffled;
+}
+
+InlineEntries buildInline(const vector<PathComponent>& names) {
+  InlineEntries entries;
+  entries.reserve(names.size());
+  for (const auto& name : names) {
+    entries.emplace(name, S_IFREG | 0644, kBlobHash);
+  }
+  return entries;
+}
+
+BoxedEntries buildBoxed(const vector<PathComponent>& names) {
+  // Allocate the entries in a random order, the way they end up scattered
+  // around the heap after a directory has been modified for a while.
+  vector<std::unique_ptr<TreeInode::Entry>> allocated(names.size());
+  vector<size_t> order(names.size());
+  for (size_t n = 0; n < order.size(); ++n) {
+    order[n] = n;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937{});
+  for (auto idx : order) {
+    allocated[idx] =
+        std::make_unique<TreeInode::Entry>(S_IFREG | 0644, kBlobHash);
+  }
+
+  BoxedEntries entries;
+  for (size_t n = 0; n < names.size(); ++n) {
+    entries.emplace(names[n], std::move(allocated[n]));
+  }
+  return entries;
+}
+
+const TreeInode::Entry& deref(const TreeInode::Entry& entry) {
+  return entry;
+}
+const TreeInode::Entry& deref(const std::unique_ptr<TreeInode::Entry>& entry) {
+  return *entry;
+}
+
+template <typename Entries>
+void scanEntries(size_t iters, const Entries& entries) {
+  for (size_t n = 0; n < iters; ++n) {
+    size_t numChanged = 0;
+    for (const auto& entry : entries) {
+      const auto& ent = deref(entry.second);
+      numChanged += ent.isMaterialized() || ent.getHash() != kBlobHash;
+    }
+    folly::doNotOptimizeAway(numChanged);
+  }
+}
+
+template <typename Entries>
+void lookupEntries(
+    size_t iters,
+    const Entries& entries,
+    const vector<PathComponent>& names) {
+  size_t idx = 0;
+  for (size_t n = 0; n < iters; ++n) {
+    auto it = entries.find(names[idx]);
+    folly::doNotOptimizeAway(deref(it->second).mode);
+    idx += 1;
+    if (idx >= names.size()) {
+      idx = 0;
+    }
+  }
+}
+
+class CountingDiffCallback : public InodeDiffCallback {
+ public:
+  void ignoredFile(RelativePathPiece) override {
+    ++count;
+  }
+  void untrackedFile(RelativePathPiece) override {
+    ++count;
+  }
+  void removedFile(RelativePathPiece, const TreeEntry&) override {
+    ++count;
+  }
+  void modifiedFile(RelativePathPiece, const TreeEntry&) override {
+    ++count;
+  }
+  void diffError(RelativePathPiece, const folly::exception_wrapper&) override {
+    ++count;
+  }
+
+  std::atomic<size_t> count{0};
+};
+
+/** Returns the offset of the last dirent in a readdir reply. */
+off_t getLastOffset(StringPiece buf) {
+  off_t off = 0;
+  const char* p = buf.begin();
+  while (p < buf.end()) {
+    auto* dirent = reinterpret_cast<const fuse_dirent*>(p);
+    off = dirent->off;
+    p += FUSE_DIRENT_SIZE(dirent);
+  }
+  return off;
+}
+
+/*
+ * A mount whose root directory contains numEntries files.  One file is
+ * modified, so the root directory is materialized and diff has to compare
+ * every entry against source control.
+ */
+struct LargeDirFixture {
+  explicit LargeDirFixture(size_t numEntries = FLAGS_num_entries)
+      : names{buildNames(numEntries)} {
+    FakeTreeBuilder builder;
+    for (const auto& name : names) {
+      builder.setFile(RelativePathPiece{name.stringPiece()}, "contents\n");
+    }
+    mount.initialize(builder);
+    mount.overwriteFile(names[0].stringPiece(), "modified\n");
+    root = mount.getTreeInode("");
+  }
+
+  vector<PathComponent> names;
+  TestMount mount;
+  TreeInodePtr root;
+};
+}
+
+BENCHMARK(scan_boxed, iters) {
+  BoxedEntries entries;
+  BENCHMARK_SUSPEND {
+    entries = buildBoxed(buildNames());
+  }
+  scanEntries(iters, entries);
+}
+
+BENCHMARK_RELATIVE(scan_inline, iters) {
+  InlineEntries entries;
+  BENCHMARK_SUSPEND {
+    entries = buildInline(buildNames());
+  }
+  scanEntries(iters, entries);
+}
+
+BENCHMARK(lookup_boxed, iters) {
+  BoxedEntries entries;
+  vector<PathComponent> names;
+  BENCHMARK_SUSPEND {
+    names = buildNames();
+    entries = buildBoxed(names);
+    names = shuffledNames(names);
+  }
+  lookupEntries(iters, entries, names);
+}
+
+BENCHMARK_RELATIVE(lookup_inline, iters) {
+  InlineEntries entries;
+  vector<PathComponent> names;
+  BENCHMARK_SUSPEND {
+    names = buildNames();
+    entries = buildInline(names);
+    names = shuffledNames(names);
+  }
+  lookupEntries(iters, entries, names);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(treeinode_lookup, iters) {
+  folly::Optional<LargeDirFixture> fixture;
+  vector<PathComponent> names;
+  BENCHMARK_SUSPEND {
+    fixture.emplace();
+    names = shuffledNames(fixture->names);
+  }
+
+  size_t idx = 0;
+  for (size_t n = 0; n < iters; ++n) {
+    folly::doNotOptimizeAway(fixture->root->getChildInodeNumber(names[idx]));
+    idx += 1;
+    if (idx >= names.size()) {
+      idx = 0;
+    }
+  }
+
+  BENCHMARK_SUSPEND {
+    fixture.clear();
+  }
+}
+
+/*
+ * List a directory from start to finish through a fresh handle, a page at a
+ * time.  The kernel asks for one page (4KB) of entries per readdir call.
+ * Compare the time per entry across directory sizes: it should stay flat
+ * rather than grow with the size of the directory.
+ */
+void listDirectory(size_t iters, size_t numEntries) {
+  folly::Optional<LargeDirFixture> fixture;
+  BENCHMARK_SUSPEND {
+    fixture.emplace(numEntries);
+  }
+
+  for (size_t n = 0; n < iters; ++n) {
+    TreeInodeDirHandle handle{fixture->root};
+    off_t off = 0;
+    while (true) {
+      auto list = handle.readdir(fusell::DirList{4096}, off).get();
+      auto buf = list.getBuf();
+      if (buf.empty()) {
+        break;
+      }
+      off = getLastOffset(buf);
+    }
+    folly::doNotOptimizeAway(off);
+  }
+
+  BENCHMARK_SUSPEND {
+    fixture.clear();
+  }
+}
+
+BENCHMARK_PARAM(listDirectory, 1000);
+BENCHMARK_PARAM(listDirectory, 10000);
+BENCHMARK_PARAM(listDirectory, 100000);
+BENCHMARK_PARAM(listDirectory, 1000000);
+
+BENCHMARK(treeinode_diff, iters) {
+  folly::Optional<LargeDirFixture> fixture;
+  BENCHMARK_SUSPEND {
+    fixture.emplace();
+  }
+
+  for (size_t n = 0; n < iters; ++n) {
+    CountingDiffCallback callback;
+    fixture->mount.getEdenMount()->diff(&callback).get();
+    folly::doNotOptimizeAway(callback.count.load());
+  }
+
+  BENCHMARK_SUSPEND {
+    fixture.clear();
+  }
+}
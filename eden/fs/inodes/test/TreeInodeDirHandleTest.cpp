@@ -0,0 +1,242 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/inodes/TreeInodeDirHandle.h"
+
+#include <folly/Conv.h>
+#include <gtest/gtest.h>
+#include <linux/fuse.h>
+#include <algorithm>
+#include "eden/fs/inodes/FileInode.h"
+#include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+#include "eden/fuse/DirList.h"
+
+using namespace facebook::eden;
+using std::string;
+using std::vector;
+
+namespace {
+/**
+ * The name, inode number and offset of each entry returned by a readdir()
+ * call.
+ */
+struct ReaddirResult {
+  vector<string> names;
+  vector<fuse_ino_t> inodes;
+  vector<off_t> offsets;
+};
+
+ReaddirResult
+readdirPage(TreeInodeDirHandle& handle, size_t bufSize, off_t off) {
+  auto list = handle.readdir(fusell::DirList{bufSize}, off).get();
+  auto buf = list.getBuf();
+
+  ReaddirResult result;
+  const char* p = buf.begin();
+  while (p < buf.end()) {
+    auto* dirent = reinterpret_cast<const fuse_dirent*>(p);
+    result.names.emplace_back(dirent->name, dirent->namelen);
+    result.inodes.push_back(dirent->ino);
+    result.offsets.push_back(dirent->off);
+    p += FUSE_DIRENT_SIZE(dirent);
+  }
+  return result;
+}
+
+/**
+ * Read the whole directory a small page at a time, the way the kernel does.
+ */
+vector<string> readdirAll(TreeInodeDirHandle& handle, size_t bufSize) {
+  vector<string> names;
+  off_t off = 0;
+  while (true) {
+    auto page = readdirPage(handle, bufSize, off);
+    if (page.names.empty()) {
+      return names;
+    }
+    names.insert(names.end(), page.names.begin(), page.names.end());
+    off = page.offsets.back();
+  }
+}
+
+/**
+ * An entry returned by a readdirplus() call.
+ */
+struct ReaddirplusEntry {
+  string name;
+  fuse_entry_out entry;
+};
+
+vector<ReaddirplusEntry>
+readdirplusPage(TreeInodeDirHandle& handle, size_t bufSize, off_t off) {
+  auto list = handle.readdirplus(fusell::DirList{bufSize}, off).get();
+  auto buf = list.getBuf();
+
+  vector<ReaddirplusEntry> result;
+  const char* p = buf.begin();
+  while (p < buf.end()) {
+    auto* direntplus = reinterpret_cast<const fuse_direntplus*>(p);
+    result.push_back(ReaddirplusEntry{
+        string(direntplus->dirent.name, direntplus->dirent.namelen),
+        direntplus->entry_out});
+    p += FUSE_DIRENTPLUS_SIZE(direntplus);
+  }
+  return result;
+}
+
+class TreeInodeDirHandleTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FakeTreeBuilder builder;
+    for (int n = 0; n < 100; ++n) {
+      builder.setFile(folly::to<string>("file", 100 + n), "contents\n");
+    }
+    mount_.initialize(builder);
+  }
+
+  vector<string> expectedNames() const {
+    vector<string> names{".", ".."};
+    for (int n = 0; n < 100; ++n) {
+      names.push_back(folly::to<string>("file", 100 + n));
+    }
+    return names;
+  }
+
+  TestMount mount_;
+};
+}
+
+TEST_F(TreeInodeDirHandleTest, readInPages) {
+  TreeInodeDirHandle handle{mount_.getTreeInode("")};
+  // Each entry takes 32 bytes, so this returns a few entries per call.
+  EXPECT_EQ(expectedNames(), readdirAll(handle, 128));
+}
+
+TEST_F(TreeInodeDirHandleTest, seek) {
+  TreeInodeDirHandle handle{mount_.getTreeInode("")};
+  auto first = readdirPage(handle, 128, 0);
+  ASSERT_EQ(4, first.names.size());
+  auto second = readdirPage(handle, 128, first.offsets.back());
+
+  // Seeking back to an offset returned earlier returns the same entries.
+  auto again = readdirPage(handle, 128, first.offsets[1]);
+  EXPECT_EQ(first.names[2], again.names[0]);
+  EXPECT_EQ(first.names[3], again.names[1]);
+  EXPECT_EQ(second.names[0], again.names[2]);
+  EXPECT_EQ(first.offsets[2], again.offsets[0]);
+
+  // Reading past the end returns nothing.
+  EXPECT_TRUE(readdirPage(handle, 128, 1000).names.empty());
+}
+
+TEST_F(TreeInodeDirHandleTest, changesDuringListing) {
+  TreeInodeDirHandle handle{mount_.getTreeInode("")};
+  auto first = readdirPage(handle, 128, 0);
+  ASSERT_EQ(4, first.names.size());
+
+  // Entries removed after the listing started are skipped rather than
+  // failing the readdir, and new entries are not reported until the
+  // caller starts over.
+  mount_.deleteFile("file150");
+  mount_.addFile("file300", "new\n");
+
+  auto names = first.names;
+  off_t off = first.offsets.back();
+  while (true) {
+    auto page = readdirPage(handle, 128, off);
+    if (page.names.empty()) {
+      break;
+    }
+    names.insert(names.end(), page.names.begin(), page.names.end());
+    off = page.offsets.back();
+  }
+  auto expected = expectedNames();
+  expected.erase(std::find(expected.begin(), expected.end(), "file150"));
+  EXPECT_EQ(expected, names);
+
+  expected.push_back("file300");
+  EXPECT_EQ(expected, readdirAll(handle, 128));
+}
+
+TEST_F(TreeInodeDirHandleTest, readdirInodeNumbersMatchLookup) {
+  auto root = mount_.getTreeInode("");
+  TreeInodeDirHandle handle{root};
+
+  // Listing the directory does not assign inode numbers to its entries.
+  auto listing = readdirPage(handle, 8192, 0);
+  ASSERT_EQ(expectedNames(), listing.names);
+  {
+    auto contents = root->getContents().rlock();
+    EXPECT_NE(0, contents->reservedInodeBase);
+    auto iter = contents->entries.find(PathComponentPiece{"file199"});
+    ASSERT_NE(contents->entries.end(), iter);
+    EXPECT_FALSE(iter->second.hasInodeNumber());
+  }
+
+  // Every entry gets a distinct number, and listing again reports the same
+  // numbers.
+  vector<fuse_ino_t> children(
+      listing.inodes.begin() + 2, listing.inodes.end());
+  std::sort(children.begin(), children.end());
+  EXPECT_EQ(children.end(), std::unique(children.begin(), children.end()));
+  EXPECT_EQ(listing.inodes, readdirPage(handle, 8192, 0).inodes);
+
+  // Looking up an entry reports the same number that readdir() did.
+  EXPECT_EQ("file101", listing.names[3]);
+  EXPECT_EQ(listing.inodes[3], mount_.getFileInode("file101")->getNodeId());
+
+  // Adding an entry shifts the position of the others, but they keep the
+  // numbers that readdir() reported for them.
+  mount_.addFile("file000", "new file\n");
+  EXPECT_EQ("file150", listing.names[52]);
+  EXPECT_EQ(listing.inodes[52], mount_.getFileInode("file150")->getNodeId());
+  EXPECT_EQ("file199", listing.names.back());
+  auto again = readdirPage(handle, 8192, 0);
+  EXPECT_EQ(listing.inodes.back(), again.inodes.back());
+  EXPECT_EQ(
+      listing.inodes.back(), mount_.getFileInode("file199")->getNodeId());
+}
+
+TEST_F(TreeInodeDirHandleTest, readdirplus) {
+  // Load one of the files, so both loaded and unloaded entries are returned.
+  auto loaded = mount_.getFileInode("file101");
+  TreeInodeDirHandle handle{mount_.getTreeInode("")};
+
+  auto entries = readdirplusPage(handle, 4096, 0);
+  ASSERT_LE(4, entries.size());
+  EXPECT_EQ(".", entries[0].name);
+  EXPECT_EQ(0, entries[0].entry.nodeid);
+  EXPECT_EQ("..", entries[1].name);
+  EXPECT_EQ(0, entries[1].entry.nodeid);
+
+  for (size_t n = 2; n < entries.size(); ++n) {
+    SCOPED_TRACE(entries[n].name);
+    const auto& entry = entries[n].entry;
+    EXPECT_NE(0, entry.nodeid);
+    EXPECT_EQ(entry.nodeid, entry.attr.ino);
+    EXPECT_TRUE(S_ISREG(entry.attr.mode));
+    EXPECT_EQ(9, entry.attr.size);
+  }
+
+  // Each returned entry counts as a lookup, whether or not the inode was
+  // loaded when it was returned.
+  EXPECT_EQ("file101", entries[3].name);
+  EXPECT_EQ(loaded->getNodeId(), entries[3].entry.nodeid);
+  EXPECT_EQ(1, loaded->getFuseRefcount());
+  EXPECT_EQ("file100", entries[2].name);
+  auto unloaded = mount_.getFileInode("file100");
+  EXPECT_EQ(unloaded->getNodeId(), entries[2].entry.nodeid);
+  EXPECT_EQ(1, unloaded->getFuseRefcount());
+
+  // Entries that did not fit in this page were not referenced.
+  ASSERT_GT(102, entries.size());
+  EXPECT_EQ(0, mount_.getFileInode("file199")->getFuseRefcount());
+}
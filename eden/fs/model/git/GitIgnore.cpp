@@ -62,20 +62,48 @@ void GitIgnore::loadFile(StringPiece contents) {
   // reverse them so that we can do a forward walk through our patterns and
   // stop at the first match.
   std::reverse(newRules.begin(), newRules.end());
+
+  GlobMatcherSet basenameMatchers;
+  std::vector<size_t> basenameRuleIndices;
+  GlobMatcherSet pathMatchers;
+  std::vector<size_t> pathRuleIndices;
+  for (size_t idx = 0; idx < newRules.size(); ++idx) {
+    const auto& rule = newRules[idx];
+    if (rule.isBasenameOnly()) {
+      basenameMatchers.add(&rule.getMatcher());
+      basenameRuleIndices.push_back(idx);
+    } else {
+      pathMatchers.add(&rule.getMatcher());
+      pathRuleIndices.push_back(idx);
+    }
+  }
+
   std::swap(rules_, newRules);
+  std::swap(basenameMatchers_, basenameMatchers);
+  std::swap(basenameRuleIndices_, basenameRuleIndices);
+  std::swap(pathMatchers_, pathMatchers);
+  std::swap(pathRuleIndices_, pathRuleIndices);
 }
 
 GitIgnore::MatchResult GitIgnore::match(
     RelativePathPiece path,
     PathComponentPiece basename) const {
-  for (const auto& pattern : rules_) {
-    auto result = pattern.match(path, basename);
-    if (result != NO_MATCH) {
-      return result;
-    }
+  // rules_ is sorted from highest to lowest precedence, so the matching rule
+  // with the lowest index wins.
+  auto best = rules_.size();
+  auto basenameMatch = basenameMatchers_.match(basename.stringPiece());
+  if (basenameMatch.hasValue()) {
+    best = basenameRuleIndices_[basenameMatch.value()];
+  }
+  auto pathMatch = pathMatchers_.match(path.stringPiece());
+  if (pathMatch.hasValue()) {
+    best = std::min(best, pathRuleIndices_[pathMatch.value()]);
   }
 
-  return NO_MATCH;
+  if (best == rules_.size()) {
+    return NO_MATCH;
+  }
+  return rules_[best].getMatchResult();
 }
 
 string GitIgnore::matchString(MatchResult result) {
@@ -11,6 +11,7 @@
 
 #include <folly/Range.h>
 #include <vector>
+#include "eden/fs/model/git/GlobMatcherSet.h"
 #include "eden/utils/PathFuncs.h"
 
 namespace facebook {
@@ -142,6 +143,20 @@ class GitIgnore {
    * listed in the .gitignore file).
    */
   std::vector<GitIgnorePattern> rules_;
+
+  /*
+   * Indexes of the rules_ patterns, so match() can test a path against all of
+   * them at once.  Patterns that only match the basename and patterns that
+   * match the full path are kept in separate sets.  The *RuleIndices_ vectors
+   * map each set index back to its index in rules_.
+   *
+   * The sets refer to the GlobMatchers owned by rules_, which are left in
+   * place when a GitIgnore is moved.
+   */
+  GlobMatcherSet basenameMatchers_;
+  std::vector<size_t> basenameRuleIndices_;
+  GlobMatcherSet pathMatchers_;
+  std::vector<size_t> pathRuleIndices_;
 };
 }
 }
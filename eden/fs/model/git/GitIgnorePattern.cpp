@@ -166,7 +166,7 @@ GitIgnore::MatchResult GitIgnorePattern::match(
   }
 
   if (isMatch) {
-    return (flags_ & FLAG_INCLUDE) ? GitIgnore::INCLUDE : GitIgnore::EXCLUDE;
+    return getMatchResult();
   }
 
   return GitIgnore::NO_MATCH;
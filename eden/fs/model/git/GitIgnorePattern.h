@@ -66,6 +66,28 @@ class GitIgnorePattern {
       RelativePathPiece path,
       PathComponentPiece basename) const;
 
+  /**
+   * Returns true if this pattern is matched against just the basename of a
+   * path, rather than the full path.
+   */
+  bool isBasenameOnly() const {
+    return flags_ & FLAG_BASENAME_ONLY;
+  }
+
+  /**
+   * The result returned by match() when a path matches this pattern.
+   */
+  GitIgnore::MatchResult getMatchResult() const {
+    return (flags_ & FLAG_INCLUDE) ? GitIgnore::INCLUDE : GitIgnore::EXCLUDE;
+  }
+
+  /**
+   * Get the GlobMatcher for this pattern.
+   */
+  const GlobMatcher& getMatcher() const {
+    return matcher_;
+  }
+
  private:
   /**
    * Flag values that can be bitwise-ORed to create the flags_ value.
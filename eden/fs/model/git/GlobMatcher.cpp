@@ -414,6 +414,50 @@ bool GlobMatcher::match(StringPiece text) const {
   return tryMatchAt(text, 0, 0);
 }
 
+GlobMatcher::Shape GlobMatcher::getShape(StringPiece* literal) const {
+  // Returns true if pattern_ consists of exactly one literal-carrying opcode
+  // of the given type starting at idx.
+  auto isSingleLiteral = [this, literal](size_t idx, uint8_t opcode) {
+    if (pattern_.size() < idx + 2 || pattern_[idx] != opcode) {
+      return false;
+    }
+    uint8_t length = pattern_[idx + 1];
+    if (pattern_.size() != idx + 2 + length) {
+      return false;
+    }
+    *literal = StringPiece{ByteRange(pattern_.data() + idx + 2, length)};
+    return true;
+  };
+
+  if (pattern_.empty()) {
+    // The empty pattern only matches the empty string.
+    *literal = StringPiece();
+    return Shape::LITERAL;
+  }
+  if (pattern_.size() == 1 && pattern_[0] == GLOB_STAR) {
+    return Shape::ANY_NO_SLASH;
+  }
+  if (isSingleLiteral(0, GLOB_LITERAL)) {
+    return Shape::LITERAL;
+  }
+  if (isSingleLiteral(0, GLOB_ENDS_WITH)) {
+    return Shape::ENDS_WITH;
+  }
+  if (pattern_[0] == GLOB_STAR_STAR_SLASH) {
+    // "**/" followed by "*<literal>".  Whatever precedes the literal, "**/"
+    // can consume everything up to its last slash and "*" the rest.
+    if (isSingleLiteral(1, GLOB_ENDS_WITH)) {
+      return Shape::ANY_ENDS_WITH;
+    }
+    // "**/" followed by a literal with no slashes matches that basename.
+    if (isSingleLiteral(1, GLOB_LITERAL) &&
+        literal->find('/') == StringPiece::npos) {
+      return Shape::BASENAME;
+    }
+  }
+  return Shape::OTHER;
+}
+
 bool GlobMatcher::tryMatchAt(
     StringPiece text,
     size_t textIdx,
@@ -62,6 +62,37 @@ class GlobMatcher {
    */
   bool match(folly::StringPiece text) const;
 
+  /**
+   * Simple pattern forms that can be matched with a hash table lookup on
+   * part of the text, rather than by running the matcher.
+   *
+   * GlobMatcherSet uses this to index large numbers of patterns.
+   */
+  enum class Shape {
+    // Any other pattern.  The matcher must be run to test it.
+    OTHER,
+    // Matches only the literal text ("foo").
+    LITERAL,
+    // Matches text that ends with the literal, where the text before the
+    // literal contains no '/' ("*.txt").
+    ENDS_WITH,
+    // Matches any text that ends with the literal ("**/*.txt").
+    ANY_ENDS_WITH,
+    // Matches text whose final path component is the literal ("**/foo").
+    BASENAME,
+    // Matches any text that contains no '/' ("*").
+    ANY_NO_SLASH,
+  };
+
+  /**
+   * Get the shape of this pattern.
+   *
+   * For shapes with a literal component, *literal is set to the literal.  It
+   * points into this GlobMatcher's pattern buffer, and remains valid for as
+   * long as this GlobMatcher exists.
+   */
+  Shape getShape(folly::StringPiece* literal) const;
+
  private:
   explicit GlobMatcher(std::vector<uint8_t> pattern);
 
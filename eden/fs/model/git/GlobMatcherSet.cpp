@@ -0,0 +1,162 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "GlobMatcherSet.h"
+
+#include <folly/Hash.h>
+#include <algorithm>
+#include <cstring>
+
+using folly::StringPiece;
+using std::vector;
+
+namespace facebook {
+namespace eden {
+
+GlobMatcherSet::GlobMatcherSet() {}
+
+GlobMatcherSet::~GlobMatcherSet() {}
+
+size_t GlobMatcherSet::Hasher::operator()(StringPiece text) const {
+  return folly::hash::fnv64_buf(text.data(), text.size());
+}
+
+void GlobMatcherSet::add(const GlobMatcher* matcher) {
+  auto index = size_++;
+
+  StringPiece literal;
+  switch (matcher->getShape(&literal)) {
+    case GlobMatcher::Shape::LITERAL:
+      literals_[literal].push_back(index);
+      return;
+    case GlobMatcher::Shape::ENDS_WITH:
+      addSuffix(&endsWith_, literal, index);
+      return;
+    case GlobMatcher::Shape::ANY_ENDS_WITH:
+      addSuffix(&anyEndsWith_, literal, index);
+      return;
+    case GlobMatcher::Shape::BASENAME:
+      basenames_[literal].push_back(index);
+      return;
+    case GlobMatcher::Shape::ANY_NO_SLASH:
+      anyNoSlash_.push_back(index);
+      return;
+    case GlobMatcher::Shape::OTHER:
+      break;
+  }
+  others_.emplace_back(index, matcher);
+}
+
+void GlobMatcherSet::addMatchAll() {
+  matchAll_.push_back(size_++);
+}
+
+void GlobMatcherSet::addSuffix(
+    vector<SuffixGroup>* groups,
+    StringPiece suffix,
+    size_t index) {
+  for (auto& group : *groups) {
+    if (group.length == suffix.size()) {
+      group.suffixes[suffix].push_back(index);
+      return;
+    }
+  }
+  groups->emplace_back(suffix.size());
+  groups->back().suffixes[suffix].push_back(index);
+}
+
+template <typename Func>
+void GlobMatcherSet::forEachIndexedMatch(StringPiece text, Func&& func) const {
+  auto lastSlash = text.rfind('/');
+  // Returns true if the first prefixLength bytes of text contain no slash
+  auto noSlashBefore = [&](size_t prefixLength) {
+    return lastSlash == StringPiece::npos ||
+        memchr(text.data(), '/', prefixLength) == nullptr;
+  };
+
+  if (!matchAll_.empty()) {
+    func(matchAll_);
+  }
+  if (!anyNoSlash_.empty() && lastSlash == StringPiece::npos) {
+    func(anyNoSlash_);
+  }
+  if (!literals_.empty()) {
+    auto it = literals_.find(text);
+    if (it != literals_.end()) {
+      func(it->second);
+    }
+  }
+  if (!basenames_.empty()) {
+    auto basename =
+        lastSlash == StringPiece::npos ? text : text.subpiece(lastSlash + 1);
+    auto it = basenames_.find(basename);
+    if (it != basenames_.end()) {
+      func(it->second);
+    }
+  }
+  for (const auto& group : endsWith_) {
+    if (text.size() < group.length) {
+      continue;
+    }
+    auto prefixLength = text.size() - group.length;
+    auto it = group.suffixes.find(text.subpiece(prefixLength));
+    if (it != group.suffixes.end() && noSlashBefore(prefixLength)) {
+      func(it->second);
+    }
+  }
+  for (const auto& group : anyEndsWith_) {
+    if (text.size() < group.length) {
+      continue;
+    }
+    auto it = group.suffixes.find(text.subpiece(text.size() - group.length));
+    if (it != group.suffixes.end()) {
+      func(it->second);
+    }
+  }
+}
+
+folly::Optional<size_t> GlobMatcherSet::match(StringPiece text) const {
+  // Every index vector is sorted, so the first entry of each is the best
+  // candidate it has to offer.
+  size_t best = size_;
+  forEachIndexedMatch(text, [&best](const vector<size_t>& indices) {
+    best = std::min(best, indices.front());
+  });
+
+  // Only patterns with a higher priority than the best match so far can
+  // change the result.
+  for (const auto& other : others_) {
+    if (other.first >= best) {
+      break;
+    }
+    if (other.second->match(text)) {
+      best = other.first;
+      break;
+    }
+  }
+
+  if (best == size_) {
+    return folly::none;
+  }
+  return best;
+}
+
+void GlobMatcherSet::matchAll(StringPiece text, vector<size_t>* matches)
+    const {
+  forEachIndexedMatch(text, [matches](const vector<size_t>& indices) {
+    matches->insert(matches->end(), indices.begin(), indices.end());
+  });
+  for (const auto& other : others_) {
+    if (other.second->match(text)) {
+      matches->push_back(other.first);
+    }
+  }
+}
+}
+}
@@ -0,0 +1,125 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "eden/fs/model/git/GlobMatcher.h"
+
+namespace facebook {
+namespace eden {
+
+/**
+ * GlobMatcherSet tests a string against many glob patterns at once.
+ *
+ * Each pattern is identified by its index, in the order it was added.  Lower
+ * indices have higher priority.
+ *
+ * Running every GlobMatcher in turn costs O(patterns) per string.  Most
+ * patterns in practice are fixed strings or simple "ends with" patterns
+ * (see GlobMatcher::create()), so GlobMatcherSet indexes those by their
+ * literal text and only needs a few hash table lookups to test them all.
+ * The remaining patterns are run one at a time.
+ *
+ * GlobMatcherSet does not own the GlobMatcher objects added to it.  They must
+ * not be destroyed or moved for as long as the set is in use.
+ */
+class GlobMatcherSet {
+ public:
+  GlobMatcherSet();
+  ~GlobMatcherSet();
+  GlobMatcherSet(GlobMatcherSet&&) = default;
+  GlobMatcherSet& operator=(GlobMatcherSet&&) = default;
+
+  /**
+   * Add a pattern to the set.
+   *
+   * The pattern's index is the number of patterns added before it.
+   */
+  void add(const GlobMatcher* matcher);
+
+  /**
+   * Add a pattern that matches every string.
+   */
+  void addMatchAll();
+
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /**
+   * Return the index of the highest priority pattern that matches text, or
+   * folly::none if no patterns match.
+   */
+  folly::Optional<size_t> match(folly::StringPiece text) const;
+
+  /**
+   * Append the indices of all patterns that match text to the matches vector.
+   *
+   * The indices are appended in no particular order.
+   */
+  void matchAll(folly::StringPiece text, std::vector<size_t>* matches) const;
+
+ private:
+  GlobMatcherSet(GlobMatcherSet const&) = delete;
+  GlobMatcherSet& operator=(GlobMatcherSet const&) = delete;
+
+  struct Hasher {
+    size_t operator()(folly::StringPiece text) const;
+  };
+  /**
+   * Maps literal text to the indices of the patterns using it, sorted from
+   * lowest to highest.  The keys point into the GlobMatcher pattern buffers.
+   */
+  using LiteralMap =
+      std::unordered_map<folly::StringPiece, std::vector<size_t>, Hasher>;
+  /**
+   * Suffix patterns grouped by the length of their literal, so each group
+   * needs just one lookup on the final `length` bytes of the text.
+   */
+  struct SuffixGroup {
+    explicit SuffixGroup(size_t len) : length(len) {}
+
+    size_t length;
+    LiteralMap suffixes;
+  };
+
+  static void addSuffix(
+      std::vector<SuffixGroup>* groups,
+      folly::StringPiece suffix,
+      size_t index);
+
+  /**
+   * Call func(indices) with a sorted vector of candidate pattern indices for
+   * each indexed pattern group that matches the text.
+   */
+  template <typename Func>
+  void forEachIndexedMatch(folly::StringPiece text, Func&& func) const;
+
+  size_t size_{0};
+  LiteralMap literals_;
+  LiteralMap basenames_;
+  std::vector<SuffixGroup> endsWith_;
+  std::vector<SuffixGroup> anyEndsWith_;
+  std::vector<size_t> anyNoSlash_;
+  std::vector<size_t> matchAll_;
+  /**
+   * Patterns that are not indexed, sorted by index.
+   */
+  std::vector<std::pair<size_t, const GlobMatcher*>> others_;
+};
+}
+}
@@ -0,0 +1,259 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <algorithm>
+
+#include "eden/fs/model/git/GitIgnore.h"
+#include "eden/fs/model/git/GitIgnorePattern.h"
+#include "eden/fs/model/git/GlobMatcherSet.h"
+
+using namespace facebook::eden;
+using folly::StringPiece;
+using std::string;
+using std::vector;
+
+namespace {
+/*
+ * A combination of commonly used .gitignore templates for C/C++, Python,
+ * Java, Node and editor files, similar to the ignore files found at the root
+ * of large repositories.
+ */
+const char* const kIgnoreFile =
+    "# Prerequisites\n"
+    "*.d\n"
+    "# Compiled Object files\n"
+    "*.slo\n*.lo\n*.o\n*.obj\n"
+    "# Precompiled Headers\n"
+    "*.gch\n*.pch\n"
+    "# Compiled Dynamic libraries\n"
+    "*.so\n*.dylib\n*.dll\n"
+    "# Fortran module files\n"
+    "*.mod\n*.smod\n"
+    "# Compiled Static libraries\n"
+    "*.lai\n*.la\n*.a\n*.lib\n"
+    "# Executables\n"
+    "*.exe\n*.out\n*.app\n"
+    "# Byte-compiled / optimized / DLL files\n"
+    "__pycache__/\n*.py[cod]\n*$py.class\n"
+    "# Distribution / packaging\n"
+    ".Python\nbuild/\ndevelop-eggs/\ndist/\ndownloads/\neggs/\n.eggs/\n"
+    "lib/\nlib64/\nparts/\nsdist/\nvar/\nwheels/\n*.egg-info/\n"
+    ".installed.cfg\n*.egg\nMANIFEST\n"
+    "# Installer logs\n"
+    "pip-log.txt\npip-delete-this-directory.txt\n"
+    "# Unit test / coverage reports\n"
+    "htmlcov/\n.tox/\n.coverage\n.coverage.*\n.cache\nnosetests.xml\n"
+    "coverage.xml\n*.cover\n.hypothesis/\n.pytest_cache/\n"
+    "# Translations\n"
+    "*.mo\n*.pot\n"
+    "# Sphinx documentation\n"
+    "docs/_build/\n"
+    "# Environments\n"
+    ".env\n.venv\nenv/\nvenv/\nENV/\n"
+    "# Java\n"
+    "*.class\n*.log\n*.ctxt\n.mtj.tmp/\n*.jar\n*.war\n*.nar\n*.ear\n*.zip\n"
+    "*.tar.gz\n*.rar\nhs_err_pid*\n"
+    "# Logs\n"
+    "logs\nnpm-debug.log*\nyarn-debug.log*\nyarn-error.log*\n"
+    "# Runtime data\n"
+    "pids\n*.pid\n*.seed\n*.pid.lock\n"
+    "# Dependency directories\n"
+    "node_modules/\njspm_packages/\n"
+    "# Optional npm cache directory\n"
+    ".npm\n.eslintcache\n.node_repl_history\n*.tgz\n.yarn-integrity\n"
+    "# Editors\n"
+    ".idea/\n*.iml\n*.swp\n*.swo\n*~\n.*.sw?\n.vscode/\n*.sublime-*\n"
+    "\\#*\\#\n.\\#*\n"
+    "# OS files\n"
+    ".DS_Store\n.DS_Store?\n._*\n.Spotlight-V100\n.Trashes\n"
+    "ehthumbs.db\nThumbs.db\n"
+    "# Repository specific\n"
+    "/buck-out/\n/.buckd/\n/buck-cache/\n/.buckconfig.local\n"
+    "**/tmp/**\n**/*.generated.h\n!/third-party/**/*.a\n"
+    "/eden/fs/service/gen-*\n/common/**/build\n";
+
+const vector<StringPiece> kPathCorpus = {
+    "kernel/irq/manage.c",
+    "kernel/irq/manage.o",
+    "kernel/power/console.c",
+    "include/uapi/linux/netfilter_bridge/ebt_mark_t.h",
+    "README",
+    "foo/README",
+    "Documentation/DocBook/media/v4l/vidioc-g-modulator.xml",
+    "net/ipv4/netfilter/nf_conntrack_l3proto_ipv4_compat.c",
+    "eden/fs/service/GlobNode.cpp",
+    "eden/fs/service/gen-cpp2",
+    "eden/integration/__pycache__",
+    "eden/integration/lib/testcase.pyc",
+    "web/node_modules",
+    "web/src/app/components/Button.jsx",
+    "third-party/zlib/libz.a",
+    "java/com/facebook/Main.java",
+    "java/com/facebook/Main.class",
+    "buck-out",
+    "src/.main.cpp.swp",
+    "src/main.cpp~",
+    "common/stats/build",
+    "tmp/scratch.txt",
+    "photos/.DS_Store",
+};
+
+/*
+ * The previous GitIgnore::match() implementation: try every rule in
+ * precedence order until one matches.
+ */
+class LinearIgnore {
+ public:
+  void init(StringPiece contents) {
+    vector<StringPiece> lines;
+    folly::split('\n', contents, lines);
+    for (auto line : lines) {
+      auto pattern = GitIgnorePattern::parseLine(line);
+      if (pattern.hasValue()) {
+        rules_.emplace_back(std::move(pattern).value());
+      }
+    }
+    std::reverse(rules_.begin(), rules_.end());
+  }
+
+  GitIgnore::MatchResult match(RelativePathPiece path) const {
+    auto basename = path.basename();
+    for (const auto& rule : rules_) {
+      auto result = rule.match(path, basename);
+      if (result != GitIgnore::NO_MATCH) {
+        return result;
+      }
+    }
+    return GitIgnore::NO_MATCH;
+  }
+
+ private:
+  vector<GitIgnorePattern> rules_;
+};
+
+class IndexedIgnore {
+ public:
+  void init(StringPiece contents) {
+    ignore_.loadFile(contents);
+  }
+
+  GitIgnore::MatchResult match(RelativePathPiece path) const {
+    return ignore_.match(path);
+  }
+
+ private:
+  GitIgnore ignore_;
+};
+
+template <typename Impl>
+void runIgnoreBenchmark(size_t numIters) {
+  Impl impl;
+  vector<RelativePath> paths;
+  BENCHMARK_SUSPEND {
+    impl.init(kIgnoreFile);
+    for (auto path : kPathCorpus) {
+      paths.emplace_back(path);
+    }
+  }
+
+  size_t idx = 0;
+  for (size_t n = 0; n < numIters; ++n) {
+    auto ret = impl.match(paths[idx]);
+    folly::doNotOptimizeAway(ret);
+    idx += 1;
+    if (idx >= paths.size()) {
+      idx = 0;
+    }
+  }
+}
+
+/*
+ * A list of sibling glob patterns like those passed to glob() by build
+ * tools: a few wildcard patterns plus many individually named files.
+ */
+vector<string> buildGlobList() {
+  vector<string> globs = {
+      "*.java", "*.kt", "*Test.java", "*.cpp", "*.h", "BUCK", "*.thrift"};
+  for (int n = 0; n < 200; ++n) {
+    globs.push_back(folly::to<string>("Generated", n, ".java"));
+  }
+  return globs;
+}
+
+const vector<StringPiece> kNameCorpus = {
+    "Main.java",
+    "MainTest.java",
+    "Generated17.java",
+    "Generated199.java",
+    "README",
+    "BUCK",
+    "util.cpp",
+    "util.h",
+    "service.thrift",
+    "notes.txt",
+};
+}
+
+BENCHMARK(gitignore_linear, numIters) {
+  runIgnoreBenchmark<LinearIgnore>(numIters);
+}
+
+BENCHMARK_RELATIVE(gitignore_indexed, numIters) {
+  runIgnoreBenchmark<IndexedIgnore>(numIters);
+}
+
+BENCHMARK(globlist_linear, numIters) {
+  vector<GlobMatcher> matchers;
+  BENCHMARK_SUSPEND {
+    for (const auto& glob : buildGlobList()) {
+      matchers.push_back(GlobMatcher::create(glob).value());
+    }
+  }
+
+  size_t idx = 0;
+  for (size_t n = 0; n < numIters; ++n) {
+    size_t numMatches = 0;
+    for (const auto& matcher : matchers) {
+      numMatches += matcher.match(kNameCorpus[idx]);
+    }
+    folly::doNotOptimizeAway(numMatches);
+    idx += 1;
+    if (idx >= kNameCorpus.size()) {
+      idx = 0;
+    }
+  }
+}
+
+BENCHMARK_RELATIVE(globlist_set, numIters) {
+  vector<GlobMatcher> matchers;
+  GlobMatcherSet set;
+  vector<size_t> matches;
+  BENCHMARK_SUSPEND {
+    auto globs = buildGlobList();
+    matchers.reserve(globs.size());
+    for (const auto& glob : globs) {
+      matchers.push_back(GlobMatcher::create(glob).value());
+      set.add(&matchers.back());
+    }
+  }
+
+  size_t idx = 0;
+  for (size_t n = 0; n < numIters; ++n) {
+    matches.clear();
+    set.matchAll(kNameCorpus[idx], &matches);
+    folly::doNotOptimizeAway(matches.size());
+    idx += 1;
+    if (idx >= kNameCorpus.size()) {
+      idx = 0;
+    }
+  }
+}
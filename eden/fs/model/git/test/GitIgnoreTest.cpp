@@ -217,6 +217,25 @@ TEST(GitIgnore, testBasenameMatch) {
   EXPECT_IGNORE(ignore, NO_MATCH, "x/ignoreddir/foo");
 }
 
+TEST(GitIgnore, testPrecedenceAcrossBasenameAndPathRules) {
+  // Basename-only and full path rules are indexed separately, but the last
+  // matching rule in the file must still win.
+  GitIgnore ignore;
+  ignore.loadFile(
+      "*.txt\n"
+      "!docs/*.txt\n"
+      "docs/secret.txt\n"
+      "!keep.txt\n");
+
+  EXPECT_IGNORE(ignore, EXCLUDE, "a.txt");
+  EXPECT_IGNORE(ignore, EXCLUDE, "src/a.txt");
+  EXPECT_IGNORE(ignore, INCLUDE, "docs/a.txt");
+  EXPECT_IGNORE(ignore, EXCLUDE, "docs/secret.txt");
+  EXPECT_IGNORE(ignore, INCLUDE, "keep.txt");
+  EXPECT_IGNORE(ignore, INCLUDE, "docs/keep.txt");
+  EXPECT_IGNORE(ignore, NO_MATCH, "docs/a.c");
+}
+
 // TODO: test trailing backslash to ensure it only matches directories
 // - test a backslash at the end of a line
 // - test a backslash at the end of the file
@@ -0,0 +1,191 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+
+#include "eden/fs/model/git/GlobMatcherSet.h"
+
+using namespace facebook::eden;
+using folly::StringPiece;
+using std::vector;
+using ::testing::UnorderedElementsAre;
+
+namespace {
+/*
+ * Compiles a list of patterns and adds them to a GlobMatcherSet, keeping the
+ * GlobMatcher objects alive alongside it.
+ */
+class TestSet {
+ public:
+  explicit TestSet(const vector<StringPiece>& patterns) {
+    for (auto pattern : patterns) {
+      matchers_.push_back(
+          std::make_unique<GlobMatcher>(GlobMatcher::create(pattern).value()));
+      set_.add(matchers_.back().get());
+    }
+  }
+
+  /*
+   * Returns the index of the first pattern that matches, by running each
+   * GlobMatcher in turn.
+   */
+  folly::Optional<size_t> linearMatch(StringPiece text) const {
+    for (size_t idx = 0; idx < matchers_.size(); ++idx) {
+      if (matchers_[idx]->match(text)) {
+        return idx;
+      }
+    }
+    return folly::none;
+  }
+
+  vector<size_t> linearMatchAll(StringPiece text) const {
+    vector<size_t> results;
+    for (size_t idx = 0; idx < matchers_.size(); ++idx) {
+      if (matchers_[idx]->match(text)) {
+        results.push_back(idx);
+      }
+    }
+    return results;
+  }
+
+  GlobMatcherSet& set() {
+    return set_;
+  }
+
+ private:
+  vector<std::unique_ptr<GlobMatcher>> matchers_;
+  GlobMatcherSet set_;
+};
+}
+
+TEST(GlobMatcherSet, shapes) {
+  auto shape = [](StringPiece glob, StringPiece expectedLiteral) {
+    auto matcher = GlobMatcher::create(glob).value();
+    StringPiece literal;
+    auto result = matcher.getShape(&literal);
+    if (result != GlobMatcher::Shape::OTHER &&
+        result != GlobMatcher::Shape::ANY_NO_SLASH) {
+      EXPECT_EQ(expectedLiteral, literal) << "for glob " << glob;
+    }
+    return result;
+  };
+
+  EXPECT_EQ(GlobMatcher::Shape::LITERAL, shape("foo", "foo"));
+  EXPECT_EQ(GlobMatcher::Shape::LITERAL, shape("foo/bar", "foo/bar"));
+  EXPECT_EQ(GlobMatcher::Shape::LITERAL, shape("\\*foo", "*foo"));
+  EXPECT_EQ(GlobMatcher::Shape::ENDS_WITH, shape("*.txt", ".txt"));
+  EXPECT_EQ(GlobMatcher::Shape::ANY_ENDS_WITH, shape("**/*.txt", ".txt"));
+  EXPECT_EQ(GlobMatcher::Shape::BASENAME, shape("**/foo", "foo"));
+  EXPECT_EQ(GlobMatcher::Shape::ANY_NO_SLASH, shape("*", ""));
+  EXPECT_EQ(GlobMatcher::Shape::OTHER, shape("**/foo/bar", ""));
+  EXPECT_EQ(GlobMatcher::Shape::OTHER, shape("foo*", ""));
+  EXPECT_EQ(GlobMatcher::Shape::OTHER, shape("*.tx?", ""));
+  EXPECT_EQ(GlobMatcher::Shape::OTHER, shape("foo/**", ""));
+}
+
+TEST(GlobMatcherSet, empty) {
+  GlobMatcherSet set;
+  EXPECT_TRUE(set.empty());
+  EXPECT_FALSE(set.match("foo").hasValue());
+
+  vector<size_t> matches;
+  set.matchAll("foo", &matches);
+  EXPECT_TRUE(matches.empty());
+}
+
+TEST(GlobMatcherSet, priority) {
+  TestSet test({"*.txt", "a*", "abc.txt", "**/*.txt", "abc.*"});
+
+  EXPECT_EQ(0, test.set().match("abc.txt").value());
+  EXPECT_EQ(1, test.set().match("abc.c").value());
+  EXPECT_EQ(3, test.set().match("dir/abc.txt").value());
+  EXPECT_FALSE(test.set().match("dir/abc.c").hasValue());
+
+  vector<size_t> matches;
+  test.set().matchAll("abc.txt", &matches);
+  EXPECT_THAT(matches, UnorderedElementsAre(0, 1, 2, 3, 4));
+}
+
+TEST(GlobMatcherSet, matchAll) {
+  GlobMatcherSet set;
+  auto txt = GlobMatcher::create("*.txt").value();
+  set.add(&txt);
+  set.addMatchAll();
+
+  EXPECT_EQ(2, set.size());
+  EXPECT_EQ(0, set.match("foo.txt").value());
+  EXPECT_EQ(1, set.match("foo/bar.c").value());
+}
+
+TEST(GlobMatcherSet, agreesWithGlobMatcher) {
+  // A mix of every indexed shape, plus patterns that fall back to running
+  // the matcher, with overlapping literals and suffix lengths.
+  TestSet test({
+      "README",
+      "*.o",
+      "**/*.pyc",
+      "**/node_modules",
+      "build/",
+      "foo/*.txt",
+      "*",
+      "*.txt",
+      "docs/**",
+      "**/build/out",
+      "[Tt]humbs.db",
+      "*~",
+      ".*.swp",
+      "foo/bar",
+      "**/*.o",
+      "*.tar.gz",
+      "src/**/*.h",
+      "a?c",
+  });
+  vector<StringPiece> corpus = {
+      "",
+      "README",
+      "foo/README",
+      "main.o",
+      "src/main.o",
+      "x.pyc",
+      "a/b/c/x.pyc",
+      "node_modules",
+      "web/node_modules",
+      "web/node_modules/x",
+      "foo/a.txt",
+      "foo/b/a.txt",
+      "a.txt",
+      "docs/index.html",
+      "build/out",
+      "x/build/out",
+      "Thumbs.db",
+      "dir/thumbs.db",
+      "notes~",
+      ".file.swp",
+      "foo/bar",
+      "release.tar.gz",
+      "src/a/b/x.h",
+      "abc",
+      "a/c",
+      "o",
+      ".o",
+  };
+
+  for (auto text : corpus) {
+    EXPECT_EQ(test.linearMatch(text), test.set().match(text)) << "for \""
+                                                              << text << "\"";
+
+    vector<size_t> matches;
+    test.set().matchAll(text, &matches);
+    std::sort(matches.begin(), matches.end());
+    EXPECT_EQ(test.linearMatchAll(text), matches) << "for \"" << text << "\"";
+  }
+}
@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "CheckoutProgressSubscriber.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include "eden/fs/inodes/CheckoutContext.h"
+
+DEFINE_int32(
+    checkout_progress_interval_ms,
+    100,
+    "How often to send checkout progress updates to subscribed clients");
+
+namespace facebook {
+namespace eden {
+
+CheckoutProgressSubscriber::CheckoutProgressSubscriber(
+    std::unique_ptr<apache::thrift::StreamingHandlerCallback<
+        std::unique_ptr<CheckoutProgressInfo>>> callback,
+    std::shared_ptr<const CheckoutProgress> progress)
+    : callback_(std::move(callback)), progress_(std::move(progress)) {}
+
+CheckoutProgressSubscriber::~CheckoutProgressSubscriber() {
+  // NOTE: we can't call callback_->done() directly from here as there is no
+  // guarantee that we'd be destroyed on the correct thread!
+}
+
+void CheckoutProgressSubscriber::start() {
+  callback_->getEventBase()->runInEventBaseThread(
+      [self = shared_from_this()]() { self->sendUpdate(); });
+}
+
+void CheckoutProgressSubscriber::sendUpdate() {
+  if (!callback_) {
+    return;
+  }
+
+  if (!callback_->isRequestActive()) {
+    // Peer disconnected, so stop sending updates
+    VLOG(1) << "Checkout progress subscription is no longer active";
+    callback_->done();
+    callback_.reset();
+    return;
+  }
+
+  // Read finished before the counters, so that the final update always
+  // includes every increment made by the checkout.
+  CheckoutProgressInfo info;
+  info.inProgress = progress_ && !progress_->finished.load();
+  if (progress_) {
+    info.treesCompared = progress_->treesCompared.load();
+    info.treesLoaded = progress_->treesLoaded.load();
+    info.actionsStarted = progress_->actionsStarted.load();
+    info.actionsCompleted = progress_->actionsCompleted.load();
+    info.inodesInvalidated = progress_->inodesInvalidated.load();
+  }
+
+  try {
+    callback_->write(info);
+  } catch (const std::exception& exc) {
+    LOG(ERROR) << "Error while sending checkout progress update: "
+               << exc.what();
+  }
+
+  if (!info.inProgress) {
+    callback_->done();
+    callback_.reset();
+    return;
+  }
+  // We are already running on the client's EventBase thread here
+  callback_->getEventBase()->runAfterDelay(
+      [self = shared_from_this()]() { self->sendUpdate(); },
+      FLAGS_checkout_progress_interval_ms);
+}
+}
+}
@@ -0,0 +1,53 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+#include <memory>
+#include "eden/fs/service/gen-cpp2/StreamingEdenService.h"
+
+namespace facebook {
+namespace eden {
+
+struct CheckoutProgress;
+
+/** CheckoutProgressSubscriber pushes snapshots of a checkout's progress
+ * counters to a connected client at a fixed interval until the checkout
+ * finishes.
+ *
+ * All of the work is done on the EventBase thread associated with the
+ * client.  Each scheduled update holds a reference to the subscriber, which
+ * keeps it alive until the final update has been sent.
+ */
+class CheckoutProgressSubscriber
+    : public std::enable_shared_from_this<CheckoutProgressSubscriber> {
+ public:
+  /** progress may be null if no checkout is running, in which case a single
+   * update with inProgress=false is sent. */
+  CheckoutProgressSubscriber(
+      std::unique_ptr<apache::thrift::StreamingHandlerCallback<
+          std::unique_ptr<CheckoutProgressInfo>>> callback,
+      std::shared_ptr<const CheckoutProgress> progress);
+  ~CheckoutProgressSubscriber();
+
+  /** Send the first update, and schedule the following ones. */
+  void start();
+
+ private:
+  /** Send the current counters to the client, and schedule the next update
+   * if the checkout is still running.
+   * This must only be called on the thread associated with the client. */
+  void sendUpdate();
+
+  std::unique_ptr<apache::thrift::StreamingHandlerCallback<
+      std::unique_ptr<CheckoutProgressInfo>>>
+      callback_;
+  std::shared_ptr<const CheckoutProgress> progress_;
+};
+}
+}
@@ -11,25 +11,47 @@
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
+#include <folly/FileUtil.h>
+#include <folly/Optional.h>
 #include <folly/SocketAddress.h>
 #include <folly/String.h>
+#include <folly/futures/Future.h>
 #include <gflags/gflags.h>
+#include <unistd.h>
+#include <chrono>
 #include <thrift/lib/cpp2/server/ThriftServer.h>
 #include <wangle/concurrent/CPUThreadPoolExecutor.h>
 #include <wangle/concurrent/GlobalExecutor.h>
 
 #include "EdenServiceHandler.h"
+#include "common/stats/ServiceData.h"
 #include "eden/fs/config/ClientConfig.h"
 #include "eden/fs/inodes/Dirstate.h"
 #include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/InodeMap.h"
+#include "eden/fs/inodes/TreeInode.h"
 #include "eden/fs/store/EmptyBackingStore.h"
 #include "eden/fs/store/LocalStore.h"
+#include "eden/fs/store/ObjectStore.h"
 #include "eden/fs/store/git/GitBackingStore.h"
 #include "eden/fs/store/hg/HgBackingStore.h"
+#include "eden/fs/takeover/TakeoverClient.h"
 #include "eden/fuse/MountPoint.h"
 #include "eden/fuse/privhelper/PrivHelper.h"
 
 DEFINE_bool(debug, false, "run fuse in debug mode");
+DEFINE_bool(
+    takeover,
+    false,
+    "Take over the mount points of the edenfs process that is already "
+    "running for this eden directory, rather than remounting them");
+
+DEFINE_int32(
+    takeover_store_close_timeout,
+    60,
+    "seconds to wait for our mount points to be destroyed and the local store "
+    "to close after handing them over to another process, before exiting "
+    "without waiting for them");
 
 DEFINE_int32(num_eden_threads, 12, "the number of eden CPU worker threads");
 
@@ -47,9 +69,25 @@ DEFINE_int32(
     200,
     "Minimum response compression size");
 
+DEFINE_int32(
+    unload_interval_minutes,
+    0,
+    "Frequency in minutes of background inode unloading (0 disables it)");
+DEFINE_int32(
+    unload_age_minutes,
+    360,
+    "Minimum time in minutes since an inode was last accessed before the "
+    "background unloader will unload it");
+DEFINE_int64(
+    unload_memory_target_mb,
+    0,
+    "Only unload inodes in the background when the daemon's resident memory "
+    "exceeds this size in megabytes (0 unloads regardless of memory usage)");
+
 using apache::thrift::ThriftServer;
 using folly::StringPiece;
 using std::make_shared;
+using std::make_unique;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -59,6 +97,7 @@ folly::SocketAddress getThriftAddress(
     StringPiece argument,
     StringPiece edenDir);
 std::string getPathToUnixDomainSocket(StringPiece edenDir);
+folly::Optional<uint64_t> getResidentMemoryBytes();
 }
 
 namespace facebook {
@@ -75,6 +114,10 @@ EdenServer::EdenServer(
       rocksPath_(rocksPath) {}
 
 EdenServer::~EdenServer() {
+  if (takeoverServer_) {
+    takeoverServer_->stop();
+  }
+  inodeUnloadScheduler_.shutdown();
   unmountAll();
 }
 
@@ -83,8 +126,10 @@ void EdenServer::unmountAll() {
   // They will each call mountFinished() as they exit.
   {
     std::lock_guard<std::mutex> guard(mountPointsMutex_);
-    for (const auto& mountPoint : mountPoints_) {
-      fusell::privilegedFuseUnmount(mountPoint.first);
+    if (!takeoverShutdown_) {
+      for (const auto& mountPoint : mountPoints_) {
+        fusell::privilegedFuseUnmount(mountPoint.first);
+      }
     }
   }
 
@@ -98,9 +143,19 @@ void EdenServer::unmountAll() {
 }
 
 void EdenServer::run() {
+  // The running process releases the eden lock and closes the local store
+  // once it has handed its mount points over to us, so take them over before
+  // acquiring the lock.
+  folly::Optional<TakeoverData> takeoverData;
+  if (FLAGS_takeover) {
+    takeoverData = takeoverMounts(getTakeoverSocketPath());
+    LOG(INFO) << "received " << takeoverData->mountPoints.size()
+              << " mount points to take over";
+  }
+
   acquireEdenLock();
   createThriftServer();
-  localStore_ = make_shared<LocalStore>(rocksPath_);
+  openLocalStore();
 
   auto pool =
       make_shared<wangle::CPUThreadPoolExecutor>(FLAGS_num_eden_threads);
@@ -108,37 +163,309 @@ void EdenServer::run() {
 
   reloadConfig();
 
-  // Remount existing mount points
+  auto remounts = takeoverData
+      ? startTakeoverMounts(pool.get(), std::move(takeoverData.value()))
+      : startRemounts(pool.get());
+  startTakeoverServer();
+  scheduleInodeUnload();
+  prepareThriftAddress();
+  runThriftServer();
+
+  // Wait for any remounts that are still in progress, since they refer to
+  // this EdenServer.
+  folly::collectAll(remounts).wait();
+}
+
+std::vector<folly::Future<folly::Unit>> EdenServer::startRemounts(
+    folly::Executor* executor) {
+  std::vector<folly::Future<folly::Unit>> remounts;
   folly::dynamic dirs = folly::dynamic::object();
   try {
     dirs = ClientConfig::loadClientDirectoryMap(edenDir_);
   } catch (const std::exception& ex) {
     LOG(ERROR) << "Could not parse config.json file: " << ex.what()
                << " Skipping remount step.";
+    return remounts;
   }
+
+  // Each mount loads its config, scans its overlay, loads its root tree and
+  // talks to the privhelper, so mount them all in parallel rather than
+  // making the thrift server wait for the sum of all of them.
   for (auto& client : dirs.items()) {
-    auto mountInfo = std::make_unique<MountInfo>();
-    mountInfo->mountPoint = client.first.c_str();
+    auto mountPath = client.first.asString();
     auto edenClientPath = edenDir_ + PathComponent("clients") +
         PathComponent(client.second.c_str());
-    mountInfo->edenClientPath = edenClientPath.stringPiece().str();
+    pendingMounts_.starting(mountPath);
+
+    remounts.push_back(folly::via(executor).then([
+      this,
+      mountPath,
+      edenClientPath = edenClientPath.stringPiece().str()
+    ] {
+      auto start = std::chrono::steady_clock::now();
+      auto mountInfo = std::make_unique<MountInfo>();
+      mountInfo->mountPoint = mountPath;
+      mountInfo->edenClientPath = edenClientPath;
+      try {
+        handler_->mount(std::move(mountInfo));
+      } catch (const std::exception& ex) {
+        LOG(ERROR) << "Failed to perform remount for " << mountPath << ": "
+                   << folly::exceptionStr(ex);
+        pendingMounts_.failed(
+            mountPath, folly::exceptionStr(ex).toStdString());
+        return;
+      }
+      pendingMounts_.mounted(mountPath);
+      auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start);
+      LOG(INFO) << "remounted " << mountPath << " in " << duration.count()
+                << "ms";
+    }));
+  }
+  return remounts;
+}
+
+std::vector<folly::Future<folly::Unit>> EdenServer::startTakeoverMounts(
+    folly::Executor* executor,
+    TakeoverData&& takeoverData) {
+  std::vector<folly::Future<folly::Unit>> mounts;
+  for (auto& info : takeoverData.mountPoints) {
+    auto mountPath = info.mountPath.stringPiece().str();
+    pendingMounts_.starting(mountPath);
+
+    mounts.push_back(
+        folly::via(executor).then([ this, mountPath, info = std::move(info) ](
+        ) mutable {
+          auto start = std::chrono::steady_clock::now();
+          try {
+            takeoverMount(std::move(info));
+          } catch (const std::exception& ex) {
+            // The kernel still has the mount point, but nothing is serving
+            // it any more.  It has to be unmounted and remounted by hand.
+            LOG(ERROR) << "Failed to take over " << mountPath << ": "
+                       << folly::exceptionStr(ex);
+            pendingMounts_.failed(
+                mountPath, folly::exceptionStr(ex).toStdString());
+            return;
+          }
+          pendingMounts_.mounted(mountPath);
+          auto duration =
+              std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start);
+          LOG(INFO) << "took over " << mountPath << " in " << duration.count()
+                    << "ms";
+        }));
+  }
+  return mounts;
+}
+
+void EdenServer::takeoverMount(TakeoverData::MountInfo&& info) {
+  auto config = ClientConfig::loadFromClientDirectory(
+      info.mountPath, info.stateDirectory, getConfig().get());
+  auto backingStore =
+      getBackingStore(config->getRepoType(), config->getRepoSource());
+  auto objectStore = make_unique<ObjectStore>(getLocalStore(), backingStore);
+
+  auto edenMount = EdenMount::makeShared(
+      std::move(config),
+      std::move(objectStore),
+      getSocketPath(),
+      getStats(),
+      &info.inodeMap);
+  edenMount->getRootInode()->loadMaterializedChildren().wait();
+
+  // Reopen the files and directories that the kernel still has open, using
+  // the same handle numbers, before any requests can refer to them.
+  edenMount->getDispatcher()->restoreFileHandles(info.fileHandleMap).get();
+
+  startMount(edenMount, std::move(info.channelData));
+}
+
+void EdenServer::startTakeoverServer() {
+  takeoverServer_ = make_unique<TakeoverServer>(getTakeoverSocketPath(), this);
+  takeoverServer_->start();
+}
+
+AbsolutePath EdenServer::getTakeoverSocketPath() const {
+  return edenDir_ + PathComponentPiece{"takeover"};
+}
+
+folly::Future<TakeoverData> EdenServer::startTakeoverShutdown() {
+  {
+    std::lock_guard<std::mutex> guard(mountPointsMutex_);
+    if (takeoverShutdown_) {
+      return folly::makeFuture<TakeoverData>(
+          std::runtime_error("a takeover is already in progress"));
+    }
+    takeoverShutdown_ = true;
+  }
+
+  std::vector<folly::Future<TakeoverData::MountInfo>> futures;
+  for (const auto& edenMount : getMountPoints()) {
+    futures.push_back(edenMount->getMountPoint()->stopForTakeover().then(
+        [edenMount](fusell::FuseChannelData channelData) {
+          // Nothing can use the inodes or file handles until the takeover is
+          // completed or aborted, since the FUSE channel has stopped.
+          auto inodeMap = edenMount->getInodeMap()->save();
+          auto fileHandleMap =
+              edenMount->getDispatcher()->getFileHandles().serialize();
+          return TakeoverData::MountInfo(
+              edenMount->getPath(),
+              edenMount->getConfig()->getClientDirectory(),
+              std::move(channelData),
+              std::move(inodeMap),
+              std::move(fileHandleMap));
+        }));
+  }
+
+  return folly::collectAll(futures).then(
+      [this](std::vector<folly::Try<TakeoverData::MountInfo>> results) {
+        TakeoverData data;
+        for (auto& result : results) {
+          if (result.hasException()) {
+            // Hand over all of the mount points or none of them, since the
+            // ones left behind would not be served once we exit.
+            LOG(ERROR) << "unable to hand over a mount point: "
+                       << result.exception().what();
+            abortTakeover();
+            result.throwIfFailed();
+          }
+          data.mountPoints.push_back(std::move(result.value()));
+        }
+        return data;
+      });
+}
+
+void EdenServer::completeTakeover() {
+  LOG(INFO) << "releasing our mount points to the new edenfs process";
+  // Stop serving thrift requests first, since they could otherwise try to use
+  // the mount points and the local store that we are about to release.
+  stop();
+
+  for (const auto& edenMount : getMountPoints()) {
+    // Otherwise the privhelper would unmount it when we exit.
     try {
-      handler_->mount(std::move(mountInfo));
+      fusell::privilegedFuseTakeoverShutdown(
+          edenMount->getPath().stringPiece());
     } catch (const std::exception& ex) {
-      LOG(ERROR) << "Failed to perform remount for " << client.first.c_str()
-                 << ": " << ex.what();
+      LOG(ERROR) << "error releasing " << edenMount->getPath()
+                 << " from the privhelper: " << folly::exceptionStr(ex);
     }
+    // The kernel will release these handles in the new process.
+    edenMount->getDispatcher()->getFileHandles().clear();
+    edenMount->getMountPoint()->completeTakeover();
   }
-  prepareThriftAddress();
-  runThriftServer();
+  {
+    std::unique_lock<std::mutex> lock(mountPointsMutex_);
+    while (!mountPoints_.empty()) {
+      mountPointsCV_.wait(lock);
+    }
+  }
+
+  // Close the local store before releasing the eden lock, since the new
+  // process opens it as soon as it acquires the lock.  Each EdenMount's
+  // ObjectStore refers to it until the EdenMount has been destroyed, which
+  // also closes its overlay.  The backing stores keep raw pointers to it.
+  backingStores_.wlock()->clear();
+  localStore_.reset();
+  localStoreClosed_->wait(
+      std::chrono::seconds(FLAGS_takeover_store_close_timeout));
+  if (!localStoreClosed_->isReady()) {
+    // Something still refers to one of our mount points.  Exit so that the
+    // kernel releases the store, rather than leave the new process unable to
+    // open it.
+    LOG(ERROR) << "the local store was not closed within "
+               << FLAGS_takeover_store_close_timeout
+               << " seconds of handing over our mount points; exiting now";
+    _exit(1);
+  }
+
+  lockFile_.unlock();
+  lockFile_.close();
+}
+
+void EdenServer::abortTakeover() {
+  for (const auto& edenMount : getMountPoints()) {
+    edenMount->getMountPoint()->resumeAfterTakeover();
+  }
+  std::lock_guard<std::mutex> guard(mountPointsMutex_);
+  takeoverShutdown_ = false;
+}
+
+void EdenServer::scheduleInodeUnload() {
+  if (FLAGS_unload_interval_minutes <= 0) {
+    return;
+  }
+
+  inodeUnloadScheduler_.addFunction(
+      [this] { unloadInodes(); },
+      std::chrono::minutes(FLAGS_unload_interval_minutes),
+      "unload_inodes");
+  inodeUnloadScheduler_.setThreadName("inode_unloader");
+  inodeUnloadScheduler_.start();
+}
+
+void EdenServer::unloadInodes() {
+  if (FLAGS_unload_memory_target_mb > 0) {
+    auto rss = getResidentMemoryBytes();
+    auto target = static_cast<uint64_t>(FLAGS_unload_memory_target_mb) << 20;
+    if (rss.hasValue() && rss.value() < target) {
+      VLOG(3) << "skipping inode unload: resident memory " << rss.value()
+              << " is below target " << target;
+      return;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto cutoff = start - std::chrono::minutes(FLAGS_unload_age_minutes);
+  size_t numUnloaded = 0;
+  InodeCounts totalCounts;
+  for (const auto& edenMount : getMountPoints()) {
+    try {
+      auto rootInode = edenMount->getRootInode();
+      numUnloaded += rootInode->unloadChildrenLastAccessedBefore(cutoff);
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "error unloading inodes for "
+                 << edenMount->getPath().stringPiece() << ": "
+                 << folly::exceptionStr(ex);
+    }
+    auto counts = edenMount->getInodeMap()->getInodeCounts();
+    totalCounts.loadedInodeCount += counts.loadedInodeCount;
+    totalCounts.unloadedInodeCount += counts.unloadedInodeCount;
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  LOG(INFO) << "unloaded " << numUnloaded << " inodes in "
+            << duration.count() << "ms; " << totalCounts.loadedInodeCount
+            << " inodes remain loaded";
+  fbData->setCounter("inodes.loaded", totalCounts.loadedInodeCount);
+  fbData->setCounter("inodes.unloaded", totalCounts.unloadedInodeCount);
+  fbData->setCounter("inodes.unload_sweep.unloaded", numUnloaded);
+  fbData->setCounter("inodes.unload_sweep.duration_ms", duration.count());
 }
 
 void EdenServer::mount(shared_ptr<EdenMount> edenMount) {
+  auto mountPath = edenMount->getPath().stringPiece().str();
+  startMount(std::move(edenMount), folly::none);
+  // This may be a mount point that failed to remount at startup.
+  pendingMounts_.mounted(mountPath);
+}
+
+void EdenServer::startMount(
+    shared_ptr<EdenMount> edenMount,
+    folly::Optional<fusell::FuseChannelData> takeoverData) {
   // Add the mount point to mountPoints_.
   // This also makes sure we don't have this path mounted already
   auto mountPath = edenMount->getPath().stringPiece();
   {
     std::lock_guard<std::mutex> guard(mountPointsMutex_);
+    if (takeoverShutdown_) {
+      throw EdenError(folly::to<string>(
+          "cannot mount \"",
+          mountPath,
+          "\" while handing our mount points over to another process"));
+    }
     auto ret = mountPoints_.emplace(mountPath, edenMount);
     if (!ret.second) {
       // This mount point already exists.
@@ -149,7 +476,12 @@ void EdenServer::mount(shared_ptr<EdenMount> edenMount) {
 
   auto onFinish = [this, edenMount]() { this->mountFinished(edenMount.get()); };
   try {
-    edenMount->getMountPoint()->start(FLAGS_debug, onFinish);
+    if (takeoverData) {
+      edenMount->getMountPoint()->takeoverStart(
+          FLAGS_debug, std::move(takeoverData.value()), onFinish);
+    } else {
+      edenMount->getMountPoint()->start(FLAGS_debug, onFinish);
+    }
   } catch (...) {
     // If we fail to start the mount point, call mountFinished()
     // to make sure it gets removed from mountPoints_.
@@ -161,6 +493,23 @@ void EdenServer::mount(shared_ptr<EdenMount> edenMount) {
     throw;
   }
 
+  // The bind mounts were left in place by the process we took over from.
+  // Have the privhelper unmount them and the mount point when we exit.
+  if (takeoverData) {
+    std::vector<string> bindMounts;
+    for (const auto& bindMount : edenMount->getBindMounts()) {
+      bindMounts.push_back(bindMount.pathInMountDir.stringPiece().str());
+    }
+    try {
+      fusell::privilegedFuseTakeoverStartup(mountPath, bindMounts);
+    } catch (const std::exception& ex) {
+      // The mount point is already being served, so don't fail the takeover.
+      LOG(ERROR) << "error registering " << mountPath
+                 << " with the privhelper: " << folly::exceptionStr(ex);
+    }
+    return;
+  }
+
   // Perform all of the bind mounts associated with the client.
   for (auto& bindMount : edenMount->getBindMounts()) {
     auto pathInMountDir = bindMount.pathInMountDir;
@@ -183,9 +532,18 @@ void EdenServer::mount(shared_ptr<EdenMount> edenMount) {
 }
 
 void EdenServer::unmount(StringPiece mountPath) {
+  // Unmounting a mount point that failed to remount at startup means giving
+  // up on it, so stop reporting the failure.
+  auto wasFailed = pendingMounts_.forgetFailed(mountPath);
   try {
     fusell::privilegedFuseUnmount(mountPath);
   } catch (const std::exception& ex) {
+    if (wasFailed && !getMountOrNull(mountPath)) {
+      // Unless a takeover failed, the kernel never had it mounted.
+      LOG(INFO) << "forgot failed mount point \"" << mountPath
+                << "\": " << folly::exceptionStr(ex);
+      return;
+    }
     LOG(ERROR) << "Failed to perform unmount for \"" << mountPath
                << "\": " << folly::exceptionStr(ex);
     throw;
@@ -221,6 +579,14 @@ EdenServer::MountList EdenServer::getMountPoints() const {
   return results;
 }
 
+std::vector<EdenServer::MountStatus> EdenServer::getMountStatuses() const {
+  std::vector<std::string> mountedPaths;
+  for (const auto& mount : getMountPoints()) {
+    mountedPaths.push_back(mount->getPath().stringPiece().str());
+  }
+  return pendingMounts_.getStatuses(mountedPaths);
+}
+
 shared_ptr<EdenMount> EdenServer::getMount(StringPiece mountPath) const {
   auto mount = getMountOrNull(mountPath);
   if (!mount) {
@@ -301,6 +667,18 @@ void EdenServer::createThriftServer() {
   server_->setAddress(address);
 }
 
+void EdenServer::openLocalStore() {
+  // Record when the store is actually closed, which only happens once every
+  // ObjectStore referring to it has been destroyed.
+  auto closed = std::make_shared<folly::Promise<folly::Unit>>();
+  localStoreClosed_ = closed->getFuture();
+  localStore_ = shared_ptr<LocalStore>(
+      new LocalStore(rocksPath_), [closed](LocalStore* store) {
+        delete store;
+        closed->setValue();
+      });
+}
+
 void EdenServer::acquireEdenLock() {
   boost::filesystem::path edenPath{edenDir_.stringPiece().str()};
   boost::filesystem::path lockPath = edenPath / "lock";
@@ -388,4 +766,26 @@ std::string getPathToUnixDomainSocket(StringPiece edenDir) {
   return socketPath.string();
 }
 
+/*
+ * Get the resident set size of this process, or folly::none if it cannot be
+ * determined.
+ */
+folly::Optional<uint64_t> getResidentMemoryBytes() {
+  std::string statm;
+  if (!folly::readFile("/proc/self/statm", statm)) {
+    return folly::none;
+  }
+  // The second field of /proc/self/statm is the resident set size, in pages.
+  std::vector<StringPiece> fields;
+  folly::split(' ', statm, fields);
+  if (fields.size() < 2) {
+    return folly::none;
+  }
+  try {
+    return folly::to<uint64_t>(fields[1]) * sysconf(_SC_PAGESIZE);
+  } catch (const std::range_error& ex) {
+    return folly::none;
+  }
+}
+
 } // unnamed namespace
@@ -10,18 +10,24 @@
 #pragma once
 
 #include <folly/File.h>
+#include <folly/Optional.h>
 #include <folly/Range.h>
 #include <folly/SocketAddress.h>
 #include <folly/Synchronized.h>
 #include <folly/ThreadLocal.h>
+#include <folly/experimental/FunctionScheduler.h>
 #include <folly/experimental/StringKeyedMap.h>
+#include <folly/futures/Future.h>
 #include <condition_variable>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "eden/fs/config/InterpolatedPropertyTree.h"
+#include "eden/fs/service/PendingMounts.h"
+#include "eden/fs/takeover/TakeoverServer.h"
 #include "eden/fuse/EdenStats.h"
 #include "eden/utils/PathFuncs.h"
 
@@ -31,6 +37,10 @@ class ThriftServer;
 }
 }
 
+namespace folly {
+class Executor;
+}
+
 namespace facebook {
 namespace eden {
 
@@ -47,13 +57,16 @@ class LocalStore;
  * for a particular location, then starts the thrift management server
  * and the fuse session.
  */
-class EdenServer {
+class EdenServer : private TakeoverHandler {
  public:
   using ConfigData = InterpolatedPropertyTree;
   using MountList = std::vector<std::shared_ptr<EdenMount>>;
   using MountMap = folly::StringKeyedMap<std::shared_ptr<EdenMount>>;
   using DirstateMap = folly::StringKeyedMap<std::shared_ptr<Dirstate>>;
 
+  using MountState = PendingMounts::State;
+  using MountStatus = PendingMounts::Status;
+
   EdenServer(
       AbsolutePathPiece edenDir,
       AbsolutePathPiece etcEdenDir,
@@ -67,6 +80,14 @@ class EdenServer {
    * This is primarily responsible for running the thrift server loop.
    * run() will not return until stop() is called in another thread.
    *
+   * The mount points listed in the client directory map are remounted in
+   * parallel on the CPU thread pool.  The thrift server starts without
+   * waiting for them, and getMountStatuses() reports their progress.
+   *
+   * With --takeover, the mount points are instead taken over from the
+   * edenfs process that is already running for this eden directory, without
+   * unmounting them.
+   *
    * When run() returns there may still be outstanding FUSE mount points
    * running.  (These are driven by a separate FUSE thread pool.)
    * unmountAll() can be called after run() returns to unmount all mount
@@ -92,12 +113,17 @@ class EdenServer {
 
   /**
    * Unmount an EdenMount.
+   *
+   * This also forgets a mount point that failed to remount at startup.
    */
   void unmount(folly::StringPiece mountPath);
 
   /**
    * Unmount all mount points maintained by this server, and wait for them to
    * be completely unmounted.
+   *
+   * If the mount points have been handed over to another process this only
+   * waits for them to stop.
    */
   void unmountAll();
 
@@ -112,6 +138,12 @@ class EdenServer {
 
   MountList getMountPoints() const;
 
+  /**
+   * Get the state of every mount point: the ones that are mounted, and the
+   * ones that are still being remounted or failed to remount at startup.
+   */
+  std::vector<MountStatus> getMountStatuses() const;
+
   /**
    * Look up an EdenMount by the path where it is mounted.
    *
@@ -156,6 +188,19 @@ class EdenServer {
     return &edenStats_;
   }
 
+  /**
+   * Unload inodes that have not been accessed recently from all mount points.
+   *
+   * Inodes are only unloaded if the daemon's resident memory is above
+   * --unload_memory_target_mb (or if no target is set), and only if they have
+   * not been accessed in the last --unload_age_minutes.
+   *
+   * This is normally invoked periodically in a background thread, every
+   * --unload_interval_minutes.  It updates the inodes.* counters with the
+   * results.
+   */
+  void unloadInodes();
+
  private:
   using BackingStoreKey = std::pair<std::string, std::string>;
   using BackingStoreMap =
@@ -171,7 +216,25 @@ class EdenServer {
   void runThriftServer();
   void createThriftServer();
   void acquireEdenLock();
+  void openLocalStore();
   void prepareThriftAddress();
+  void scheduleInodeUnload();
+  std::vector<folly::Future<folly::Unit>> startRemounts(
+      folly::Executor* executor);
+  std::vector<folly::Future<folly::Unit>> startTakeoverMounts(
+      folly::Executor* executor,
+      TakeoverData&& takeoverData);
+  void takeoverMount(TakeoverData::MountInfo&& info);
+  void startMount(
+      std::shared_ptr<EdenMount> edenMount,
+      folly::Optional<fusell::FuseChannelData> takeoverData);
+  void startTakeoverServer();
+  AbsolutePath getTakeoverSocketPath() const;
+
+  // TakeoverHandler methods
+  folly::Future<TakeoverData> startTakeoverShutdown() override;
+  void completeTakeover() override;
+  void abortTakeover() override;
 
   // Called when a mount has been unmounted and has stopped.
   void mountFinished(EdenMount* mountPoint);
@@ -195,12 +258,41 @@ class EdenServer {
   std::shared_ptr<apache::thrift::ThriftServer> server_;
 
   std::shared_ptr<LocalStore> localStore_;
+  /**
+   * Completes once the LocalStore has been destroyed, which happens after
+   * localStore_ and every ObjectStore using it have released it.
+   */
+  folly::Optional<folly::Future<folly::Unit>> localStoreClosed_;
   folly::Synchronized<BackingStoreMap> backingStores_;
 
   mutable std::mutex mountPointsMutex_;
   std::condition_variable mountPointsCV_;
   MountMap mountPoints_;
+  /**
+   * Set while the mount points are being handed over to another process,
+   * during which they must not be unmounted and no new mount points can be
+   * added.  This is cleared again if the takeover is aborted.  Protected by
+   * mountPointsMutex_.
+   */
+  bool takeoverShutdown_{false};
   mutable folly::ThreadLocal<fusell::EdenStats> edenStats_;
+
+  /**
+   * The mount points being remounted at startup, or that failed to remount.
+   */
+  PendingMounts pendingMounts_;
+
+  /**
+   * Runs the periodic background inode unloading.
+   */
+  folly::FunctionScheduler inodeUnloadScheduler_;
+
+  /**
+   * Listens for a new edenfs process that wants to take over our mount
+   * points.  This is destroyed first, so that any takeover in progress
+   * finishes sending its data before the rest of the server goes away.
+   */
+  std::unique_ptr<TakeoverServer> takeoverServer_;
 };
 }
 } // facebook::eden
@@ -14,6 +14,8 @@
 #include <folly/String.h>
 #include <folly/Subprocess.h>
 #include <folly/futures/Future.h>
+#include <gflags/gflags.h>
+#include <algorithm>
 #include <unordered_set>
 #include "EdenError.h"
 #include "EdenServer.h"
@@ -30,6 +32,7 @@
 #include "eden/fs/model/Hash.h"
 #include "eden/fs/model/Tree.h"
 #include "eden/fs/model/TreeEntry.h"
+#include "eden/fs/service/CheckoutProgressSubscriber.h"
 #include "eden/fs/service/GlobNode.h"
 #include "eden/fs/service/StreamingSubscriber.h"
 #include "eden/fs/service/ThriftUtil.h"
@@ -37,6 +40,13 @@
 #include "eden/fs/store/LocalStore.h"
 #include "eden/fs/store/ObjectStore.h"
 #include "eden/fuse/MountPoint.h"
+#include "eden/utils/RequestTrace.h"
+
+DEFINE_int32(
+    max_concurrent_paths_per_request,
+    64,
+    "The maximum number of paths that a single getSHA1 or getFileInformation "
+    "call looks up at once");
 
 using std::make_unique;
 using std::string;
@@ -50,6 +60,77 @@ using folly::StringPiece;
 namespace facebook {
 namespace eden {
 
+namespace {
+/**
+ * The number of paths a batch request may have in flight at once.
+ *
+ * This keeps one large request from queueing up so many inode loads and
+ * backing store fetches that every other request has to wait behind them.
+ */
+size_t getMaxConcurrentPaths() {
+  return std::max(FLAGS_max_concurrent_paths_per_request, 1);
+}
+
+/**
+ * Look up the inodes for the paths passed to a batch request, and apply func
+ * to each of them.
+ *
+ * The inodes are looked up with EdenMount::getInodes(), so each directory
+ * shared by several paths is only loaded once.  At most
+ * getMaxConcurrentPaths() inodes are loaded at a time, and func is then
+ * applied to at most that many inodes at a time.  The results are returned
+ * in the same order as paths; a malformed path or a failed lookup only fails
+ * the result for that path.
+ *
+ * Unless allowEmptyPath is true, the empty path (which would otherwise refer
+ * to the root directory) is rejected with EINVAL.
+ */
+template <typename T, typename Func>
+Future<vector<folly::Try<T>>> applyToInodes(
+    const std::shared_ptr<EdenMount>& edenMount,
+    const vector<string>& paths,
+    bool allowEmptyPath,
+    Func func) {
+  auto results = std::make_shared<vector<folly::Try<T>>>(paths.size());
+  vector<RelativePath> relativePaths;
+  vector<size_t> indices;
+  relativePaths.reserve(paths.size());
+  indices.reserve(paths.size());
+  for (size_t n = 0; n < paths.size(); ++n) {
+    try {
+      if (!allowEmptyPath && paths[n].empty()) {
+        throw newEdenError(EINVAL, "path cannot be the empty string");
+      }
+      relativePaths.emplace_back(paths[n]);
+      indices.push_back(n);
+    } catch (const std::exception& ex) {
+      (*results)[n] =
+          folly::Try<T>(folly::exception_wrapper{std::current_exception(), ex});
+    }
+  }
+
+  return edenMount->getInodes(std::move(relativePaths), getMaxConcurrentPaths())
+      .then([ edenMount, func, results, indices = std::move(indices) ](
+          vector<folly::Try<InodePtr>>&& inodes) {
+        auto futures = folly::window(
+            std::move(inodes),
+            [func](const folly::Try<InodePtr>& inode) {
+              return folly::makeFutureWith(
+                  [&] { return func(inode.value()); });
+            },
+            getMaxConcurrentPaths());
+        return folly::collectAll(futures).then(
+            [ results, indices = std::move(indices) ](
+                vector<folly::Try<T>>&& done) {
+              for (size_t n = 0; n < done.size(); ++n) {
+                (*results)[indices[n]] = std::move(done[n]);
+              }
+              return std::move(*results);
+            });
+      });
+}
+}
+
 EdenServiceHandler::EdenServiceHandler(EdenServer* server)
     : FacebookBase2("Eden"), server_(server) {}
 
@@ -170,6 +251,26 @@ void EdenServiceHandler::listMounts(std::vector<MountInfo>& results) {
   }
 }
 
+void EdenServiceHandler::getMountStatuses(std::vector<MountStatus>& results) {
+  for (const auto& status : server_->getMountStatuses()) {
+    MountStatus result;
+    result.mountPoint = status.mountPoint;
+    switch (status.state) {
+      case EdenServer::MountState::INITIALIZING:
+        result.state = MountState::INITIALIZING;
+        break;
+      case EdenServer::MountState::READY:
+        result.state = MountState::READY;
+        break;
+      case EdenServer::MountState::FAILED:
+        result.state = MountState::FAILED;
+        break;
+    }
+    result.error = status.error;
+    results.push_back(std::move(result));
+  }
+}
+
 void EdenServiceHandler::getCurrentSnapshot(
     std::string& result,
     std::unique_ptr<std::string> mountPoint) {
@@ -177,16 +278,32 @@ void EdenServiceHandler::getCurrentSnapshot(
   result = thriftHash(edenMount->getSnapshotID());
 }
 
-void EdenServiceHandler::checkOutRevision(
-    std::vector<CheckoutConflict>& results,
+Future<unique_ptr<vector<CheckoutConflict>>>
+EdenServiceHandler::future_checkOutRevision(
     std::unique_ptr<std::string> mountPoint,
     std::unique_ptr<std::string> hash,
     bool force) {
   auto hashObj = hashFromThrift(*hash);
 
   auto edenMount = server_->getMount(*mountPoint);
-  auto checkoutFuture = edenMount->checkout(hashObj, force);
-  results = checkoutFuture.get();
+  return edenMount->checkout(hashObj, force)
+      .then([edenMount](vector<CheckoutConflict>&& conflicts) {
+        return make_unique<vector<CheckoutConflict>>(std::move(conflicts));
+      });
+}
+
+Future<unique_ptr<CheckoutDryRunResult>>
+EdenServiceHandler::future_checkOutRevisionDryRun(
+    std::unique_ptr<std::string> mountPoint,
+    std::unique_ptr<std::string> hash,
+    bool force) {
+  auto hashObj = hashFromThrift(*hash);
+
+  auto edenMount = server_->getMount(*mountPoint);
+  return edenMount->checkoutDryRun(hashObj, force)
+      .then([edenMount](CheckoutDryRunResult&& result) {
+        return make_unique<CheckoutDryRunResult>(std::move(result));
+      });
 }
 
 void EdenServiceHandler::resetParentCommit(
@@ -197,58 +314,38 @@ void EdenServiceHandler::resetParentCommit(
   edenMount->resetCommit(hashObj);
 }
 
-void EdenServiceHandler::getSHA1(
-    vector<SHA1Result>& out,
+Future<unique_ptr<vector<SHA1Result>>> EdenServiceHandler::future_getSHA1(
     unique_ptr<string> mountPoint,
     unique_ptr<vector<string>> paths) {
-  vector<Future<Hash>> futures;
-  for (const auto& path : *paths) {
-    futures.emplace_back(getSHA1ForPathDefensively(*mountPoint, path));
-  }
-
-  auto results = folly::collectAll(std::move(futures)).get();
-  for (auto& result : results) {
-    out.emplace_back();
-    SHA1Result& sha1Result = out.back();
-    if (result.hasValue()) {
-      sha1Result.set_sha1(thriftHash(result.value()));
-    } else {
-      sha1Result.set_error(newEdenError(result.exception()));
-    }
-  }
-}
-
-Future<Hash> EdenServiceHandler::getSHA1ForPathDefensively(
-    StringPiece mountPoint,
-    StringPiece path) noexcept {
-  // Calls getSHA1ForPath() and traps all immediate exceptions and converts
-  // them in to a Future result.
-  try {
-    return getSHA1ForPath(mountPoint, path);
-  } catch (const std::system_error& e) {
-    return makeFuture<Hash>(newEdenError(e));
-  }
-}
-
-Future<Hash> EdenServiceHandler::getSHA1ForPath(
-    StringPiece mountPoint,
-    StringPiece path) {
-  if (path.empty()) {
-    return makeFuture<Hash>(
-        newEdenError(EINVAL, "path cannot be the empty string"));
-  }
-
-  auto edenMount = server_->getMount(mountPoint);
-  auto relativePath = RelativePathPiece{path};
-  return edenMount->getInode(relativePath).then([](const InodePtr& inode) {
-    auto fileInode = inode.asFilePtr();
-    if (!S_ISREG(fileInode->getMode())) {
-      // We intentionally want to refuse to compute the SHA1 of symlinks
-      return makeFuture<Hash>(
-          InodeError(EINVAL, fileInode, "file is a symlink"));
-    }
-    return fileInode->getSHA1();
-  });
+  auto edenMount = server_->getMount(*mountPoint);
+  return applyToInodes<Hash>(
+             edenMount,
+             *paths,
+             /* allowEmptyPath */ false,
+             [](const InodePtr& inode) {
+               auto fileInode = inode.asFilePtr();
+               if (!S_ISREG(fileInode->getMode())) {
+                 // We intentionally want to refuse to compute the SHA1 of
+                 // symlinks
+                 return makeFuture<Hash>(
+                     InodeError(EINVAL, fileInode, "file is a symlink"));
+               }
+               return fileInode->getSHA1();
+             })
+      .then([](vector<folly::Try<Hash>>&& results) {
+        auto out = make_unique<vector<SHA1Result>>();
+        out->reserve(results.size());
+        for (auto& result : results) {
+          out->emplace_back();
+          SHA1Result& sha1Result = out->back();
+          if (result.hasValue()) {
+            sha1Result.set_sha1(thriftHash(result.value()));
+          } else {
+            sha1Result.set_error(newEdenError(result.exception()));
+          }
+        }
+        return out;
+      });
 }
 
 void EdenServiceHandler::getBindMounts(
@@ -292,6 +389,18 @@ void EdenServiceHandler::async_tm_subscribe(
   sub->subscribe();
 }
 
+void EdenServiceHandler::async_tm_subscribeCheckoutProgress(
+    std::unique_ptr<apache::thrift::StreamingHandlerCallback<
+        std::unique_ptr<CheckoutProgressInfo>>> callback,
+    std::unique_ptr<std::string> mountPoint) {
+  auto edenMount = server_->getMount(*mountPoint);
+  auto sub = std::make_shared<CheckoutProgressSubscriber>(
+      std::move(callback), edenMount->getCheckoutProgress());
+  // The subscriber keeps itself alive through the callbacks it schedules on
+  // the client's EventBase until it has sent its final update.
+  sub->start();
+}
+
 void EdenServiceHandler::getFilesChangedSince(
     FileDelta& out,
     std::unique_ptr<std::string> mountPoint,
@@ -337,67 +446,80 @@ void EdenServiceHandler::getFilesChangedSince(
   }
 }
 
-void EdenServiceHandler::getFileInformation(
-    std::vector<FileInformationOrError>& out,
+Future<unique_ptr<vector<FileInformationOrError>>>
+EdenServiceHandler::future_getFileInformation(
     std::unique_ptr<std::string> mountPoint,
     std::unique_ptr<std::vector<std::string>> paths) {
   auto edenMount = server_->getMount(*mountPoint);
-  auto rootInode = edenMount->getRootInode();
-
-  for (auto& path : *paths) {
-    FileInformationOrError result;
-
-    try {
-      auto relativePath = RelativePathPiece{path};
-      auto inodeBase = edenMount->getInodeBlocking(relativePath);
-
-      // we've reached the item of interest.
-      auto attr = inodeBase->getattr().get();
-      FileInformation info;
-      info.size = attr.st.st_size;
-      info.mtime.seconds = attr.st.st_mtim.tv_sec;
-      info.mtime.nanoSeconds = attr.st.st_mtim.tv_nsec;
-      info.mode = attr.st.st_mode;
-
-      result.set_info(info);
-      out.emplace_back(std::move(result));
-
-    } catch (const std::system_error& e) {
-      result.set_error(newEdenError(e));
-      out.emplace_back(std::move(result));
-    }
-  }
+  return applyToInodes<FileInformation>(
+             edenMount,
+             *paths,
+             /* allowEmptyPath */ true,
+             [](const InodePtr& inode) {
+               return inode->getattr().then(
+                   [](const fusell::Dispatcher::Attr& attr) {
+                     FileInformation info;
+                     info.size = attr.st.st_size;
+                     info.mtime.seconds = attr.st.st_mtim.tv_sec;
+                     info.mtime.nanoSeconds = attr.st.st_mtim.tv_nsec;
+                     info.mode = attr.st.st_mode;
+                     return info;
+                   });
+             })
+      .then([](vector<folly::Try<FileInformation>>&& results) {
+        auto out = make_unique<vector<FileInformationOrError>>();
+        out->reserve(results.size());
+        for (auto& result : results) {
+          out->emplace_back();
+          if (result.hasValue()) {
+            out->back().set_info(result.value());
+          } else {
+            out->back().set_error(newEdenError(result.exception()));
+          }
+        }
+        return out;
+      });
 }
 
-void EdenServiceHandler::glob(
-    vector<string>& out,
+Future<unique_ptr<vector<string>>> EdenServiceHandler::future_glob(
     unique_ptr<string> mountPoint,
     unique_ptr<vector<string>> globs) {
   auto edenMount = server_->getMount(*mountPoint);
   auto rootInode = edenMount->getRootInode();
 
   // Compile the list of globs into a tree
-  GlobNode globRoot;
+  auto globRoot = std::make_shared<GlobNode>();
   for (auto& globString : *globs) {
-    globRoot.parse(globString);
+    globRoot->parse(globString);
   }
 
-  // and evaluate it against the root
-  auto matches = globRoot.evaluate(RelativePathPiece(), rootInode).get();
-  for (auto& fileName : matches) {
-    out.emplace_back(fileName.stringPiece().toString());
-  }
+  // and evaluate it against the root.  globRoot must stay alive until the
+  // evaluation completes.
+  return globRoot->evaluate(RelativePathPiece(), rootInode)
+      .then([globRoot](std::unordered_set<RelativePath>&& matches) {
+        auto out = make_unique<vector<string>>();
+        out->reserve(matches.size());
+        for (auto& fileName : matches) {
+          out->emplace_back(fileName.stringPiece().toString());
+        }
+        return out;
+      });
 }
 
-void EdenServiceHandler::scmGetStatus(
-    ThriftHgStatus& out,
-    std::unique_ptr<std::string> mountPoint,
+Future<unique_ptr<ThriftHgStatus>> EdenServiceHandler::future_scmGetStatus(
+    unique_ptr<string> mountPoint,
     bool listIgnored) {
-  auto dirstate = server_->getMount(*mountPoint)->getDirstate();
+  auto mount = server_->getMount(*mountPoint);
+  auto dirstate = mount->getDirstate();
   DCHECK(dirstate != nullptr) << "Failed to get dirstate for "
                               << mountPoint.get();
 
-  out = dirstate->getStatus(listIgnored);
+  // Hold a reference to the mount until the status is computed, since the
+  // Dirstate is owned by it.
+  return dirstate->getStatus(listIgnored).then(
+      [mount](ThriftHgStatus&& status) {
+        return make_unique<ThriftHgStatus>(std::move(status));
+      });
 }
 
 void EdenServiceHandler::scmAdd(
@@ -468,98 +590,141 @@ void EdenServiceHandler::scmMarkCommitted(
   dirstate->markCommitted(hash, pathsToClean, pathsToDrop);
 }
 
-void EdenServiceHandler::debugGetScmTree(
-    vector<ScmTreeEntry>& entries,
+Future<unique_ptr<vector<ScmTreeEntry>>>
+EdenServiceHandler::future_debugGetScmTree(
     unique_ptr<string> mountPoint,
     unique_ptr<string> idStr,
     bool localStoreOnly) {
   auto edenMount = server_->getMount(*mountPoint);
   auto id = hashFromThrift(*idStr);
 
-  std::unique_ptr<Tree> tree;
   auto store = edenMount->getObjectStore();
-  if (localStoreOnly) {
-    auto localStore = store->getLocalStore();
-    tree = localStore->getTree(id);
-  } else {
-    tree = store->getTreeFuture(id).get();
-  }
-
-  if (!tree) {
-    throw newEdenError("no tree found for id ", *idStr);
-  }
+  auto treeFuture = localStoreOnly
+      ? makeFuture(store->getLocalStore()->getTree(id))
+      : store->getTreeFuture(id);
+
+  return treeFuture.then([ edenMount, idStr = std::move(idStr) ](
+      std::unique_ptr<Tree> tree) {
+    if (!tree) {
+      throw newEdenError("no tree found for id ", *idStr);
+    }
 
-  for (const auto& entry : tree->getTreeEntries()) {
-    entries.emplace_back();
-    auto& out = entries.back();
-    out.name = entry.getName().stringPiece().str();
-    out.mode = entry.getMode();
-    out.id = thriftHash(entry.getHash());
-  }
+    auto entries = make_unique<vector<ScmTreeEntry>>();
+    for (const auto& entry : tree->getTreeEntries()) {
+      entries->emplace_back();
+      auto& out = entries->back();
+      out.name = entry.getName().stringPiece().str();
+      out.mode = entry.getMode();
+      out.id = thriftHash(entry.getHash());
+    }
+    return entries;
+  });
 }
 
-void EdenServiceHandler::debugGetScmBlob(
-    string& data,
+Future<unique_ptr<string>> EdenServiceHandler::future_debugGetScmBlob(
     unique_ptr<string> mountPoint,
     unique_ptr<string> idStr,
     bool localStoreOnly) {
   auto edenMount = server_->getMount(*mountPoint);
   auto id = hashFromThrift(*idStr);
 
-  std::unique_ptr<Blob> blob;
   auto store = edenMount->getObjectStore();
-  if (localStoreOnly) {
-    auto localStore = store->getLocalStore();
-    blob = localStore->getBlob(id);
-  } else {
-    blob = store->getBlobFuture(id).get();
-  }
-
-  if (!blob) {
-    throw newEdenError("no blob found for id ", *idStr);
-  }
-  auto dataBuf = blob->getContents().cloneCoalescedAsValue();
-  data.assign(reinterpret_cast<const char*>(dataBuf.data()), dataBuf.length());
+  auto blobFuture = localStoreOnly
+      ? makeFuture(store->getLocalStore()->getBlob(id))
+      : store->getBlobFuture(id);
+
+  return blobFuture.then([ edenMount, idStr = std::move(idStr) ](
+      std::unique_ptr<Blob> blob) {
+    if (!blob) {
+      throw newEdenError("no blob found for id ", *idStr);
+    }
+    auto dataBuf = blob->getContents().cloneCoalescedAsValue();
+    return make_unique<string>(
+        reinterpret_cast<const char*>(dataBuf.data()), dataBuf.length());
+  });
 }
 
-void EdenServiceHandler::debugGetScmBlobMetadata(
-    ScmBlobMetadata& result,
+Future<unique_ptr<ScmBlobMetadata>>
+EdenServiceHandler::future_debugGetScmBlobMetadata(
     unique_ptr<string> mountPoint,
     unique_ptr<string> idStr,
     bool localStoreOnly) {
   auto edenMount = server_->getMount(*mountPoint);
   auto id = hashFromThrift(*idStr);
 
-  Optional<BlobMetadata> metadata;
   auto store = edenMount->getObjectStore();
-  if (localStoreOnly) {
-    auto localStore = store->getLocalStore();
-    metadata = localStore->getBlobMetadata(id);
-  } else {
-    metadata = store->getBlobMetadata(id).get();
-  }
-
-  if (!metadata.hasValue()) {
-    throw newEdenError("no blob metadata found for id ", *idStr);
-  }
-  result.size = metadata->size;
-  result.contentsSha1 = thriftHash(metadata->sha1);
+  auto metadataFuture = localStoreOnly
+      ? makeFuture(store->getLocalStore()->getBlobMetadata(id))
+      : store->getBlobMetadata(id).then([](BlobMetadata&& metadata) {
+          return Optional<BlobMetadata>(std::move(metadata));
+        });
+
+  return metadataFuture.then([ edenMount, idStr = std::move(idStr) ](
+      Optional<BlobMetadata> metadata) {
+    if (!metadata.hasValue()) {
+      throw newEdenError("no blob metadata found for id ", *idStr);
+    }
+    auto result = make_unique<ScmBlobMetadata>();
+    result->size = metadata->size;
+    result->contentsSha1 = thriftHash(metadata->sha1);
+    return result;
+  });
 }
 
-void EdenServiceHandler::debugInodeStatus(
-    vector<TreeInodeDebugInfo>& inodeInfo,
+Future<unique_ptr<vector<TreeInodeDebugInfo>>>
+EdenServiceHandler::future_debugInodeStatus(
     unique_ptr<string> mountPoint,
     std::unique_ptr<std::string> path) {
   auto edenMount = server_->getMount(*mountPoint);
 
-  TreeInodePtr inode;
-  if (path->empty()) {
-    inode = edenMount->getRootInode();
-  } else {
-    inode = edenMount->getInode(RelativePathPiece{*path}).get().asTreePtr();
+  auto inodeFuture = path->empty()
+      ? makeFuture<InodePtr>(edenMount->getRootInode())
+      : edenMount->getInode(RelativePathPiece{*path});
+
+  return inodeFuture.then([edenMount](const InodePtr& inode) {
+    auto inodeInfo = make_unique<vector<TreeInodeDebugInfo>>();
+    inode.asTreePtr()->getDebugStatus(*inodeInfo);
+    return inodeInfo;
+  });
+}
+
+namespace {
+FuseRequestTrace toThrift(const RequestTrace::Info& info) {
+  FuseRequestTrace trace;
+  trace.requestId = info.requestId;
+  trace.operation = info.operation;
+  trace.inodeNumber = info.inodeNumber;
+  trace.pid = info.pid;
+  trace.durationUs = info.duration.count();
+  trace.finished = info.finished;
+  for (const auto& fetchInfo : info.fetches) {
+    trace.fetches.emplace_back();
+    auto& fetch = trace.fetches.back();
+    fetch.type = fetchInfo.type;
+    fetch.id = fetchInfo.id;
+    fetch.startOffsetUs = fetchInfo.startOffset.count();
+    fetch.durationUs = fetchInfo.duration.count();
+    fetch.finished = fetchInfo.finished;
   }
+  return trace;
+}
+}
 
-  inode->getDebugStatus(inodeInfo);
+void EdenServiceHandler::debugGetFuseRequests(
+    FuseRequestTraces& result,
+    unique_ptr<string> mountPoint,
+    int32_t maxSlowest) {
+  auto edenMount = server_->getMount(*mountPoint);
+  auto& tracer = edenMount->getDispatcher()->getTracer();
+
+  for (const auto& info : tracer.getOutstanding()) {
+    result.outstanding.push_back(toThrift(info));
+  }
+  if (maxSlowest > 0) {
+    for (const auto& info : tracer.getSlowest(maxSlowest)) {
+      result.slowest.push_back(toThrift(info));
+    }
+  }
 }
 
 void EdenServiceHandler::shutdown() {
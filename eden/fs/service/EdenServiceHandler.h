@@ -21,7 +21,6 @@ class Future;
 namespace facebook {
 namespace eden {
 
-class Hash;
 class EdenServer;
 class TreeInode;
 
@@ -40,13 +39,25 @@ class EdenServiceHandler : virtual public StreamingEdenServiceSvIf,
   void unmount(std::unique_ptr<std::string> mountPoint) override;
 
   void listMounts(std::vector<MountInfo>& results) override;
+  void getMountStatuses(std::vector<MountStatus>& results) override;
 
   void getCurrentSnapshot(
       std::string& result,
       std::unique_ptr<std::string> mountPoint) override;
 
-  void checkOutRevision(
-      std::vector<CheckoutConflict>& results,
+  void async_tm_subscribeCheckoutProgress(
+      std::unique_ptr<apache::thrift::StreamingHandlerCallback<
+          std::unique_ptr<CheckoutProgressInfo>>> callback,
+      std::unique_ptr<std::string> mountPoint) override;
+
+  folly::Future<std::unique_ptr<std::vector<CheckoutConflict>>>
+  future_checkOutRevision(
+      std::unique_ptr<std::string> mountPoint,
+      std::unique_ptr<std::string> hash,
+      bool force) override;
+
+  folly::Future<std::unique_ptr<CheckoutDryRunResult>>
+  future_checkOutRevisionDryRun(
       std::unique_ptr<std::string> mountPoint,
       std::unique_ptr<std::string> hash,
       bool force) override;
@@ -59,8 +70,7 @@ class EdenServiceHandler : virtual public StreamingEdenServiceSvIf,
       std::vector<std::string>& out,
       std::unique_ptr<std::string> mountPoint) override;
 
-  void getSHA1(
-      std::vector<SHA1Result>& out,
+  folly::Future<std::unique_ptr<std::vector<SHA1Result>>> future_getSHA1(
       std::unique_ptr<std::string> mountPoint,
       std::unique_ptr<std::vector<std::string>> paths) override;
 
@@ -73,13 +83,12 @@ class EdenServiceHandler : virtual public StreamingEdenServiceSvIf,
       std::unique_ptr<std::string> mountPoint,
       std::unique_ptr<JournalPosition> fromPosition) override;
 
-  void getFileInformation(
-      std::vector<FileInformationOrError>& out,
+  folly::Future<std::unique_ptr<std::vector<FileInformationOrError>>>
+  future_getFileInformation(
       std::unique_ptr<std::string> mountPoint,
       std::unique_ptr<std::vector<std::string>> paths) override;
 
-  void glob(
-      std::vector<std::string>& out,
+  folly::Future<std::unique_ptr<std::vector<std::string>>> future_glob(
       std::unique_ptr<std::string> mountPoint,
       std::unique_ptr<std::vector<std::string>> globs) override;
 
@@ -88,8 +97,7 @@ class EdenServiceHandler : virtual public StreamingEdenServiceSvIf,
           std::unique_ptr<JournalPosition>>> callback,
       std::unique_ptr<std::string> mountPoint) override;
 
-  void scmGetStatus(
-      ThriftHgStatus& out,
+  folly::Future<std::unique_ptr<ThriftHgStatus>> future_scmGetStatus(
       std::unique_ptr<std::string> mountPoint,
       bool listIgnored) override;
 
@@ -110,29 +118,33 @@ class EdenServiceHandler : virtual public StreamingEdenServiceSvIf,
       std::unique_ptr<std::vector<std::string>> pathsToClear,
       std::unique_ptr<std::vector<std::string>> pathsToDrop) override;
 
-  void debugGetScmTree(
-      std::vector<ScmTreeEntry>& entries,
+  folly::Future<std::unique_ptr<std::vector<ScmTreeEntry>>>
+  future_debugGetScmTree(
       std::unique_ptr<std::string> mountPoint,
       std::unique_ptr<std::string> id,
       bool localStoreOnly) override;
 
-  void debugGetScmBlob(
-      std::string& data,
+  folly::Future<std::unique_ptr<std::string>> future_debugGetScmBlob(
       std::unique_ptr<std::string> mountPoint,
       std::unique_ptr<std::string> id,
       bool localStoreOnly) override;
 
-  void debugGetScmBlobMetadata(
-      ScmBlobMetadata& metadata,
+  folly::Future<std::unique_ptr<ScmBlobMetadata>>
+  future_debugGetScmBlobMetadata(
       std::unique_ptr<std::string> mountPoint,
       std::unique_ptr<std::string> id,
       bool localStoreOnly) override;
 
-  void debugInodeStatus(
-      std::vector<TreeInodeDebugInfo>& inodeInfo,
+  folly::Future<std::unique_ptr<std::vector<TreeInodeDebugInfo>>>
+  future_debugInodeStatus(
       std::unique_ptr<std::string> mountPoint,
       std::unique_ptr<std::string> path) override;
 
+  void debugGetFuseRequests(
+      FuseRequestTraces& result,
+      std::unique_ptr<std::string> mountPoint,
+      int32_t maxSlowest) override;
+
   /**
    * When this Thrift handler is notified to shutdown, it notifies the
    * EdenServer to shut down, as well.
@@ -144,14 +156,6 @@ class EdenServiceHandler : virtual public StreamingEdenServiceSvIf,
   EdenServiceHandler(EdenServiceHandler const&) = delete;
   EdenServiceHandler& operator=(EdenServiceHandler const&) = delete;
 
-  folly::Future<Hash> getSHA1ForPath(
-      folly::StringPiece mountPoint,
-      folly::StringPiece path);
-
-  folly::Future<Hash> getSHA1ForPathDefensively(
-      folly::StringPiece mountPoint,
-      folly::StringPiece path) noexcept;
-
   void mountImpl(const MountInfo& info);
 
   AbsolutePath getPathToDirstateStorage(AbsolutePathPiece mountPointPath);
@@ -8,8 +8,17 @@
  *
  */
 #include "GlobNode.h"
+#include <folly/Conv.h>
+#include <folly/Function.h>
+#include <folly/Synchronized.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <deque>
 #include "EdenError.h"
+#include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/model/Tree.h"
+#include "eden/fs/store/ObjectStore.h"
 
 using std::string;
 using std::unique_ptr;
@@ -19,10 +28,240 @@ using folly::makeFuture;
 using std::make_unique;
 using folly::StringPiece;
 using std::unordered_set;
+using folly::Unit;
+
+DEFINE_int32(
+    glob_concurrency,
+    32,
+    "The maximum number of directories that a single glob evaluation will "
+    "load and match concurrently");
 
 namespace facebook {
 namespace eden {
 
+namespace {
+/**
+ * Adapts a TreeInode to the interface used by the glob evaluation code.
+ *
+ * The entry callbacks are invoked with the TreeInode's contents lock held.
+ */
+class TreeInodeRoot {
+ public:
+  explicit TreeInodeRoot(TreeInodePtr root) : root_(std::move(root)) {}
+
+  // Calls func(name, isDir, treeHash) for every entry.  treeHash is set for
+  // child directories that can be evaluated from their source control Tree.
+  template <typename Func>
+  void forEachEntry(Func&& func) const {
+    auto contents = root_->getContents().rlock();
+    for (auto& entry : contents->entries) {
+      func(entry.first, entry.second.isDirectory(), getTreeHash(entry.second));
+    }
+  }
+
+  // Calls func(name, isDir, treeHash) for the named entry, if it exists.
+  template <typename Func>
+  void lookupEntry(PathComponentPiece name, Func&& func) const {
+    auto contents = root_->getContents().rlock();
+    auto it = contents->entries.find(name);
+    if (it != contents->entries.end()) {
+      func(it->first, it->second.isDirectory(), getTreeHash(it->second));
+    }
+  }
+
+  Future<TreeInodePtr> loadChildTree(PathComponentPiece name) const {
+    return root_->getOrLoadChildTree(name);
+  }
+
+ private:
+  static folly::Optional<Hash> getTreeHash(const TreeInode::Entry& entry) {
+    // A loaded child inode is the authoritative source for its contents, and
+    // materialized directories only exist in the overlay.  Everything else is
+    // identical to its source control Tree.
+    if (entry.inode || entry.isMaterialized() || !entry.isDirectory()) {
+      return folly::none;
+    }
+    return entry.getHash();
+  }
+
+  TreeInodePtr root_;
+};
+
+/**
+ * Adapts a source control Tree to the interface used by the glob evaluation
+ * code.  All child directories are evaluated from the ObjectStore.
+ */
+class TreeRoot {
+ public:
+  explicit TreeRoot(std::shared_ptr<const Tree> tree)
+      : tree_(std::move(tree)) {}
+
+  template <typename Func>
+  void forEachEntry(Func&& func) const {
+    for (const auto& entry : tree_->getTreeEntries()) {
+      visit(entry, func);
+    }
+  }
+
+  template <typename Func>
+  void lookupEntry(PathComponentPiece name, Func&& func) const {
+    auto* entry = tree_->getEntryPtr(name);
+    if (entry) {
+      visit(*entry, func);
+    }
+  }
+
+  Future<TreeInodePtr> loadChildTree(PathComponentPiece name) const {
+    // Every child of a Tree has a tree hash, so evaluateChild() never
+    // needs to load inodes below a TreeRoot.
+    return makeFuture<TreeInodePtr>(std::logic_error(folly::to<string>(
+        "attempted to load an inode for ", name, " while globbing a Tree")));
+  }
+
+ private:
+  template <typename Func>
+  static void visit(const TreeEntry& entry, Func& func) {
+    if (entry.getType() == TreeEntryType::TREE) {
+      func(entry.getName(), true, folly::Optional<Hash>(entry.getHash()));
+    } else {
+      func(entry.getName(), false, folly::Optional<Hash>());
+    }
+  }
+
+  std::shared_ptr<const Tree> tree_;
+};
+}
+
+/**
+ * The state shared by every directory visited during a single evaluation.
+ *
+ * Each directory to visit is queued as a job.  At most maxConcurrency jobs
+ * are outstanding at once, regardless of where they are in the tree, and
+ * each job adds its matches directly to a single shared result set.
+ */
+class GlobNode::EvaluateContext
+    : public std::enable_shared_from_this<GlobNode::EvaluateContext> {
+ public:
+  using Job =
+      folly::Function<Future<Unit>(const std::shared_ptr<EvaluateContext>&)>;
+
+  EvaluateContext(const ObjectStore* store, size_t maxConcurrency)
+      : store_(store), maxConcurrency_(std::max(maxConcurrency, size_t(1))) {}
+
+  const ObjectStore* getObjectStore() const {
+    return store_;
+  }
+
+  void addResults(vector<RelativePath>&& paths) {
+    if (paths.empty()) {
+      return;
+    }
+    auto results = results_.wlock();
+    for (auto& path : paths) {
+      results->insert(std::move(path));
+    }
+  }
+
+  void enqueue(Job&& job) {
+    auto state = state_.wlock();
+    if (!state->error) {
+      state->pending.push_back(std::move(job));
+    }
+  }
+
+  /**
+   * Start running the queued jobs.
+   *
+   * The returned Future completes once all jobs, including the jobs that
+   * they queue in turn, have finished.  If any job fails the remaining queued
+   * jobs are discarded and the Future fails with the first error seen.
+   */
+  Future<unordered_set<RelativePath>> run() {
+    auto future = promise_.getFuture();
+    pump();
+    return future;
+  }
+
+ private:
+  struct State {
+    std::deque<Job> pending;
+    size_t running{0};
+    // Set while a thread is inside pump(), so that jobs that complete
+    // immediately hand their slot back to that loop instead of recursing.
+    bool pumping{false};
+    bool finished{false};
+    folly::exception_wrapper error;
+  };
+
+  void pump() {
+    {
+      auto state = state_.wlock();
+      if (state->pumping) {
+        return;
+      }
+      state->pumping = true;
+    }
+
+    while (true) {
+      Job job;
+      {
+        auto state = state_.wlock();
+        if (state->running < maxConcurrency_ && !state->pending.empty()) {
+          job = std::move(state->pending.front());
+          state->pending.pop_front();
+          ++state->running;
+        } else {
+          state->pumping = false;
+          if (state->running > 0 || !state->pending.empty() ||
+              state->finished) {
+            return;
+          }
+          state->finished = true;
+        }
+      }
+
+      if (!job) {
+        finish();
+        return;
+      }
+
+      auto self = shared_from_this();
+      folly::makeFutureWith([&job, &self] { return job(self); })
+          .then([self](folly::Try<Unit>&& result) {
+            self->jobFinished(std::move(result));
+          });
+    }
+  }
+
+  void jobFinished(folly::Try<Unit>&& result) {
+    {
+      auto state = state_.wlock();
+      --state->running;
+      if (result.hasException() && !state->error) {
+        state->error = std::move(result.exception());
+        state->pending.clear();
+      }
+    }
+    pump();
+  }
+
+  void finish() {
+    // Once finished is set no other thread touches the state or results.
+    auto error = std::move(state_.wlock()->error);
+    if (error) {
+      promise_.setException(std::move(error));
+    } else {
+      promise_.setValue(std::move(*results_.wlock()));
+    }
+  }
+
+  const ObjectStore* const store_;
+  const size_t maxConcurrency_;
+  folly::Synchronized<unordered_set<RelativePath>> results_;
+  folly::Synchronized<State> state_;
+  folly::Promise<unordered_set<RelativePath>> promise_;
+};
+
 GlobNode::GlobNode(StringPiece pattern, bool hasSpecials)
     : pattern_(pattern), hasSpecials_(hasSpecials) {
   if (pattern_ == "**" || pattern_ == "*") {
@@ -46,6 +285,7 @@ void GlobNode::parse(StringPiece pattern) {
   while (!pattern.empty()) {
     StringPiece token;
     auto* container = &parent->children_;
+    auto* matchers = &parent->childMatchers_;
     bool hasSpecials;
 
     if (pattern.startsWith("**")) {
@@ -54,6 +294,7 @@ void GlobNode::parse(StringPiece pattern) {
       token = pattern;
       pattern = StringPiece();
       container = &parent->recursiveChildren_;
+      matchers = &parent->recursiveMatchers_;
       hasSpecials = true;
     } else {
       token = tokenize(pattern, &hasSpecials);
@@ -63,6 +304,10 @@ void GlobNode::parse(StringPiece pattern) {
     if (!node) {
       container->emplace_back(std::make_unique<GlobNode>(token, hasSpecials));
       node = container->back().get();
+      node->addPatternTo(matchers);
+      if (hasSpecials && container == &parent->children_) {
+        parent->childrenHaveSpecials_ = true;
+      }
     }
 
     // If there are no more tokens remaining then we have a leaf node
@@ -79,79 +324,145 @@ void GlobNode::parse(StringPiece pattern) {
   }
 }
 
+void GlobNode::addPatternTo(GlobMatcherSet* matchers) const {
+  if (alwaysMatch_) {
+    matchers->addMatchAll();
+  } else {
+    matchers->add(&matcher_);
+  }
+}
+
 Future<unordered_set<RelativePath>> GlobNode::evaluate(
     RelativePathPiece rootPath,
     TreeInodePtr root) {
-  unordered_set<RelativePath> results =
-      evaluateRecursiveComponent(rootPath, root).get();
-  vector<std::pair<PathComponent, GlobNode*>> recurse;
+  const auto* store = root->getMount()->getObjectStore();
+  return startEvaluate(store, rootPath, TreeInodeRoot{std::move(root)});
+}
+
+Future<unordered_set<RelativePath>> GlobNode::evaluate(
+    const ObjectStore* store,
+    RelativePathPiece rootPath,
+    std::shared_ptr<const Tree> tree) {
+  return startEvaluate(store, rootPath, TreeRoot{std::move(tree)});
+}
 
-  {
-    auto contents = root->getContents().rlock();
+template <typename ROOT>
+Future<unordered_set<RelativePath>> GlobNode::startEvaluate(
+    const ObjectStore* store,
+    RelativePathPiece rootPath,
+    ROOT root) {
+  auto ctx = std::make_shared<EvaluateContext>(
+      store, static_cast<size_t>(std::max(FLAGS_glob_concurrency, 1)));
+  ctx->enqueue([ this, rootPath = rootPath.copy(), root = std::move(root) ](
+      const std::shared_ptr<EvaluateContext>& context) {
+    evaluateImpl(context, rootPath, root);
+    return makeFuture();
+  });
+  return ctx->run();
+}
+
+template <typename ROOT>
+void GlobNode::evaluateImpl(
+    const std::shared_ptr<EvaluateContext>& ctx,
+    RelativePathPiece rootPath,
+    const ROOT& root) {
+  evaluateRecursiveComponent(ctx, rootPath, root);
+
+  vector<RelativePath> results;
+  vector<ChildDir> recurse;
+
+  auto visit = [&](
+      GlobNode* node,
+      PathComponentPiece name,
+      bool isDir,
+      const folly::Optional<Hash>& treeHash) {
+    if (node->isLeaf_) {
+      results.emplace_back(rootPath + name);
+      return;
+    }
+
+    // Not the leaf of a pattern; if this is a dir, we need to recurse
+    if (isDir) {
+      recurse.emplace_back(name, node, treeHash);
+    }
+  };
+
+  if (!childrenHaveSpecials_) {
+    // Every child pattern is a plain name, so we can look each one up
+    // directly rather than walking the directory.
     for (auto& node : children_) {
-      if (!node->hasSpecials_) {
-        // We can try a lookup for the exact name
-        auto it = contents->entries.find(PathComponentPiece(node->pattern_));
-        if (it != contents->entries.end()) {
-          // Matched!
-          if (node->isLeaf_) {
-            results.emplace((rootPath + it->first));
-            continue;
-          }
+      root.lookupEntry(
+          PathComponentPiece(node->pattern_),
+          [&](PathComponentPiece name,
+              bool isDir,
+              const folly::Optional<Hash>& treeHash) {
+            visit(node.get(), name, isDir, treeHash);
+          });
+    }
+  } else {
+    // Match each entry in this directory against all of the child patterns
+    // in a single pass.
+    vector<size_t> matching;
+    root.forEachEntry([&](
+        PathComponentPiece name,
+        bool isDir,
+        const folly::Optional<Hash>& treeHash) {
+      matching.clear();
+      childMatchers_.matchAll(name.stringPiece(), &matching);
+      for (auto idx : matching) {
+        visit(children_[idx].get(), name, isDir, treeHash);
+      }
+    });
+  }
 
-          // Not the leaf of a pattern; if this is a dir, we need to recurse
-          if (S_ISDIR(it->second->mode)) {
-            recurse.emplace_back(std::make_pair(it->first, node.get()));
-          }
-        }
-      } else {
-        // We need to match it out of the entries in this inode
-        for (auto& entry : contents->entries) {
-          if (node->alwaysMatch_ ||
-              node->matcher_.match(entry.first.stringPiece())) {
-            if (node->isLeaf_) {
-              results.emplace((rootPath + entry.first));
-              continue;
-            }
-            // Not the leaf of a pattern; if this is a dir, we need to
-            // recurse
-            if (S_ISDIR(entry.second->mode)) {
-              recurse.emplace_back(std::make_pair(entry.first, node.get()));
+  ctx->addResults(std::move(results));
+
+  // Queue the matching child directories.  They are evaluated once the
+  // context has a free slot in its concurrency budget.
+  for (auto& item : recurse) {
+    enqueueChild(ctx, rootPath, root, std::move(item), false);
+  }
+}
+
+template <typename ROOT>
+void GlobNode::enqueueChild(
+    const std::shared_ptr<EvaluateContext>& ctx,
+    RelativePathPiece rootPath,
+    const ROOT& root,
+    ChildDir child,
+    bool recursive) {
+  ctx->enqueue([
+    childPath = rootPath + child.name,
+    root,
+    child = std::move(child),
+    recursive
+  ](const std::shared_ptr<EvaluateContext>& context) {
+    auto* node = child.node;
+    if (child.treeHash.hasValue()) {
+      // Walk the source control Tree directly, without creating a TreeInode.
+      return context->getObjectStore()
+          ->getTreeFuture(child.treeHash.value())
+          .then([ context, node, childPath, recursive ](
+              std::unique_ptr<Tree> tree) {
+            TreeRoot treeRoot{std::shared_ptr<const Tree>(std::move(tree))};
+            if (recursive) {
+              node->evaluateRecursiveComponent(context, childPath, treeRoot);
+            } else {
+              node->evaluateImpl(context, childPath, treeRoot);
             }
-          }
-        }
-      }
+          });
     }
-  }
 
-  // Recursively load child inodes and evaluate matches with a concurrency
-  // constraint.
-  // For now we only evaluate 1 child dir at a time.
-  // We could go larger but need to be careful about how this expands
-  // with the depth of the tree.
-  const constexpr size_t kConcurrency = 1;
-
-  auto childInodes = folly::window(
-      std::move(recurse),
-      [ rootPath = rootPath.copy(), root, this ](
-          const std::pair<PathComponent, GlobNode*>& item) {
-        auto candidateName = rootPath + item.first;
-        return root->getOrLoadChildTree(item.first).then([
-          candidateName,
-          node = item.second
-        ](TreeInodePtr dir) { return node->evaluate(candidateName, dir); });
-      },
-      kConcurrency);
-
-  // Merge the results to yield a de-duplicated set of matches
-  return folly::unorderedReduce(
-      std::move(childInodes),
-      std::move(results),
-      [](unordered_set<RelativePath> result,
-         const unordered_set<RelativePath>& matches) {
-        result.insert(matches.begin(), matches.end());
-        return result;
-      });
+    return root.loadChildTree(child.name)
+        .then([ context, node, childPath, recursive ](TreeInodePtr dir) {
+          TreeInodeRoot inodeRoot{std::move(dir)};
+          if (recursive) {
+            node->evaluateRecursiveComponent(context, childPath, inodeRoot);
+          } else {
+            node->evaluateImpl(context, childPath, inodeRoot);
+          }
+        });
+  });
 }
 
 StringPiece GlobNode::tokenize(StringPiece& pattern, bool* hasSpecials) {
@@ -192,64 +503,41 @@ GlobNode* GlobNode::lookupToken(
   return nullptr;
 }
 
-Future<unordered_set<RelativePath>> GlobNode::evaluateRecursiveComponent(
+template <typename ROOT>
+void GlobNode::evaluateRecursiveComponent(
+    const std::shared_ptr<EvaluateContext>& ctx,
     RelativePathPiece rootPath,
-    TreeInodePtr root) {
-  unordered_set<RelativePath> results;
+    const ROOT& root) {
   if (recursiveChildren_.empty()) {
-    return results;
+    return;
   }
 
-  vector<RelativePath> subDirNames;
-  {
-    auto contents = root->getContents().rlock();
-    for (auto& entry : contents->entries) {
-      auto candidateName = rootPath + entry.first;
-
-      for (auto& node : recursiveChildren_) {
-        if (node->alwaysMatch_ ||
-            node->matcher_.match(candidateName.stringPiece())) {
-          results.emplace(candidateName);
-          // No sense running multiple matches for this same file.
-          break;
-        }
-      }
+  vector<RelativePath> results;
+  vector<ChildDir> subDirs;
+  root.forEachEntry([&](
+      PathComponentPiece name,
+      bool isDir,
+      const folly::Optional<Hash>& treeHash) {
+    auto candidateName = rootPath + name;
 
-      // Remember to recurse through child dirs after we've released
-      // the lock on the contents.
-      if (S_ISDIR(entry.second->mode)) {
-        subDirNames.emplace_back(candidateName);
-      }
+    // No sense running multiple matches for this same file; any one of the
+    // recursive patterns is enough.
+    if (recursiveMatchers_.match(candidateName.stringPiece()).hasValue()) {
+      results.emplace_back(std::move(candidateName));
     }
-  }
 
-  // Recursively load child inodes and evaluate matches with a concurrency
-  // constraint.
-  // For now we only evaluate 1 child dir at a time.
-  // We could go larger but need to be careful about how this expands
-  // with the depth of the tree.
-  const constexpr size_t kConcurrency = 1;
-
-  auto childInodes = folly::window(
-      std::move(subDirNames),
-      [ rootPath = rootPath.copy(), root, this ](
-          const RelativePath& candidateName) {
-        return root->getOrLoadChildTree(candidateName.basename())
-            .then([candidateName, this](TreeInodePtr dir) {
-              return evaluateRecursiveComponent(candidateName, dir);
-            });
-      },
-      kConcurrency);
-
-  // Merge the results to yield a de-duplicated set of matches
-  return folly::unorderedReduce(
-      childInodes,
-      results,
-      [](unordered_set<RelativePath> result,
-         const unordered_set<RelativePath>& matches) {
-        result.insert(matches.begin(), matches.end());
-        return result;
-      });
+    // Remember to recurse through child dirs after we've released
+    // the lock on the contents.
+    if (isDir) {
+      subDirs.emplace_back(name, this, treeHash);
+    }
+  });
+
+  ctx->addResults(std::move(results));
+
+  for (auto& item : subDirs) {
+    enqueueChild(ctx, rootPath, root, std::move(item), true);
+  }
 }
 }
 }
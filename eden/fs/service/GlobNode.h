@@ -8,14 +8,20 @@
  *
  */
 #pragma once
+#include <folly/Optional.h>
 #include <folly/futures/Future.h>
 #include "eden/fs/inodes/InodePtrFwd.h"
+#include "eden/fs/model/Hash.h"
 #include "eden/fs/model/git/GlobMatcher.h"
+#include "eden/fs/model/git/GlobMatcherSet.h"
 #include "eden/utils/PathFuncs.h"
 
 namespace facebook {
 namespace eden {
 
+class ObjectStore;
+class Tree;
+
 /** Represents the compiled state of a tree-walking glob operation.
  * We split the glob into path components and build a tree of name
  * matching operations.
@@ -37,16 +43,49 @@ class GlobNode {
   // Compilation splits the pattern into nodes, with one node for each
   // directory separator separated path component.
   void parse(folly::StringPiece pattern);
-  // This is a recursive function to evaluate the compiled glob against
-  // the provided input path and inode.
+  // Evaluate the compiled glob against the provided input path and inode.
   // It returns the set of matching file names.
+  // Directories are visited asynchronously; at most --glob_concurrency
+  // directories are being loaded and matched at any one time across the
+  // whole evaluation.
   // Note: the caller is responsible for ensuring that this
   // GlobNode exists until the returned Future is resolved.
+  //
+  // Child directories that are neither loaded nor materialized are
+  // evaluated directly against their source control Tree objects, so a
+  // glob over a large, mostly unmodified checkout does not create a
+  // TreeInode for every directory it visits.
   folly::Future<std::unordered_set<RelativePath>> evaluate(
       RelativePathPiece rootPath,
       TreeInodePtr root);
+  // Evaluate the compiled glob against a source control Tree, fetching
+  // child Trees from the ObjectStore as needed.
+  folly::Future<std::unordered_set<RelativePath>> evaluate(
+      const ObjectStore* store,
+      RelativePathPiece rootPath,
+      std::shared_ptr<const Tree> tree);
 
  private:
+  // Shared state for a single evaluation: the collected results and the
+  // queue of directories still to be visited.  Defined in GlobNode.cpp.
+  class EvaluateContext;
+
+  // A child directory that evaluation needs to descend into.
+  struct ChildDir {
+    ChildDir(
+        PathComponentPiece n,
+        GlobNode* gn,
+        const folly::Optional<Hash>& hash)
+        : name(n), node(gn), treeHash(hash) {}
+
+    PathComponent name;
+    // The node to evaluate against the child directory
+    GlobNode* node;
+    // If set, the child can be evaluated directly from this source control
+    // Tree, without loading a TreeInode for it.
+    folly::Optional<Hash> treeHash;
+  };
+
   // Returns the next glob node token.
   // This is the text from the start of pattern up to the first
   // slash, or the end of the string is there was no slash.
@@ -63,16 +102,47 @@ class GlobNode {
   GlobNode* lookupToken(
       std::vector<std::unique_ptr<GlobNode>>* container,
       folly::StringPiece token);
+  // Add this node's pattern to a parent's GlobMatcherSet.
+  void addPatternTo(GlobMatcherSet* matchers) const;
+  // Starts an evaluation of this node against root, returning a Future
+  // that completes once every directory it reaches has been visited.
+  template <typename ROOT>
+  folly::Future<std::unordered_set<RelativePath>> startEvaluate(
+      const ObjectStore* store,
+      RelativePathPiece rootPath,
+      ROOT root);
+  // Matches this node's children against the entries of root, adding any
+  // results to the context and queueing the child directories that need to
+  // be visited.  ROOT adapts either a TreeInode or a source control Tree to
+  // a common interface.
+  template <typename ROOT>
+  void evaluateImpl(
+      const std::shared_ptr<EvaluateContext>& ctx,
+      RelativePathPiece rootPath,
+      const ROOT& root);
   // Evaluates any recursive glob entries associated with this node.
-  // This is a recursive function which evaluates the current GlobNode against
-  // the recursive set of children.
-  // By contrast, evaluate() walks down through the GlobNodes AND the
+  // This evaluates the current GlobNode against the entries of root, and
+  // queues each child directory to be evaluated the same way.
+  // By contrast, evaluateImpl() walks down through the GlobNodes AND the
   // inode children.
   // The difference is because a pattern like "**/foo" must be recursively
   // matched against all the children of the inode.
-  folly::Future<std::unordered_set<RelativePath>> evaluateRecursiveComponent(
+  template <typename ROOT>
+  void evaluateRecursiveComponent(
+      const std::shared_ptr<EvaluateContext>& ctx,
       RelativePathPiece rootPath,
-      TreeInodePtr root);
+      const ROOT& root);
+  // Queues the evaluation of child.node against a child directory of root.
+  // The child is loaded from its source control Tree when possible and from
+  // its TreeInode otherwise.
+  template <typename ROOT>
+  static void enqueueChild(
+      const std::shared_ptr<EvaluateContext>& ctx,
+      RelativePathPiece rootPath,
+      const ROOT& root,
+      ChildDir child,
+      bool recursive);
+
   // The pattern fragment for this node
   folly::StringPiece pattern_;
   // The compiled pattern
@@ -81,6 +151,10 @@ class GlobNode {
   std::vector<std::unique_ptr<GlobNode>> children_;
   // List of ** child rules
   std::vector<std::unique_ptr<GlobNode>> recursiveChildren_;
+  // The patterns of children_ and recursiveChildren_, indexed in the same
+  // order, so that a name can be tested against all of them in one pass.
+  GlobMatcherSet childMatchers_;
+  GlobMatcherSet recursiveMatchers_;
 
   // If true, generate results for matches.  Only applies
   // to non-recursive glob patterns.
@@ -90,6 +164,10 @@ class GlobNode {
   bool hasSpecials_{false};
   // If true, this node is **
   bool alwaysMatch_{false};
+  // If true, at least one of children_ has special glob characters, so
+  // entries must be matched against childMatchers_ rather than looked up
+  // by name.
+  bool childrenHaveSpecials_{false};
 };
 }
 }
@@ -0,0 +1,63 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/service/PendingMounts.h"
+
+namespace facebook {
+namespace eden {
+
+void PendingMounts::starting(folly::StringPiece mountPath) {
+  Status status;
+  status.mountPoint = mountPath.str();
+  auto mounts = mounts_.wlock();
+  (*mounts)[status.mountPoint] = std::move(status);
+}
+
+void PendingMounts::mounted(folly::StringPiece mountPath) {
+  mounts_.wlock()->erase(mountPath.str());
+}
+
+void PendingMounts::failed(folly::StringPiece mountPath, std::string error) {
+  auto mounts = mounts_.wlock();
+  auto& status = (*mounts)[mountPath.str()];
+  status.mountPoint = mountPath.str();
+  status.state = State::FAILED;
+  status.error = std::move(error);
+}
+
+bool PendingMounts::forgetFailed(folly::StringPiece mountPath) {
+  auto mounts = mounts_.wlock();
+  auto it = mounts->find(mountPath.str());
+  if (it == mounts->end() || it->second.state != State::FAILED) {
+    return false;
+  }
+  mounts->erase(it);
+  return true;
+}
+
+std::vector<PendingMounts::Status> PendingMounts::getStatuses(
+    const std::vector<std::string>& mountedPaths) const {
+  std::vector<Status> results;
+  auto mounts = mounts_.rlock();
+  for (const auto& path : mountedPaths) {
+    // Mounts still finishing their startup mount are reported from mounts_
+    if (mounts->find(path) == mounts->end()) {
+      Status status;
+      status.mountPoint = path;
+      status.state = State::READY;
+      results.push_back(std::move(status));
+    }
+  }
+  for (const auto& entry : *mounts) {
+    results.push_back(entry.second);
+  }
+  return results;
+}
+}
+}
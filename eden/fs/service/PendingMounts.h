@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/Synchronized.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace eden {
+
+/**
+ * PendingMounts tracks the mount points that EdenServer is remounting (or
+ * taking over) at startup, along with the ones for which that failed.
+ *
+ * A mount point that is not listed here and is mounted is READY.  A FAILED
+ * entry stays until the mount point is successfully mounted again, or until
+ * it is explicitly unmounted.
+ */
+class PendingMounts {
+ public:
+  enum class State {
+    /** The mount point is still being remounted at startup. */
+    INITIALIZING,
+    /** The mount point is mounted. */
+    READY,
+    /** Remounting the mount point at startup failed. */
+    FAILED,
+  };
+  struct Status {
+    std::string mountPoint;
+    State state{State::INITIALIZING};
+    /** The reason for the failure, for FAILED mount points. */
+    std::string error;
+  };
+
+  /**
+   * Record that mountPath is being mounted at startup.
+   */
+  void starting(folly::StringPiece mountPath);
+
+  /**
+   * Record that mountPath was mounted successfully.
+   *
+   * This forgets any earlier failure to mount it.
+   */
+  void mounted(folly::StringPiece mountPath);
+
+  /**
+   * Record that mounting mountPath at startup failed.
+   */
+  void failed(folly::StringPiece mountPath, std::string error);
+
+  /**
+   * Forget mountPath if it is FAILED.
+   *
+   * Returns true if there was a FAILED entry for mountPath.  Mount points
+   * that are still INITIALIZING are left alone.
+   */
+  bool forgetFailed(folly::StringPiece mountPath);
+
+  /**
+   * Get the state of every mount point.
+   *
+   * mountedPaths lists the mount points that are currently mounted.  They are
+   * reported as READY unless they are still finishing their startup mount.
+   */
+  std::vector<Status> getStatuses(
+      const std::vector<std::string>& mountedPaths) const;
+
+ private:
+  /**
+   * The mount points that are INITIALIZING or FAILED, indexed by mount path.
+   */
+  folly::Synchronized<std::map<std::string, Status>> mounts_;
+};
+}
+}
@@ -31,6 +31,27 @@ struct MountInfo {
   2: string edenClientPath
 }
 
+enum MountState {
+  /**
+   * The mount point is still being remounted after eden started.
+   */
+  INITIALIZING = 0,
+  READY = 1,
+  /**
+   * Remounting the mount point after eden started failed.
+   */
+  FAILED = 2,
+}
+
+struct MountStatus {
+  1: string mountPoint
+  2: MountState state
+  /**
+   * The reason for the failure, if state is FAILED.
+   */
+  3: string error
+}
+
 union SHA1Result {
   1: BinaryHash sha1
   2: EdenError error
@@ -158,6 +179,32 @@ struct CheckoutConflict {
   3: string message
 }
 
+/**
+ * The result of a checkout dry run: the conflicts that the checkout would
+ * report, and the number of files it would change.
+ */
+struct CheckoutDryRunResult {
+  1: list<CheckoutConflict> conflicts
+  2: i64 filesAdded
+  3: i64 filesModified
+  4: i64 filesRemoved
+}
+
+/**
+ * A snapshot of the progress of a checkout operation.
+ *
+ * inProgress is false once the checkout has finished, or if no checkout was
+ * running on the mount point.  The counters are cumulative for the checkout.
+ */
+struct CheckoutProgressInfo {
+  1: bool inProgress
+  2: i64 treesCompared
+  3: i64 treesLoaded
+  4: i64 actionsStarted
+  5: i64 actionsCompleted
+  6: i64 inodesInvalidated
+}
+
 struct ScmBlobMetadata {
   1: i64 size
   2: BinaryHash contentsSha1
@@ -206,8 +253,69 @@ struct TreeInodeDebugInfo {
   5: list<TreeInodeEntryDebugInfo> entries
 }
 
+/**
+ * A backing store fetch that a FUSE request had to wait on.
+ */
+struct FuseFetchTrace {
+  /**
+   * The kind of object fetched: "tree" or "blob".
+   */
+  1: string type
+  /**
+   * The ID of the object, as a hex string.
+   */
+  2: string id
+  /**
+   * When the fetch started, in microseconds since the start of the request.
+   */
+  3: i64 startOffsetUs
+  /**
+   * The duration of the fetch, or the time so far if it is still in
+   * progress.
+   */
+  4: i64 durationUs
+  5: bool finished
+}
+
+struct FuseRequestTrace {
+  1: i64 requestId
+  /**
+   * The FUSE operation, such as "lookup" or "getattr".
+   */
+  2: string operation
+  /**
+   * The inode the request operates on.  For operations on a directory entry,
+   * such as lookup or unlink, this is the parent directory.
+   */
+  3: i64 inodeNumber
+  4: i32 pid
+  /**
+   * The duration of the request, or the time so far if it is still in
+   * progress.
+   */
+  5: i64 durationUs
+  6: bool finished
+  7: list<FuseFetchTrace> fetches
+}
+
+struct FuseRequestTraces {
+  /**
+   * The requests currently being processed, oldest first.
+   */
+  1: list<FuseRequestTrace> outstanding
+  /**
+   * The slowest of the recently completed requests, slowest first.
+   */
+  2: list<FuseRequestTrace> slowest
+}
+
 service EdenService extends fb303.FacebookService {
   list<MountInfo> listMounts() throws (1: EdenError ex)
+  /**
+   * Get the state of each mount point, including the ones that are still
+   * being remounted, or that failed to remount, since eden started.
+   */
+  list<MountStatus> getMountStatuses() throws (1: EdenError ex)
   void mount(1: MountInfo info) throws (1: EdenError ex)
   void unmount(1: string mountPoint) throws (1: EdenError ex)
 
@@ -245,6 +353,21 @@ service EdenService extends fb303.FacebookService {
     3: bool force)
       throws (1: EdenError ex)
 
+  /**
+   * Report what checkOutRevision() would do, without changing anything.
+   *
+   * The returned conflicts are the same ones checkOutRevision() would report
+   * with the same arguments.  The file counts include files inside
+   * directories that have never been accessed, which are computed from the
+   * source control trees.  No file contents are fetched, and file system
+   * operations on the mount point are not blocked while this runs.
+   */
+  CheckoutDryRunResult checkOutRevisionDryRun(
+    1: string mountPoint,
+    2: BinaryHash snapshotHash,
+    3: bool force)
+      throws (1: EdenError ex)
+
   /**
    * Reset the working directory's parent commit, without changing the working
    * directory contents.
@@ -410,4 +533,16 @@ service EdenService extends fb303.FacebookService {
     1: string mountPoint,
     2: string path,
   ) throws (1: EdenError ex)
+
+  /**
+   * Get details about the FUSE requests for a mount point.
+   *
+   * This returns the requests that are currently outstanding, and the
+   * maxSlowest slowest of the recently completed requests.  Each request
+   * includes the backing store fetches that it waited on.
+   */
+  FuseRequestTraces debugGetFuseRequests(
+    1: string mountPoint,
+    2: i32 maxSlowest,
+  ) throws (1: EdenError ex)
 }
@@ -27,6 +27,8 @@ DEFINE_string(
 DEFINE_string(configPath, "", "The path of the ~/.edenrc config file");
 DEFINE_string(rocksPath, "", "The path to the local RocksDB store");
 
+DECLARE_string(user_ignore_file);
+
 DEFINE_int32(
     fuseThreadStack,
     1 * 1024 * 1024,
@@ -155,6 +157,21 @@ int main(int argc, char **argv) {
   }
   auto configPath = canonicalPath(configPathStr);
 
+  // Default to git's per-user excludes file, if one was not specified.
+  // This is deliberately not ~/.gitignore: that file applies to a home
+  // directory kept under version control, and often ignores everything.
+  if (FLAGS_user_ignore_file.empty()) {
+    auto xdgConfigHome = getenv("XDG_CONFIG_HOME");
+    auto homeDir = getenv("HOME");
+    if (xdgConfigHome && xdgConfigHome[0] != '\0') {
+      FLAGS_user_ignore_file =
+          folly::to<std::string>(xdgConfigHome, "/git/ignore");
+    } else if (homeDir) {
+      FLAGS_user_ignore_file =
+          folly::to<std::string>(homeDir, "/.config/git/ignore");
+    }
+  }
+
   // Set the FUSE_THREAD_STACK environment variable.
   // Do this early on before we spawn any other threads, since setenv()
   // is not thread-safe.
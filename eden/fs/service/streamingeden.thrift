@@ -16,4 +16,14 @@ service StreamingEdenService extends eden.EdenService {
    */
   stream<eden.JournalPosition> subscribe(
     1: string mountPoint)
+
+  /** Request periodic updates about the progress of the checkout operation
+   * currently running on the specified mountPoint.
+   * A CheckoutProgressInfo is pushed to the client at a fixed interval while
+   * the checkout runs.  The stream ends after an update with inProgress set
+   * to false is sent, either because the checkout completed or because no
+   * checkout was running.
+   */
+  stream<eden.CheckoutProgressInfo> subscribeCheckoutProgress(
+    1: string mountPoint)
 }
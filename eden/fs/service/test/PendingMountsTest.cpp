@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/service/PendingMounts.h"
+
+#include <gtest/gtest.h>
+#include <map>
+
+using namespace facebook::eden;
+using State = PendingMounts::State;
+
+namespace {
+/**
+ * Index the statuses by mount point, since getStatuses() returns them in no
+ * particular order.
+ */
+std::map<std::string, PendingMounts::Status> statusesByPath(
+    const PendingMounts& pending,
+    const std::vector<std::string>& mountedPaths) {
+  std::map<std::string, PendingMounts::Status> result;
+  for (auto& status : pending.getStatuses(mountedPaths)) {
+    auto path = status.mountPoint;
+    EXPECT_EQ(0, result.count(path)) << "duplicate status for " << path;
+    result.emplace(path, std::move(status));
+  }
+  return result;
+}
+}
+
+TEST(PendingMounts, remountSucceeds) {
+  PendingMounts pending;
+  pending.starting("/mnt/a");
+  auto statuses = statusesByPath(pending, {});
+  ASSERT_EQ(1, statuses.size());
+  EXPECT_EQ(State::INITIALIZING, statuses["/mnt/a"].state);
+
+  // The mount point is registered before the remount has finished.
+  statuses = statusesByPath(pending, {"/mnt/a"});
+  ASSERT_EQ(1, statuses.size());
+  EXPECT_EQ(State::INITIALIZING, statuses["/mnt/a"].state);
+
+  pending.mounted("/mnt/a");
+  statuses = statusesByPath(pending, {"/mnt/a"});
+  ASSERT_EQ(1, statuses.size());
+  EXPECT_EQ(State::READY, statuses["/mnt/a"].state);
+  EXPECT_EQ("", statuses["/mnt/a"].error);
+}
+
+TEST(PendingMounts, remountFails) {
+  PendingMounts pending;
+  pending.starting("/mnt/a");
+  pending.starting("/mnt/b");
+  pending.failed("/mnt/a", "no such repository");
+  pending.mounted("/mnt/b");
+
+  auto statuses = statusesByPath(pending, {"/mnt/b"});
+  ASSERT_EQ(2, statuses.size());
+  EXPECT_EQ(State::FAILED, statuses["/mnt/a"].state);
+  EXPECT_EQ("no such repository", statuses["/mnt/a"].error);
+  EXPECT_EQ(State::READY, statuses["/mnt/b"].state);
+}
+
+TEST(PendingMounts, mountAfterFailure) {
+  PendingMounts pending;
+  pending.starting("/mnt/a");
+  pending.failed("/mnt/a", "no such repository");
+
+  // Mounting it by hand later replaces the failure.
+  pending.mounted("/mnt/a");
+  auto statuses = statusesByPath(pending, {"/mnt/a"});
+  ASSERT_EQ(1, statuses.size());
+  EXPECT_EQ(State::READY, statuses["/mnt/a"].state);
+  EXPECT_EQ("", statuses["/mnt/a"].error);
+
+  // Once it is unmounted again it is no longer reported at all.
+  EXPECT_TRUE(statusesByPath(pending, {}).empty());
+}
+
+TEST(PendingMounts, forgetFailed) {
+  PendingMounts pending;
+  pending.starting("/mnt/a");
+  pending.starting("/mnt/b");
+  pending.failed("/mnt/a", "no such repository");
+
+  // Only failed mount points are forgotten, not the ones still in progress.
+  EXPECT_FALSE(pending.forgetFailed("/mnt/b"));
+  EXPECT_FALSE(pending.forgetFailed("/mnt/c"));
+  EXPECT_TRUE(pending.forgetFailed("/mnt/a"));
+  EXPECT_FALSE(pending.forgetFailed("/mnt/a"));
+
+  auto statuses = statusesByPath(pending, {});
+  ASSERT_EQ(1, statuses.size());
+  EXPECT_EQ(State::INITIALIZING, statuses["/mnt/b"].state);
+}
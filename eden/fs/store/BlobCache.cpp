@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "BlobCache.h"
+
+#include "eden/fs/model/Blob.h"
+
+namespace facebook {
+namespace eden {
+
+BlobCache::BlobCache(size_t maximumCacheSizeBytes)
+    : maximumSize_(maximumCacheSizeBytes) {}
+
+BlobCache::~BlobCache() {}
+
+std::shared_ptr<const Blob> BlobCache::get(const Hash& hash) {
+  auto state = state_.wlock();
+  auto it = state->index.find(hash);
+  if (it == state->index.end()) {
+    return nullptr;
+  }
+
+  // Move the entry to the front of the list
+  state->entries.splice(state->entries.begin(), state->entries, it->second);
+  return *it->second;
+}
+
+void BlobCache::insert(std::shared_ptr<const Blob> blob) {
+  auto size = getBlobSize(*blob);
+  if (size > maximumSize_) {
+    return;
+  }
+
+  // Keep the evicted entries alive until after we release the lock, so that
+  // freeing the blob data does not happen while other threads are waiting.
+  EntryList evicted;
+  {
+    auto state = state_.wlock();
+    auto it = state->index.find(blob->getHash());
+    if (it != state->index.end()) {
+      state->entries.splice(state->entries.begin(), state->entries, it->second);
+      return;
+    }
+
+    evicted = evictLocked(*state, maximumSize_ - size);
+
+    auto hash = blob->getHash();
+    state->entries.push_front(std::move(blob));
+    state->index.emplace(hash, state->entries.begin());
+    state->totalSize += size;
+  }
+}
+
+void BlobCache::clear() {
+  EntryList entries;
+  {
+    auto state = state_.wlock();
+    state->index.clear();
+    state->totalSize = 0;
+    entries.swap(state->entries);
+  }
+}
+
+size_t BlobCache::getTotalSize() const {
+  return state_.rlock()->totalSize;
+}
+
+size_t BlobCache::getEntryCount() const {
+  return state_.rlock()->index.size();
+}
+
+size_t BlobCache::getBlobSize(const Blob& blob) {
+  return blob.getContents().computeChainDataLength();
+}
+
+BlobCache::EntryList BlobCache::evictLocked(State& state, size_t targetSize) {
+  // Walk backwards from the least recently used entry until we are within
+  // the target size, then splice everything after that point off into a
+  // separate list.  The caller destroys the returned list outside of the
+  // lock.
+  auto it = state.entries.end();
+  while (state.totalSize > targetSize && it != state.entries.begin()) {
+    --it;
+    state.totalSize -= getBlobSize(**it);
+    state.index.erase((*it)->getHash());
+  }
+
+  EntryList evicted;
+  evicted.splice(evicted.end(), state.entries, it, state.entries.end());
+  return evicted;
+}
+}
+}
@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Synchronized.h>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include "eden/fs/model/Hash.h"
+
+namespace facebook {
+namespace eden {
+
+class Blob;
+
+/**
+ * BlobCache is a small in-memory LRU cache of recently released Blobs.
+ *
+ * FileData objects drop their reference to the blob contents once no file
+ * handles or in-flight requests need them, so that we do not hold the full
+ * contents of every file that has ever been read for the lifetime of its
+ * inode.  Released blobs are handed to the BlobCache so that a file that is
+ * repeatedly opened and closed (a very common access pattern for build tools)
+ * does not have to go back to the LocalStore each time.
+ *
+ * The cache is bounded by the total size of the blob contents it holds.
+ * Blobs larger than the whole cache are never retained.
+ *
+ * BlobCache is thread-safe.  Its internal lock is a leaf lock: it never calls
+ * out to other code while holding it, so it may be used while holding inode
+ * locks.
+ */
+class BlobCache {
+ public:
+  explicit BlobCache(size_t maximumCacheSizeBytes);
+  ~BlobCache();
+
+  /**
+   * Look up a blob by hash.
+   *
+   * Returns nullptr if the blob is not present in the cache.  On a hit the
+   * blob becomes the most recently used entry.
+   */
+  std::shared_ptr<const Blob> get(const Hash& hash);
+
+  /**
+   * Insert a blob into the cache, evicting the least recently used entries as
+   * necessary to stay within the size limit.
+   *
+   * Inserting a blob that is already present just marks it as the most
+   * recently used entry.
+   */
+  void insert(std::shared_ptr<const Blob> blob);
+
+  /**
+   * Drop all entries from the cache.
+   */
+  void clear();
+
+  size_t getMaximumSize() const {
+    return maximumSize_;
+  }
+
+  /** Return the total size in bytes of the blob contents currently cached. */
+  size_t getTotalSize() const;
+
+  /** Return the number of blobs currently cached. */
+  size_t getEntryCount() const;
+
+ private:
+  using EntryList = std::list<std::shared_ptr<const Blob>>;
+
+  struct State {
+    /** Cached blobs, ordered from most to least recently used. */
+    EntryList entries;
+    std::unordered_map<Hash, EntryList::iterator> index;
+    size_t totalSize{0};
+  };
+
+  static size_t getBlobSize(const Blob& blob);
+  static EntryList evictLocked(State& state, size_t targetSize);
+
+  BlobCache(BlobCache const&) = delete;
+  BlobCache& operator=(BlobCache const&) = delete;
+
+  const size_t maximumSize_;
+  folly::Synchronized<State> state_;
+};
+}
+}
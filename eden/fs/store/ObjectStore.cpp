@@ -18,6 +18,7 @@
 #include "LocalStore.h"
 #include "eden/fs/model/Blob.h"
 #include "eden/fs/model/Tree.h"
+#include "eden/utils/RequestTrace.h"
 
 using folly::Future;
 using folly::IOBuf;
@@ -59,8 +60,9 @@ Future<unique_ptr<Tree>> ObjectStore::getTreeFuture(const Hash& id) const {
   // layer.  Therefore we currently don't bother de-duping loads at this layer.
 
   // Load the tree from the BackingStore.
-  return backingStore_->getTree(id).then([id](
-      std::unique_ptr<Tree> loadedTree) {
+  auto fetch = RequestTrace::startFetch("tree", id.toString());
+  auto future = backingStore_->getTree(id).ensure([fetch] { fetch.finish(); });
+  return future.then([id](std::unique_ptr<Tree> loadedTree) {
     if (!loadedTree) {
       // TODO: Perhaps we should do some short-term negative caching?
       VLOG(2) << "unable to find tree " << id;
@@ -90,7 +92,9 @@ Future<unique_ptr<Blob>> ObjectStore::getBlobFuture(const Hash& id) const {
   }
 
   // Look in the BackingStore
-  return backingStore_->getBlob(id).then(
+  auto fetch = RequestTrace::startFetch("blob", id.toString());
+  auto future = backingStore_->getBlob(id).ensure([fetch] { fetch.finish(); });
+  return future.then(
       [ localStore = localStore_, id ](std::unique_ptr<Blob> loadedBlob) {
         if (!loadedBlob) {
           VLOG(2) << "unable to find blob " << id;
@@ -139,7 +143,9 @@ Future<BlobMetadata> ObjectStore::getBlobMetadata(const Hash& id) const {
   // TODO: It would be nice to add a smarter API to the BackingStore so that we
   // can query it just for the blob metadata if it supports getting that
   // without retrieving the full blob data.
-  return backingStore_->getBlob(id).then(
+  auto fetch = RequestTrace::startFetch("blob", id.toString());
+  auto future = backingStore_->getBlob(id).ensure([fetch] { fetch.finish(); });
+  return future.then(
       [ localStore = localStore_, id ](std::unique_ptr<Blob> blob) {
         if (!blob) {
           // TODO: Perhaps we should do some short-term negative caching?
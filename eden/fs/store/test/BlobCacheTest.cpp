@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2016-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+#include "eden/fs/model/Blob.h"
+#include "eden/fs/model/Hash.h"
+#include "eden/fs/store/BlobCache.h"
+
+using namespace facebook::eden;
+
+using folly::IOBuf;
+using folly::StringPiece;
+
+namespace {
+std::shared_ptr<const Blob> makeBlob(StringPiece contents) {
+  auto hash = Hash::sha1(folly::ByteRange{contents});
+  return std::make_shared<Blob>(
+      hash, IOBuf{IOBuf::COPY_BUFFER, contents.data(), contents.size()});
+}
+}
+
+TEST(BlobCache, getReturnsInsertedBlob) {
+  BlobCache cache{1024};
+  auto blob = makeBlob("hello world");
+  auto hash = blob->getHash();
+
+  EXPECT_EQ(nullptr, cache.get(hash));
+  cache.insert(blob);
+  EXPECT_EQ(blob, cache.get(hash));
+  EXPECT_EQ(1, cache.getEntryCount());
+  EXPECT_EQ(11, cache.getTotalSize());
+
+  // Inserting the same blob again does not double count it
+  cache.insert(blob);
+  EXPECT_EQ(1, cache.getEntryCount());
+  EXPECT_EQ(11, cache.getTotalSize());
+}
+
+TEST(BlobCache, evictsLeastRecentlyUsed) {
+  BlobCache cache{10};
+  auto a = makeBlob("aaaa");
+  auto b = makeBlob("bbbb");
+  auto c = makeBlob("cccc");
+
+  cache.insert(a);
+  cache.insert(b);
+  // Touch a so that b becomes the least recently used entry
+  EXPECT_EQ(a, cache.get(a->getHash()));
+  cache.insert(c);
+
+  EXPECT_EQ(2, cache.getEntryCount());
+  EXPECT_EQ(8, cache.getTotalSize());
+  EXPECT_EQ(a, cache.get(a->getHash()));
+  EXPECT_EQ(nullptr, cache.get(b->getHash()));
+  EXPECT_EQ(c, cache.get(c->getHash()));
+}
+
+TEST(BlobCache, doesNotCacheOversizedBlobs) {
+  BlobCache cache{4};
+  auto small = makeBlob("abc");
+  auto large = makeBlob("this blob is too large");
+
+  cache.insert(small);
+  cache.insert(large);
+  EXPECT_EQ(small, cache.get(small->getHash()));
+  EXPECT_EQ(nullptr, cache.get(large->getHash()));
+  EXPECT_EQ(3, cache.getTotalSize());
+
+  cache.clear();
+  EXPECT_EQ(0, cache.getEntryCount());
+  EXPECT_EQ(0, cache.getTotalSize());
+  EXPECT_EQ(nullptr, cache.get(small->getHash()));
+}
@@ -0,0 +1,51 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/takeover/TakeoverClient.h"
+
+#include <folly/Exception.h>
+#include <folly/File.h>
+#include <folly/SocketAddress.h>
+#include <glog/logging.h>
+#include <sys/socket.h>
+
+namespace facebook {
+namespace eden {
+
+TakeoverData takeoverMounts(AbsolutePathPiece socketPath) {
+  folly::SocketAddress address;
+  address.setFromPath(socketPath.stringPiece());
+  sockaddr_storage addrStorage;
+  auto addrLen = address.getAddress(&addrStorage);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  folly::checkUnixError(fd, "failed to create takeover socket");
+  folly::File socket(fd, true);
+
+  int rc = connect(
+      socket.fd(), reinterpret_cast<sockaddr*>(&addrStorage), addrLen);
+  folly::checkUnixError(
+      rc, "unable to connect to takeover socket ", socketPath);
+
+  auto data = TakeoverData::receive(socket.fd());
+
+  // Tell the other process that we have the mount points, and wait for it to
+  // close the stores in the eden directory before we open them.  If it closes
+  // the socket instead it has either exited, or given up on us and resumed
+  // serving, in which case acquiring the eden lock will fail.
+  TakeoverData::sendSignal(socket.fd(), TakeoverData::Signal::ACKNOWLEDGED);
+  if (!TakeoverData::waitForSignal(
+          socket.fd(), TakeoverData::Signal::RELEASED)) {
+    LOG(WARNING) << "the old edenfs process exited without confirming that it "
+                 << "released the eden directory";
+  }
+  return data;
+}
+}
+}
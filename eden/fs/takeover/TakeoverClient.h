@@ -0,0 +1,31 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "eden/fs/takeover/TakeoverData.h"
+#include "eden/utils/PathFuncs.h"
+
+namespace facebook {
+namespace eden {
+
+/**
+ * Ask the edenfs process listening on the takeover socket to hand over its
+ * mount points to this process.
+ *
+ * This blocks until the other process has stopped serving its mount points,
+ * closed its stores and released the eden lock.  Throws if the other process
+ * could not be contacted or failed to stop.
+ *
+ * If this throws before the data has been acknowledged, the other process
+ * resumes serving its mount points.
+ */
+TakeoverData takeoverMounts(AbsolutePathPiece socketPath);
+}
+}
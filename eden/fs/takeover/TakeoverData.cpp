@@ -0,0 +1,286 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/takeover/TakeoverData.h"
+
+#include <folly/Conv.h>
+#include <folly/Exception.h>
+#include <folly/FileUtil.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <thrift/lib/cpp2/protocol/Serializer.h>
+#include <array>
+#include "eden/fs/takeover/gen-cpp2/takeover_types.h"
+
+using apache::thrift::CompactSerializer;
+using folly::StringPiece;
+using std::string;
+
+namespace facebook {
+namespace eden {
+
+namespace {
+/**
+ * The header sent before the serialized SerializedTakeoverData.
+ *
+ * The FUSE device file descriptors are attached to the header, in the same
+ * order as the mount points in the body.
+ */
+struct MessageHeader {
+  uint32_t magic;
+  uint32_t numFds;
+  uint64_t bodyLength;
+};
+
+constexpr uint32_t kMagic = 0xede00001;
+
+/**
+ * The most file descriptors that can be passed in a single message.
+ * (This is SCM_MAX_FD in the Linux kernel.)
+ */
+constexpr size_t kMaxFds = 253;
+
+void sendMessage(
+    int socket,
+    const string& body,
+    const std::vector<int>& fds) {
+  if (fds.size() > kMaxFds) {
+    throw std::runtime_error(folly::to<string>(
+        "cannot hand over ", fds.size(), " mount points at once"));
+  }
+
+  MessageHeader header;
+  header.magic = kMagic;
+  header.numFds = fds.size();
+  header.bodyLength = body.size();
+
+  struct iovec iov;
+  iov.iov_base = &header;
+  iov.iov_len = sizeof(header);
+
+  struct msghdr mh;
+  memset(&mh, 0, sizeof(mh));
+  mh.msg_iov = &iov;
+  mh.msg_iovlen = 1;
+
+  std::vector<char> ctrlBuf;
+  if (!fds.empty()) {
+    auto payloadSize = sizeof(int) * fds.size();
+    ctrlBuf.resize(CMSG_SPACE(payloadSize));
+    mh.msg_control = ctrlBuf.data();
+    mh.msg_controllen = ctrlBuf.size();
+
+    auto cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(payloadSize);
+    memcpy(CMSG_DATA(cmsg), fds.data(), payloadSize);
+    mh.msg_controllen = cmsg->cmsg_len;
+  }
+
+  ssize_t bytesSent;
+  do {
+    bytesSent = sendmsg(socket, &mh, MSG_NOSIGNAL);
+  } while (bytesSent < 0 && errno == EINTR);
+  if (bytesSent < 0) {
+    folly::throwSystemError("error sending takeover header");
+  }
+  if (static_cast<size_t>(bytesSent) != sizeof(header)) {
+    throw std::runtime_error(folly::to<string>(
+        "only sent ", bytesSent, " bytes of the takeover header"));
+  }
+
+  if (folly::writeFull(socket, body.data(), body.size()) < 0) {
+    folly::throwSystemError("error sending takeover data");
+  }
+}
+
+void sendSerialized(
+    int socket,
+    const SerializedTakeoverData& data,
+    const std::vector<int>& fds) {
+  sendMessage(socket, CompactSerializer::serialize<string>(data), fds);
+}
+}
+
+void TakeoverData::send(int socket) {
+  std::vector<int> fds;
+  std::vector<SerializedMountInfo> mounts;
+  for (const auto& mount : mountPoints) {
+    fds.push_back(mount.channelData.fd.fd());
+
+    SerializedMountInfo serialized;
+    serialized.mountPath = mount.mountPath.stringPiece().str();
+    serialized.stateDirectory = mount.stateDirectory.stringPiece().str();
+    serialized.fuseInitRequest = mount.channelData.initRequest;
+    serialized.inodeMap = mount.inodeMap;
+    serialized.fileHandleMap = mount.fileHandleMap;
+    mounts.push_back(std::move(serialized));
+  }
+
+  SerializedTakeoverData data;
+  data.set_mounts(std::move(mounts));
+  sendSerialized(socket, data, fds);
+}
+
+void TakeoverData::sendError(int socket, StringPiece reason) {
+  SerializedTakeoverData data;
+  data.set_errorReason(reason.str());
+  sendSerialized(socket, data, {});
+}
+
+void TakeoverData::sendSignal(int socket, Signal signal) {
+  MessageHeader header;
+  header.magic = static_cast<uint32_t>(signal);
+  header.numFds = 0;
+  header.bodyLength = 0;
+
+  ssize_t bytesSent;
+  do {
+    bytesSent = ::send(socket, &header, sizeof(header), MSG_NOSIGNAL);
+  } while (bytesSent < 0 && errno == EINTR);
+  if (bytesSent < 0) {
+    folly::throwSystemError("error sending takeover signal");
+  }
+  if (static_cast<size_t>(bytesSent) != sizeof(header)) {
+    throw std::runtime_error(folly::to<string>(
+        "only sent ", bytesSent, " bytes of the takeover signal"));
+  }
+}
+
+bool TakeoverData::waitForSignal(int socket, Signal signal) {
+  MessageHeader header;
+  auto bytesRead = folly::readFull(socket, &header, sizeof(header));
+  if (bytesRead < 0) {
+    folly::throwSystemError("error receiving takeover signal");
+  }
+  if (bytesRead == 0) {
+    return false;
+  }
+  if (static_cast<size_t>(bytesRead) != sizeof(header)) {
+    throw std::runtime_error(folly::to<string>(
+        "received truncated takeover signal: ", bytesRead, " bytes"));
+  }
+  if (header.magic != static_cast<uint32_t>(signal) || header.numFds != 0 ||
+      header.bodyLength != 0) {
+    throw std::runtime_error(folly::to<string>(
+        "unexpected takeover signal ",
+        header.magic,
+        " while waiting for ",
+        static_cast<uint32_t>(signal)));
+  }
+  return true;
+}
+
+TakeoverData TakeoverData::receive(int socket) {
+  MessageHeader header;
+  struct iovec iov;
+  iov.iov_base = &header;
+  iov.iov_len = sizeof(header);
+
+  std::array<char, CMSG_SPACE(sizeof(int) * kMaxFds)> ctrlBuf;
+  struct msghdr mh;
+  memset(&mh, 0, sizeof(mh));
+  mh.msg_iov = &iov;
+  mh.msg_iovlen = 1;
+  mh.msg_control = ctrlBuf.data();
+  mh.msg_controllen = ctrlBuf.size();
+
+  ssize_t bytesRead;
+  do {
+    bytesRead = recvmsg(socket, &mh, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+  } while (bytesRead < 0 && errno == EINTR);
+  if (bytesRead < 0) {
+    folly::throwSystemError("error receiving takeover header");
+  }
+
+  // Take ownership of any file descriptors we were sent before checking
+  // anything else, so that they are closed if we throw.
+  std::vector<folly::File> files;
+  for (auto cmsg = CMSG_FIRSTHDR(&mh); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    auto numFds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t n = 0; n < numFds; ++n) {
+      int fd;
+      memcpy(&fd, CMSG_DATA(cmsg) + n * sizeof(int), sizeof(fd));
+      files.emplace_back(fd, true);
+    }
+  }
+
+  if (static_cast<size_t>(bytesRead) != sizeof(header)) {
+    throw std::runtime_error(folly::to<string>(
+        "received truncated takeover header: ", bytesRead, " bytes"));
+  }
+  if (header.magic != kMagic) {
+    throw std::runtime_error(folly::to<string>(
+        "unexpected takeover protocol version ", header.magic));
+  }
+  if (mh.msg_flags & MSG_CTRUNC) {
+    throw std::runtime_error("takeover file descriptors were truncated");
+  }
+  if (files.size() != header.numFds) {
+    throw std::runtime_error(folly::to<string>(
+        "expected ",
+        header.numFds,
+        " file descriptors in the takeover data, but received ",
+        files.size()));
+  }
+
+  string body;
+  body.resize(header.bodyLength);
+  auto bodyRead = folly::readFull(socket, &body[0], body.size());
+  if (bodyRead < 0) {
+    folly::throwSystemError("error receiving takeover data");
+  }
+  if (static_cast<size_t>(bodyRead) != body.size()) {
+    throw std::runtime_error("received truncated takeover data");
+  }
+
+  auto data = CompactSerializer::deserialize<SerializedTakeoverData>(body);
+  switch (data.getType()) {
+    case SerializedTakeoverData::Type::errorReason:
+      throw std::runtime_error(folly::to<string>(
+          "the running edenfs process could not be taken over: ",
+          data.get_errorReason()));
+    case SerializedTakeoverData::Type::mounts:
+      break;
+    default:
+      throw std::runtime_error("received empty takeover data");
+  }
+
+  const auto& mounts = data.get_mounts();
+  if (mounts.size() != files.size()) {
+    throw std::runtime_error(folly::to<string>(
+        "received ",
+        mounts.size(),
+        " mount points but ",
+        files.size(),
+        " FUSE devices"));
+  }
+
+  TakeoverData result;
+  for (size_t n = 0; n < mounts.size(); ++n) {
+    const auto& mount = mounts[n];
+    fusell::FuseChannelData channelData;
+    channelData.fd = std::move(files[n]);
+    channelData.initRequest = mount.fuseInitRequest;
+    result.mountPoints.emplace_back(
+        AbsolutePathPiece{mount.mountPath},
+        AbsolutePathPiece{mount.stateDirectory},
+        std::move(channelData),
+        mount.inodeMap,
+        mount.fileHandleMap);
+  }
+  return result;
+}
+}
+}
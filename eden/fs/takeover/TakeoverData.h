@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <vector>
+#include "eden/fs/inodes/gen-cpp2/overlay_types.h"
+#include "eden/fuse/Channel.h"
+#include "eden/fuse/gen-cpp2/handlemap_types.h"
+#include "eden/utils/PathFuncs.h"
+
+namespace facebook {
+namespace eden {
+
+/**
+ * The state that one edenfs process hands over to another during a graceful
+ * restart, so that the new process can continue serving the mount points
+ * without unmounting them.
+ */
+class TakeoverData {
+ public:
+  struct MountInfo {
+    MountInfo(
+        AbsolutePathPiece mountPath,
+        AbsolutePathPiece stateDirectory,
+        fusell::FuseChannelData channelData,
+        overlay::SerializedInodeMap inodeMap,
+        fusell::SerializedFileHandleMap fileHandleMap)
+        : mountPath{mountPath},
+          stateDirectory{stateDirectory},
+          channelData{std::move(channelData)},
+          inodeMap{std::move(inodeMap)},
+          fileHandleMap{std::move(fileHandleMap)} {}
+
+    AbsolutePath mountPath;
+    /** The client directory holding the mount point's configuration. */
+    AbsolutePath stateDirectory;
+    fusell::FuseChannelData channelData;
+    overlay::SerializedInodeMap inodeMap;
+    fusell::SerializedFileHandleMap fileHandleMap;
+  };
+
+  /**
+   * The messages the two processes exchange after the takeover data has been
+   * sent, so that the new process does not open the eden directory's stores
+   * until the old process has closed them.
+   */
+  enum class Signal : uint32_t {
+    /** The new process has received the data and is taking over. */
+    ACKNOWLEDGED = 0xede00002,
+    /** The old process has closed its stores and released the eden lock. */
+    RELEASED = 0xede00003,
+  };
+
+  /**
+   * Send this data over a connected unix domain socket.
+   *
+   * The FUSE device file descriptors are passed with SCM_RIGHTS.
+   */
+  void send(int socket);
+
+  /**
+   * Tell the process on the other end of the socket that the takeover
+   * failed.
+   */
+  static void sendError(int socket, folly::StringPiece reason);
+
+  /**
+   * Receive the data sent by send() from a connected unix domain socket.
+   *
+   * Throws if the other process sent an error instead.
+   */
+  static TakeoverData receive(int socket);
+
+  /**
+   * Send a signal to the process on the other end of the socket.
+   */
+  static void sendSignal(int socket, Signal signal);
+
+  /**
+   * Wait for the process on the other end of the socket to send the
+   * specified signal.
+   *
+   * Returns false if the other process closed the socket instead.  Throws if
+   * it sent anything else, or if the socket has a receive timeout that
+   * expires.
+   */
+  static bool waitForSignal(int socket, Signal signal);
+
+  std::vector<MountInfo> mountPoints;
+};
+}
+}
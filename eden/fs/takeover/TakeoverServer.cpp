@@ -0,0 +1,152 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/takeover/TakeoverServer.h"
+
+#include <folly/Exception.h>
+#include <folly/SocketAddress.h>
+#include <folly/String.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+DEFINE_int32(
+    takeover_ack_timeout,
+    60,
+    "seconds to wait for the new edenfs process to acknowledge the takeover "
+    "data before resuming service of our mount points");
+
+namespace facebook {
+namespace eden {
+
+TakeoverServer::TakeoverServer(
+    AbsolutePathPiece socketPath,
+    TakeoverHandler* handler)
+    : socketPath_{socketPath}, handler_{handler} {}
+
+TakeoverServer::~TakeoverServer() {
+  stop();
+}
+
+void TakeoverServer::start() {
+  folly::SocketAddress address;
+  address.setFromPath(socketPath_.stringPiece());
+  sockaddr_storage addrStorage;
+  auto addrLen = address.getAddress(&addrStorage);
+
+  // Our caller holds the eden lock, so any existing socket is unused.
+  int rc = unlink(socketPath_.c_str());
+  if (rc != 0 && errno != ENOENT) {
+    folly::throwSystemError(
+        "unable to remove old takeover socket ", socketPath_);
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  folly::checkUnixError(fd, "failed to create takeover socket");
+  listenSocket_ = folly::File(fd, true);
+
+  rc = bind(
+      listenSocket_.fd(), reinterpret_cast<sockaddr*>(&addrStorage), addrLen);
+  folly::checkUnixError(rc, "failed to bind takeover socket ", socketPath_);
+  rc = listen(listenSocket_.fd(), 1);
+  folly::checkUnixError(rc, "failed to listen on takeover socket");
+
+  thread_ = std::thread([this] { serve(); });
+}
+
+void TakeoverServer::stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  // Shutting down the listening socket wakes up the thread if it is still
+  // blocked in accept().
+  shutdown(listenSocket_.fd(), SHUT_RDWR);
+  thread_.join();
+  listenSocket_.close();
+}
+
+void TakeoverServer::serve() {
+  while (true) {
+    int fd;
+    do {
+      fd = accept4(listenSocket_.fd(), nullptr, nullptr, SOCK_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+      if (errno != EINVAL) {
+        PLOG(ERROR) << "error accepting takeover connection";
+      }
+      return;
+    }
+
+    folly::File socket(fd, true);
+    if (handleConnection(socket.fd())) {
+      return;
+    }
+  }
+}
+
+bool TakeoverServer::handleConnection(int socket) {
+  LOG(INFO) << "another edenfs process is taking over our mount points";
+  TakeoverData data;
+  try {
+    data = handler_->startTakeoverShutdown().get();
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "error while handing over mount points: "
+               << folly::exceptionStr(ex);
+    try {
+      TakeoverData::sendError(socket, folly::exceptionStr(ex).toStdString());
+    } catch (const std::exception& sendEx) {
+      LOG(ERROR) << "error sending takeover error: "
+                 << folly::exceptionStr(sendEx);
+    }
+    return false;
+  }
+
+  // Until the new process acknowledges the data we can still take the mount
+  // points back, so only wait a limited time for it.
+  bool acknowledged = false;
+  try {
+    data.send(socket);
+    struct timeval timeout;
+    timeout.tv_sec = FLAGS_takeover_ack_timeout;
+    timeout.tv_usec = 0;
+    auto rc = setsockopt(
+        socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    folly::checkUnixError(rc, "failed to set the takeover socket timeout");
+    acknowledged =
+        TakeoverData::waitForSignal(socket, TakeoverData::Signal::ACKNOWLEDGED);
+    if (!acknowledged) {
+      LOG(ERROR) << "the new edenfs process exited without acknowledging the "
+                 << "takeover";
+    }
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "error while handing over mount points: "
+               << folly::exceptionStr(ex);
+  }
+  if (!acknowledged) {
+    LOG(INFO) << "resuming service of our mount points";
+    handler_->abortTakeover();
+    return false;
+  }
+
+  handler_->completeTakeover();
+  LOG(INFO) << "handed over " << data.mountPoints.size() << " mount points";
+  try {
+    TakeoverData::sendSignal(socket, TakeoverData::Signal::RELEASED);
+  } catch (const std::exception& ex) {
+    // The new process also treats us closing the socket as the release.
+    LOG(WARNING) << "error confirming the takeover: "
+                 << folly::exceptionStr(ex);
+  }
+  return true;
+}
+}
+}
+}
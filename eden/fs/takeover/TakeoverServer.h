@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/File.h>
+#include <folly/futures/Future.h>
+#include <thread>
+#include "eden/fs/takeover/TakeoverData.h"
+#include "eden/utils/PathFuncs.h"
+
+namespace facebook {
+namespace eden {
+
+/**
+ * The interface TakeoverServer uses to ask the running process to hand over
+ * its mount points.
+ */
+class TakeoverHandler {
+ public:
+  virtual ~TakeoverHandler() {}
+
+  /**
+   * Stop serving all mount points, and return the state needed for another
+   * process to resume serving them.
+   *
+   * Exactly one of completeTakeover() or abortTakeover() is called once the
+   * returned future succeeds.  If it fails, the process must already be
+   * serving its mount points again.
+   */
+  virtual folly::Future<TakeoverData> startTakeoverShutdown() = 0;
+
+  /**
+   * Called once the new process has acknowledged the takeover data.
+   *
+   * This must let go of the mount points, close everything in the eden
+   * directory that the new process will open, and release the eden lock
+   * before returning.  The process then exits without unmounting anything.
+   */
+  virtual void completeTakeover() = 0;
+
+  /**
+   * Called if the new process does not acknowledge the takeover data, to
+   * resume serving the mount points.
+   */
+  virtual void abortTakeover() = 0;
+};
+
+/**
+ * Listens on a unix domain socket for a new edenfs process that wants to take
+ * over the mount points of this one.
+ *
+ * The protocol is:
+ *   - this process stops its mount points and sends the TakeoverData
+ *   - the new process replies with Signal::ACKNOWLEDGED
+ *   - this process closes its stores, releases the eden lock, and sends
+ *     Signal::RELEASED, after which the new process may open them
+ *
+ * If the new process disconnects or times out before acknowledging the
+ * data, this process resumes serving its mount points and waits for another
+ * connection.  The server stops listening once a takeover has succeeded.
+ */
+class TakeoverServer {
+ public:
+  TakeoverServer(AbsolutePathPiece socketPath, TakeoverHandler* handler);
+  ~TakeoverServer();
+
+  /**
+   * Start listening on the socket, replacing any socket left behind by a
+   * previous process.
+   */
+  void start();
+
+  /**
+   * Stop listening, and wait for any takeover in progress to finish.
+   */
+  void stop();
+
+ private:
+  TakeoverServer(TakeoverServer const&) = delete;
+  TakeoverServer& operator=(TakeoverServer const&) = delete;
+
+  void serve();
+  /**
+   * Perform a takeover for a new connection.  Returns true if the mount
+   * points were handed over.
+   */
+  bool handleConnection(int socket);
+
+  AbsolutePath socketPath_;
+  TakeoverHandler* const handler_;
+  folly::File listenSocket_;
+  std::thread thread_;
+};
+}
+}
@@ -0,0 +1,21 @@
+include "eden/fs/inodes/overlay.thrift"
+include "eden/fuse/handlemap.thrift"
+
+namespace cpp2 facebook.eden
+
+// The state of a mount point that is being handed over to another edenfs
+// process.  The FUSE device for the mount is sent alongside the message.
+struct SerializedMountInfo {
+  1: string mountPath
+  2: string stateDirectory
+  // The FUSE_INIT request that the kernel sent when the mount was created.
+  3: binary fuseInitRequest
+  4: overlay.SerializedInodeMap inodeMap
+  5: handlemap.SerializedFileHandleMap fileHandleMap
+}
+
+union SerializedTakeoverData {
+  1: list<SerializedMountInfo> mounts
+  // Sent instead of the mount points if the old process could not stop them.
+  2: string errorReason
+}
@@ -0,0 +1,124 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/takeover/TakeoverData.h"
+
+#include <folly/Exception.h>
+#include <folly/FileUtil.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <array>
+
+using namespace facebook::eden;
+using folly::File;
+
+namespace {
+std::array<File, 2> makeSocketPair() {
+  std::array<int, 2> fds;
+  int rc = socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data());
+  folly::checkUnixError(rc, "socketpair failed");
+  return {{File(fds[0], true), File(fds[1], true)}};
+}
+
+std::array<File, 2> makePipe() {
+  std::array<int, 2> fds;
+  int rc = pipe(fds.data());
+  folly::checkUnixError(rc, "pipe failed");
+  return {{File(fds[0], true), File(fds[1], true)}};
+}
+}
+
+TEST(TakeoverData, roundTrip) {
+  auto sockets = makeSocketPair();
+  auto pipe = makePipe();
+
+  overlay::SerializedInodeMap inodeMap;
+  inodeMap.nextInodeNumber = 100;
+  overlay::SerializedInodeMapEntry inodeEntry;
+  inodeEntry.inodeNumber = 42;
+  inodeEntry.parentInode = 1;
+  inodeEntry.name = "foo";
+  inodeEntry.numFuseReferences = 3;
+  inodeMap.entries.push_back(inodeEntry);
+
+  fusell::SerializedFileHandleMap handleMap;
+  fusell::FileHandleMapEntry handleEntry;
+  handleEntry.inodeNumber = 42;
+  handleEntry.handleId = 1234;
+  handleEntry.isDir = false;
+  handleEntry.flags = O_RDWR;
+  handleMap.entries.push_back(handleEntry);
+
+  fusell::FuseChannelData channelData;
+  channelData.fd = pipe[0].dup();
+  channelData.initRequest = "init request";
+
+  TakeoverData sent;
+  sent.mountPoints.emplace_back(
+      AbsolutePathPiece{"/mnt/eden"},
+      AbsolutePathPiece{"/home/user/.eden/clients/eden"},
+      std::move(channelData),
+      inodeMap,
+      handleMap);
+  sent.send(sockets[0].fd());
+
+  auto received = TakeoverData::receive(sockets[1].fd());
+  ASSERT_EQ(1, received.mountPoints.size());
+  const auto& mount = received.mountPoints[0];
+  EXPECT_EQ(AbsolutePathPiece{"/mnt/eden"}, mount.mountPath);
+  EXPECT_EQ(
+      AbsolutePathPiece{"/home/user/.eden/clients/eden"},
+      mount.stateDirectory);
+  EXPECT_EQ("init request", mount.channelData.initRequest);
+  EXPECT_EQ(inodeMap, mount.inodeMap);
+  EXPECT_EQ(handleMap, mount.fileHandleMap);
+
+  // The received file descriptor should refer to the same pipe.
+  ASSERT_TRUE(mount.channelData.fd);
+  EXPECT_NE(pipe[0].fd(), mount.channelData.fd.fd());
+  ASSERT_EQ(5, folly::writeFull(pipe[1].fd(), "hello", 5));
+  char buf[5];
+  ASSERT_EQ(5, folly::readFull(mount.channelData.fd.fd(), buf, sizeof(buf)));
+  EXPECT_EQ("hello", folly::StringPiece(buf, sizeof(buf)));
+}
+
+TEST(TakeoverData, sendError) {
+  auto sockets = makeSocketPair();
+  TakeoverData::sendError(sockets[0].fd(), "mount points are busy");
+  try {
+    TakeoverData::receive(sockets[1].fd());
+    FAIL() << "receive() should have thrown";
+  } catch (const std::runtime_error& ex) {
+    EXPECT_NE(
+        std::string::npos,
+        std::string(ex.what()).find("mount points are busy"));
+  }
+}
+
+TEST(TakeoverData, signals) {
+  auto sockets = makeSocketPair();
+  TakeoverData::sendSignal(
+      sockets[1].fd(), TakeoverData::Signal::ACKNOWLEDGED);
+  EXPECT_TRUE(TakeoverData::waitForSignal(
+      sockets[0].fd(), TakeoverData::Signal::ACKNOWLEDGED));
+
+  // Receiving a different signal than expected is an error.
+  TakeoverData::sendSignal(sockets[0].fd(), TakeoverData::Signal::RELEASED);
+  EXPECT_THROW(
+      TakeoverData::waitForSignal(
+          sockets[1].fd(), TakeoverData::Signal::ACKNOWLEDGED),
+      std::runtime_error);
+
+  // The other process closing the socket is reported, not thrown.
+  sockets[0].close();
+  EXPECT_FALSE(TakeoverData::waitForSignal(
+      sockets[1].fd(), TakeoverData::Signal::RELEASED));
+}
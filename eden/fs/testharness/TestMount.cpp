@@ -119,6 +119,21 @@ void TestMount::initialize(
       std::move(config_), std::move(objectStore), AbsolutePathPiece(), &stats_);
 }
 
+void TestMount::remount(const overlay::SerializedInodeMap& takeoverInodeMap) {
+  auto config = make_unique<ClientConfig>(
+      edenMount_->getPath(), edenMount_->getConfig()->getClientDirectory());
+  edenMount_.reset();
+
+  unique_ptr<ObjectStore> objectStore =
+      make_unique<ObjectStore>(localStore_, backingStore_);
+  edenMount_ = EdenMount::makeShared(
+      std::move(config),
+      std::move(objectStore),
+      AbsolutePathPiece(),
+      &stats_,
+      &takeoverInodeMap);
+}
+
 Hash TestMount::nextCommitHash() {
   auto number = commitNumber_.fetch_add(1);
   return makeTestHash(folly::to<string>(number));
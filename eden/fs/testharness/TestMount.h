@@ -121,6 +121,16 @@ class TestMount {
       bool startReady = true);
   void initialize(FakeTreeBuilder& rootBuilder, bool startReady = true);
 
+  /**
+   * Destroy the current EdenMount and create a new one for the same client
+   * directory, as if another process had taken over the mount point.
+   *
+   * The new EdenMount restores the inode numbers in takeoverInodeMap, which
+   * would normally come from InodeMap::save() on the old EdenMount.  The
+   * caller must not hold any references to the old mount's inodes.
+   */
+  void remount(const overlay::SerializedInodeMap& takeoverInodeMap);
+
   /**
    * Set the initial directives stored in the on-disk dirstate.
    *
@@ -9,26 +9,92 @@
  */
 #include "BufVec.h"
 
+#include <folly/Exception.h>
+#include <folly/FileUtil.h>
+
 namespace facebook {
 namespace eden {
 namespace fusell {
 
 BufVec::Buf::Buf(std::unique_ptr<folly::IOBuf> buf) : buf(std::move(buf)) {}
 
+BufVec::Buf::Buf(int fd, off_t pos, size_t size)
+    : fd(fd), fd_size(size), fd_pos(pos) {}
+
+void BufVec::Buf::loadFromFd() {
+  if (fd == -1) {
+    return;
+  }
+
+  auto data = folly::IOBuf::createCombined(fd_size);
+  auto res = folly::preadFull(fd, data->writableBuffer(), fd_size, fd_pos);
+  folly::checkUnixError(res, "error reading file data for BufVec");
+  data->append(res);
+
+  buf = std::move(data);
+  fd = -1;
+  fd_size = 0;
+  fd_pos = -1;
+}
+
 BufVec::BufVec(std::unique_ptr<folly::IOBuf> buf) {
   items_.emplace_back(std::make_shared<Buf>(std::move(buf)));
 }
 
+BufVec::BufVec(int fd, off_t pos, size_t size) {
+  items_.emplace_back(std::make_shared<Buf>(fd, pos, size));
+}
+
 folly::fbvector<struct iovec> BufVec::getIov() const {
   folly::fbvector<struct iovec> vec;
 
   for (const auto& b : items_) {
-    DCHECK(b->fd == -1) << "we don't support splicing yet";
+    b->loadFromFd();
     b->buf->appendToIov(&vec);
   }
 
   return vec;
 }
+
+bool BufVec::hasFileDescriptors() const {
+  for (const auto& b : items_) {
+    if (b->fd != -1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#ifdef FUSE_CAP_SPLICE_WRITE
+folly::fbvector<struct fuse_buf> BufVec::getFuseBufs() const {
+  folly::fbvector<struct fuse_buf> bufs;
+
+  for (const auto& b : items_) {
+    if (b->fd != -1) {
+      struct fuse_buf fb {};
+      fb.size = b->fd_size;
+      fb.flags = static_cast<fuse_buf_flags>(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+      fb.fd = b->fd;
+      fb.pos = b->fd_pos;
+      bufs.push_back(fb);
+      continue;
+    }
+
+    for (const auto& range : *b->buf) {
+      if (range.empty()) {
+        continue;
+      }
+      struct fuse_buf fb {};
+      fb.size = range.size();
+      fb.mem = const_cast<uint8_t*>(range.data());
+      fb.fd = -1;
+      bufs.push_back(fb);
+    }
+  }
+
+  return bufs;
+}
+#endif
 }
 }
 }
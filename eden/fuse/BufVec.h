@@ -10,6 +10,7 @@
 #pragma once
 #include <folly/FBVector.h>
 #include <folly/io/IOBuf.h>
+#include "eden/fuse/fuse_headers.h"
 
 namespace facebook {
 namespace eden {
@@ -18,9 +19,13 @@ namespace fusell {
 /**
  * Represents data that may come from a buffer or a file descriptor.
  *
- * While we don't currently have a fuse client lib that supports this,
- * we want to make sure we're ready to use it, so this looks like
- * a dumb wrapper around IOBuf at the moment.
+ * File descriptor backed data is not read into memory up front.  When
+ * replying to a FUSE read request with fuse_reply_data() the FUSE library can
+ * splice() it directly from the file into the kernel, avoiding a copy through
+ * userspace.  Callers that need the data in memory can use getIov(), which
+ * reads any file descriptor backed data on demand.
+ *
+ * The file descriptor must remain open until the BufVec has been consumed.
  */
 class BufVec {
   struct Buf {
@@ -35,6 +40,13 @@ class BufVec {
     Buf& operator=(Buf&&) = default;
 
     explicit Buf(std::unique_ptr<folly::IOBuf> buf);
+    Buf(int fd, off_t pos, size_t size);
+
+    /**
+     * Read the file descriptor backed data into buf.
+     * This is a no-op if this Buf is already memory backed.
+     */
+    void loadFromFd();
   };
   folly::fbvector<std::shared_ptr<Buf>> items_;
 
@@ -46,12 +58,35 @@ class BufVec {
 
   explicit BufVec(std::unique_ptr<folly::IOBuf> buf);
 
+  /**
+   * Construct a BufVec referring to up to size bytes of the file fd,
+   * starting at offset pos.  Fewer bytes will be produced if the file ends
+   * before pos + size.
+   */
+  BufVec(int fd, off_t pos, size_t size);
+
   /**
    * Return an iovector suitable for e.g. writev()
    *   auto iov = buf->getIov();
    *   auto xfer = writev(fd, iov.data(), iov.size());
+   *
+   * Any file descriptor backed data is read into memory first.
    */
   folly::fbvector<struct iovec> getIov() const;
+
+  /**
+   * Returns true if some of the data in this BufVec still has to be read
+   * from a file descriptor.
+   */
+  bool hasFileDescriptors() const;
+
+#ifdef FUSE_CAP_SPLICE_WRITE
+  /**
+   * Return a list of fuse_buf structures describing this data, suitable for
+   * building a fuse_bufvec to pass to fuse_reply_data().
+   */
+  folly::fbvector<struct fuse_buf> getFuseBufs() const;
+#endif
 };
 }
 }
@@ -9,16 +9,21 @@
  */
 #include "Channel.h"
 
+#include <fcntl.h>
+#include <folly/Conv.h>
 #include <folly/Exception.h>
 #include <folly/File.h>
 #include <folly/Format.h>
 #include <folly/String.h>
 #include <linux/fuse.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
 #include <algorithm>
+#include <mutex>
 
 #include "Dispatcher.h"
 #include "MountPoint.h"
@@ -31,8 +36,122 @@ namespace facebook {
 namespace eden {
 namespace fusell {
 
+/**
+ * Coordinates stopForTakeover() with the worker threads reading requests
+ * from the FUSE device.
+ *
+ * fuse_do_work() in libfuse 2.9 discards a request it has just received if
+ * fuse_session_loop_mt() is shutting down, so the session must not exit
+ * while any worker is between reading a request and dispatching it.  A
+ * worker only calls receive again once it has dispatched its last request,
+ * so a read counts as active until the same thread next calls receive, or
+ * exits.
+ */
+class ChannelStopState {
+ public:
+  explicit ChannelStopState(folly::File stopEvent)
+      : stopEvent_(std::move(stopEvent)) {}
+
+  void setSession(fuse_session* session) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    session_ = session;
+  }
+
+  int getStopEventFd() const {
+    return stopEvent_.fd();
+  }
+
+  /**
+   * Called before reading from the device.  Returns false if the channel is
+   * being stopped, in which case the caller must not read.
+   */
+  bool startRead() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (stopping_) {
+      return false;
+    }
+    ++activeReads_;
+    return true;
+  }
+
+  /**
+   * Called once a request read after startRead() has been dispatched, or if
+   * the read failed.
+   */
+  void finishRead() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    DCHECK_GT(activeReads_, 0);
+    --activeReads_;
+    if (stopping_ && activeReads_ == 0) {
+      exitLocked();
+    }
+  }
+
+  void stop() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stopping_ = true;
+    if (activeReads_ == 0) {
+      exitLocked();
+    }
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    uint64_t value;
+    while (read(stopEvent_.fd(), &value, sizeof(value)) > 0) {
+    }
+    stopping_ = false;
+    exited_ = false;
+  }
+
+ private:
+  void exitLocked() {
+    if (exited_) {
+      return;
+    }
+    exited_ = true;
+    if (session_) {
+      fuse_session_exit(session_);
+    }
+    // Wake every worker waiting in receive.  The event stays signalled until
+    // reset(), so they all see it.
+    uint64_t value = 1;
+    if (write(stopEvent_.fd(), &value, sizeof(value)) < 0) {
+      PLOG(ERROR) << "failed to signal the FUSE channel stop event";
+    }
+  }
+
+  std::mutex mutex_;
+  folly::File stopEvent_;
+  fuse_session* session_{nullptr};
+  size_t activeReads_{0};
+  bool stopping_{false};
+  bool exited_{false};
+};
+
 namespace {
 
+/**
+ * The request that this thread most recently read from a FUSE device, if it
+ * may not have been dispatched yet.
+ */
+struct PendingRead {
+  ~PendingRead() {
+    finish();
+  }
+
+  void finish() {
+    if (state) {
+      state->finishRead();
+      state.reset();
+    }
+  }
+
+  std::shared_ptr<ChannelStopState> state;
+};
+
+thread_local PendingRead tlPendingRead;
+
 /*
  * fuse_chan_ops functions.
  *
@@ -43,49 +162,8 @@ namespace {
  */
 
 int fuseChanReceive(struct fuse_chan** chp, char* buf, size_t size) {
-  struct fuse_chan* ch = *chp;
-  auto session = fuse_chan_session(ch);
-
-  int fd = fuse_chan_fd(ch);
-  while (true) {
-    auto res = read(fd, buf, size);
-    int err = errno;
-
-    if (fuse_session_exited(session)) {
-      return 0;
-    }
-    if (res < 0) {
-      if (err == ENOENT) {
-        // According to comments in the libfuse code:
-        // ENOENT means the operation was interrupted; it's safe to restart
-        continue;
-      }
-      if (err == ENODEV) {
-        // ENODEV means the filesystem was unmounted
-        fuse_session_exit(session);
-        return 0;
-      }
-      if (err != EINTR && err != EAGAIN) {
-        LOG(WARNING) << "error reading from fuse channel: "
-                     << folly::errnoStr(err);
-      }
-      return -err;
-    }
-
-    // It really seems like our caller should be responsible for
-    // checking that a short read wasn't performed before using the buffer,
-    // rather than just assuming that the receive operator will always do this.
-    //
-    // Unfortunately it doesn't look like fuse_do_work() checks the buffer
-    // length before using header fields though, so we have to make sure to
-    // check for this ourselves.
-    if (static_cast<size_t>(res) < sizeof(struct fuse_in_header)) {
-      LOG(ERROR) << "read truncated message from kernel fuse device: len="
-                 << res;
-      return -EIO;
-    }
-    return res;
-  }
+  auto* channel = static_cast<Channel*>(fuse_chan_data(*chp));
+  return channel->receive(buf, size);
 }
 
 int fuseChanSend(struct fuse_chan* ch, const struct iovec iov[], size_t count) {
@@ -113,7 +191,14 @@ void fuseChanDestroy(struct fuse_chan* ch) {
   close(fuse_chan_fd(ch));
 }
 
-fuse_chan* fuseChanNew(folly::File&& fuseDevice) {
+fuse_chan* fuseChanNew(folly::File&& fuseDevice, Channel* channel) {
+  // Make reads non-blocking, so that fuseChanReceive() only ever waits in
+  // poll(), where stopForTakeover() can wake it.
+  auto flags = fcntl(fuseDevice.fd(), F_GETFL);
+  if (flags < 0 || fcntl(fuseDevice.fd(), F_SETFL, flags | O_NONBLOCK) < 0) {
+    throwSystemError("failed to make the FUSE device non-blocking");
+  }
+
   struct fuse_chan_ops op;
   op.receive = fuseChanReceive;
   op.send = fuseChanSend;
@@ -122,7 +207,7 @@ fuse_chan* fuseChanNew(folly::File&& fuseDevice) {
   constexpr size_t MIN_BUFSIZE = 0x21000;
   size_t bufsize =
       std::min(static_cast<size_t>(getpagesize()) + 0x1000, MIN_BUFSIZE);
-  auto* ch = fuse_chan_new(&op, fuseDevice.fd(), bufsize, nullptr);
+  auto* ch = fuse_chan_new(&op, fuseDevice.fd(), bufsize, channel);
   if (!ch) {
     throw std::runtime_error("failed to mount");
   }
@@ -134,11 +219,33 @@ fuse_chan* fuseChanNew(folly::File&& fuseDevice) {
   return ch;
 }
 
+folly::File makeStopEvent() {
+  auto fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd < 0) {
+    throwSystemError("failed to create eventfd for FUSE channel");
+  }
+  return folly::File{fd, true};
+}
+
 } // unnamed namespace
 
-Channel::Channel(const MountPoint* mount) : mountPoint_(mount) {
+Channel::Channel(const MountPoint* mount)
+    : mountPoint_(mount),
+      stopState_(std::make_shared<ChannelStopState>(makeStopEvent())) {
   auto fuseDevice = privilegedFuseMount(mountPoint_->getPath().stringPiece());
-  ch_ = fuseChanNew(std::move(fuseDevice));
+  ch_ = fuseChanNew(std::move(fuseDevice), this);
+}
+
+Channel::Channel(const MountPoint* mount, FuseChannelData takeoverData)
+    : mountPoint_(mount),
+      stopState_(std::make_shared<ChannelStopState>(makeStopEvent())),
+      initRequest_(std::move(takeoverData.initRequest)) {
+  if (initRequest_.rlock()->empty()) {
+    throw std::runtime_error(folly::to<std::string>(
+        "no FUSE_INIT request was handed over for ", mountPoint_->getPath()));
+  }
+  replayInit_.store(true, std::memory_order_release);
+  ch_ = fuseChanNew(std::move(takeoverData.fd), this);
 }
 
 const MountPoint* Channel::getMountPoint() const {
@@ -146,7 +253,15 @@ const MountPoint* Channel::getMountPoint() const {
 }
 
 Channel::~Channel() {
-  if (ch_) {
+  if (!ch_) {
+    return;
+  }
+  destroySession();
+  if (takenOver_) {
+    // Another process is now serving this mount point.  Just close our
+    // descriptor for the device.
+    fuse_chan_destroy(ch_);
+  } else {
     fuse_unmount(mountPoint_->getPath().c_str(), ch_);
   }
 }
@@ -181,15 +296,174 @@ void Channel::invalidateEntry(fuse_ino_t parent, PathComponentPiece name) {
 }
 
 void Channel::runSession(Dispatcher* disp, bool debug) {
-  auto sess = disp->makeSession(*this, debug);
-  fuse_session_add_chan(sess.get(), ch_);
+  if (!session_) {
+    session_ = disp->makeSession(*this, debug).release();
+    fuse_session_add_chan(session_, ch_);
+    stopState_->setSession(session_);
+  }
 
-  auto err = fuse_session_loop_mt(sess.get());
+  auto err = fuse_session_loop_mt(session_);
   if (err) {
     throw std::runtime_error("session failed");
   }
   LOG(INFO) << "session completed";
 }
+
+void Channel::destroySession() {
+  if (session_) {
+    stopState_->setSession(nullptr);
+    SessionDeleter(this)(session_);
+    session_ = nullptr;
+  }
+}
+
+void Channel::stopForTakeover() {
+  stopState_->stop();
+}
+
+FuseChannelData Channel::getTakeoverData() {
+  FuseChannelData data;
+  data.fd = folly::File{fuse_chan_fd(ch_)}.dup();
+  data.initRequest = *initRequest_.rlock();
+  if (data.initRequest.empty()) {
+    throw std::runtime_error(folly::to<std::string>(
+        "never received a FUSE_INIT request for ", mountPoint_->getPath()));
+  }
+  return data;
+}
+
+void Channel::releaseForTakeover() {
+  takenOver_ = true;
+  destroySession();
+}
+
+void Channel::resumeAfterTakeover() {
+  stopState_->reset();
+  if (session_) {
+    fuse_session_reset(session_);
+  }
+}
+
+int Channel::receive(char* buf, size_t size) {
+  // libfuse only calls us again once it has dispatched the last request this
+  // thread read, so it can no longer be dropped.
+  tlPendingRead.finish();
+
+  // A channel taken over from another process starts by replaying the
+  // FUSE_INIT request that the kernel sent to the original process.
+  auto initLength = replayInitRequest(buf, size);
+  if (UNLIKELY(initLength != 0)) {
+    return initLength;
+  }
+
+  int fd = fuse_chan_fd(ch_);
+  while (true) {
+    // Wait for either a request or for the stop event, which is signalled
+    // once stopForTakeover() has made the session exit.  Every thread waiting
+    // here then returns, which makes fuse_session_loop_mt() return without
+    // unmounting.  The device is non-blocking, so threads that lose the race
+    // for a request come back here rather than blocking in read().
+    struct pollfd pfds[2];
+    pfds[0].fd = fd;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = stopState_->getStopEventFd();
+    pfds[1].events = POLLIN;
+    auto pollResult = poll(pfds, 2, -1);
+    if (pollResult < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -errno;
+    }
+    if (pfds[1].revents & POLLIN) {
+      return 0;
+    }
+
+    if (!stopState_->startRead()) {
+      // stopForTakeover() has been called.  Leave the remaining requests in
+      // the kernel for the process taking over the device, and wait for the
+      // requests that other threads have already read to be dispatched.
+      struct pollfd stopPfd;
+      stopPfd.fd = stopState_->getStopEventFd();
+      stopPfd.events = POLLIN;
+      while (poll(&stopPfd, 1, -1) < 0 && errno == EINTR) {
+      }
+      return 0;
+    }
+
+    auto res = read(fd, buf, size);
+    int err = errno;
+
+    if (res < 0) {
+      stopState_->finishRead();
+      if (fuse_session_exited(session_)) {
+        return 0;
+      }
+      if (err == ENOENT) {
+        // According to comments in the libfuse code:
+        // ENOENT means the operation was interrupted; it's safe to restart
+        continue;
+      }
+      if (err == EAGAIN) {
+        // Another thread picked up the request that woke us.
+        continue;
+      }
+      if (err == ENODEV) {
+        // ENODEV means the filesystem was unmounted
+        fuse_session_exit(session_);
+        return 0;
+      }
+      if (err != EINTR) {
+        LOG(WARNING) << "error reading from fuse channel: "
+                     << folly::errnoStr(err);
+      }
+      return -err;
+    }
+
+    // It really seems like our caller should be responsible for
+    // checking that a short read wasn't performed before using the buffer,
+    // rather than just assuming that the receive operator will always do this.
+    //
+    // Unfortunately it doesn't look like fuse_do_work() checks the buffer
+    // length before using header fields though, so we have to make sure to
+    // check for this ourselves.
+    if (static_cast<size_t>(res) < sizeof(struct fuse_in_header)) {
+      stopState_->finishRead();
+      LOG(ERROR) << "read truncated message from kernel fuse device: len="
+                 << res;
+      return -EIO;
+    }
+
+    // The session must not exit until libfuse has dispatched this request.
+    tlPendingRead.state = stopState_;
+
+    auto* header = reinterpret_cast<const struct fuse_in_header*>(buf);
+    if (UNLIKELY(header->opcode == FUSE_INIT)) {
+      recordInitRequest(
+          folly::ByteRange{reinterpret_cast<const uint8_t*>(buf),
+                           static_cast<size_t>(res)});
+    }
+    return res;
+  }
+}
+
+void Channel::recordInitRequest(folly::ByteRange request) {
+  initRequest_.wlock()->assign(
+      reinterpret_cast<const char*>(request.data()), request.size());
+}
+
+size_t Channel::replayInitRequest(char* buf, size_t size) {
+  if (LIKELY(!replayInit_.load(std::memory_order_acquire))) {
+    return 0;
+  }
+  if (!replayInit_.exchange(false, std::memory_order_acq_rel)) {
+    return 0;
+  }
+  auto request = initRequest_.rlock();
+  CHECK_LE(request->size(), size);
+  memcpy(buf, request->data(), request->size());
+  return request->size();
+}
 }
 }
 }
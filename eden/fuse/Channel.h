@@ -8,7 +8,12 @@
  *
  */
 #pragma once
+#include <folly/File.h>
 #include <folly/Range.h>
+#include <folly/Synchronized.h>
+#include <atomic>
+#include <memory>
+#include <string>
 #include "eden/fuse/fuse_headers.h"
 #include "eden/utils/PathFuncs.h"
 
@@ -16,28 +21,140 @@ namespace facebook {
 namespace eden {
 namespace fusell {
 
+class ChannelStopState;
 class Dispatcher;
 class MountPoint;
 
+/**
+ * The state needed to continue serving a mounted FUSE device from another
+ * process, without unmounting it.
+ */
+struct FuseChannelData {
+  folly::File fd;
+  /**
+   * The FUSE_INIT request that the kernel sent when the device was mounted.
+   *
+   * The kernel only sends this once, so the new process replays it to set up
+   * its libfuse session.
+   */
+  std::string initRequest;
+};
+
 class Channel {
   fuse_chan* ch_;
   const MountPoint* mountPoint_;
+  /**
+   * The libfuse session serving this channel.
+   *
+   * This is created by the first call to runSession(), and is kept until the
+   * channel is destroyed: replies to requests that were read before
+   * stopForTakeover() may still be sent after runSession() returns, and the
+   * session is run again if the takeover is abandoned.
+   */
+  fuse_session* session_{nullptr};
+  /**
+   * Tracks the requests being read from the device, so that
+   * stopForTakeover() can wait for them.  This is shared with the worker
+   * threads, which may outlive the channel.
+   */
+  std::shared_ptr<ChannelStopState> stopState_;
+  folly::Synchronized<std::string> initRequest_;
+  /**
+   * Set when this channel was created from a device handed over by another
+   * process, until the saved FUSE_INIT request has been replayed.
+   */
+  std::atomic<bool> replayInit_{false};
+  /**
+   * Set once the device has been handed off to another process, in which case
+   * it must not be unmounted when the channel is destroyed.
+   */
+  bool takenOver_{false};
 
   friend class SessionDeleter;
 
+  void destroySession();
+
  public:
   Channel(const Channel&) = delete;
   Channel& operator=(const Channel&) = delete;
-  Channel(Channel&&) = default;
-  Channel& operator=(Channel&&) = default;
 
   explicit Channel(const MountPoint* mountPoint);
+
+  /**
+   * Create a channel for a FUSE device that another process has handed over
+   * to us, rather than mounting a new one.
+   */
+  Channel(const MountPoint* mountPoint, FuseChannelData takeoverData);
   ~Channel();
 
   const MountPoint* getMountPoint() const;
 
+  /**
+   * Serve requests until the filesystem is unmounted or stopForTakeover() is
+   * called.
+   *
+   * This may be called again after resumeAfterTakeover().
+   */
   void runSession(Dispatcher* disp, bool debug);
 
+  /**
+   * Make runSession() return without unmounting the filesystem, so that the
+   * FUSE device can be handed over to another process.
+   *
+   * libfuse 2.9 drops any request that a worker thread has already read once
+   * the session has exited, and the kernel never resends it, so the process
+   * that made it would hang.  Therefore this stops further reads from the
+   * device first, and only exits the session once every request already
+   * read has been dispatched.  Requests that are still queued in the kernel
+   * are left for the process that takes over the device.
+   *
+   * This may be called from any thread.
+   */
+  void stopForTakeover();
+
+  /**
+   * Get the data needed to continue serving this FUSE device from another
+   * process.
+   *
+   * This must only be called after runSession() has returned following a
+   * call to stopForTakeover(), and once all outstanding requests have been
+   * replied to.
+   */
+  FuseChannelData getTakeoverData();
+
+  /**
+   * Record that another process has taken over the FUSE device, and destroy
+   * our session.  The filesystem will not be unmounted when this channel is
+   * destroyed.
+   */
+  void releaseForTakeover();
+
+  /**
+   * Undo stopForTakeover(), so that runSession() can be called again to
+   * continue serving the FUSE device when the takeover is abandoned.
+   */
+  void resumeAfterTakeover();
+
+  /**
+   * Implements the fuse_chan receive operation: wait for a request from the
+   * kernel and read it into buf.
+   *
+   * Returns the length of the request, 0 if the session should stop, or a
+   * negative errno value.
+   */
+  int receive(char* buf, size_t size);
+
+  /**
+   * Record the FUSE_INIT request, so it can be handed off to another process.
+   */
+  void recordInitRequest(folly::ByteRange request);
+  /**
+   * If this channel was taken over from another process, copy the saved
+   * FUSE_INIT request into buf the first time this is called, and return its
+   * length.  Otherwise return 0.
+   */
+  size_t replayInitRequest(char* buf, size_t size);
+
   /**
    * Notify to invalidate cache for an inode
    *
@@ -25,6 +25,17 @@ class DirHandle : public FileHandleBase {
    */
   virtual folly::Future<DirList> readdir(DirList&& list, off_t off) = 0;
 
+  /**
+   * Read directory, including the attributes of each entry
+   *
+   * Send a DirList filled using DirList::addPlus().
+   * Send an empty DirList on end of stream.
+   *
+   * Each entry added with a non-zero inode number counts as a lookup() of
+   * that inode: the kernel will send a forget() for it later.
+   */
+  virtual folly::Future<DirList> readdirplus(DirList&& list, off_t off) = 0;
+
   /**
    * Synchronize directory contents
    *
@@ -10,6 +10,7 @@
 #include "DirList.h"
 
 #include <linux/fuse.h>
+#include <climits>
 #include "fuse_headers.h"
 
 using folly::StringPiece;
@@ -53,6 +54,94 @@ bool DirList::add(StringPiece name, const struct stat& st, off_t off) {
   return add(name, st.st_ino, mode_to_dtype(st.st_mode), off);
 }
 
+namespace {
+// These match the conversions libfuse performs for fuse_reply_entry().
+uint64_t timeoutSeconds(double t) {
+  if (t > static_cast<double>(ULONG_MAX)) {
+    return ULONG_MAX;
+  } else if (t < 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(t);
+}
+
+uint32_t timeoutNanoseconds(double t) {
+  double frac = t - static_cast<double>(timeoutSeconds(t));
+  if (frac < 0) {
+    return 0;
+  } else if (frac >= 0.999999999) {
+    return 999999999;
+  }
+  return static_cast<uint32_t>(frac * 1.0e9);
+}
+
+void statToFuseAttr(const struct stat& st, fuse_attr* attr) {
+  attr->ino = st.st_ino;
+  attr->mode = st.st_mode;
+  attr->nlink = st.st_nlink;
+  attr->uid = st.st_uid;
+  attr->gid = st.st_gid;
+  attr->rdev = st.st_rdev;
+  attr->size = st.st_size;
+  attr->blksize = st.st_blksize;
+  attr->blocks = st.st_blocks;
+  attr->atime = st.st_atim.tv_sec;
+  attr->mtime = st.st_mtim.tv_sec;
+  attr->ctime = st.st_ctim.tv_sec;
+  attr->atimensec = st.st_atim.tv_nsec;
+  attr->mtimensec = st.st_mtim.tv_nsec;
+  attr->ctimensec = st.st_ctim.tv_nsec;
+}
+}
+
+bool DirList::addPlus(
+    StringPiece name,
+    const fuse_entry_param& entry,
+    off_t off) {
+  // As with add(), we build the fuse_direntplus ourselves rather than using
+  // fuse_add_direntry_plus(), which needs a null terminated name and is only
+  // available in newer libfuse versions.
+  size_t avail = end_ - cur_;
+  auto entLength = FUSE_NAME_OFFSET_DIRENTPLUS + name.size();
+  auto fullSize = FUSE_DIRENT_ALIGN(entLength);
+  if (fullSize > avail) {
+    return false;
+  }
+
+  auto* direntplus = reinterpret_cast<fuse_direntplus*>(cur_);
+  memset(&direntplus->entry_out, 0, sizeof(direntplus->entry_out));
+  if (entry.ino != 0) {
+    auto& out = direntplus->entry_out;
+    out.nodeid = entry.ino;
+    out.generation = entry.generation;
+    out.entry_valid = timeoutSeconds(entry.entry_timeout);
+    out.entry_valid_nsec = timeoutNanoseconds(entry.entry_timeout);
+    out.attr_valid = timeoutSeconds(entry.attr_timeout);
+    out.attr_valid_nsec = timeoutNanoseconds(entry.attr_timeout);
+    statToFuseAttr(entry.attr, &out.attr);
+  }
+
+  auto* dirent = &direntplus->dirent;
+  dirent->ino = entry.attr.st_ino;
+  dirent->off = off;
+  dirent->namelen = name.size();
+  dirent->type =
+      static_cast<decltype(dirent->type)>(mode_to_dtype(entry.attr.st_mode));
+  memcpy(dirent->name, name.data(), name.size());
+  if (fullSize > entLength) {
+    // 0 out any padding
+    memset(cur_ + entLength, 0, fullSize - entLength);
+  }
+
+  cur_ += fullSize;
+  DCHECK_LE(cur_, end_);
+  return true;
+}
+
+size_t DirList::getPlusEntrySize(StringPiece name) {
+  return FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET_DIRENTPLUS + name.size());
+}
+
 StringPiece DirList::getBuf() const {
   return StringPiece(buf_.get(), cur_ - buf_.get());
 }
@@ -10,6 +10,7 @@
 #pragma once
 #include <folly/Range.h>
 #include <sys/stat.h>
+#include "eden/fuse/fuse_headers.h"
 #include "eden/utils/DirType.h"
 
 namespace facebook {
@@ -44,6 +45,32 @@ class DirList {
    */
   bool add(folly::StringPiece name, const struct stat& st, off_t off);
 
+  /**
+   * Add a new entry to a readdirplus() reply.
+   *
+   * If entry.ino is non-zero the kernel treats the entry as the result of a
+   * lookup() call, caches entry.attr, and will later send a matching
+   * forget().  If entry.ino is 0 only the name, entry.attr.st_ino and the
+   * type bits of entry.attr.st_mode are reported, like add() does.
+   *
+   * Returns true on success or false if the list is full.
+   */
+  bool addPlus(
+      folly::StringPiece name,
+      const fuse_entry_param& entry,
+      off_t off);
+
+  /**
+   * Returns the number of bytes that addPlus() needs to store an entry with
+   * the specified name.
+   */
+  static size_t getPlusEntrySize(folly::StringPiece name);
+
+  /** Returns the number of bytes still available in the list. */
+  size_t getAvailable() const {
+    return end_ - cur_;
+  }
+
   folly::StringPiece getBuf() const;
 };
 }
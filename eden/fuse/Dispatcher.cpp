@@ -11,6 +11,7 @@
 #include <folly/Exception.h>
 #include <folly/Format.h>
 #include <folly/MoveWrapper.h>
+#include <gflags/gflags.h>
 #include <wangle/concurrent/GlobalExecutor.h>
 #include "DirHandle.h"
 #include "FileHandle.h"
@@ -21,6 +22,19 @@
 using namespace folly;
 using namespace std::chrono;
 
+DEFINE_bool(
+    fuse_splice_write,
+    true,
+    "allow file data to be spliced directly into the kernel when replying to "
+    "FUSE read requests");
+
+DEFINE_bool(
+    fuse_readdirplus,
+    true,
+    "return entry attributes with directory listings when the kernel "
+    "supports READDIRPLUS, so listing a directory does not require a "
+    "separate lookup of every entry");
+
 namespace facebook {
 namespace eden {
 namespace fusell {
@@ -34,6 +48,22 @@ Dispatcher::~Dispatcher() {}
 
 Dispatcher::Dispatcher(folly::ThreadLocal<EdenStats>* stats) : stats_(stats) {}
 
+bool Dispatcher::waitForOutstandingRequests(milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(outstandingRequestsMutex_);
+  return noOutstandingRequestsCV_.wait_for(lock, timeout, [this] {
+    return outstandingRequests_.load(std::memory_order_acquire) == 0;
+  });
+}
+
+void Dispatcher::requestFinished() {
+  if (outstandingRequests_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // Notify while holding the mutex, so a waiter cannot miss the wakeup
+    // between checking the count and blocking.
+    std::lock_guard<std::mutex> guard(outstandingRequestsMutex_);
+    noOutstandingRequestsCV_.notify_all();
+  }
+}
+
 void Dispatcher::setMountPoint(MountPoint* mountPoint) {
   CHECK(mountPoint_ == nullptr);
   mountPoint_ = mountPoint;
@@ -61,6 +91,40 @@ std::shared_ptr<DirHandle> Dispatcher::getDirHandle(uint64_t dh) {
   return fileHandles_.getDirHandle(dh);
 }
 
+folly::Future<folly::Unit> Dispatcher::restoreFileHandles(
+    const SerializedFileHandleMap& handles) {
+  std::vector<folly::Future<folly::Unit>> futures;
+  futures.reserve(handles.entries.size());
+  for (const auto& entry : handles.entries) {
+    fuse_file_info fi;
+    memset(&fi, 0, sizeof(fi));
+    fi.flags = entry.flags;
+    auto ino = static_cast<fuse_ino_t>(entry.inodeNumber);
+    auto number = static_cast<uint64_t>(entry.handleId);
+
+    auto handle = folly::makeFutureWith([&]() {
+      if (entry.isDir) {
+        return opendir(ino, fi).then([](std::shared_ptr<DirHandle> dh) {
+          return std::shared_ptr<FileHandleBase>{std::move(dh)};
+        });
+      }
+      return open(ino, fi).then([](std::shared_ptr<FileHandle> fh) {
+        return std::shared_ptr<FileHandleBase>{std::move(fh)};
+      });
+    });
+    futures.push_back(
+        handle
+            .then([this, number](std::shared_ptr<FileHandleBase> fh) {
+              fileHandles_.recordHandle(std::move(fh), number);
+            })
+            .onError([ino, number](const folly::exception_wrapper& ew) {
+              LOG(ERROR) << "unable to restore file handle " << number
+                         << " for inode " << ino << ": " << ew.what();
+            }));
+  }
+  return folly::collectAll(futures).unit();
+}
+
 static std::string flagsToLabel(
     const std::unordered_map<int32_t, const char*>& labels, uint32_t flags) {
   std::vector<const char*> bits;
@@ -96,6 +160,9 @@ static std::unordered_map<int32_t, const char*> capsLabels = {
     {FUSE_CAP_FLOCK_LOCKS, "FLOCK_LOCKS"},
     {FUSE_CAP_IOCTL_DIR, "IOCTL_DIR"},
 #endif
+#ifdef FUSE_CAP_READDIRPLUS
+    {FUSE_CAP_READDIRPLUS, "READDIRPLUS"},
+#endif
 #ifdef __APPLE__
     {FUSE_CAP_ALLOCATE, "ALLOCATE"},
     {FUSE_CAP_EXCHANGE_DATA, "EXCHANGE_DATA"},
@@ -114,6 +181,21 @@ void Dispatcher::disp_init(void* userdata, struct fuse_conn_info* conn) {
 #endif
                                     FUSE_CAP_ATOMIC_O_TRUNC |
                                     FUSE_CAP_BIG_WRITES | FUSE_CAP_ASYNC_READ);
+#ifdef FUSE_CAP_SPLICE_WRITE
+  if (FLAGS_fuse_splice_write) {
+    // Allow read replies for file descriptor backed data to be spliced
+    // into /dev/fuse rather than copied through our own buffers.
+    conn->want |=
+        conn->capable & (FUSE_CAP_SPLICE_WRITE | FUSE_CAP_SPLICE_MOVE);
+  }
+#endif
+#ifdef FUSE_CAP_READDIRPLUS
+  if (FLAGS_fuse_readdirplus) {
+    conn->want |= conn->capable & FUSE_CAP_READDIRPLUS;
+  } else {
+    conn->want &= ~FUSE_CAP_READDIRPLUS;
+  }
+#endif
 
   disp->initConnection(*conn);
   disp->connInfo_ = *conn;
@@ -140,7 +222,7 @@ folly::Future<fuse_entry_param> Dispatcher::lookup(
 }
 
 static void disp_lookup(fuse_req_t req, fuse_ino_t parent, const char* name) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, parent);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::lookup)
@@ -158,7 +240,7 @@ folly::Future<folly::Unit> Dispatcher::forget(fuse_ino_t ino,
 }
 
 static void disp_forget(fuse_req_t req, fuse_ino_t ino, unsigned long nlookup) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.catchErrors(
       request.startRequest(dispatcher->getStats(), &EdenStats::forget)
@@ -191,7 +273,7 @@ folly::Future<Dispatcher::Attr> Dispatcher::getattr(fuse_ino_t ino) {
 static void disp_getattr(fuse_req_t req,
                          fuse_ino_t ino,
                          struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
 
   if (fi) {
@@ -225,7 +307,7 @@ static void disp_setattr(fuse_req_t req,
                          struct stat* attr,
                          int to_set,
                          struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
 
   if (fi) {
@@ -256,7 +338,7 @@ folly::Future<std::string> Dispatcher::readlink(fuse_ino_t ino) {
 }
 
 static void disp_readlink(fuse_req_t req, fuse_ino_t ino) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::readlink)
@@ -279,7 +361,7 @@ static void disp_mknod(fuse_req_t req,
                        const char* name,
                        mode_t mode,
                        dev_t rdev) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, parent);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::mknod)
@@ -301,7 +383,7 @@ static void disp_mkdir(fuse_req_t req,
                        fuse_ino_t parent,
                        const char* name,
                        mode_t mode) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, parent);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::mkdir)
@@ -318,7 +400,7 @@ folly::Future<folly::Unit> Dispatcher::unlink(fuse_ino_t, PathComponentPiece) {
 }
 
 static void disp_unlink(fuse_req_t req, fuse_ino_t parent, const char* name) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, parent);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::unlink)
@@ -333,7 +415,7 @@ folly::Future<folly::Unit> Dispatcher::rmdir(fuse_ino_t, PathComponentPiece) {
 }
 
 static void disp_rmdir(fuse_req_t req, fuse_ino_t parent, const char* name) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, parent);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::rmdir)
@@ -352,7 +434,7 @@ static void disp_symlink(fuse_req_t req,
                          const char* link,
                          fuse_ino_t parent,
                          const char* name) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, parent);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::symlink)
@@ -377,7 +459,7 @@ static void disp_rename(fuse_req_t req,
                         const char* name,
                         fuse_ino_t newparent,
                         const char* newname) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, parent);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(request
                                .startRequest(
@@ -402,7 +484,7 @@ static void disp_link(fuse_req_t req,
                       fuse_ino_t ino,
                       fuse_ino_t newparent,
                       const char* newname) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::link)
@@ -424,7 +506,7 @@ folly::Future<std::shared_ptr<FileHandle>> Dispatcher::open(
 static void disp_open(fuse_req_t req,
                       fuse_ino_t ino,
                       struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::open)
@@ -453,7 +535,7 @@ static void disp_read(fuse_req_t req,
                       size_t size,
                       off_t off,
                       struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::read)
@@ -461,10 +543,7 @@ static void disp_read(fuse_req_t req,
             auto fh = dispatcher->getFileHandle(fi.fh);
             return fh->read(size, off);
           })
-          .then([](BufVec&& buf) {
-            auto iov = buf.getIov();
-            RequestData::get().replyIov(iov.data(), iov.size());
-          }));
+          .then([](BufVec&& buf) { RequestData::get().replyData(buf); }));
 }
 
 static void disp_write(fuse_req_t req,
@@ -473,7 +552,7 @@ static void disp_write(fuse_req_t req,
                        size_t size,
                        off_t off,
                        struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::write)
@@ -488,7 +567,7 @@ static void disp_write(fuse_req_t req,
 static void disp_flush(fuse_req_t req,
                        fuse_ino_t ino,
                        struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::flush)
@@ -503,7 +582,7 @@ static void disp_flush(fuse_req_t req,
 static void disp_release(fuse_req_t req,
                          fuse_ino_t ino,
                          struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::release)
@@ -517,7 +596,7 @@ static void disp_fsync(fuse_req_t req,
                        fuse_ino_t ino,
                        int datasync,
                        struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::fsync)
@@ -537,7 +616,7 @@ folly::Future<std::shared_ptr<DirHandle>> Dispatcher::opendir(
 static void disp_opendir(fuse_req_t req,
                          fuse_ino_t ino,
                          struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::opendir)
@@ -562,7 +641,7 @@ static void disp_readdir(fuse_req_t req,
                          size_t size,
                          off_t off,
                          struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::readdir)
@@ -576,10 +655,31 @@ static void disp_readdir(fuse_req_t req,
           }));
 }
 
+#if FUSE_MAJOR_VERSION >= 3
+static void disp_readdirplus(fuse_req_t req,
+                             fuse_ino_t ino,
+                             size_t size,
+                             off_t off,
+                             struct fuse_file_info* fi) {
+  auto& request = RequestData::create(req, ino);
+  auto* dispatcher = request.getDispatcher();
+  request.setRequestFuture(
+      request.startRequest(dispatcher->getStats(), &EdenStats::readdirplus)
+          .then([ =, &request, fi = *fi ] {
+            auto dh = dispatcher->getDirHandle(fi.fh);
+            return dh->readdirplus(DirList(size), off);
+          })
+          .then([](DirList&& list) {
+            auto buf = list.getBuf();
+            RequestData::get().replyBuf(buf.data(), buf.size());
+          }));
+}
+#endif
+
 static void disp_releasedir(fuse_req_t req,
                             fuse_ino_t ino,
                             struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::releasedir)
@@ -593,7 +693,7 @@ static void disp_fsyncdir(fuse_req_t req,
                           fuse_ino_t ino,
                           int datasync,
                           struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::fsyncdir)
@@ -615,7 +715,7 @@ folly::Future<struct statvfs> Dispatcher::statfs(fuse_ino_t ino) {
 }
 
 static void disp_statfs(fuse_req_t req, fuse_ino_t ino) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::statfs)
@@ -643,7 +743,7 @@ static void disp_setxattr(fuse_req_t req,
                           uint32_t position
 #endif
                           ) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
 
 #ifdef __APPLE__
@@ -684,7 +784,7 @@ static void disp_getxattr(fuse_req_t req,
                           uint32_t position
 #endif
                           ) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
 
 #ifdef __APPLE__
@@ -714,7 +814,7 @@ folly::Future<std::vector<std::string>> Dispatcher::listxattr(fuse_ino_t ino) {
 }
 
 static void disp_listxattr(fuse_req_t req, fuse_ino_t ino, size_t size) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::listxattr)
@@ -749,7 +849,7 @@ folly::Future<folly::Unit> Dispatcher::removexattr(fuse_ino_t ino,
 }
 
 static void disp_removexattr(fuse_req_t req, fuse_ino_t ino, const char* name) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::removexattr)
@@ -768,7 +868,7 @@ folly::Future<folly::Unit> Dispatcher::access(fuse_ino_t ino, int mask) {
 }
 
 static void disp_access(fuse_req_t req, fuse_ino_t ino, int mask) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::access)
@@ -786,7 +886,7 @@ static void disp_create(fuse_req_t req,
                         const char* name,
                         mode_t mode,
                         struct fuse_file_info* fi) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, parent);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::create)
@@ -820,7 +920,7 @@ static void disp_bmap(fuse_req_t req,
                       fuse_ino_t ino,
                       size_t blocksize,
                       uint64_t idx) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::bmap)
@@ -841,7 +941,7 @@ static void disp_ioctl(fuse_req_t req,
                        size_t in_bufsz,
                        size_t out_bufsz) {
 
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
 
   if (flags & FUSE_IOCTL_UNRESTRICTED) {
@@ -873,7 +973,7 @@ static void disp_poll(fuse_req_t req,
                       fuse_ino_t ino,
                       struct fuse_file_info* fi,
                       struct fuse_pollhandle* ph) {
-  auto& request = RequestData::create(req);
+  auto& request = RequestData::create(req, ino);
   auto* dispatcher = request.getDispatcher();
   request.setRequestFuture(
       request.startRequest(dispatcher->getStats(), &EdenStats::poll)
@@ -939,6 +1039,9 @@ static const fuse_lowlevel_ops dispatcher_ops = {
     .flock = nullptr,
     .fallocate = nullptr,
 #endif
+#if FUSE_MAJOR_VERSION >= 3
+    .readdirplus = disp_readdirplus,
+#endif
 };
 
 const fuse_conn_info& Dispatcher::getConnInfo() const { return connInfo_; }
@@ -14,8 +14,13 @@
 #include <folly/Range.h>
 #include <folly/ThreadLocal.h>
 #include <folly/futures/Future.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include "eden/fuse/EdenStats.h"
 #include "eden/fuse/FileHandleMap.h"
+#include "eden/fuse/RequestTracer.h"
 #include "eden/fuse/fuse_headers.h"
 #include "eden/utils/PathFuncs.h"
 
@@ -49,6 +54,10 @@ class Dispatcher {
   MountPoint* mountPoint_{nullptr};
   folly::ThreadLocal<EdenStats>* stats_{nullptr};
   FileHandleMap fileHandles_;
+  std::atomic<size_t> outstandingRequests_{0};
+  std::mutex outstandingRequestsMutex_;
+  std::condition_variable noOutstandingRequestsCV_;
+  RequestTracer tracer_;
 
  public:
   virtual ~Dispatcher();
@@ -70,6 +79,40 @@ class Dispatcher {
   const fuse_conn_info& getConnInfo() const;
   FileHandleMap& getFileHandles();
 
+  /**
+   * Returns the number of FUSE requests currently being processed.
+   *
+   * Background work such as checkout uses this to back off while there is
+   * interactive filesystem traffic.
+   */
+  size_t getOutstandingRequestCount() const {
+    return outstandingRequests_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Wait until no FUSE requests are being processed.
+   *
+   * Returns false if there were still requests outstanding after the
+   * timeout.
+   */
+  bool waitForOutstandingRequests(std::chrono::milliseconds timeout);
+
+  /**
+   * Called by RequestData when it starts and finishes processing a request.
+   */
+  void requestStarted() {
+    outstandingRequests_.fetch_add(1, std::memory_order_relaxed);
+  }
+  void requestFinished();
+
+  /**
+   * Returns the tracer recording the in-flight and recently completed
+   * requests for this dispatcher.
+   */
+  RequestTracer& getTracer() {
+    return tracer_;
+  }
+
   // delegates to FileHandleMap::getGenericFileHandle
   std::shared_ptr<FileHandleBase> getGenericFileHandle(uint64_t fh);
   // delegates to FileHandleMap::getFileHandle
@@ -77,6 +120,18 @@ class Dispatcher {
   // delegates to FileHandleMap::getDirHandle
   std::shared_ptr<DirHandle> getDirHandle(uint64_t dh);
 
+  /**
+   * Reopen the file and directory handles described by a FileHandleMap that
+   * another process serialized when handing its mount point over to us, and
+   * record them under their original handle numbers.
+   *
+   * Handles that cannot be reopened are logged and skipped; the kernel will
+   * get EBADF if it tries to use them.  This must complete before the
+   * mount point starts processing requests.
+   */
+  folly::Future<folly::Unit> restoreFileHandles(
+      const SerializedFileHandleMap& handles);
+
   /**
    * Set the MountPoint currently using this Dispatcher.
    *
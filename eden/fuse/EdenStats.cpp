@@ -9,7 +9,6 @@
  */
 #include "EdenStats.h"
 
-#include <folly/Array.h>
 #include <chrono>
 
 using namespace folly;
@@ -19,56 +18,86 @@ namespace {
 constexpr std::chrono::microseconds kMinValue{0};
 constexpr std::chrono::microseconds kMaxValue{10000};
 constexpr std::chrono::microseconds kBucketSize{1000};
-constexpr unsigned int kNumTimeseriesBuckets{60};
-constexpr auto kDurations = folly::make_array(
-    std::chrono::seconds(60),
-    std::chrono::seconds(600),
-    std::chrono::seconds(3600),
-    std::chrono::seconds(0));
 }
 
 namespace facebook {
 namespace eden {
 namespace fusell {
 
+namespace {
+const std::pair<EdenStats::HistogramPtr, const char*> kOperationNames[] = {
+    {&EdenStats::lookup, "lookup"},
+    {&EdenStats::forget, "forget"},
+    {&EdenStats::getattr, "getattr"},
+    {&EdenStats::setattr, "setattr"},
+    {&EdenStats::readlink, "readlink"},
+    {&EdenStats::mknod, "mknod"},
+    {&EdenStats::mkdir, "mkdir"},
+    {&EdenStats::unlink, "unlink"},
+    {&EdenStats::rmdir, "rmdir"},
+    {&EdenStats::symlink, "symlink"},
+    {&EdenStats::rename, "rename"},
+    {&EdenStats::link, "link"},
+    {&EdenStats::open, "open"},
+    {&EdenStats::read, "read"},
+    {&EdenStats::write, "write"},
+    {&EdenStats::flush, "flush"},
+    {&EdenStats::release, "release"},
+    {&EdenStats::fsync, "fsync"},
+    {&EdenStats::opendir, "opendir"},
+    {&EdenStats::readdir, "readdir"},
+    {&EdenStats::readdirplus, "readdirplus"},
+    {&EdenStats::releasedir, "releasedir"},
+    {&EdenStats::fsyncdir, "fsyncdir"},
+    {&EdenStats::statfs, "statfs"},
+    {&EdenStats::setxattr, "setxattr"},
+    {&EdenStats::getxattr, "getxattr"},
+    {&EdenStats::listxattr, "listxattr"},
+    {&EdenStats::removexattr, "removexattr"},
+    {&EdenStats::access, "access"},
+    {&EdenStats::create, "create"},
+    {&EdenStats::bmap, "bmap"},
+    {&EdenStats::ioctl, "ioctl"},
+    {&EdenStats::poll, "poll"},
+    {&EdenStats::forgetmulti, "forgetmulti"},
+    {&EdenStats::invalidate, "invalidate"},
+};
+}
+
 EdenStats::EdenStats() {}
 
-#if EDEN_HAS_COMMON_STATS
 EdenStats::Histogram EdenStats::createHistogram(const std::string& name) {
-  return Histogram{this,
-                   name,
-                   kBucketSize.count(),
-                   kMinValue.count(),
-                   kMaxValue.count(),
-                   facebook::stats::COUNT,
-                   50,
-                   90,
-                   99};
-}
-
+  return Histogram{
+#if EDEN_HAS_COMMON_STATS
+      this,
 #else
-
-folly::TimeseriesHistogram<int64_t> EdenStats::createHistogram(
-    const std::string& /* name */) {
-  return folly::TimeseriesHistogram<int64_t>{
+      facebook::stats::ThreadCachedServiceData::get()->getThreadStats(),
+#endif
+      name,
       kBucketSize.count(),
       kMinValue.count(),
       kMaxValue.count(),
-      MultiLevelTimeSeries<int64_t>{
-          kNumTimeseriesBuckets, kDurations.size(), kDurations.data()}};
+      facebook::stats::COUNT,
+      50,
+      90,
+      99};
 }
-#endif
 
 void EdenStats::recordLatency(
     HistogramPtr item,
     std::chrono::microseconds elapsed,
     std::chrono::seconds now) {
-#if EDEN_HAS_COMMON_STATS
-  (void)now; // we don't use it in this code path
+  (void)now; // values are timestamped when they are published
   (this->*item).addValue(elapsed.count());
-#else
-  (this->*item)->addValue(now, elapsed.count());
-#endif
+}
+
+StringPiece EdenStats::getOperationName(HistogramPtr item) {
+  for (const auto& entry : kOperationNames) {
+    if (entry.first == item) {
+      return entry.second;
+    }
+  }
+  return "unknown";
 }
 }
 }
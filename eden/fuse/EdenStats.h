@@ -21,9 +21,9 @@
 #if EDEN_HAS_COMMON_STATS
 #include "common/stats/ThreadLocalStats.h"
 #else
-#include <folly/Synchronized.h>
-#include <folly/stats/TimeseriesHistogram.h>
+#include "common/stats/ThreadCachedServiceData.h"
 #endif
+#include <folly/Range.h>
 
 namespace facebook {
 namespace eden {
@@ -40,7 +40,7 @@ class EdenStats
 #if EDEN_HAS_COMMON_STATS
       TLHistogram
 #else
-      folly::Synchronized<folly::TimeseriesHistogram<int64_t>, std::mutex>
+      facebook::stats::ThreadCachedServiceData::TLHistogram
 #endif
       ;
 
@@ -69,6 +69,7 @@ class EdenStats
   Histogram fsync{createHistogram("fuse.fsync_us")};
   Histogram opendir{createHistogram("fuse.opendir_us")};
   Histogram readdir{createHistogram("fuse.readdir_us")};
+  Histogram readdirplus{createHistogram("fuse.readdirplus_us")};
   Histogram releasedir{createHistogram("fuse.releasedir_us")};
   Histogram fsyncdir{createHistogram("fuse.fsyncdir_us")};
   Histogram statfs{createHistogram("fuse.statfs_us")};
@@ -83,6 +84,9 @@ class EdenStats
   Histogram poll{createHistogram("fuse.poll_us")};
   Histogram forgetmulti{createHistogram("fuse.forgetmulti_us")};
 
+  // Time spent sending each kernel cache invalidation notification.
+  Histogram invalidate{createHistogram("fuse.invalidate_us")};
+
   // Since we can potentially finish a request in a different
   // thread from the one used to initiate it, we use HistogramPtr
   // as a helper for referencing the pointer-to-member that we
@@ -93,20 +97,21 @@ class EdenStats
    * item is the pointer-to-member for one of the histograms defined
    * above.
    * elapsed is the duration of the operation, measured in microseconds.
-   * now is the current steady clock value in seconds.
-   * (Once we open source the common stats code we can eliminate the
-   * now parameter from this method). */
+   * now is the current steady clock value in seconds.  It is unused: both
+   * stats implementations timestamp values when they are published.
+   * (Once the callers are updated we can eliminate the now parameter
+   * from this method). */
   void recordLatency(
       HistogramPtr item,
       std::chrono::microseconds elapsed,
       std::chrono::seconds now);
 
+  /** Returns the name of the operation that a histogram measures, such as
+   * "lookup" for &EdenStats::lookup. */
+  static folly::StringPiece getOperationName(HistogramPtr item);
+
  private:
-#if EDEN_HAS_COMMON_STATS
   Histogram createHistogram(const std::string& name);
-#else
-  folly::TimeseriesHistogram<int64_t> createHistogram(const std::string& name);
-#endif
 };
 }
 }
@@ -23,6 +23,21 @@ class FileHandleBase {
  public:
   virtual ~FileHandleBase();
 
+  /**
+   * Return the number of the inode that this handle refers to.
+   */
+  virtual fuse_ino_t getInodeNumber() = 0;
+
+  /**
+   * Return the flags that this handle was opened with.
+   *
+   * This is used to reopen the handle when handing the mount point off to
+   * another process.
+   */
+  virtual int getOpenFlags() const {
+    return 0;
+  }
+
   /**
    * Get file attributes
    */
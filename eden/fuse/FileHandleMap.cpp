@@ -11,6 +11,7 @@
 
 #include <folly/Exception.h>
 #include <folly/Random.h>
+#include <fcntl.h>
 #include "DirHandle.h"
 #include "FileHandle.h"
 
@@ -57,9 +58,9 @@ uint64_t FileHandleMap::recordHandle(std::shared_ptr<FileHandleBase> fh) {
   // any other mechanism for assigning or tracking numbers and keeps the
   // cost of the assignment constant.
   //
-  // However, in the future hot upgrade case, we need to be able to pass
-  // the mapping from another process where there is no way for us to
-  // contrive an address for a given instance.
+  // However, in the graceful restart case, we receive the mapping from
+  // another process where there is no way for us to contrive an address
+  // for a given instance.
   //
   // So what we do it first try to take the address from the incoming
   // file handle, but if we get a collision we fall back to attempting
@@ -90,6 +91,17 @@ uint64_t FileHandleMap::recordHandle(std::shared_ptr<FileHandleBase> fh) {
   folly::throwSystemErrorExplicit(EMFILE);
 }
 
+void FileHandleMap::recordHandle(
+    std::shared_ptr<FileHandleBase> fh,
+    uint64_t number) {
+  auto handles = handles_.wlock();
+  auto ret = handles->emplace(number, std::move(fh));
+  if (!ret.second) {
+    folly::throwSystemErrorExplicit(
+        EEXIST, "file number ", number, " is already in use");
+  }
+}
+
 std::shared_ptr<FileHandleBase> FileHandleMap::forgetGenericHandle(
     uint64_t fh) {
   auto handles = handles_.wlock();
@@ -102,6 +114,32 @@ std::shared_ptr<FileHandleBase> FileHandleMap::forgetGenericHandle(
   handles->erase(iter);
   return result;
 }
+
+SerializedFileHandleMap FileHandleMap::serialize() const {
+  // Opening the file again must not modify it.
+  constexpr int kIgnoredFlags = O_CREAT | O_EXCL | O_TRUNC;
+
+  auto handles = handles_.rlock();
+  SerializedFileHandleMap result;
+  result.entries.reserve(handles->size());
+  for (const auto& entry : *handles) {
+    FileHandleMapEntry serialized;
+    serialized.handleId = entry.first;
+    serialized.inodeNumber = entry.second->getInodeNumber();
+    serialized.isDir =
+        std::dynamic_pointer_cast<DirHandle>(entry.second) != nullptr;
+    serialized.flags = entry.second->getOpenFlags() & ~kIgnoredFlags;
+    result.entries.push_back(std::move(serialized));
+  }
+  return result;
+}
+
+void FileHandleMap::clear() {
+  std::unordered_map<uint64_t, std::shared_ptr<FileHandleBase>> handles;
+  handles_.wlock()->swap(handles);
+  // The handles are released here, after the lock has been dropped, since
+  // destroying them may release inodes.
+}
 }
 }
 }
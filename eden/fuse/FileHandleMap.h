@@ -10,6 +10,7 @@
 #pragma once
 #include <folly/Synchronized.h>
 #include <unordered_map>
+#include "eden/fuse/gen-cpp2/handlemap_types.h"
 
 namespace facebook {
 namespace eden {
@@ -27,9 +28,9 @@ class FileHandleBase;
  * a way to map that number and return a shared_ptr to the associated
  * file handle.
  *
- * During a hot upgrade we intend to use this mapping to pass information
- * on to the replacement child process, although that functionality has
- * not yet been written.
+ * During a graceful restart this mapping is passed on to the replacement
+ * process (see serialize()), which reopens each handle and records
+ * it under the same number so the kernel's handles remain valid.
  */
 class FileHandleMap {
  public:
@@ -57,11 +58,27 @@ class FileHandleMap {
    **/
   uint64_t recordHandle(std::shared_ptr<FileHandleBase> fh);
 
+  /** Records a handle under a specific file handle number.
+   * This is used to restore the handles that another process had open
+   * when it handed the mount point over to us.
+   * Throws EEXIST if the number is already in use. */
+  void recordHandle(std::shared_ptr<FileHandleBase> fh, uint64_t number);
+
   /** Delete the association from the fh to a handle instance.
    * Throws EBADF if the file handle is not tracked by this map.
    * On success, returns the instance. */
   std::shared_ptr<FileHandleBase> forgetGenericHandle(uint64_t fh);
 
+  /** Returns a description of all of the open handles.
+   * This is used when handing the mount point over to another process. */
+  SerializedFileHandleMap serialize() const;
+
+  /** Forgets all of the open handles.
+   * This is used once another process has taken over the mount point:
+   * the handles will not be released by the kernel, so dropping them here
+   * releases the references they hold on their inodes. */
+  void clear();
+
  private:
 
   folly::Synchronized<
@@ -0,0 +1,233 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "InvalidationQueue.h"
+
+#include <folly/String.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include "Channel.h"
+#include "EdenStats.h"
+#include "MountPoint.h"
+#include "common/stats/ServiceData.h"
+
+using folly::Future;
+using folly::Promise;
+using folly::Unit;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+
+DEFINE_int32(
+    fuse_invalidation_collapse_threshold,
+    64,
+    "when at least this many entries in one directory are invalidated at "
+    "once, invalidate the directory's own entry instead (0 disables this)");
+
+namespace facebook {
+namespace eden {
+namespace fusell {
+
+namespace {
+// Totals across all mount points, exported as counters.
+std::atomic<int64_t> globalPendingDirectories{0};
+std::atomic<uint64_t> globalNotificationsSent{0};
+
+void publishCounters() {
+  fbData->setCounter(
+      "fuse.invalidation.pending_dirs", globalPendingDirectories.load());
+  fbData->setCounter(
+      "fuse.invalidation.sent", globalNotificationsSent.load());
+}
+}
+
+InvalidationQueue::InvalidationQueue(
+    MountPoint* mountPoint,
+    folly::ThreadLocal<EdenStats>* stats)
+    : mountPoint_(mountPoint), stats_(stats) {
+  worker_ = std::thread([this] { workerLoop(); });
+}
+
+InvalidationQueue::~InvalidationQueue() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  worker_.join();
+}
+
+void InvalidationQueue::invalidateEntry(
+    fuse_ino_t parent,
+    PathComponentPiece name) {
+  if (!mountPoint_->getChannel()) {
+    // The kernel has never been told about anything in this mount
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    addEntry(getPendingDirectory(parent), name);
+  }
+  cv_.notify_one();
+}
+
+void InvalidationQueue::invalidateEntry(
+    fuse_ino_t parent,
+    PathComponentPiece name,
+    fuse_ino_t grandparent,
+    PathComponentPiece parentName) {
+  if (!mountPoint_->getChannel()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& dir = getPendingDirectory(parent);
+    if (!dir.location.hasValue()) {
+      dir.location = std::make_pair(grandparent, PathComponent{parentName});
+    }
+    addEntry(dir, name);
+  }
+  cv_.notify_one();
+}
+
+InvalidationQueue::PendingDirectory& InvalidationQueue::getPendingDirectory(
+    fuse_ino_t parent) {
+  auto ret = pending_.emplace(parent, PendingDirectory{});
+  if (ret.second) {
+    ++globalPendingDirectories;
+  }
+  return ret.first->second;
+}
+
+void InvalidationQueue::addEntry(
+    PendingDirectory& dir,
+    PathComponentPiece name) {
+  if (!dir.names.emplace(name).second) {
+    duplicatesDropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+Future<Unit> InvalidationQueue::flush() {
+  Promise<Unit> promise;
+  auto future = promise.getFuture();
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (pending_.empty() && !processing_) {
+      // Nothing is queued or in flight, so there is no need to wait for the
+      // worker thread.
+      return folly::makeFuture();
+    }
+    flushPromises_.push_back(std::move(promise));
+  }
+  cv_.notify_one();
+  return future;
+}
+
+InvalidationQueue::Stats InvalidationQueue::getStats() const {
+  Stats stats;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stats.pendingDirectories = pending_.size();
+  }
+  stats.notificationsSent = notificationsSent_.load();
+  stats.duplicatesDropped = duplicatesDropped_.load();
+  stats.directoriesCollapsed = directoriesCollapsed_.load();
+  stats.timeSpent = microseconds(timeSpentUs_.load());
+  return stats;
+}
+
+void InvalidationQueue::workerLoop() {
+  while (true) {
+    PendingMap batch;
+    std::vector<Promise<Unit>> promises;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] {
+        return stop_ || !pending_.empty() || !flushPromises_.empty();
+      });
+      if (stop_ && pending_.empty() && flushPromises_.empty()) {
+        return;
+      }
+      // Taking the pending invalidations and the flush promises together
+      // guarantees that everything queued before a flush() call is sent
+      // before its promise is fulfilled.
+      batch.swap(pending_);
+      promises.swap(flushPromises_);
+      processing_ = true;
+    }
+
+    globalPendingDirectories -= batch.size();
+    processBatch(std::move(batch));
+    publishCounters();
+
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      processing_ = false;
+    }
+
+    for (auto& promise : promises) {
+      promise.setValue();
+    }
+  }
+}
+
+void InvalidationQueue::processBatch(PendingMap&& batch) {
+  const auto threshold = static_cast<size_t>(
+      std::max(FLAGS_fuse_invalidation_collapse_threshold, 0));
+  for (const auto& entry : batch) {
+    const auto& dir = entry.second;
+    if (threshold > 0 && dir.location.hasValue() &&
+        dir.names.size() >= threshold) {
+      // Invalidating the directory's own entry makes the kernel discard the
+      // directory dentry along with all of its cached children.
+      directoriesCollapsed_.fetch_add(1, std::memory_order_relaxed);
+      sendEntryInvalidation(dir.location->first, dir.location->second);
+      continue;
+    }
+
+    for (const auto& name : dir.names) {
+      sendEntryInvalidation(entry.first, name);
+    }
+  }
+}
+
+void InvalidationQueue::sendEntryInvalidation(
+    fuse_ino_t parent,
+    PathComponentPiece name) {
+  auto* channel = mountPoint_->getChannel();
+  if (!channel) {
+    return;
+  }
+
+  auto start = steady_clock::now();
+  try {
+    channel->invalidateEntry(parent, name);
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "error invalidating FUSE entry " << name
+                 << " in directory inode " << parent << ": "
+                 << folly::exceptionStr(ex);
+  }
+  auto now = steady_clock::now();
+  auto elapsed = duration_cast<microseconds>(now - start);
+
+  notificationsSent_.fetch_add(1, std::memory_order_relaxed);
+  ++globalNotificationsSent;
+  timeSpentUs_.fetch_add(elapsed.count(), std::memory_order_relaxed);
+  if (stats_) {
+    stats_->get()->recordLatency(
+        &EdenStats::invalidate,
+        elapsed,
+        duration_cast<seconds>(now.time_since_epoch()));
+  }
+}
+}
+}
+}
@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/ThreadLocal.h>
+#include <folly/futures/Future.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "eden/fuse/fuse_headers.h"
+#include "eden/utils/PathFuncs.h"
+
+namespace facebook {
+namespace eden {
+namespace fusell {
+
+class EdenStats;
+class MountPoint;
+
+/**
+ * InvalidationQueue sends kernel cache invalidation notifications for a
+ * mount point from a dedicated worker thread.
+ *
+ * Each notification is a blocking write to /dev/fuse, which can stall behind
+ * kernel locks.  Operations such as checkout that change many directory
+ * entries queue their invalidations here instead of sending them inline
+ * while holding inode locks, and then call flush() to wait for them to be
+ * delivered before reporting completion.
+ *
+ * Queued invalidations are deduplicated.  When many entries in a single
+ * directory are invalidated and the caller told us where that directory
+ * lives, a single invalidation of the directory's own entry in its parent is
+ * sent instead.  The kernel drops the directory dentry together with all of
+ * its cached children, which is much cheaper than notifying each child.
+ */
+class InvalidationQueue {
+ public:
+  struct Stats {
+    /** Number of directories with invalidations waiting to be sent. */
+    size_t pendingDirectories{0};
+    /** Total number of notifications sent to the kernel. */
+    uint64_t notificationsSent{0};
+    /** Number of entry invalidations that were dropped as duplicates. */
+    uint64_t duplicatesDropped{0};
+    /** Number of directories collapsed into a single invalidation. */
+    uint64_t directoriesCollapsed{0};
+    /** Total time spent sending notifications. */
+    std::chrono::microseconds timeSpent{0};
+  };
+
+  /**
+   * Create an InvalidationQueue for the specified mount point.
+   *
+   * Notifications are sent on the mount point's Channel.  If the mount point
+   * does not have a channel (because it has not been started) queued
+   * invalidations are simply discarded.
+   *
+   * stats may be null.
+   */
+  InvalidationQueue(
+      MountPoint* mountPoint,
+      folly::ThreadLocal<EdenStats>* stats);
+  ~InvalidationQueue();
+
+  /**
+   * Queue an invalidation of the entry name in directory parent.
+   */
+  void invalidateEntry(fuse_ino_t parent, PathComponentPiece name);
+
+  /**
+   * Queue an invalidation of the entry name in directory parent, where
+   * parent is itself the entry parentName in directory grandparent.
+   *
+   * Providing the directory's location allows the queue to collapse many
+   * invalidations in the same directory into one.
+   */
+  void invalidateEntry(
+      fuse_ino_t parent,
+      PathComponentPiece name,
+      fuse_ino_t grandparent,
+      PathComponentPiece parentName);
+
+  /**
+   * Returns a Future that completes once all invalidations queued before
+   * this call have been sent to the kernel.
+   */
+  folly::Future<folly::Unit> flush();
+
+  Stats getStats() const;
+
+ private:
+  struct PendingDirectory {
+    /** The directory's inode number and name in its parent, if known. */
+    folly::Optional<std::pair<fuse_ino_t, PathComponent>> location;
+    std::unordered_set<PathComponent> names;
+  };
+  using PendingMap = std::unordered_map<fuse_ino_t, PendingDirectory>;
+
+  InvalidationQueue(InvalidationQueue const&) = delete;
+  InvalidationQueue& operator=(InvalidationQueue const&) = delete;
+
+  PendingDirectory& getPendingDirectory(fuse_ino_t parent);
+  void addEntry(PendingDirectory& dir, PathComponentPiece name);
+
+  void workerLoop();
+  void processBatch(PendingMap&& batch);
+  void sendEntryInvalidation(fuse_ino_t parent, PathComponentPiece name);
+
+  MountPoint* const mountPoint_;
+  folly::ThreadLocal<EdenStats>* const stats_;
+
+  /**
+   * mutex_ protects pending_, flushPromises_, processing_, and stop_.
+   * It is a leaf lock, and may be acquired while holding inode locks.
+   */
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  PendingMap pending_;
+  std::vector<folly::Promise<folly::Unit>> flushPromises_;
+  /** Whether the worker thread is currently sending a batch. */
+  bool processing_{false};
+  bool stop_{false};
+
+  std::atomic<uint64_t> notificationsSent_{0};
+  std::atomic<uint64_t> duplicatesDropped_{0};
+  std::atomic<uint64_t> directoriesCollapsed_{0};
+  std::atomic<uint64_t> timeSpentUs_{0};
+
+  std::thread worker_;
+};
+}
+}
+}
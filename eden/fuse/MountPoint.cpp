@@ -12,7 +12,18 @@
 #include "Channel.h"
 #include "Dispatcher.h"
 
+#include <folly/Conv.h>
+#include <gflags/gflags.h>
 #include <sys/stat.h>
+#include <chrono>
+#include <thread>
+
+DEFINE_int32(
+    fuse_takeover_request_timeout,
+    30,
+    "seconds to wait for in-flight FUSE requests to finish before handing a "
+    "mount point over to another process; the mount point resumes serving "
+    "requests if they have not finished by then");
 
 namespace facebook {
 namespace eden {
@@ -29,15 +40,30 @@ void MountPoint::start(bool debug) {
 }
 
 void MountPoint::start(bool debug, const std::function<void()>& onStop) {
+  startImpl(debug, onStop, folly::none);
+}
+
+void MountPoint::takeoverStart(
+    bool debug,
+    FuseChannelData channelData,
+    const std::function<void()>& onStop) {
+  startImpl(debug, onStop, std::move(channelData));
+}
+
+void MountPoint::startImpl(
+    bool debug,
+    const std::function<void()>& onStop,
+    folly::Optional<FuseChannelData> takeoverData) {
   std::unique_lock<std::mutex> lock(mutex_);
   if (status_ != Status::UNINIT) {
     throw std::runtime_error("mount point has already been started");
   }
 
   status_ = Status::STARTING;
-  auto runner = [this, debug, onStop]() {
+  auto runner = [ this, debug, onStop, takeoverData = std::move(takeoverData) ](
+  ) mutable {
     try {
-      this->run(debug);
+      this->run(debug, std::move(takeoverData));
     } catch (const std::exception& ex) {
       std::lock_guard<std::mutex> guard(mutex_);
       if (status_ == Status::STARTING) {
@@ -57,7 +83,7 @@ void MountPoint::start(bool debug, const std::function<void()>& onStop) {
       onStop();
     }
   };
-  auto t = std::thread(runner);
+  auto t = std::thread(std::move(runner));
   // Detach from the thread after starting it.
   // The onStop() function will be called to allow the caller to perform
   // any clean up desired.  However, since it runs from inside the thread
@@ -83,13 +109,118 @@ void MountPoint::mountStarted() {
   }
 }
 
+folly::Future<FuseChannelData> MountPoint::stopForTakeover() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (status_ != Status::RUNNING) {
+    return folly::makeFuture<FuseChannelData>(std::runtime_error(
+        folly::to<std::string>(path_, " is not running")));
+  }
+  status_ = Status::STOPPING_FOR_TAKEOVER;
+  takeoverPromise_ = folly::Promise<FuseChannelData>();
+  auto future = takeoverPromise_.getFuture();
+  channel_->stopForTakeover();
+  return future;
+}
+
+void MountPoint::completeTakeover() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (status_ != Status::STOPPED_FOR_TAKEOVER) {
+    throw std::runtime_error(folly::to<std::string>(
+        path_, " has not been stopped for a takeover"));
+  }
+  status_ = Status::TAKEN_OVER;
+  statusCV_.notify_all();
+}
+
+void MountPoint::resumeAfterTakeover() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (status_ == Status::STOPPED_FOR_TAKEOVER) {
+    status_ = Status::RUNNING;
+    statusCV_.notify_all();
+  }
+}
+
 void MountPoint::run(bool debug) {
-  // This next line is responsible for indirectly calling mount().
+  run(debug, folly::none);
+}
+
+void MountPoint::run(
+    bool debug,
+    folly::Optional<FuseChannelData> takeoverData) {
+  // This next line is responsible for indirectly calling mount(), unless we
+  // are taking over a device that is already mounted.
   dispatcher_->setMountPoint(this);
-  channel_ = std::make_unique<Channel>(this);
-  channel_->runSession(dispatcher_, debug);
+  if (takeoverData) {
+    channel_ = std::make_unique<Channel>(this, std::move(takeoverData.value()));
+  } else {
+    channel_ = std::make_unique<Channel>(this);
+  }
+
+  while (true) {
+    channel_->runSession(dispatcher_, debug);
+
+    bool takeover;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      takeover = (status_ == Status::STOPPING_FOR_TAKEOVER);
+    }
+    if (!takeover) {
+      break;
+    }
+    if (finishTakeover()) {
+      return;
+    }
+    // The takeover was abandoned, so continue serving requests.
+  }
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  channel_.reset();
+  dispatcher_->unsetMountPoint();
+}
+
+bool MountPoint::finishTakeover() {
+  // Requests that were read before the session stopped may still be running.
+  // Wait for them to reply, since the new process will never see them.
+  folly::Try<FuseChannelData> result;
+  auto timeout = std::chrono::seconds(FLAGS_fuse_takeover_request_timeout);
+  if (dispatcher_->waitForOutstandingRequests(timeout)) {
+    result = folly::makeTryWith([&] { return channel_->getTakeoverData(); });
+  } else {
+    auto message = folly::to<std::string>(
+        dispatcher_->getOutstandingRequestCount(),
+        " FUSE requests for ",
+        path_,
+        " did not finish within ",
+        FLAGS_fuse_takeover_request_timeout,
+        " seconds");
+    result = folly::Try<FuseChannelData>(
+        folly::make_exception_wrapper<std::runtime_error>(message));
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (result.hasException()) {
+    channel_->resumeAfterTakeover();
+    status_ = Status::RUNNING;
+    lock.unlock();
+    takeoverPromise_.setTry(std::move(result));
+    return false;
+  }
+
+  status_ = Status::STOPPED_FOR_TAKEOVER;
+  lock.unlock();
+  takeoverPromise_.setTry(std::move(result));
+  lock.lock();
+  statusCV_.wait(
+      lock, [this] { return status_ != Status::STOPPED_FOR_TAKEOVER; });
+
+  if (status_ != Status::TAKEN_OVER) {
+    channel_->resumeAfterTakeover();
+    return false;
+  }
+  channel_->releaseForTakeover();
   channel_.reset();
   dispatcher_->unsetMountPoint();
+  return true;
 }
 
 struct stat MountPoint::initStatData() const {
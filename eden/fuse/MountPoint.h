@@ -9,9 +9,12 @@
  */
 #pragma once
 
+#include <folly/Optional.h>
+#include <folly/futures/Future.h>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
+#include "eden/fuse/Channel.h"
 #include "eden/utils/PathFuncs.h"
 
 struct stat;
@@ -21,7 +24,6 @@ namespace eden {
 namespace fusell {
 
 class Dispatcher;
-class Channel;
 
 class MountPoint {
  public:
@@ -47,6 +49,46 @@ class MountPoint {
   void start(bool debug);
   void start(bool debug, const std::function<void()>& onStop);
 
+  /**
+   * Like start(), but serve a FUSE device that another process handed over
+   * to us during a graceful restart, rather than mounting the filesystem.
+   */
+  void takeoverStart(
+      bool debug,
+      FuseChannelData channelData,
+      const std::function<void()>& onStop);
+
+  /**
+   * Stop serving FUSE requests without unmounting the filesystem, so that
+   * another process can take over the mount point.
+   *
+   * The returned Future completes with the FUSE device once all outstanding
+   * requests have been replied to.  The mount point then waits for either
+   * completeTakeover() or resumeAfterTakeover() to be called.
+   *
+   * If the outstanding requests do not finish within
+   * --fuse_takeover_request_timeout seconds the Future fails, and the mount
+   * point resumes serving requests.
+   */
+  folly::Future<FuseChannelData> stopForTakeover();
+
+  /**
+   * Record that another process has taken over the FUSE device returned by
+   * stopForTakeover().
+   *
+   * The onStop() function passed to start() is then called without
+   * unmounting the filesystem.
+   */
+  void completeTakeover();
+
+  /**
+   * Continue serving FUSE requests after stopForTakeover(), because the
+   * other process did not take over the mount point.
+   *
+   * This does nothing if the mount point is not stopped for a takeover.
+   */
+  void resumeAfterTakeover();
+
   /**
    * Mount the file system, and run the fuse channel.
    *
@@ -94,12 +136,27 @@ class MountPoint {
   struct stat initStatData() const;
 
  private:
-  enum class Status { UNINIT, STARTING, RUNNING, ERROR };
+  enum class Status {
+    UNINIT,
+    STARTING,
+    RUNNING,
+    STOPPING_FOR_TAKEOVER,
+    STOPPED_FOR_TAKEOVER,
+    TAKEN_OVER,
+    ERROR,
+  };
 
   // Forbidden copy constructor and assignment operator
   MountPoint(MountPoint const&) = delete;
   MountPoint& operator=(MountPoint const&) = delete;
 
+  void startImpl(
+      bool debug,
+      const std::function<void()>& onStop,
+      folly::Optional<FuseChannelData> takeoverData);
+  void run(bool debug, folly::Optional<FuseChannelData> takeoverData);
+  bool finishTakeover();
+
   AbsolutePath const path_; // the path where this MountPoint is mounted
   uid_t uid_;
   gid_t gid_;
@@ -111,6 +168,7 @@ class MountPoint {
   std::condition_variable statusCV_;
   Status status_{Status::UNINIT};
   std::exception_ptr startError_;
+  folly::Promise<FuseChannelData> takeoverPromise_;
 };
 }
 }
@@ -8,6 +8,7 @@
  *
  */
 #include "RequestData.h"
+#include "BufVec.h"
 #include "Dispatcher.h"
 
 #include <glog/logging.h>
@@ -21,8 +22,10 @@ namespace fusell {
 
 const std::string RequestData::kKey("fusell");
 
-RequestData::RequestData(fuse_req_t req)
-    : req_(req), requestContext_(folly::RequestContext::saveContext()) {
+RequestData::RequestData(fuse_req_t req, fuse_ino_t ino)
+    : req_(req),
+      ino_(ino),
+      requestContext_(folly::RequestContext::saveContext()) {
   fuse_req_interrupt_func(req, RequestData::interrupter, this);
 }
 
@@ -54,10 +57,10 @@ RequestData& RequestData::get() {
   return *dynamic_cast<RequestData*>(data);
 }
 
-RequestData& RequestData::create(fuse_req_t req) {
+RequestData& RequestData::create(fuse_req_t req, fuse_ino_t ino) {
   folly::RequestContext::create();
   folly::RequestContext::get()->setContextData(
-      RequestData::kKey, std::make_unique<RequestData>(req));
+      RequestData::kKey, std::make_unique<RequestData>(req, ino));
   return get();
 }
 
@@ -68,6 +71,13 @@ Future<folly::Unit> RequestData::startRequest(
   DCHECK(latencyHistogram_ == nullptr);
   latencyHistogram_ = histogram;
   stats_ = stats;
+  DCHECK(dispatcher_ == nullptr);
+  dispatcher_ = getDispatcher();
+  dispatcher_->requestStarted();
+  trace_ = dispatcher_->getTracer().start(
+      EdenStats::getOperationName(histogram), ino_, getContext().pid);
+  // Let lower layers attribute backing store fetches to this request
+  RequestTrace::setCurrent(trace_.getTrace());
   return folly::Unit{};
 }
 
@@ -77,6 +87,11 @@ void RequestData::finishRequest() {
   stats_->get()->recordLatency(latencyHistogram_, diff, now);
   latencyHistogram_ = nullptr;
   stats_ = nullptr;
+  if (dispatcher_) {
+    dispatcher_->getTracer().finish(std::move(trace_));
+    dispatcher_->requestFinished();
+    dispatcher_ = nullptr;
+  }
 }
 
 fuse_req_t RequestData::stealReq() {
@@ -189,6 +204,35 @@ void RequestData::replyIov(const struct iovec* iov, int count) {
   checkKernelError(fuse_reply_iov(stealReq(), iov, count));
 }
 
+void RequestData::replyData(const BufVec& buf) {
+#ifdef FUSE_CAP_SPLICE_WRITE
+  if (buf.hasFileDescriptors()) {
+    auto bufs = buf.getFuseBufs();
+    // fuse_bufvec ends with a variable length array of fuse_buf structures.
+    auto allocSize =
+        sizeof(fuse_bufvec) + sizeof(fuse_buf) * (bufs.size() - 1);
+    std::unique_ptr<fuse_bufvec, void (*)(void*)> bufv{
+        static_cast<fuse_bufvec*>(malloc(allocSize)), free};
+    if (!bufv) {
+      throw std::bad_alloc();
+    }
+    bufv->count = bufs.size();
+    bufv->idx = 0;
+    bufv->off = 0;
+    std::copy(bufs.begin(), bufs.end(), bufv->buf);
+
+    // fuse_reply_data() falls back to reading the data into memory itself if
+    // splicing is not enabled or fails for this request.
+    checkKernelError(
+        fuse_reply_data(stealReq(), bufv.get(), FUSE_BUF_SPLICE_MOVE));
+    return;
+  }
+#endif
+
+  auto iov = buf.getIov();
+  replyIov(iov.data(), iov.size());
+}
+
 void RequestData::replyStatfs(const struct statvfs& st) {
   checkKernelError(fuse_reply_statfs(stealReq(), &st));
 }
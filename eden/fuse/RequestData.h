@@ -12,23 +12,31 @@
 #include <folly/futures/Future.h>
 #include <folly/io/async/Request.h>
 #include "eden/fuse/EdenStats.h"
+#include "eden/fuse/RequestTracer.h"
 #include "eden/fuse/fuse_headers.h"
 
 namespace facebook {
 namespace eden {
 namespace fusell {
 
+class BufVec;
 class Channel;
 class Dispatcher;
 
 class RequestData : public folly::RequestData {
   std::atomic<fuse_req_t> req_;
+  // The inode that the request operates on, for tracing
+  fuse_ino_t ino_{0};
   // We're managed by this context, so we only keep a weak ref
   std::weak_ptr<folly::RequestContext> requestContext_;
   // Needed to track stats
   std::chrono::time_point<std::chrono::steady_clock> startTime_;
   EdenStats::HistogramPtr latencyHistogram_{nullptr};
   folly::ThreadLocal<EdenStats>* stats_{nullptr};
+  // The dispatcher whose outstanding request count includes this request
+  Dispatcher* dispatcher_{nullptr};
+  // This request's entry in the dispatcher's RequestTracer
+  RequestTracer::ActiveRequest trace_;
 
   static void interrupter(fuse_req_t req, void* data);
   fuse_req_t stealReq();
@@ -44,9 +52,15 @@ class RequestData : public folly::RequestData {
   RequestData& operator=(const RequestData&) = delete;
   RequestData(RequestData&&) = default;
   RequestData& operator=(RequestData&&) = default;
-  explicit RequestData(fuse_req_t req);
+  explicit RequestData(fuse_req_t req, fuse_ino_t ino = 0);
   static RequestData& get();
-  static RequestData& create(fuse_req_t req);
+  /**
+   * Create the RequestData for a new request, in a new RequestContext.
+   *
+   * ino is the inode that the request operates on (or the parent directory
+   * for operations on a directory entry), and is recorded for tracing.
+   */
+  static RequestData& create(fuse_req_t req, fuse_ino_t ino = 0);
 
   // Returns true if the current context is being called from inside
   // a FUSE request, false otherwise.
@@ -136,6 +150,10 @@ class RequestData : public folly::RequestData {
   void replyWrite(size_t count);
   void replyBuf(const char* buf, size_t size);
   void replyIov(const struct iovec* iov, int count);
+  // Reply with read data.  File descriptor backed data is spliced into the
+  // kernel when the connection supports it, rather than being copied through
+  // a userspace buffer.
+  void replyData(const BufVec& buf);
   void replyStatfs(const struct statvfs& st);
   void replyXattr(size_t count);
   void replyLock(struct flock& lock);
@@ -0,0 +1,140 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "RequestTracer.h"
+
+#include <gflags/gflags.h>
+#include <algorithm>
+
+DEFINE_int32(
+    fuse_trace_buffer_size,
+    256,
+    "The number of completed FUSE requests to remember per thread, "
+    "for debugging slow requests");
+
+using folly::StringPiece;
+
+namespace facebook {
+namespace eden {
+namespace fusell {
+
+RequestTracer::RequestTracer(size_t completedPerThread)
+    : completedPerThread_{completedPerThread} {}
+
+RequestTracer::RequestTracer()
+    : RequestTracer{static_cast<size_t>(
+          std::max(FLAGS_fuse_trace_buffer_size, 0))} {}
+
+RequestTracer::~RequestTracer() {}
+
+RequestTracer::Shard* RequestTracer::getShard() {
+  auto& shard = *threadShard_;
+  if (!shard) {
+    auto newShard = std::make_unique<Shard>(completedPerThread_);
+    shard = newShard.get();
+    shards_.wlock()->push_back(std::move(newShard));
+  }
+  return shard;
+}
+
+RequestTracer::ActiveRequest
+RequestTracer::start(StringPiece operation, fuse_ino_t inode, pid_t pid) {
+  auto trace = std::make_shared<RequestTrace>(
+      nextRequestId_.fetch_add(1, std::memory_order_relaxed),
+      operation,
+      inode,
+      pid);
+
+  auto* shard = getShard();
+  {
+    std::lock_guard<std::mutex> guard(shard->mutex);
+    shard->inFlight.emplace(trace->getRequestId(), trace);
+  }
+  return ActiveRequest{std::move(trace), shard};
+}
+
+void RequestTracer::finish(ActiveRequest&& request) {
+  if (!request.trace_) {
+    return;
+  }
+  request.trace_->finish();
+
+  auto* shard = request.shard_;
+  std::lock_guard<std::mutex> guard(shard->mutex);
+  shard->inFlight.erase(request.trace_->getRequestId());
+  if (completedPerThread_ == 0) {
+    return;
+  }
+  if (shard->completed.size() < completedPerThread_) {
+    shard->completed.push_back(std::move(request.trace_));
+  } else {
+    shard->completed[shard->nextCompleted] = std::move(request.trace_);
+  }
+  shard->nextCompleted = (shard->nextCompleted + 1) % completedPerThread_;
+}
+
+std::vector<RequestTrace::Info> RequestTracer::getOutstanding() const {
+  std::vector<RequestTrace::Info> results;
+  {
+    auto shards = shards_.rlock();
+    for (const auto& shard : *shards) {
+      std::lock_guard<std::mutex> guard(shard->mutex);
+      for (const auto& entry : shard->inFlight) {
+        results.push_back(entry.second->getInfo());
+      }
+    }
+  }
+
+  std::sort(
+      results.begin(),
+      results.end(),
+      [](const RequestTrace::Info& a, const RequestTrace::Info& b) {
+        return a.requestId < b.requestId;
+      });
+  return results;
+}
+
+std::vector<RequestTrace::Info> RequestTracer::getSlowest(size_t count) const {
+  // Pick the slowest requests before copying out their details, which
+  // involves allocating memory for each of them.
+  std::vector<std::shared_ptr<RequestTrace>> traces;
+  {
+    auto shards = shards_.rlock();
+    for (const auto& shard : *shards) {
+      std::lock_guard<std::mutex> guard(shard->mutex);
+      traces.insert(
+          traces.end(), shard->completed.begin(), shard->completed.end());
+    }
+  }
+
+  std::vector<std::pair<std::chrono::microseconds, RequestTrace*>> durations;
+  durations.reserve(traces.size());
+  for (const auto& trace : traces) {
+    durations.emplace_back(trace->getDuration(), trace.get());
+  }
+  count = std::min(count, durations.size());
+  std::partial_sort(
+      durations.begin(),
+      durations.begin() + count,
+      durations.end(),
+      [](const std::pair<std::chrono::microseconds, RequestTrace*>& a,
+         const std::pair<std::chrono::microseconds, RequestTrace*>& b) {
+        return a.first > b.first;
+      });
+
+  std::vector<RequestTrace::Info> results;
+  results.reserve(count);
+  for (size_t n = 0; n < count; ++n) {
+    results.push_back(durations[n].second->getInfo());
+  }
+  return results;
+}
+}
+}
+}
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+#include <folly/Range.h>
+#include <folly/Synchronized.h>
+#include <folly/ThreadLocal.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "eden/fuse/fuse_headers.h"
+#include "eden/utils/RequestTrace.h"
+
+namespace facebook {
+namespace eden {
+namespace fusell {
+
+/**
+ * Keeps track of the in-flight FUSE requests for a Dispatcher, and of the
+ * most recently completed ones, for debugging slow requests.
+ *
+ * Each thread that starts requests gets its own shard, holding the requests
+ * that it started and a fixed size ring buffer of the ones that have
+ * finished.  A request may finish on a different thread than it started on,
+ * but it is always recorded in the shard it started in, so the shard locks
+ * are almost never contended.
+ */
+class RequestTracer {
+  class Shard;
+
+ public:
+  /**
+   * A request registered with start().  The request must be passed to
+   * finish() once it is complete.
+   */
+  class ActiveRequest {
+   public:
+    ActiveRequest() {}
+
+    const std::shared_ptr<RequestTrace>& getTrace() const {
+      return trace_;
+    }
+
+   private:
+    friend class RequestTracer;
+    ActiveRequest(std::shared_ptr<RequestTrace> trace, Shard* shard)
+        : trace_{std::move(trace)}, shard_{shard} {}
+
+    std::shared_ptr<RequestTrace> trace_;
+    Shard* shard_{nullptr};
+  };
+
+  /**
+   * Create a RequestTracer that remembers up to completedPerThread finished
+   * requests for each thread.
+   */
+  explicit RequestTracer(size_t completedPerThread);
+  RequestTracer();
+  ~RequestTracer();
+
+  ActiveRequest
+  start(folly::StringPiece operation, fuse_ino_t inode, pid_t pid);
+  void finish(ActiveRequest&& request);
+
+  /** Returns the requests that have not finished yet, oldest first. */
+  std::vector<RequestTrace::Info> getOutstanding() const;
+
+  /** Returns the slowest recently completed requests, slowest first. */
+  std::vector<RequestTrace::Info> getSlowest(size_t count) const;
+
+ private:
+  class Shard {
+   public:
+    explicit Shard(size_t capacity) {
+      completed.reserve(capacity);
+    }
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<RequestTrace>> inFlight;
+    std::vector<std::shared_ptr<RequestTrace>> completed;
+    size_t nextCompleted{0};
+  };
+
+  Shard* getShard();
+
+  const size_t completedPerThread_;
+  std::atomic<uint64_t> nextRequestId_{1};
+  folly::ThreadLocal<Shard*> threadShard_;
+  /**
+   * All of the shards ever created.  Shards are kept after their thread
+   * exits, since requests that they started may still be in flight.
+   */
+  folly::Synchronized<std::vector<std::unique_ptr<Shard>>> shards_;
+};
+}
+}
+}
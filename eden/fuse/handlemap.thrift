@@ -0,0 +1,16 @@
+namespace cpp2 facebook.eden.fusell
+
+// An open file or directory handle, recorded so that it can be reopened with
+// the same handle number by another process during a graceful restart.
+struct FileHandleMapEntry {
+  1: i64 inodeNumber
+  2: i64 handleId
+  3: bool isDir
+  // The flags the handle was opened with, minus any that would modify the
+  // file if they were applied again (such as O_TRUNC).
+  4: i32 flags
+}
+
+struct SerializedFileHandleMap {
+  1: list<FileHandleMapEntry> entries
+}
@@ -11,6 +11,8 @@
 
 #include <folly/Range.h>
 #include <sys/types.h>
+#include <string>
+#include <vector>
 
 namespace folly {
 class File;
@@ -87,6 +89,22 @@ folly::File privilegedFuseMount(folly::StringPiece mountPath);
  */
 void privilegedFuseUnmount(folly::StringPiece mountPath);
 
+/*
+ * Ask the privileged helper process to forget about a fuse mount that another
+ * edenfs process has taken over, so that it is not unmounted when we exit.
+ * Its bind mounts are forgotten too.  Throws an exception on error.
+ */
+void privilegedFuseTakeoverShutdown(folly::StringPiece mountPath);
+
+/*
+ * Tell the privileged helper process about a fuse mount and its bind mounts
+ * that we have taken over from another edenfs process, so that they are
+ * unmounted when we exit.  Throws an exception on error.
+ */
+void privilegedFuseTakeoverStartup(
+    folly::StringPiece mountPath,
+    const std::vector<std::string>& bindMounts);
+
 /*
  * @param clientPath Absolute path (that should be under
  *     .eden/clients/<client-name>/bind-mounts/) where the "real" storage is.
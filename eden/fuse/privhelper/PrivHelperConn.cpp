@@ -332,6 +332,53 @@ void PrivHelperConn::parseUnmountRequest(Message* msg, string& mountPoint) {
   deserializeMessage(msg, parseBody);
 }
 
+void PrivHelperConn::serializeTakeoverShutdownRequest(
+    Message* msg,
+    StringPiece mountPoint) {
+  auto serializeBody = [&](Appender& a) { serializeString(a, mountPoint); };
+  serializeMessage(msg, REQ_TAKEOVER_SHUTDOWN, serializeBody);
+}
+
+void PrivHelperConn::parseTakeoverShutdownRequest(
+    Message* msg,
+    string& mountPoint) {
+  CHECK_EQ(msg->msgType, REQ_TAKEOVER_SHUTDOWN);
+  auto parseBody = [&](Cursor& cursor) {
+    mountPoint = deserializeString(cursor);
+  };
+  deserializeMessage(msg, parseBody);
+}
+
+void PrivHelperConn::serializeTakeoverStartupRequest(
+    Message* msg,
+    StringPiece mountPoint,
+    const std::vector<string>& bindMounts) {
+  auto serializeBody = [&](Appender& a) {
+    serializeString(a, mountPoint);
+    a.writeBE<uint32_t>(bindMounts.size());
+    for (const auto& bindMount : bindMounts) {
+      serializeString(a, bindMount);
+    }
+  };
+  serializeMessage(msg, REQ_TAKEOVER_STARTUP, serializeBody);
+}
+
+void PrivHelperConn::parseTakeoverStartupRequest(
+    Message* msg,
+    string& mountPoint,
+    std::vector<string>& bindMounts) {
+  CHECK_EQ(msg->msgType, REQ_TAKEOVER_STARTUP);
+  auto parseBody = [&](Cursor& cursor) {
+    mountPoint = deserializeString(cursor);
+    auto numBindMounts = cursor.readBE<uint32_t>();
+    bindMounts.clear();
+    for (uint32_t n = 0; n < numBindMounts; ++n) {
+      bindMounts.push_back(deserializeString(cursor));
+    }
+  };
+  deserializeMessage(msg, parseBody);
+}
+
 void PrivHelperConn::serializeEmptyResponse(Message* msg) {
   msg->msgType = RESP_EMPTY;
   msg->dataSize = 0;
@@ -25,6 +25,7 @@
 #include <unistd.h>
 #include <chrono>
 #include <set>
+#include <vector>
 
 #include "PrivHelperConn.h"
 
@@ -204,6 +205,63 @@ void PrivHelperServer::processBindMountMsg(PrivHelperConn::Message* msg) {
   conn_.sendMsg(msg);
 }
 
+void PrivHelperServer::processTakeoverShutdownMsg(
+    PrivHelperConn::Message* msg) {
+  string mountPath;
+  conn_.parseTakeoverShutdownRequest(msg, mountPath);
+
+  try {
+    auto it = mountPoints_.find(mountPath);
+    if (it == mountPoints_.end()) {
+      throw std::domain_error(
+          folly::to<string>("No FUSE mount found for ", mountPath));
+    }
+
+    // Another edenfs process is now serving this mount point, so forget it
+    // without unmounting it or its bind mounts.
+    bindMountPoints_.erase(mountPath);
+    mountPoints_.erase(it);
+    conn_.serializeEmptyResponse(msg);
+  } catch (const std::exception& ex) {
+    // Note that we re-use the request message buffer for the response data
+    conn_.serializeErrorResponse(msg, ex);
+    conn_.sendMsg(msg);
+    return;
+  }
+
+  // Note that we re-use the request message buffer for the response data
+  conn_.sendMsg(msg);
+}
+
+void PrivHelperServer::processTakeoverStartupMsg(
+    PrivHelperConn::Message* msg) {
+  string mountPath;
+  std::vector<string> bindMounts;
+  conn_.parseTakeoverStartupRequest(msg, mountPath, bindMounts);
+
+  try {
+    // Our process has taken over this mount point and its bind mounts from
+    // another edenfs process, so unmount them when we exit.
+    auto ret = mountPoints_.insert(mountPath);
+    if (!ret.second) {
+      throw std::domain_error(
+          folly::to<string>("FUSE mount already exists for ", mountPath));
+    }
+    for (auto& bindMount : bindMounts) {
+      bindMountPoints_.insert({mountPath, std::move(bindMount)});
+    }
+    conn_.serializeEmptyResponse(msg);
+  } catch (const std::exception& ex) {
+    // Note that we re-use the request message buffer for the response data
+    conn_.serializeErrorResponse(msg, ex);
+    conn_.sendMsg(msg);
+    return;
+  }
+
+  // Note that we re-use the request message buffer for the response data
+  conn_.sendMsg(msg);
+}
+
 void PrivHelperServer::messageLoop() {
   PrivHelperConn::Message msg;
 
@@ -216,6 +274,10 @@ void PrivHelperServer::messageLoop() {
       processBindMountMsg(&msg);
     } else if (msgType == PrivHelperConn::REQ_UNMOUNT_FUSE) {
       processUnmountMsg(&msg);
+    } else if (msgType == PrivHelperConn::REQ_TAKEOVER_SHUTDOWN) {
+      processTakeoverShutdownMsg(&msg);
+    } else if (msgType == PrivHelperConn::REQ_TAKEOVER_STARTUP) {
+      processTakeoverStartupMsg(&msg);
     } else {
       // This shouldn't ever happen unless we have a bug.
       // Crash if it does occur.  (We could send back an error message and
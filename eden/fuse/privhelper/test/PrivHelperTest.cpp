@@ -269,3 +269,58 @@ TEST(PrivHelper, ServerShutdownTest) {
   EXPECT_FALSE(server.isMounted(bar));
   EXPECT_FALSE(server.isMounted(other));
 }
+
+TEST(PrivHelper, SerializeTakeoverStartup) {
+  PrivHelperConn::Message msg;
+  std::vector<string> bindMounts{"/mnt/foo/buck-out", "/mnt/foo/a/b"};
+  PrivHelperConn::serializeTakeoverStartupRequest(&msg, "/mnt/foo", bindMounts);
+
+  string readMountPath;
+  std::vector<string> readBindMounts;
+  PrivHelperConn::parseTakeoverStartupRequest(
+      &msg, readMountPath, readBindMounts);
+  EXPECT_EQ("/mnt/foo", readMountPath);
+  EXPECT_EQ(bindMounts, readBindMounts);
+}
+
+TEST(PrivHelper, TakeoverTest) {
+  TemporaryDirectory tmpDir;
+  PrivHelperTestServer server;
+
+  auto fooDir = tmpDir.path() / "foo";
+  create_directory(fooDir);
+  auto foo = fooDir.string();
+  auto mountedBuckOut = tmpDir.path() / "foo" / "buck-out";
+
+  {
+    startPrivHelper(&server, getuid(), getgid());
+    SCOPE_EXIT {
+      stopPrivHelper();
+    };
+
+    privilegedFuseMount(foo);
+    TemporaryDirectory realBuckOut;
+    privilegedBindMount(realBuckOut.path().c_str(), mountedBuckOut.c_str());
+
+    // Hand the mount point over to another process.
+    privilegedFuseTakeoverShutdown(foo);
+  }
+
+  // The mounts are left in place when the privhelper quits.
+  EXPECT_TRUE(server.isMounted(foo));
+  EXPECT_TRUE(server.isBindMounted(mountedBuckOut.string()));
+
+  {
+    startPrivHelper(&server, getuid(), getgid());
+    SCOPE_EXIT {
+      stopPrivHelper();
+    };
+
+    // Take the mount point over from the other process.
+    privilegedFuseTakeoverStartup(foo, {mountedBuckOut.string()});
+  }
+
+  // The taken over mounts are unmounted when the privhelper quits.
+  EXPECT_FALSE(server.isMounted(foo));
+  EXPECT_FALSE(server.isBindMounted(mountedBuckOut.string()));
+}
@@ -0,0 +1,150 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fuse/RequestTracer.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace facebook::eden;
+using namespace facebook::eden::fusell;
+using std::vector;
+
+namespace {
+vector<uint64_t> getRequestIds(const vector<RequestTrace::Info>& infos) {
+  vector<uint64_t> ids;
+  for (const auto& info : infos) {
+    ids.push_back(info.requestId);
+  }
+  return ids;
+}
+
+vector<uint64_t> sorted(vector<uint64_t> ids) {
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+}
+
+TEST(RequestTracer, outstanding) {
+  RequestTracer tracer{4};
+  EXPECT_TRUE(tracer.getOutstanding().empty());
+
+  auto lookup = tracer.start("lookup", 1, 100);
+  auto read = tracer.start("read", 2, 101);
+  auto outstanding = tracer.getOutstanding();
+  ASSERT_EQ(2, outstanding.size());
+  EXPECT_EQ(lookup.getTrace()->getRequestId(), outstanding[0].requestId);
+  EXPECT_EQ("lookup", outstanding[0].operation);
+  EXPECT_EQ(1, outstanding[0].inodeNumber);
+  EXPECT_EQ(100, outstanding[0].pid);
+  EXPECT_FALSE(outstanding[0].finished);
+  EXPECT_EQ(read.getTrace()->getRequestId(), outstanding[1].requestId);
+  EXPECT_EQ("read", outstanding[1].operation);
+
+  tracer.finish(std::move(lookup));
+  outstanding = tracer.getOutstanding();
+  ASSERT_EQ(1, outstanding.size());
+  EXPECT_EQ("read", outstanding[0].operation);
+
+  tracer.finish(std::move(read));
+  EXPECT_TRUE(tracer.getOutstanding().empty());
+}
+
+TEST(RequestTracer, ringBufferWrapsAround) {
+  RequestTracer tracer{3};
+  vector<uint64_t> ids;
+  for (int n = 0; n < 5; ++n) {
+    auto request = tracer.start("getattr", n, 100);
+    ids.push_back(request.getTrace()->getRequestId());
+    tracer.finish(std::move(request));
+  }
+
+  // Only the three most recently completed requests are remembered.
+  auto slowest = tracer.getSlowest(10);
+  EXPECT_EQ(
+      (vector<uint64_t>{ids[2], ids[3], ids[4]}),
+      sorted(getRequestIds(slowest)));
+  for (const auto& info : slowest) {
+    EXPECT_TRUE(info.finished);
+  }
+
+  // Keep wrapping around more than once.
+  for (int n = 0; n < 4; ++n) {
+    auto request = tracer.start("getattr", n, 100);
+    ids.push_back(request.getTrace()->getRequestId());
+    tracer.finish(std::move(request));
+  }
+  EXPECT_EQ(
+      (vector<uint64_t>{ids[6], ids[7], ids[8]}),
+      sorted(getRequestIds(tracer.getSlowest(10))));
+}
+
+TEST(RequestTracer, noCompletedBuffer) {
+  RequestTracer tracer{0};
+  auto request = tracer.start("read", 1, 100);
+  EXPECT_EQ(1, tracer.getOutstanding().size());
+  tracer.finish(std::move(request));
+  EXPECT_TRUE(tracer.getOutstanding().empty());
+  EXPECT_TRUE(tracer.getSlowest(10).empty());
+}
+
+TEST(RequestTracer, getSlowest) {
+  RequestTracer tracer{8};
+
+  // Start the requests a few milliseconds apart and finish them together,
+  // so the ones started first take the longest.
+  vector<RequestTracer::ActiveRequest> requests;
+  vector<uint64_t> ids;
+  for (int n = 0; n < 4; ++n) {
+    requests.push_back(tracer.start("read", n, 100));
+    ids.push_back(requests.back().getTrace()->getRequestId());
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  for (auto& request : requests) {
+    tracer.finish(std::move(request));
+  }
+
+  auto slowest = tracer.getSlowest(2);
+  EXPECT_EQ((vector<uint64_t>{ids[0], ids[1]}), getRequestIds(slowest));
+  EXPECT_GE(slowest[0].duration, slowest[1].duration);
+
+  EXPECT_EQ(
+      (vector<uint64_t>{ids[0], ids[1], ids[2], ids[3]}),
+      getRequestIds(tracer.getSlowest(10)));
+  EXPECT_TRUE(tracer.getSlowest(0).empty());
+}
+
+TEST(RequestTracer, requestsFromManyThreads) {
+  // With room for only one completed request per thread, both requests
+  // below are only remembered if each is recorded in the shard of the
+  // thread that started it, rather than the one that finished it.
+  RequestTracer tracer{1};
+
+  vector<RequestTracer::ActiveRequest> requests(2);
+  std::thread first{[&] { requests[0] = tracer.start("lookup", 1, 100); }};
+  std::thread second{[&] { requests[1] = tracer.start("read", 2, 101); }};
+  first.join();
+  second.join();
+
+  auto ids = sorted(vector<uint64_t>{requests[0].getTrace()->getRequestId(),
+                                     requests[1].getTrace()->getRequestId()});
+  EXPECT_EQ(ids, getRequestIds(tracer.getOutstanding()));
+
+  // Finish both requests on this thread.
+  tracer.finish(std::move(requests[1]));
+  auto outstanding = tracer.getOutstanding();
+  ASSERT_EQ(1, outstanding.size());
+  EXPECT_EQ("lookup", outstanding[0].operation);
+  tracer.finish(std::move(requests[0]));
+  EXPECT_TRUE(tracer.getOutstanding().empty());
+
+  EXPECT_EQ(ids, sorted(getRequestIds(tracer.getSlowest(10))));
+}
@@ -117,3 +117,13 @@ class ThriftTest:
             self.client.glob(self.mount, ['adir['])
         self.assertIn('unterminated bracket sequence',
                       str(ctx.exception))
+
+    def test_glob_does_not_load_unmaterialized_trees(self):
+        self.assertEqual(
+            ['adir/file'], self.client.glob(self.mount, ['**/file']))
+        loaded_paths = [
+            info.path for info in self.client.debugInodeStatus(self.mount, '')
+        ]
+        self.assertNotIn(b'adir', loaded_paths,
+                         msg='Glob should read source control Trees '
+                         'rather than load TreeInodes')
@@ -144,6 +144,8 @@ class PathMap : private folly::fbvector<std::pair<Key, Value>, Allocator> {
   using Vector::max_size;
   using Vector::clear;
   using Vector::erase;
+  using Vector::reserve;
+  using Vector::capacity;
 
   // Swap contents with another map.
   void swap(PathMap& other) noexcept {
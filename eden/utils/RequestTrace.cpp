@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/utils/RequestTrace.h"
+
+#include <folly/io/async/Request.h>
+
+using folly::StringPiece;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+namespace facebook {
+namespace eden {
+
+namespace {
+const std::string kRequestTraceKey{"eden.trace"};
+
+/** Holds the RequestTrace in the folly::RequestContext. */
+class RequestTraceData : public folly::RequestData {
+ public:
+  explicit RequestTraceData(std::shared_ptr<RequestTrace> trace)
+      : trace{std::move(trace)} {}
+
+  std::shared_ptr<RequestTrace> trace;
+};
+}
+
+RequestTrace::RequestTrace(
+    uint64_t requestId,
+    StringPiece operation,
+    uint64_t inodeNumber,
+    pid_t pid)
+    : requestId_{requestId},
+      operation_{operation.str()},
+      inodeNumber_{inodeNumber},
+      pid_{pid},
+      startTime_{Clock::now()} {}
+
+std::shared_ptr<RequestTrace> RequestTrace::current() {
+  auto* context = folly::RequestContext::get();
+  auto* data =
+      static_cast<RequestTraceData*>(context->getContextData(kRequestTraceKey));
+  if (!data) {
+    return nullptr;
+  }
+  return data->trace;
+}
+
+void RequestTrace::setCurrent(std::shared_ptr<RequestTrace> trace) {
+  folly::RequestContext::get()->setContextData(
+      kRequestTraceKey, std::make_unique<RequestTraceData>(std::move(trace)));
+}
+
+RequestTrace::Fetch RequestTrace::startFetch(StringPiece type, StringPiece id) {
+  auto trace = current();
+  if (!trace) {
+    return Fetch{};
+  }
+
+  auto now = Clock::now();
+  size_t index;
+  {
+    auto state = trace->state_.wlock();
+    index = state->fetches.size();
+    state->fetches.emplace_back();
+    auto& fetch = state->fetches.back();
+    fetch.type = type.str();
+    fetch.id = id.str();
+    fetch.startOffset = duration_cast<microseconds>(now - trace->startTime_);
+    state->fetchStartTimes.push_back(now);
+  }
+  return Fetch{std::move(trace), index};
+}
+
+void RequestTrace::Fetch::finish() const {
+  if (!trace_) {
+    return;
+  }
+
+  auto now = Clock::now();
+  auto state = trace_->state_.wlock();
+  auto& fetch = state->fetches[index_];
+  fetch.duration =
+      duration_cast<microseconds>(now - state->fetchStartTimes[index_]);
+  fetch.finished = true;
+}
+
+void RequestTrace::finish() {
+  auto now = Clock::now();
+  auto state = state_.wlock();
+  if (!state->endTime) {
+    state->endTime = now;
+  }
+}
+
+microseconds RequestTrace::getDuration() const {
+  auto state = state_.rlock();
+  auto endTime = state->endTime ? state->endTime.value() : Clock::now();
+  return duration_cast<microseconds>(endTime - startTime_);
+}
+
+RequestTrace::Info RequestTrace::getInfo() const {
+  Info info;
+  info.requestId = requestId_;
+  info.operation = operation_;
+  info.inodeNumber = inodeNumber_;
+  info.pid = pid_;
+
+  auto now = Clock::now();
+  auto state = state_.rlock();
+  info.finished = state->endTime.hasValue();
+  auto endTime = info.finished ? state->endTime.value() : now;
+  info.duration = duration_cast<microseconds>(endTime - startTime_);
+  info.fetches = state->fetches;
+  for (size_t n = 0; n < info.fetches.size(); ++n) {
+    auto& fetch = info.fetches[n];
+    if (!fetch.finished) {
+      fetch.duration =
+          duration_cast<microseconds>(now - state->fetchStartTimes[n]);
+    }
+  }
+  return info;
+}
+}
+}
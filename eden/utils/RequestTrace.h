@@ -0,0 +1,134 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/Synchronized.h>
+#include <sys/types.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace eden {
+
+/**
+ * A record of a single request being processed, and of the backing store
+ * fetches that it had to wait on.
+ *
+ * The FUSE layer creates a RequestTrace for each request and installs it in
+ * the request's folly::RequestContext.  Lower layers such as the ObjectStore
+ * can then call RequestTrace::startFetch() to attribute slow operations to
+ * the request that triggered them, without depending on the FUSE code.
+ */
+class RequestTrace {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct FetchInfo {
+    /** The kind of object fetched, such as "tree" or "blob". */
+    std::string type;
+    std::string id;
+    /** When the fetch started, relative to the start of the request. */
+    std::chrono::microseconds startOffset{0};
+    /** The duration of the fetch, or the time so far if it is unfinished. */
+    std::chrono::microseconds duration{0};
+    bool finished{false};
+  };
+
+  /** A snapshot of the state of a RequestTrace. */
+  struct Info {
+    uint64_t requestId{0};
+    std::string operation;
+    uint64_t inodeNumber{0};
+    pid_t pid{0};
+    /** The duration of the request, or the time so far if it is unfinished. */
+    std::chrono::microseconds duration{0};
+    bool finished{false};
+    std::vector<FetchInfo> fetches;
+  };
+
+  /**
+   * A handle to a fetch started with startFetch().
+   *
+   * The handle is a no-op if there was no RequestTrace for the current
+   * request.
+   */
+  class Fetch {
+   public:
+    Fetch() {}
+
+    /** Record that the fetch has finished. */
+    void finish() const;
+
+   private:
+    friend class RequestTrace;
+    Fetch(std::shared_ptr<RequestTrace> trace, size_t index)
+        : trace_{std::move(trace)}, index_{index} {}
+
+    std::shared_ptr<RequestTrace> trace_;
+    size_t index_{0};
+  };
+
+  RequestTrace(
+      uint64_t requestId,
+      folly::StringPiece operation,
+      uint64_t inodeNumber,
+      pid_t pid);
+
+  /**
+   * Get the RequestTrace installed in the current folly::RequestContext.
+   *
+   * Returns null if the current request is not being traced.
+   */
+  static std::shared_ptr<RequestTrace> current();
+
+  /** Install a RequestTrace in the current folly::RequestContext. */
+  static void setCurrent(std::shared_ptr<RequestTrace> trace);
+
+  /**
+   * Record the start of a fetch in the current request's RequestTrace, if
+   * there is one.
+   */
+  static Fetch startFetch(folly::StringPiece type, folly::StringPiece id);
+
+  uint64_t getRequestId() const {
+    return requestId_;
+  }
+
+  /** Record that the request has finished. */
+  void finish();
+
+  /**
+   * Returns the duration of the request, or the time so far if the request
+   * has not finished yet.
+   */
+  std::chrono::microseconds getDuration() const;
+
+  Info getInfo() const;
+
+ private:
+  struct State {
+    folly::Optional<Clock::time_point> endTime;
+    std::vector<FetchInfo> fetches;
+    std::vector<Clock::time_point> fetchStartTimes;
+  };
+
+  const uint64_t requestId_;
+  const std::string operation_;
+  const uint64_t inodeNumber_;
+  const pid_t pid_;
+  const Clock::time_point startTime_;
+  folly::Synchronized<State> state_;
+};
+}
+}
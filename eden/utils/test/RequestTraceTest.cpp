@@ -0,0 +1,57 @@
+/*
+ *  Copyright (c) 2017-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/utils/RequestTrace.h"
+
+#include <folly/io/async/Request.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::eden;
+
+TEST(RequestTrace, startFetchWithoutTrace) {
+  folly::RequestContext::create();
+  EXPECT_EQ(nullptr, RequestTrace::current());
+
+  // This should be a no-op
+  auto fetch = RequestTrace::startFetch("blob", "1234");
+  fetch.finish();
+}
+
+TEST(RequestTrace, recordsFetches) {
+  folly::RequestContext::create();
+  auto trace = std::make_shared<RequestTrace>(7, "lookup", 1, 1234);
+  RequestTrace::setCurrent(trace);
+  EXPECT_EQ(trace, RequestTrace::current());
+
+  auto treeFetch = RequestTrace::startFetch("tree", "abcd");
+  auto blobFetch = RequestTrace::startFetch("blob", "1234");
+  treeFetch.finish();
+
+  auto info = trace->getInfo();
+  EXPECT_EQ(7, info.requestId);
+  EXPECT_EQ("lookup", info.operation);
+  EXPECT_EQ(1, info.inodeNumber);
+  EXPECT_EQ(1234, info.pid);
+  EXPECT_FALSE(info.finished);
+  ASSERT_EQ(2, info.fetches.size());
+  EXPECT_EQ("tree", info.fetches[0].type);
+  EXPECT_EQ("abcd", info.fetches[0].id);
+  EXPECT_TRUE(info.fetches[0].finished);
+  EXPECT_EQ("blob", info.fetches[1].type);
+  EXPECT_EQ("1234", info.fetches[1].id);
+  EXPECT_FALSE(info.fetches[1].finished);
+  EXPECT_LE(info.fetches[0].startOffset, info.fetches[1].startOffset);
+
+  blobFetch.finish();
+  trace->finish();
+  info = trace->getInfo();
+  EXPECT_TRUE(info.finished);
+  EXPECT_TRUE(info.fetches[1].finished);
+  EXPECT_EQ(info.duration, trace->getDuration());
+}